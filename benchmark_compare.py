@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Compare two microbenchmark result files written with 'cassini --benchmark --benchmark-out'.
+
+Exits with 1 if any benchmark present in both files got slower than the threshold."""
+
+import argparse
+import json
+import sys
+
+
+def read_results(filename):
+    """Read benchmark results as a name -> real time per iteration dictionary."""
+    with open(filename, "r") as fd:
+        data = json.load(fd)
+    ret = {}
+    for benchmark in data["benchmarks"]:
+        if benchmark.get("run_type", "iteration") != "iteration":
+            continue
+        ret[benchmark["name"]] = float(benchmark["real_time"])
+    return ret
+
+
+def main():
+    """Main function."""
+    parser = argparse.ArgumentParser(usage="%(prog)s [options] baseline.json contender.json", description=__doc__)
+    parser.add_argument("baseline", help="Results before the change.")
+    parser.add_argument("contender", help="Results after the change.")
+    parser.add_argument("-t", "--threshold", type=float, default=0.1,
+                        help="Relative slowdown reported as regression (default: %(default)s).")
+    args = parser.parse_args()
+
+    baseline = read_results(args.baseline)
+    contender = read_results(args.contender)
+    regressions = []
+
+    print("%-48s %14s %14s %9s" % ("benchmark", "baseline ns", "contender ns", "change"))
+    for name in baseline:
+        if name not in contender:
+            print("%-48s %14.0f %14s" % (name, baseline[name], "missing"))
+            continue
+        change = (contender[name] - baseline[name]) / baseline[name] if baseline[name] > 0.0 else 0.0
+        mark = ""
+        if change > args.threshold:
+            regressions.append(name)
+            mark = " REGRESSION"
+        print("%-48s %14.0f %14.0f %+8.1f%%%s" % (name, baseline[name], contender[name], change * 100.0, mark))
+    for name in contender:
+        if name not in baseline:
+            print("%-48s %14s %14.0f" % (name, "new", contender[name]))
+
+    if regressions:
+        print("%i benchmark(s) slower by more than %.0f%%" % (len(regressions), args.threshold * 100.0))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
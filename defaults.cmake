@@ -213,6 +213,26 @@ function(find_boost)
     endif()
 endfunction()
 
+function(find_egl)
+    if(NOT MSVC)
+        include(FindPkgConfig)
+        pkg_search_module(EGL egl)
+        if(EGL_FOUND)
+            if(EGL_INCLUDE_DIRS)
+                include_directories(SYSTEM ${EGL_INCLUDE_DIRS})
+            endif()
+            if(EGL_LIBRARY_DIRS)
+                link_directories(${EGL_LIBRARY_DIRS})
+            endif()
+            set(EGL_FOUND TRUE PARENT_SCOPE)
+            set(EGL_LIBRARY ${EGL_LIBRARIES} PARENT_SCOPE)
+            message("-- Found EGL: ${EGL_VERSION}")
+        else()
+            message("-- EGL not found, headless rendering disabled")
+        endif()
+    endif()
+endfunction()
+
 function(find_freetype)
     if(MSVC)
         check_include_directory_msvc("freetype-" "include")
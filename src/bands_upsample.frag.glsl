@@ -0,0 +1,46 @@
+// Upsample fluid dye captured from a smaller simulation into Saturn bands.
+//
+// Catmull-Rom interpolation keeps band edges sharper than bilinear magnification. Quantization matches the CAPTURE
+// control of precalc.frag.
+
+layout(location=5) uniform sampler2D tex;
+
+in vec2 texcoord;
+
+out vec4 output_color;
+
+/// Catmull-Rom weights.
+/// \param op Fractional position between the two middle taps.
+/// \return Weights of the four taps.
+vec4 catmull_rom(float op)
+{
+  float op2 = op * op;
+  float op3 = op2 * op;
+
+  return vec4(-op3 + 2.0 * op2 - op, 3.0 * op3 - 5.0 * op2 + 2.0, -3.0 * op3 + 4.0 * op2 + op, op3 - op2) * 0.5;
+}
+
+void main()
+{
+  ivec2 size = textureSize(tex, 0);
+  vec2 pos = texcoord * vec2(size) - 0.5;
+  vec2 base = floor(pos);
+  vec4 weight_x = catmull_rom(pos.x - base.x);
+  vec4 weight_y = catmull_rom(pos.y - base.y);
+  vec3 dye = vec3(0.0);
+
+  // Simulation wraps around.
+  for(int ii = 0; (ii < 4); ++ii)
+  {
+    vec3 row = vec3(0.0);
+    for(int jj = 0; (jj < 4); ++jj)
+    {
+      ivec2 coord = (ivec2(base) + ivec2(jj - 1, ii - 1) + size) % size;
+      row += texelFetch(tex, coord, 0).rgb * weight_x[jj];
+    }
+    dye += row * weight_y[ii];
+  }
+
+  dye = round(clamp(dye, -1.0, 1.0) * 127.0);
+  output_color = vec4(max(dye, 0.0) / 255.0, 1.0);
+}
@@ -0,0 +1,5 @@
+static const char *g_shader_fragment_bands_upsample = ""
+#if defined(USE_LD)
+"bands_upsample.frag.glsl"
+#endif
+"";
@@ -0,0 +1,389 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include "global_data_temporary.hpp"
+#include "verbatim_benchmark.hpp"
+
+/// Samples per iteration in sampling benchmarks.
+static const unsigned BENCHMARK_SAMPLES = 4096;
+
+/// Generate deterministic sample positions.
+///
+/// \param seed Random seed.
+/// \param scale Coordinate range, positions are in [-scale, scale].
+/// \return Positions.
+static std::vector<vec3> benchmark_positions(unsigned seed, float scale)
+{
+  std::vector<vec3> ret;
+
+  dnload_srand(seed);
+  for(unsigned ii = 0; (ii < BENCHMARK_SAMPLES); ++ii)
+  {
+    ret.emplace_back(frand(-scale, scale), frand(-scale, scale), frand(-scale, scale));
+  }
+
+  return ret;
+}
+
+/// Generate deterministic sample directions.
+///
+/// \param seed Random seed.
+/// \return Normalized directions.
+static std::vector<vec3> benchmark_directions(unsigned seed)
+{
+  std::vector<vec3> ret;
+
+  dnload_srand(seed);
+  for(unsigned ii = 0; (ii < BENCHMARK_SAMPLES); ++ii)
+  {
+    ret.push_back(random_direction());
+  }
+
+  return ret;
+}
+
+/// Run seq benchmarks.
+///
+/// \param runner Benchmark runner.
+static void benchmark_seq(BenchmarkRunner& runner)
+{
+  const unsigned COUNT = 4096;
+
+  runner.run("seq/push_back/int", [](uint64_t iterations)
+      {
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          seq<int> values;
+          for(unsigned jj = 0; (jj < COUNT); ++jj)
+          {
+            values.push_back(static_cast<int>(jj));
+          }
+          benchmark_use(static_cast<float>(values.size()));
+        }
+      }, COUNT);
+
+  runner.run("seq/emplace_back/vec3", [](uint64_t iterations)
+      {
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          seq<vec3> values;
+          for(unsigned jj = 0; (jj < COUNT); ++jj)
+          {
+            float fj = static_cast<float>(jj);
+            values.emplace_back(fj, fj, fj);
+          }
+          benchmark_use(values.back()[0]);
+        }
+      }, COUNT);
+}
+
+/// Run image sampling benchmarks.
+///
+/// \param runner Benchmark runner.
+static void benchmark_image_sample(BenchmarkRunner& runner)
+{
+  std::vector<vec3> positions = benchmark_positions(1, 4.0f);
+
+  Image2DGray noise_2d(512, 512);
+  dnload_srand(2);
+  noise_2d.noise();
+
+  runner.run("Image2D/sampleLinear", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(const vec3& vv : positions)
+          {
+            sum += noise_2d.sampleLinear(vv[0], vv[1]);
+          }
+        }
+        benchmark_use(sum);
+      }, BENCHMARK_SAMPLES);
+
+  runner.run("Image2D/sampleNearest", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(const vec3& vv : positions)
+          {
+            sum += noise_2d.sampleNearest(vv[0], vv[1]);
+          }
+        }
+        benchmark_use(sum);
+      }, BENCHMARK_SAMPLES);
+
+  // Same size and preparation as high-quality precalc noise.
+  Image3DGray noise_3d(128, 128, 128);
+  dnload_srand(3);
+  noise_3d.noise();
+  noise_3d.normalize(0);
+
+  runner.run("Image3D/sampleLinear/wrap", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(const vec3& vv : positions)
+          {
+            sum += noise_3d.sampleLinear(vv);
+          }
+        }
+        benchmark_use(sum);
+      }, BENCHMARK_SAMPLES);
+
+  noise_3d.buildBricks();
+
+  runner.run("Image3D/sampleLinear/bricked", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(const vec3& vv : positions)
+          {
+            sum += noise_3d.sampleLinear(vv);
+          }
+        }
+        benchmark_use(sum);
+      }, BENCHMARK_SAMPLES);
+}
+
+/// Run image processing benchmarks.
+///
+/// \param runner Benchmark runner.
+static void benchmark_image_process(BenchmarkRunner& runner)
+{
+  const unsigned SIDE = 512;
+  const unsigned BPCS[] = { 1, 2, 4 };
+
+  Image2DRGBA interleaved(SIDE, SIDE);
+  Image2DRGBA planar(SIDE, SIDE, true);
+  dnload_srand(4);
+  interleaved.noise();
+  dnload_srand(4);
+  planar.noise();
+
+  for(unsigned bpc : BPCS)
+  {
+    std::ostringstream interleaved_name;
+    interleaved_name << "Image/getExportData/rgba/bpc" << bpc;
+    runner.run(interleaved_name.str(), [&](uint64_t iterations)
+        {
+          for(uint64_t ii = 0; (ii < iterations); ++ii)
+          {
+            uarr<uint8_t> data = interleaved.getExportData(bpc);
+            benchmark_use(static_cast<float>(data[0]));
+          }
+        }, SIDE * SIDE);
+
+    std::ostringstream planar_name;
+    planar_name << "Image/getExportData/rgba_planar/bpc" << bpc;
+    runner.run(planar_name.str(), [&](uint64_t iterations)
+        {
+          for(uint64_t ii = 0; (ii < iterations); ++ii)
+          {
+            uarr<uint8_t> data = planar.getExportData(bpc);
+            benchmark_use(static_cast<float>(data[0]));
+          }
+        }, SIDE * SIDE);
+  }
+
+  // Lowpass filter converges, but the amount of work does not depend on contents.
+  Image2DGray lowpass(SIDE, SIDE);
+  dnload_srand(5);
+  lowpass.noise();
+
+  runner.run("Image2D/filterLowpass/3", [&](uint64_t iterations)
+      {
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          lowpass.filterLowpass(3);
+        }
+        benchmark_use(lowpass.sampleNearest(0.5f, 0.5f));
+      }, SIDE * SIDE);
+}
+
+/// Run precalc primitive benchmarks.
+///
+/// \param runner Benchmark runner.
+/// \param params Precalc parameters for sizes and counts.
+static void benchmark_precalc(BenchmarkRunner& runner, const PrecalcParams& params)
+{
+  std::vector<vec3> directions = benchmark_directions(6);
+
+  CraterMap craters;
+  dnload_srand(7);
+  for(unsigned ii = 0; (ii < params.enceladus_crater_count); ++ii)
+  {
+    float csize = frand(0.2f, 1.0f);
+    craters.addCrater(random_direction(), 0.0005f + params.enceladus_crater_size * csize * csize * csize * csize *
+        csize);
+  }
+
+  runner.run("CraterMap/getHeight", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(const vec3& vv : directions)
+          {
+            sum += craters.getHeight(vv);
+          }
+        }
+        benchmark_use(sum);
+      }, BENCHMARK_SAMPLES);
+
+  StarLocationTree stars;
+  dnload_srand(8);
+  for(unsigned ii = 0; (ii < params.star_count); ++ii)
+  {
+    stars.add(StarLocation(random_direction(), params.star_size, frand(0.1f, 1.0f)));
+  }
+
+  // Luminosity is queried with the direction mapped to cube map boundary.
+  std::vector<vec3> mapped;
+  for(const vec3& vv : directions)
+  {
+    mapped.push_back(vv / std::max(std::max(std::abs(vv[0]), std::abs(vv[1])), std::abs(vv[2])));
+  }
+
+  runner.run("StarLocationTree/calculateLuminosity", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(unsigned jj = 0; (jj < BENCHMARK_SAMPLES); ++jj)
+          {
+            sum += stars.calculateLuminosity(directions[jj], mapped[jj]);
+          }
+        }
+        benchmark_use(sum);
+      }, BENCHMARK_SAMPLES);
+
+  // Crawlers are consumed by carving, every iteration carves a fresh copy.
+  ImageCubeRGBAUptr surface = ImageCubeRGBA::create(512);
+  surface->clear(3, 0.0f);
+  dnload_srand(9);
+  Crawler crawler(random_direction(), random_direction(), 0.5f, 0.003f, 128, params.enceladus_crawler_lifetime,
+      0.025f);
+
+  runner.run("Crawler/carve", [&](uint64_t iterations)
+      {
+        dnload_srand(10);
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          Crawler carved(crawler);
+          carved.carve(*surface, 0.001f);
+        }
+        benchmark_use(*(surface->getClosestPixelAddress(directions[0], 3)));
+      });
+
+  runner.run("png_read/saturn_rings", [](uint64_t iterations)
+      {
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          Image2DRGBAUptr img = png_read(g_saturn_rings_png);
+          benchmark_use(static_cast<float>(img->getWidth()));
+        }
+      });
+}
+
+/// Run camera path benchmarks.
+///
+/// \param runner Benchmark runner.
+static void benchmark_direction(BenchmarkRunner& runner)
+{
+  const unsigned POINTS = 16;
+  const unsigned STAMPS = 1024;
+  std::vector<int> spline_data;
+
+  dnload_srand(11);
+  for(unsigned ii = 0; (ii < POINTS); ++ii)
+  {
+    int point[] = { static_cast<int>(urand(200)) - 100, static_cast<int>(urand(200)) - 100,
+      static_cast<int>(urand(200)) - 100, 500 + static_cast<int>(urand(1000)) };
+    spline_data.insert(spline_data.end(), point, point + 4);
+  }
+  spline_data.insert(spline_data.end(), 4, 0);
+
+  Spline bezier(Spline::BEZIER);
+  bezier.readData(&(spline_data[0]));
+  Spline linear(Spline::LINEAR);
+  linear.readData(&(spline_data[0]));
+  float spline_length = static_cast<float>(POINTS * 1000);
+
+  runner.run("Spline/resolve/bezier", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(unsigned jj = 0; (jj < STAMPS); ++jj)
+          {
+            sum += bezier.resolve(static_cast<float>(jj) * (spline_length / static_cast<float>(STAMPS)))[0];
+          }
+        }
+        benchmark_use(sum);
+      }, STAMPS);
+
+  runner.run("Spline/resolve/linear", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(unsigned jj = 0; (jj < STAMPS); ++jj)
+          {
+            sum += linear.resolve(static_cast<float>(jj) * (spline_length / static_cast<float>(STAMPS)))[0];
+          }
+        }
+        benchmark_use(sum);
+      }, STAMPS);
+
+  Direction direction(g_direction);
+
+  runner.run("Direction/resolveDirectionFrame", [&](uint64_t iterations)
+      {
+        float sum = 0.0f;
+        for(uint64_t ii = 0; (ii < iterations); ++ii)
+        {
+          for(unsigned jj = 0; (jj < STAMPS); ++jj)
+          {
+            DirectionFrame frame = direction.resolveDirectionFrame(static_cast<int>(jj * (INTRO_LENGTH_TICKS /
+                    STAMPS)));
+            sum += frame.getPosition()[0];
+          }
+        }
+        benchmark_use(sum);
+      }, STAMPS);
+}
+
+/// Run all benchmarks.
+///
+/// \param filter Substring benchmark names must contain to run, empty to run all.
+/// \param filename JSON output filename, empty for none.
+static void benchmark_run_all(const std::string& filter, const std::string& filename)
+{
+  BenchmarkRunner runner(filter);
+  PrecalcParams params;
+
+  runner.addContext("executable", "cassini");
+  runner.addContext("cpu_level", cpu_level_name(g_cpu_level));
+#if defined(DEBUG)
+  runner.addContext("library_build_type", "debug");
+#else
+  runner.addContext("library_build_type", "release");
+#endif
+
+  benchmark_seq(runner);
+  benchmark_image_sample(runner);
+  benchmark_image_process(runner);
+  benchmark_precalc(runner, params);
+  benchmark_direction(runner);
+
+  if(!filename.empty())
+  {
+    runner.writeJson(filename);
+  }
+}
+
+#endif
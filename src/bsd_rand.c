@@ -3,8 +3,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-/** BSD random var. */
+/** BSD random var.
+ *
+ * Developer builds regenerate precalc assets while rendering, which reseeds for text effects. Keep the state
+ * per thread there so both stay deterministic.
+ */
+#if defined(USE_LD)
+#if defined(__cplusplus)
+static thread_local bsd_u_long bsd_rand_next = 2;
+#elif defined(_MSC_VER)
+static __declspec(thread) bsd_u_long bsd_rand_next = 2;
+#else
+static _Thread_local bsd_u_long bsd_rand_next = 2;
+#endif
+#else
 static bsd_u_long bsd_rand_next = 2;
+#endif
 
 int bsd_rand(void)
 {
@@ -43,6 +43,14 @@ class Crater
       return opt<float>(1.0f - ret);
     }
 
+    /// Accessor.
+    ///
+    /// \return Center of this crater.
+    const vec3& getCenter() const
+    {
+      return m_center;
+    }
+
     /// Accessor.
     ///
     /// \return Radius of this crater.
@@ -32,11 +32,11 @@ class CraterMap
       }
 #endif
       // Better crater profile function
-      float stepfunction = 0.5f + dnload_tanhf(WINDOW_SHARPNESS * (op - RIMPOINT)) * 0.5f;
+      float stepfunction = 0.5f + precalc_tanhf(WINDOW_SHARPNESS * (op - RIMPOINT)) * 0.5f;
       //float stepfunction = 1.0f / (1.0f + dnload_powf(static_cast<float>(M_E), -2.0f * WINDOW_SHARPNESS * (op - RIMPOINT)));
 
-      float y1 = dnload_powf(3.0f * op, 2.0f) - DEPTH;
-      float y2 = (DEPTH * 0.25f) * (dnload_sinf((op - RIMPOINT) * (static_cast<float>(M_PI) / (1.0f - RIMPOINT)) + static_cast<float>(M_PI * 0.5)) + 1.0f);
+      float y1 = precalc_powf(3.0f * op, 2.0f) - DEPTH;
+      float y2 = (DEPTH * 0.25f) * (precalc_sinf((op - RIMPOINT) * (static_cast<float>(M_PI) / (1.0f - RIMPOINT)) + static_cast<float>(M_PI * 0.5)) + 1.0f);
       return stepfunction*y2 + (1.0f - stepfunction)*y1;
       //float y = 0.0f;
 
@@ -53,7 +53,7 @@ class CraterMap
     /// \return Relative height multiplier.
     static float crater_height_mul(float rad)
     {
-      return dnload_sqrtf(dnload_sqrtf(dnload_sqrtf(rad)));
+      return precalc_sqrtf(precalc_sqrtf(precalc_sqrtf(rad)));
     }
 
   public:
@@ -66,10 +66,18 @@ class CraterMap
       m_craters.emplace_back(dir, radius);
     }
 
+    /// Accessor.
+    ///
+    /// \return Craters in the order they were added.
+    const seq<Crater>& getCraters() const
+    {
+      return m_craters;
+    }
+
     /// Get height as calculated from craters.
     ///
     /// \param dir Direction.
-    float getHeight(const vec3& dir)
+    float getHeight(const vec3& dir) const
     {
       // Crater height function increases on the edge and decreases towards the center.
       // Craters are deeper than their edges are tall.
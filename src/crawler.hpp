@@ -69,6 +69,7 @@ class Crawler
 
       while(m_lifetime)
       {
+        cancel_point();
         updateDirection();
         m_pos = normalize(m_pos + m_dir * speed);
 
@@ -86,8 +87,8 @@ class Crawler
         for(unsigned ii = 0; (ii < m_count); ++ii)
         {
           float rot = static_cast<float>(ii) * ROT_MUL;
-          float ci = dnload_cosf(rot);
-          float si = dnload_sinf(rot);
+          float ci = precalc_cosf(rot);
+          float si = precalc_sinf(rot);
           vec3 pos = m_pos + ((si * rt) + (ci * m_dir)) * (m_radius * ((ii % 2) ? 0.5f : 1.0f));
 
           float* tmp_address = img.getClosestPixelAddress(pos, 0);
@@ -108,6 +109,7 @@ class Crawler
 
       while(m_lifetime)
       {
+        cancel_point();
         updateDirection();
         m_pos = normalize(m_pos + m_dir * speed);
 
@@ -125,11 +127,11 @@ class Crawler
         for(unsigned ii = 0; (ii < m_count); ++ii)
         {
           float rot = static_cast<float>(ii) * ROT_MUL;
-          float ci = dnload_cosf(rot);
-          float si = dnload_sinf(rot);
+          float ci = precalc_cosf(rot);
+          float si = precalc_sinf(rot);
           vec3 pos = m_pos + ((si * rt) + (ci * m_dir)) * (m_radius * ((ii % 2) ? 0.5f : 1.0f));
 
-          float mul = dnload_powf(dnload_cosf(abs(si) * static_cast<float>(M_PI * 0.5)), 2.0f);
+          float mul = precalc_powf(precalc_cosf(abs(si) * static_cast<float>(M_PI * 0.5)), 2.0f);
 
           float* tmp_address = img.getClosestPixelAddress(pos, 3);
           *tmp_address = std::min(*tmp_address, -m_power * mul);
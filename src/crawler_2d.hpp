@@ -63,6 +63,7 @@ class Crawler2D
 
       while(m_lifetime)
       {
+        cancel_point();
         updateDirection();
         m_pos += m_dir * speed;
 
@@ -86,7 +87,7 @@ class Crawler2D
             
             if(mul < 1.0f)
             {
-              mul = dnload_powf(dnload_cosf(mul * static_cast<float>(M_PI * 0.5)) * frand(1.0f), 2.0f);
+              mul = precalc_powf(precalc_cosf(mul * static_cast<float>(M_PI * 0.5)) * frand(1.0f), 2.0f);
 
               //std::cout << mul << std::endl;
 
@@ -1,6 +1,11 @@
 #ifndef DIRECTION_HPP
 #define DIRECTION_HPP
 
+#if defined(USE_LD)
+#include <utility>
+#include <vector>
+#endif
+
 const int DIRECTION_SPLIT_SCENE_START = 25000 + (13 * 1400);
 const int DIRECTION_SPLIT_SCENE_SPLIT_START = 4000;
 const int DIRECTION_SPLIT_START = DIRECTION_SPLIT_SCENE_START + DIRECTION_SPLIT_SCENE_SPLIT_START;
@@ -808,6 +813,46 @@ class Direction
     }
    
   public:
+#if defined(USE_LD)
+    /// Find when a scene is first shown.
+    ///
+    /// \param id Scene ID.
+    /// \return Timestamp of first frame of the scene or -1 if it is never shown.
+    int getSceneStart(SceneEnum id) const
+    {
+      int stamp = 0;
+
+      for(const Scene* vv : m_scenes)
+      {
+        if(vv->getId() == id)
+        {
+          return stamp;
+        }
+        stamp += vv->getLength();
+      }
+
+      return -1;
+    }
+
+    /// Find all spans a scene is shown in.
+    ///
+    /// \param id Scene ID.
+    /// \param spans [out] Spans [start, end) of the scene are appended here.
+    void getSceneSpans(SceneEnum id, std::vector<std::pair<int, int> >& spans) const
+    {
+      int stamp = 0;
+
+      for(const Scene* vv : m_scenes)
+      {
+        if(vv->getId() == id)
+        {
+          spans.push_back(std::make_pair(stamp, stamp + vv->getLength()));
+        }
+        stamp += vv->getLength();
+      }
+    }
+#endif
+
     /// Resolve the current scene frame.
     ///
     /// \param stamp Timestamp (frames).
@@ -23,6 +23,8 @@ const int PROJECT = BUILD_PRESSURE + 20;
 const int APPLY_PRESSURE = PROJECT + 1;
 const int ADVECT_DYE = APPLY_PRESSURE + 1;
 const int ADVECT_SIMULATIONSPACE = ADVECT_DYE + 1;
+const int PROJECT_SEPARATE = ADVECT_SIMULATIONSPACE + 1;
+const int APPLY_PRESSURE_SEPARATE = PROJECT_SEPARATE + 1;
 
 // Physical constants
 const float dx = pixel_size.x;
@@ -81,14 +83,15 @@ float build_pressure()
   return scale*(C.r - R.r + C.g - T.g);
 }
 
-float project()
+/// Pressure is in blue of velocity targets, or in red of separate pressure targets.
+float project(int channel)
 {
   float scale = dt/(rho*dx*dx);
 
-  float T = texture(tex, texcoord_up).b;
-  float B = texture(tex, texcoord_dn).b;
-  float L = texture(tex, texcoord_lt).b;
-  float R = texture(tex, texcoord_rt).b;
+  float T = texture(tex, texcoord_up)[channel];
+  float B = texture(tex, texcoord_dn)[channel];
+  float L = texture(tex, texcoord_lt)[channel];
+  float R = texture(tex, texcoord_rt)[channel];
 
 //  float T = fetch_boundary(tex, boundary, texcoord_up).b;
 //  float B = fetch_boundary(tex, boundary, texcoord_dn).b;
@@ -98,10 +101,10 @@ float project()
   float offdiag = -scale*(T+B+L+R);
 
 //  return (fetch_boundary(initial, boundary, texcoord).b - offdiag) / (4*scale);
-  return (texture(initial, texcoord).b - offdiag) / (4*scale);
+  return (texture(initial, texcoord).r - offdiag) / (4*scale);
 }
 
-vec2 apply_pressure()
+vec2 apply_pressure(sampler2D pressure, int channel)
 {
   float scale = dt/(rho*dx);
 
@@ -111,9 +114,9 @@ vec2 apply_pressure()
 //  float R = fetch_boundary(tex, boundary, texcoord_rt).b;
 
 //  return vec2(R-L, T-B)*scale;
-  float C = texture(tex, texcoord).b;
-  float B = texture(tex, texcoord_dn).b;
-  float L = texture(tex, texcoord_lt).b;
+  float C = texture(pressure, texcoord)[channel];
+  float B = texture(pressure, texcoord_dn)[channel];
+  float L = texture(pressure, texcoord_lt)[channel];
 
   return vec2(L-C, B-C)*scale;
 }
@@ -165,17 +168,18 @@ void main()
   else if(control <= BUILD_PRESSURE)
   {
 //  	output_color = texture(tex, texcoord);
-    output_color.b = build_pressure();
+    // Pressure target may only have one channel, multigrid solver and compute shader read blue.
+    output_color = vec4(build_pressure());
   }
   else if(control <= PROJECT)
   {
   	output_color = texture(tex, texcoord);
-  	output_color.b = project();
+  	output_color.b = project(2);
   }
   else if(control <= APPLY_PRESSURE)
   {
 	  output_color = texture(tex, texcoord);
-	  output_color.rg += apply_pressure();
+	  output_color.rg += apply_pressure(tex, 2);
   }
 	else if(control <= ADVECT_DYE)
   {
@@ -187,6 +191,17 @@ void main()
     //output_color = advect_dye(tex);
     output_color = advect_simulationspace(tex);
   }
+  // Pressure iterated in separate single channel targets, tex contains pressure and initial divergence.
+  else if(control <= PROJECT_SEPARATE)
+  {
+    output_color = vec4(project(0));
+  }
+  // Initial contains pressure from separate target.
+  else if(control <= APPLY_PRESSURE_SEPARATE)
+  {
+    output_color = texture(tex, texcoord);
+    output_color.rg += apply_pressure(initial, 0);
+  }
   // Default: just copy from input to output.
   else
   {
@@ -9,7 +9,7 @@ static const char *g_shader_fragment_fluid = ""
 "in vec2 e;"
 "out vec4 o;"
 "vec2 f=vec2(1)/textureSize(t,0),z=.5*vec2(f),L=.5*vec2(.0,f.t),M=.5*vec2(f.s,.0),y=e+vec2(.0,f.t),k=e+vec2(0,-f.t),w=e+vec2(-f.s,.0),P=e+vec2(f.s,.0);"
-"int A=0,N=A+1,U=N+20,T=U+1,S=T+1,K=S+1;"
+"int A=0,N=A+1,U=N+20,T=U+1,S=T+1,K=S+1,G=K+1,F=G+1;"
 "float b=f.s,m=.1,Y=.1;"
 "vec4 X(vec4 t)"
 "{"
@@ -31,15 +31,15 @@ static const char *g_shader_fragment_fluid = ""
 "vec4 o=texture(t,e),e=texture(t,y),v=texture(t,P);"
 "return c*(o.s-v.s+o.t-e.t);"
 "}"
-"float I()"
+"float I(int v)"
 "{"
-"float o=m/(Y*b*b),c=texture(t,y).p,v=texture(t,k).p,a=texture(t,w).p,l=texture(t,P).p,t=-o*(c+v+a+l);"
-"return(texture(d,e).p-t)/(4*o);"
+"float o=m/(Y*b*b),c=texture(t,y)[v],a=texture(t,k)[v],l=texture(t,w)[v],n=texture(t,P)[v],t=-o*(c+a+l+n);"
+"return(texture(d,e).s-t)/(4*o);"
 "}"
-"vec2 H()"
+"vec2 H(sampler2D a,int v)"
 "{"
-"float c=m/(Y*b),o=texture(t,e).p,e=texture(t,k).p,v=texture(t,w).p;"
-"return vec2(v-o,e-o)*c;"
+"float c=m/(Y*b),o=texture(a,e)[v],l=texture(a,k)[v],n=texture(a,w)[v];"
+"return vec2(n-o,l-o)*c;"
 "}"
 "vec4 R(sampler2D o)"
 "{"
@@ -66,11 +66,13 @@ static const char *g_shader_fragment_fluid = ""
 "if(c.p!=.0)o.p=c.p;"
 "if(c.q!=1.)o.q=c.q;"
 "}"
-"else if(u<=N)o.p=J();"
-"else if(u<=U)o=texture(t,e),o.p=I();"
-"else if(u<=T)o=texture(t,e),o.st+=H();"
+"else if(u<=N)o=vec4(J());"
+"else if(u<=U)o=texture(t,e),o.p=I(2);"
+"else if(u<=T)o=texture(t,e),o.st+=H(t,2);"
 "else if(u<=S)o=R(d);"
 "else if(u<=K)o=Q(t);"
+"else if(u<=G)o=vec4(I(0));"
+"else if(u<=F)o=texture(t,e),o.st+=H(d,0);"
 "else o=texture(d,e);"
 "}"
 #endif
@@ -0,0 +1,160 @@
+#ifndef FLUID_BUDGET_HPP
+#define FLUID_BUDGET_HPP
+
+#include <iostream>
+
+/// GPU milliseconds per frame for fluid steps during precalc, 0 for one step per frame.
+static int g_fluid_budget = 12;
+
+/// Decides how many fluid steps fit into a frame.
+///
+/// Every step is timed with a timer query. Results are read only once available, so timing never stalls the
+/// pipeline, and the estimate lags a few frames behind.
+class FluidBudget
+{
+  private:
+    /// Number of timer queries in flight at most.
+    static const unsigned QUERY_COUNT = 64;
+
+    /// Weight of a new measurement in the step time estimate.
+    static constexpr double ESTIMATE_WEIGHT = 0.25;
+
+  private:
+    /// Timer queries.
+    GLuint m_queries[QUERY_COUNT];
+
+    /// Number of queries issued.
+    unsigned m_issued;
+
+    /// Number of query results collected.
+    unsigned m_collected;
+
+    /// True if a query is active.
+    bool m_active;
+
+    /// GPU time budget per frame in nanoseconds.
+    double m_budget;
+
+    /// Estimated GPU time of one step in nanoseconds, 0 before first measurement.
+    double m_step_time;
+
+    /// Steps run so far.
+    unsigned m_step_count;
+
+    /// Frames run so far.
+    unsigned m_frame_count;
+
+    /// Ticks at first step.
+    int m_start_ticks;
+
+  private:
+    /// Deleted copy constructor.
+    FluidBudget(const FluidBudget&) = delete;
+    /// Deleted assignment.
+    FluidBudget& operator=(const FluidBudget&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param budget GPU milliseconds per frame, 0 for one step per frame.
+    explicit FluidBudget(int budget) :
+      m_issued(0),
+      m_collected(0),
+      m_active(false),
+      m_budget(static_cast<double>(budget) * 1000000.0),
+      m_step_time(0.0),
+      m_step_count(0),
+      m_frame_count(0),
+      m_start_ticks(0)
+    {
+      glGenQueries(QUERY_COUNT, m_queries);
+    }
+
+    /// Destructor.
+    ~FluidBudget()
+    {
+      glDeleteQueries(QUERY_COUNT, m_queries);
+    }
+
+  private:
+    /// Collect available query results into the step time estimate.
+    void collect()
+    {
+      while(m_collected < m_issued)
+      {
+        GLuint query = m_queries[m_collected % QUERY_COUNT];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+        {
+          return;
+        }
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        m_step_time = (m_step_time > 0.0) ?
+          (m_step_time + (static_cast<double>(elapsed) - m_step_time) * ESTIMATE_WEIGHT) :
+          static_cast<double>(elapsed);
+        ++m_collected;
+      }
+    }
+
+  public:
+    /// Get number of steps to run this frame.
+    ///
+    /// \param remaining Steps remaining until no more steps are needed.
+    /// \return Number of steps, at least 1.
+    unsigned getStepCount(unsigned remaining)
+    {
+      collect();
+      ++m_frame_count;
+
+      if((m_budget <= 0.0) || (m_step_time <= 0.0))
+      {
+        return 1;
+      }
+
+      unsigned ret = static_cast<unsigned>(m_budget / m_step_time);
+      return std::max(std::min(ret, remaining), 1u);
+    }
+
+    /// Begin timing a step.
+    void begin()
+    {
+      if(0 == m_step_count)
+      {
+        m_start_ticks = get_current_ticks();
+      }
+      ++m_step_count;
+
+      // Skip timing if all queries are in flight.
+      if(m_issued - m_collected < QUERY_COUNT)
+      {
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_issued % QUERY_COUNT]);
+        m_active = true;
+      }
+    }
+
+    /// End timing a step.
+    void end()
+    {
+      if(m_active)
+      {
+        glEndQuery(GL_TIME_ELAPSED);
+        ++m_issued;
+        m_active = false;
+      }
+    }
+
+    /// Print achieved step rate.
+    void report() const
+    {
+      int elapsed = std::max(get_current_ticks() - m_start_ticks, 1);
+
+      std::cout << "fluid: " << m_step_count << " steps in " << m_frame_count << " frames, " << elapsed <<
+        " ms (" << (static_cast<double>(m_step_count) * 1000.0 / static_cast<double>(elapsed)) <<
+        " steps/s, " << (m_step_time / 1000000.0) << " ms GPU per step)" << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef FLUID_COMPUTE_HPP
+#define FLUID_COMPUTE_HPP
+
+#include <vector>
+
+/// Run fluid steps with the fused compute shader instead of fragment passes.
+static bool g_fluid_compute = false;
+
+/// Cross-check fused compute fluid steps against fragment passes and exit.
+static bool g_fluid_compute_verify = false;
+
+/// Fused compute shader fluid step.
+///
+/// Runs one fluid step in a few dispatches instead of a fragment pass per operation. Uses the same framebuffers
+/// as the fragment passes, so the paths can be switched between steps.
+class FluidCompute
+{
+  private:
+    /// Work group size in both image dimensions, must match the shader.
+    static const unsigned GROUP_SIZE = 16;
+
+    /// Jacobi iterations per dispatch, must match the shader.
+    static const unsigned JACOBI_ITERATIONS = 4;
+
+    /// Jacobi output tile side, must match the shader.
+    static const unsigned JACOBI_TILE = 32;
+
+    /// Shader modes.
+    enum Mode
+    {
+      MODE_INFLOW = 0,
+      MODE_JACOBI,
+      MODE_ADVECT
+    };
+
+    /// Image units, must match the shader.
+    enum ImageUnit
+    {
+      IMAGE_FLUID_SRC = 0,
+      IMAGE_FLUID_DST,
+      IMAGE_PRESSURE,
+      IMAGE_DYE_DST
+    };
+
+    /// Uniform location.
+    static const GLint UNIFORM_MODE = 0;
+
+  private:
+    /// Compute program.
+    GlslProgram m_program;
+
+  private:
+    /// Deleted copy constructor.
+    FluidCompute(const FluidCompute&) = delete;
+    /// Deleted assignment.
+    FluidCompute& operator=(const FluidCompute&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param width Fluid width.
+    /// \param height Fluid height.
+    explicit FluidCompute(unsigned width, unsigned height)
+    {
+      if((width % JACOBI_TILE) || (height % JACOBI_TILE))
+      {
+        std::ostringstream sstr;
+        sstr << "fluid size " << width << "x" << height << " is not divisible by compute tile size " <<
+          JACOBI_TILE;
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+
+      m_program.addShader(GL_COMPUTE_SHADER, g_shader_compute_fluid_step);
+      if(!m_program.link())
+      {
+        std::ostringstream sstr;
+        sstr << "compute program creation failure: " << m_program.getName();
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+    }
+
+  private:
+    /// Bind a framebuffer color texture to an image unit.
+    ///
+    /// \param unit Image unit.
+    /// \param fbo Framebuffer.
+    /// \param access Access mode.
+    static void bind_image(ImageUnit unit, const FrameBuffer& fbo, GLenum access)
+    {
+      glBindImageTexture(unit, fbo.getTextureColor().getId(), 0, GL_FALSE, 0, access, GL_RGBA32F);
+    }
+
+    /// Run the shader over the fluid.
+    ///
+    /// \param mode Mode.
+    /// \param src Fluid source.
+    /// \param dst Fluid destination.
+    /// \param tile Output tile side of one work group.
+    void dispatch(Mode mode, const FrameBuffer& src, const FrameBuffer& dst, unsigned tile)
+    {
+      bind_image(IMAGE_FLUID_SRC, src, GL_READ_ONLY);
+      bind_image(IMAGE_FLUID_DST, dst, GL_WRITE_ONLY);
+
+      glUniform1i(UNIFORM_MODE, mode);
+      glDispatchCompute(src.getWidth() / tile, src.getHeight() / tile, 1);
+      glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+  public:
+    /// Run one fluid step.
+    ///
+    /// \param fluid_1 Fluid framebuffer 1.
+    /// \param fluid_2 Fluid framebuffer 2.
+    /// \param phase Index of the fluid framebuffer containing current state.
+    /// \param pressure Pressure framebuffer.
+    /// \param dye_src Dye framebuffer containing current state.
+    /// \param dye_dst Dye framebuffer to write.
+    /// \param inflow Inflow texture.
+    /// \param project_count Number of Jacobi iterations, must be divisible by iterations per dispatch.
+    /// \return Index of the fluid framebuffer containing the new state.
+    int step(const FrameBuffer& fluid_1, const FrameBuffer& fluid_2, int phase, const FrameBuffer& pressure,
+        const FrameBuffer& dye_src, const FrameBuffer& dye_dst, const Texture& inflow, unsigned project_count)
+    {
+      const FrameBuffer* fluid[] = { &fluid_1, &fluid_2 };
+
+      if((project_count < JACOBI_ITERATIONS) || (project_count % JACOBI_ITERATIONS))
+      {
+        std::ostringstream sstr;
+        sstr << "fluid project count " << project_count << " is not a multiple of " << JACOBI_ITERATIONS;
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+
+      glUseProgram(m_program.getId());
+      bind_image(IMAGE_PRESSURE, pressure, GL_READ_WRITE);
+      bind_image(IMAGE_DYE_DST, dye_dst, GL_WRITE_ONLY);
+      inflow.bind(0);
+      dye_src.getTextureColor().bind(1);
+
+      for(unsigned ii = 0; (ii < project_count); ii += JACOBI_ITERATIONS)
+      {
+        dispatch(ii ? MODE_JACOBI : MODE_INFLOW, *(fluid[phase]), *(fluid[1 - phase]), JACOBI_TILE);
+        phase = 1 - phase;
+      }
+      dispatch(MODE_ADVECT, *(fluid[phase]), *(fluid[1 - phase]), GROUP_SIZE);
+      phase = 1 - phase;
+
+      glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+      // Rendering uses program pipelines, which a current program would override.
+      glUseProgram(0);
+
+      return phase;
+    }
+
+  public:
+    /// Read framebuffer contents.
+    ///
+    /// \param fbo Framebuffer.
+    /// \param data [out] RGBA texels.
+    static void read(const FrameBuffer& fbo, std::vector<float>& data)
+    {
+      data.resize(fbo.getWidth() * fbo.getHeight() * 4);
+      fbo.getTextureColor().bind(0);
+      glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, &(data[0]));
+    }
+
+    /// Write framebuffer contents.
+    ///
+    /// \param fbo Framebuffer.
+    /// \param data RGBA texels.
+    static void write(const FrameBuffer& fbo, const std::vector<float>& data)
+    {
+      fbo.getTextureColor().bind(0);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, fbo.getWidth(), fbo.getHeight(), GL_RGBA, GL_FLOAT, &(data[0]));
+    }
+
+    /// Largest difference between framebuffer contents.
+    ///
+    /// \param lhs Left-hand-side texels.
+    /// \param rhs Right-hand-side texels.
+    /// \param relative [out] Largest difference relative to largest magnitude.
+    /// \return Largest difference.
+    static float compare(const std::vector<float>& lhs, const std::vector<float>& rhs, float& relative)
+    {
+      float max_error = 0.0f;
+      float max_value = 0.0f;
+
+      for(unsigned ii = 0; (ii < lhs.size()); ++ii)
+      {
+        max_error = std::max(std::abs(lhs[ii] - rhs[ii]), max_error);
+        max_value = std::max(std::abs(lhs[ii]), max_value);
+      }
+
+      relative = (max_value > 0.0f) ? (max_error / max_value) : max_error;
+      return max_error;
+    }
+};
+
+#endif
@@ -0,0 +1,698 @@
+#ifndef FLUID_CPU_HPP
+#define FLUID_CPU_HPP
+
+#include "verbatim_cond.hpp"
+#include "verbatim_thread.hpp"
+
+#include <cmath>
+#include <vector>
+
+/// Run the fluid simulation on the CPU and capture Saturn bands from it before precalc.
+static bool g_fluid_cpu = false;
+
+/// Cross-check CPU fluid steps against GPU fluid steps and exit.
+static bool g_fluid_cpu_verify = false;
+
+/// Run the fluid simulation on the CPU, store Saturn bands into the precalc cache and exit without creating a GL
+/// context.
+static bool g_fluid_cpu_cache = false;
+
+/// CPU fluid simulation.
+///
+/// Calculates the same steps as the passes of fluid.frag, so Saturn bands can be generated without a GPU. Every
+/// channel is stored in a separate plane and rows are split between worker threads. Texels are calculated a vector
+/// at a time with the widest lanes of the selected CPU level, texels whose neighbours wrap around one at a time.
+///
+/// Like the shader, the boundary image is not used and the simulation wraps around at the edges.
+class FluidCpu
+{
+  private:
+    /// Maximum number of worker threads.
+    static const unsigned MAX_THREADS = 64;
+
+    /// Simulation width and height must be divisible by this, at least two vectors of the widest lanes.
+    static const unsigned SIDE_ALIGNMENT = 32;
+
+    /// Number of Jacobi iterations, must match draw_fluid().
+    static const unsigned PROJECT_COUNT = 20;
+
+    /// Time step, must match fluid.frag.
+    static constexpr float DT = 0.1f;
+
+    /// Density, must match fluid.frag.
+    static constexpr float RHO = 0.1f;
+
+    /// Passes, each must be finished on all rows before the next one starts.
+    enum Pass
+    {
+      /// Add inflow and build pressure right-hand side.
+      PASS_INFLOW = 0,
+
+      /// One Jacobi iteration.
+      PASS_JACOBI,
+
+      /// Apply pressure to velocity.
+      PASS_APPLY,
+
+      /// Advect dye and simulation space.
+      PASS_ADVECT
+    };
+
+    CPU_KERNELS_BEGIN
+    /// Rows calculated by one thread in every pass.
+    struct Worker
+    {
+      /// Simulation.
+      FluidCpu* m_parent;
+
+      /// First row.
+      unsigned m_row_begin;
+
+      /// One past last row.
+      unsigned m_row_end;
+
+      /// Signaled when a pass starts or the worker should exit.
+      Cond m_start;
+
+      /// Run the kernel.
+      template<typename V> void run()
+      {
+        m_parent->runRows<V>(m_parent->m_pass, m_row_begin, m_row_end);
+      }
+
+      /// Thread function.
+      ///
+      /// \param data Worker.
+      /// \return Always 0.
+      static int run_thread(void* data)
+      {
+        Worker* worker = static_cast<Worker*>(data);
+        worker->m_parent->runWorker(*worker);
+        return 0;
+      }
+    };
+
+    /// Bilinear sample positions for a vector of texels, like texture() on a wrapping framebuffer.
+    template<typename V> struct Bilinear
+    {
+      /// Texel indices, bottom left, bottom right, top left and top right.
+      V m_index[4];
+
+      /// Horizontal weight.
+      V m_weight_x;
+
+      /// Vertical weight.
+      V m_weight_y;
+
+      /// Constructor.
+      ///
+      /// \param px X coordinate in texels, texel centers are at integers.
+      /// \param py Y coordinate in texels, texel centers are at integers.
+      /// \param width Width in texels.
+      /// \param height Height in texels.
+      explicit Bilinear(const V& px, const V& py, const V& width, const V& height)
+      {
+        V base_x = lane_floor(px);
+        V base_y = lane_floor(py);
+        V x1 = lane_wrap(base_x, width);
+        V y1 = lane_wrap(base_y, height);
+        V x2 = x1 + V(1.0f);
+        V y2 = y1 + V(1.0f);
+
+        x2 = vselect(x2 >= width, V(0.0f), x2);
+        y2 = vselect(y2 >= height, V(0.0f), y2);
+        y1 = y1 * width;
+        y2 = y2 * width;
+
+        m_index[0] = y1 + x1;
+        m_index[1] = y1 + x2;
+        m_index[2] = y2 + x1;
+        m_index[3] = y2 + x2;
+        m_weight_x = px - base_x;
+        m_weight_y = py - base_y;
+      }
+
+      /// Sample a plane.
+      ///
+      /// \param plane Plane.
+      /// \return Interpolated values.
+      V sample(const std::vector<float>& plane) const
+      {
+        const float* data = &(plane[0]);
+        V bottom = lane_mix(vgather(data, m_index[0]), vgather(data, m_index[1]), m_weight_x);
+        V top = lane_mix(vgather(data, m_index[2]), vgather(data, m_index[3]), m_weight_x);
+        return lane_mix(bottom, top, m_weight_y);
+      }
+    };
+    CPU_KERNELS_END
+
+  private:
+    /// Width.
+    unsigned m_width;
+
+    /// Height.
+    unsigned m_height;
+
+    /// Number of worker threads.
+    unsigned m_thread_count;
+
+    /// Inflow planes.
+    std::vector<float> m_inflow[4];
+
+    /// Fluid planes (velocity x, velocity y, pressure, color).
+    std::vector<float> m_fluid[4];
+
+    /// Fluid planes being written.
+    std::vector<float> m_fluid_next[4];
+
+    /// Pressure right-hand side.
+    std::vector<float> m_rhs;
+
+    /// Dye planes.
+    std::vector<float> m_dye[4];
+
+    /// Dye planes being written.
+    std::vector<float> m_dye_next[4];
+
+    /// Rows of each thread, the calling thread calculates the rows of the first worker.
+    Worker m_workers[MAX_THREADS];
+
+    /// Worker threads, kept for the lifetime of the simulation.
+    uptr<Thread> m_threads[MAX_THREADS];
+
+    /// Guards pass state.
+    Mutex m_mutex;
+
+    /// Signaled when the last worker finishes a pass.
+    Cond m_done;
+
+    /// Current pass.
+    Pass m_pass;
+
+    /// Number of passes started, workers start a pass when it changes.
+    unsigned m_generation;
+
+    /// Number of workers still calculating the current pass.
+    unsigned m_pending;
+
+    /// Set when workers should exit.
+    bool m_quit;
+
+  private:
+    /// Deleted copy constructor.
+    FluidCpu(const FluidCpu&) = delete;
+    /// Deleted assignment.
+    FluidCpu& operator=(const FluidCpu&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// Initial state is the same the initial copy passes of draw_fluid() produce.
+    ///
+    /// \param input Fluid input, used as both initial state and inflow.
+    /// \param bands Saturn bands, dye starts as the first row quantized to 8 bits like the bands texture.
+    explicit FluidCpu(const Image2D& input, const Image2D& bands) :
+      m_width(input.getWidth()),
+      m_height(input.getHeight()),
+      m_thread_count(std::min(static_cast<unsigned>(std::max(SDL_GetCPUCount(), 1)), MAX_THREADS)),
+      m_pass(PASS_INFLOW),
+      m_generation(0),
+      m_pending(0),
+      m_quit(false)
+    {
+      if((m_width % SIDE_ALIGNMENT) || (m_height % SIDE_ALIGNMENT))
+      {
+        std::ostringstream sstr;
+        sstr << "fluid size " << m_width << "x" << m_height << " is not divisible by " << SIDE_ALIGNMENT;
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+      if(bands.getWidth() != m_width)
+      {
+        std::ostringstream sstr;
+        sstr << "fluid width " << m_width << " does not match Saturn bands width " << bands.getWidth();
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+
+      unsigned texel_count = m_width * m_height;
+      for(unsigned ii = 0; (ii < 4); ++ii)
+      {
+        m_inflow[ii].resize(texel_count);
+        m_fluid[ii].resize(texel_count);
+        m_fluid_next[ii].resize(texel_count);
+        m_dye[ii].resize(texel_count);
+        m_dye_next[ii].resize(texel_count);
+      }
+      m_rhs.resize(texel_count);
+
+      for(unsigned ii = 0; (ii < m_width); ++ii)
+      {
+        float dye[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        for(unsigned kk = 0; (kk < bands.getChannelCount()) && (kk < 4); ++kk)
+        {
+          float value = std::min(std::max(bands.getValue(ii, 0, kk), 0.0f), 1.0f);
+          dye[kk] = std::floor(value * 255.0f + 0.5f) / 255.0f;
+        }
+
+        for(unsigned jj = 0; (jj < m_height); ++jj)
+        {
+          unsigned idx = jj * m_width + ii;
+
+          for(unsigned kk = 0; (kk < 4); ++kk)
+          {
+            m_inflow[kk][idx] = input.getValue(ii, jj, kk);
+            m_fluid[kk][idx] = m_inflow[kk][idx];
+            m_dye[kk][idx] = dye[kk];
+          }
+        }
+      }
+
+      for(unsigned ii = 0; (ii < m_thread_count); ++ii)
+      {
+        m_workers[ii].m_parent = this;
+        m_workers[ii].m_row_begin = m_height * ii / m_thread_count;
+        m_workers[ii].m_row_end = m_height * (ii + 1) / m_thread_count;
+      }
+      for(unsigned ii = 1; (ii < m_thread_count); ++ii)
+      {
+        m_threads[ii].reset(new Thread(Worker::run_thread, m_workers + ii));
+      }
+    }
+
+    /// Destructor.
+    ///
+    /// Tells the workers to exit and joins them.
+    ~FluidCpu()
+    {
+      {
+        ScopedLock lock(m_mutex);
+        m_quit = true;
+        for(unsigned ii = 1; (ii < m_thread_count); ++ii)
+        {
+          m_workers[ii].m_start.signal();
+        }
+      }
+      for(unsigned ii = 1; (ii < m_thread_count); ++ii)
+      {
+        m_threads[ii].reset();
+      }
+    }
+
+  private:
+    CPU_KERNELS_BEGIN
+    /// Round down.
+    ///
+    /// \param op Value, magnitude must be under 2^31.
+    /// \return Largest integer not greater than value.
+    template<typename V> static V lane_floor(const V& op)
+    {
+      V ret = vtrunc(op);
+      return vselect(ret > op, ret - V(1.0f), ret);
+    }
+
+    /// Wrap an integral coordinate into the simulation.
+    ///
+    /// \param op Coordinate.
+    /// \param size Simulation size.
+    /// \return Wrapped coordinate.
+    template<typename V> static V lane_wrap(const V& op, const V& size)
+    {
+      return op - lane_floor(op / size) * size;
+    }
+
+    /// Linear interpolation, like mix() in GLSL.
+    ///
+    /// \param lhs Value at 0.
+    /// \param rhs Value at 1.
+    /// \param weight Weight.
+    /// \return Interpolated value.
+    template<typename V> static V lane_mix(const V& lhs, const V& rhs, const V& weight)
+    {
+      return lhs + (rhs - lhs) * weight;
+    }
+
+    /// Get offsets of lanes from the first lane.
+    ///
+    /// \return Array of offsets, enough for widest lanes.
+    static const float* get_lane_offsets()
+    {
+      static const float ret[] =
+      {
+        0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f
+      };
+      return ret;
+    }
+
+    /// Fluid channel with inflow added.
+    ///
+    /// \param channel Channel.
+    /// \param idx Index of first texel.
+    /// \return Fluid values.
+    template<typename V> V addInflow(unsigned channel, unsigned idx) const
+    {
+      V add = V::load(&(m_inflow[channel][idx]));
+      V ret = V::load(&(m_fluid[channel][idx]));
+      // Alpha of inflow is not added if it is 1.
+      V keep((channel < 3) ? 0.0f : 1.0f);
+
+      return vselect(vabs(add - keep) > V(0.0f), add, ret);
+    }
+
+    /// Add inflow and build pressure right-hand side.
+    ///
+    /// \param center Index of first texel.
+    /// \param right Index of first right neighbour.
+    /// \param top Index of first top neighbour.
+    template<typename V> void inflow(unsigned center, unsigned right, unsigned top)
+    {
+      V scale(static_cast<float>(m_width));
+      V cr = addInflow<V>(0, center);
+      V cg = addInflow<V>(1, center);
+      V rr = addInflow<V>(0, right);
+      V tg = addInflow<V>(1, top);
+
+      cr.store(&(m_fluid_next[0][center]));
+      cg.store(&(m_fluid_next[1][center]));
+      addInflow<V>(2, center).store(&(m_fluid_next[2][center]));
+      addInflow<V>(3, center).store(&(m_fluid_next[3][center]));
+      (scale * (cr - rr + cg - tg)).store(&(m_rhs[center]));
+    }
+
+    /// One Jacobi iteration.
+    ///
+    /// \param center Index of first texel.
+    /// \param left Index of first left neighbour.
+    /// \param right Index of first right neighbour.
+    /// \param top Index of first top neighbour.
+    /// \param bottom Index of first bottom neighbour.
+    template<typename V> void jacobi(unsigned center, unsigned left, unsigned right, unsigned top, unsigned bottom)
+    {
+      const float* pressure = &(m_fluid[2][0]);
+      float dx = 1.0f / static_cast<float>(m_width);
+      float scale = DT / (RHO * dx * dx);
+      V pt = V::load(pressure + top);
+      V pb = V::load(pressure + bottom);
+      V pl = V::load(pressure + left);
+      V pr = V::load(pressure + right);
+      V offdiag = V(-scale) * (pt + pb + pl + pr);
+
+      ((V::load(&(m_rhs[center])) - offdiag) / V(4.0f * scale)).store(&(m_fluid_next[2][center]));
+    }
+
+    /// Apply pressure to velocity in place.
+    ///
+    /// \param center Index of first texel.
+    /// \param left Index of first left neighbour.
+    /// \param bottom Index of first bottom neighbour.
+    template<typename V> void apply(unsigned center, unsigned left, unsigned bottom)
+    {
+      const float* pressure = &(m_fluid[2][0]);
+      float dx = 1.0f / static_cast<float>(m_width);
+      V scale(DT / (RHO * dx));
+      V pc = V::load(pressure + center);
+      V pl = V::load(pressure + left);
+      V pb = V::load(pressure + bottom);
+      float* vx = &(m_fluid[0][center]);
+      float* vy = &(m_fluid[1][center]);
+
+      (V::load(vx) + (pl - pc) * scale).store(vx);
+      (V::load(vy) + (pb - pc) * scale).store(vy);
+    }
+
+    /// Advect dye and simulation space.
+    ///
+    /// \param row Row.
+    /// \param col Column of first texel.
+    template<typename V> void advect(unsigned row, unsigned col)
+    {
+      unsigned idx = row * m_width + col;
+      V width(static_cast<float>(m_width));
+      V height(static_cast<float>(m_height));
+      V px = V(static_cast<float>(col)) + V::load(get_lane_offsets());
+      V py(static_cast<float>(row));
+      V dt(DT);
+      V half(0.5f);
+
+      {
+        Bilinear<V> pos(px - V::load(&(m_fluid[0][idx])) * dt, py - V::load(&(m_fluid[1][idx])) * dt, width,
+            height);
+        for(unsigned ii = 0; (ii < 4); ++ii)
+        {
+          pos.sample(m_dye[ii]).store(&(m_dye_next[ii][idx]));
+        }
+      }
+
+      // Velocity components are staggered, see advect_simulationspace() in fluid.frag.
+      {
+        Bilinear<V> off(px - half, py, width, height);
+        Bilinear<V> pos(px - off.sample(m_fluid[0]) * dt, py - off.sample(m_fluid[1]) * dt, width, height);
+        pos.sample(m_fluid[0]).store(&(m_fluid_next[0][idx]));
+      }
+      {
+        Bilinear<V> off(px, py - half, width, height);
+        Bilinear<V> pos(px - off.sample(m_fluid[0]) * dt, py - off.sample(m_fluid[1]) * dt, width, height);
+        pos.sample(m_fluid[1]).store(&(m_fluid_next[1][idx]));
+      }
+      {
+        Bilinear<V> off(px - half, py - half, width, height);
+        Bilinear<V> pos(px - (off.sample(m_fluid[0]) + half / width) * dt,
+            py - (off.sample(m_fluid[1]) + half / height) * dt, width, height);
+        pos.sample(m_fluid[2]).store(&(m_fluid_next[2][idx]));
+        pos.sample(m_fluid[3]).store(&(m_fluid_next[3][idx]));
+      }
+    }
+
+    /// Run a stencil pass on a vector of texels.
+    ///
+    /// \param pass Pass.
+    /// \param row Row.
+    /// \param col Column of first texel.
+    /// \param left Column of first left neighbour.
+    /// \param right Column of first right neighbour.
+    template<typename V> void runStencil(Pass pass, unsigned row, unsigned col, unsigned left, unsigned right)
+    {
+      unsigned center = row * m_width;
+      unsigned top = ((row + 1 < m_height) ? (row + 1) : 0) * m_width;
+      unsigned bottom = ((row ? row : m_height) - 1) * m_width;
+
+      switch(pass)
+      {
+        case PASS_INFLOW:
+          inflow<V>(center + col, center + right, top + col);
+          break;
+
+        case PASS_JACOBI:
+          jacobi<V>(center + col, center + left, center + right, top + col, bottom + col);
+          break;
+
+        case PASS_APPLY:
+        default:
+          apply<V>(center + col, center + left, bottom + col);
+          break;
+      }
+    }
+
+    /// Run a pass on rows.
+    ///
+    /// \param pass Pass.
+    /// \param row_begin First row.
+    /// \param row_end One past last row.
+    template<typename V> void runRows(Pass pass, unsigned row_begin, unsigned row_end)
+    {
+      const unsigned LANES = V::LANES;
+
+      for(unsigned jj = row_begin; (jj < row_end); ++jj)
+      {
+        if(PASS_ADVECT == pass)
+        {
+          for(unsigned ii = 0; (ii < m_width); ii += LANES)
+          {
+            advect<V>(jj, ii);
+          }
+          continue;
+        }
+
+        // Horizontal neighbours of the first and last vector wrap around.
+        for(unsigned ii = 0; (ii < LANES); ++ii)
+        {
+          runStencil<ffloat1>(pass, jj, ii, (ii ? ii : m_width) - 1, ii + 1);
+        }
+        for(unsigned ii = LANES; (ii < m_width - LANES); ii += LANES)
+        {
+          runStencil<V>(pass, jj, ii, ii - 1, ii + 1);
+        }
+        for(unsigned ii = m_width - LANES; (ii < m_width); ++ii)
+        {
+          runStencil<ffloat1>(pass, jj, ii, ii - 1, (ii + 1 < m_width) ? (ii + 1) : 0);
+        }
+      }
+    }
+    CPU_KERNELS_END
+
+    /// Run a pass on all rows.
+    ///
+    /// The calling thread calculates the first rows and returns once all workers have finished, so the pass acts
+    /// as a barrier.
+    ///
+    /// \param pass Pass.
+    void runPass(Pass pass)
+    {
+      {
+        ScopedLock lock(m_mutex);
+        m_pass = pass;
+        m_pending = m_thread_count - 1;
+        ++m_generation;
+        for(unsigned ii = 1; (ii < m_thread_count); ++ii)
+        {
+          m_workers[ii].m_start.signal();
+        }
+      }
+
+      ffloat_dispatch(m_workers[0]);
+
+      ScopedLock lock(m_mutex);
+      while(m_pending)
+      {
+        m_done.wait(lock);
+      }
+    }
+
+    /// Worker thread loop.
+    ///
+    /// Calculates the rows of the worker for every pass started until told to exit.
+    ///
+    /// \param worker Worker.
+    void runWorker(Worker& worker)
+    {
+      unsigned generation = 0;
+
+      for(;;)
+      {
+        {
+          ScopedLock lock(m_mutex);
+          while((m_generation == generation) && !m_quit)
+          {
+            worker.m_start.wait(lock);
+          }
+          if(m_quit)
+          {
+            return;
+          }
+          generation = m_generation;
+        }
+
+        ffloat_dispatch(worker);
+
+        ScopedLock lock(m_mutex);
+        if(!--m_pending)
+        {
+          m_done.signal();
+        }
+      }
+    }
+
+  public:
+    /// Accessor.
+    ///
+    /// \return Width.
+    unsigned getWidth() const
+    {
+      return m_width;
+    }
+
+    /// Accessor.
+    ///
+    /// \return Height.
+    unsigned getHeight() const
+    {
+      return m_height;
+    }
+
+    /// Run one fluid step.
+    void step()
+    {
+      runPass(PASS_INFLOW);
+      for(unsigned ii = 0; (ii < 4); ++ii)
+      {
+        m_fluid[ii].swap(m_fluid_next[ii]);
+      }
+
+      for(unsigned ii = 0; (ii < PROJECT_COUNT); ++ii)
+      {
+        runPass(PASS_JACOBI);
+        m_fluid[2].swap(m_fluid_next[2]);
+      }
+
+      runPass(PASS_APPLY);
+
+      runPass(PASS_ADVECT);
+      for(unsigned ii = 0; (ii < 4); ++ii)
+      {
+        m_fluid[ii].swap(m_fluid_next[ii]);
+        m_dye[ii].swap(m_dye_next[ii]);
+      }
+    }
+
+    /// Get state as RGBA texels.
+    ///
+    /// \param fluid [out] Fluid texels.
+    /// \param dye [out] Dye texels.
+    void getState(std::vector<float>& fluid, std::vector<float>& dye) const
+    {
+      unsigned texel_count = m_width * m_height;
+
+      fluid.resize(texel_count * 4);
+      dye.resize(texel_count * 4);
+      for(unsigned ii = 0; (ii < texel_count); ++ii)
+      {
+        for(unsigned jj = 0; (jj < 4); ++jj)
+        {
+          fluid[ii * 4 + jj] = m_fluid[jj][ii];
+          dye[ii * 4 + jj] = m_dye[jj][ii];
+        }
+      }
+    }
+
+    /// Set state from RGBA texels.
+    ///
+    /// \param fluid Fluid texels.
+    /// \param dye Dye texels.
+    void setState(const std::vector<float>& fluid, const std::vector<float>& dye)
+    {
+      unsigned texel_count = m_width * m_height;
+
+      for(unsigned ii = 0; (ii < texel_count); ++ii)
+      {
+        for(unsigned jj = 0; (jj < 4); ++jj)
+        {
+          m_fluid[jj][ii] = fluid[ii * 4 + jj];
+          m_dye[jj][ii] = dye[ii * 4 + jj];
+        }
+      }
+    }
+
+    /// Capture Saturn bands from dye.
+    ///
+    /// Quantizes the same way as the CAPTURE control of the precalc shader.
+    ///
+    /// \param bands [out] Saturn bands, must be the size of the simulation.
+    void capture(Image2D& bands) const
+    {
+      for(unsigned jj = 0; (jj < m_height); ++jj)
+      {
+        for(unsigned ii = 0; (ii < m_width); ++ii)
+        {
+          unsigned idx = jj * m_width + ii;
+
+          for(unsigned kk = 0; (kk < 3); ++kk)
+          {
+            float value = std::min(std::max(m_dye[kk][idx], -1.0f), 1.0f);
+            value = std::max(std::floor(value * 127.0f + 0.5f), 0.0f) / 255.0f;
+            bands.setValue(ii, jj, kk, value);
+          }
+          bands.setValue(ii, jj, 3, 1.0f);
+        }
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,88 @@
+// Multigrid pressure solve, replaces the PROJECT passes of fluid.frag.
+//
+// Like PROJECT, the solution is in the blue channel of tex and the right-hand side in the blue channel of initial.
+// Other channels of the solution are passed through, so the finest level is solved in the velocity framebuffers.
+
+layout(location=0) uniform int control;
+layout(location=5) uniform sampler2D tex;
+layout(location=7) uniform sampler2D initial;
+
+in vec2 texcoord;
+
+out vec4 output_color;
+
+const int MG_SMOOTH = 0;
+const int MG_SMOOTH_ZERO = MG_SMOOTH + 1;
+const int MG_RESTRICT = MG_SMOOTH_ZERO + 1;
+const int MG_PROLONG = MG_RESTRICT + 1;
+
+// Physical constants, must match fluid.frag.
+const float dt = 0.1;
+const float rho = 0.1;
+
+/// Weight of weighted Jacobi smoothing.
+const float OMEGA = 0.8;
+
+/// Diagonal of the pressure operator.
+/// \param pixel_size Pixel size of the level.
+/// \return Operator scale, the diagonal is four times this.
+float operator_scale(vec2 pixel_size)
+{
+  return dt / (rho * pixel_size.x * pixel_size.x);
+}
+
+/// Sum of solution at neighbors.
+/// \param coord Texture coordinate.
+/// \param pixel_size Pixel size of the level.
+/// \return Sum of the four neighbors.
+float neighbor_sum(vec2 coord, vec2 pixel_size)
+{
+  return texture(tex, coord + vec2(0.0, pixel_size.y)).b + texture(tex, coord - vec2(0.0, pixel_size.y)).b +
+    texture(tex, coord - vec2(pixel_size.x, 0.0)).b + texture(tex, coord + vec2(pixel_size.x, 0.0)).b;
+}
+
+void main()
+{
+  if(control <= MG_SMOOTH)
+  {
+    vec2 pixel_size = vec2(1.0) / textureSize(tex, 0);
+    float scale = operator_scale(pixel_size);
+    float jacobi = (texture(initial, texcoord).b + scale * neighbor_sum(texcoord, pixel_size)) / (4.0 * scale);
+
+    output_color = texture(tex, texcoord);
+    output_color.b = mix(output_color.b, jacobi, OMEGA);
+  }
+  // First smoothing of a coarse level, the correction starts from zero.
+  else if(control <= MG_SMOOTH_ZERO)
+  {
+    float scale = operator_scale(vec2(1.0) / textureSize(initial, 0));
+
+    output_color = vec4(0.0);
+    output_color.b = OMEGA * texture(initial, texcoord).b / (4.0 * scale);
+  }
+  // Average residual of the 2x2 finer texels into the coarser level. Red and alpha get mean squared right-hand side
+  // and residual for measuring convergence.
+  else if(control <= MG_RESTRICT)
+  {
+    vec2 pixel_size = vec2(1.0) / textureSize(tex, 0);
+    float scale = operator_scale(pixel_size);
+    vec4 ret = vec4(0.0);
+
+    for(int ii = 0; (ii < 4); ++ii)
+    {
+      vec2 coord = texcoord + (vec2(float(ii & 1), float(ii >> 1)) - 0.5) * pixel_size;
+      float rhs = texture(initial, coord).b;
+      float residual = rhs - scale * (4.0 * texture(tex, coord).b - neighbor_sum(coord, pixel_size));
+
+      ret += vec4(rhs * rhs, 0.0, residual, residual * residual);
+    }
+
+    output_color = ret * 0.25;
+  }
+  // Add bilinearly interpolated coarser correction.
+  else
+  {
+    output_color = texture(tex, texcoord);
+    output_color.b += texture(initial, texcoord).b;
+  }
+}
@@ -0,0 +1,5 @@
+static const char *g_shader_fragment_fluid_multigrid = ""
+#if defined(USE_LD)
+"fluid_multigrid.frag.glsl"
+#endif
+"";
@@ -0,0 +1,271 @@
+#ifndef FLUID_MULTIGRID_HPP
+#define FLUID_MULTIGRID_HPP
+
+#include <cmath>
+
+/// Solve fluid pressure with multigrid V-cycles instead of Jacobi iteration.
+static bool g_fluid_multigrid = false;
+
+/// Print pressure residual of every fluid step.
+static bool g_fluid_residual = false;
+
+/// Multigrid pressure solver for the fluid simulation.
+///
+/// Runs V-cycles over a pyramid of pressure targets with weighted Jacobi smoothing. The finest level is the fluid
+/// framebuffer pair and pressure framebuffer used by the Jacobi passes, so either solver can be used for any step.
+class FluidMultigrid
+{
+  private:
+    /// Shader controls, must match the shader.
+    enum Control
+    {
+      MG_SMOOTH = 0,
+      MG_SMOOTH_ZERO,
+      MG_RESTRICT,
+      MG_PROLONG
+    };
+
+    /// Maximum number of levels, including the finest.
+    static const unsigned MAX_LEVELS = 16;
+
+    /// Smallest side of the coarsest level.
+    static const unsigned COARSEST_SIDE = 8;
+
+    /// Smoothing passes before restriction.
+    static const unsigned PRE_SMOOTH = 2;
+
+    /// Smoothing passes after prolongation.
+    static const unsigned POST_SMOOTH = 2;
+
+    /// Smoothing passes on the coarsest level.
+    static const unsigned COARSEST_SMOOTH = 16;
+
+  private:
+    /// Pipeline program.
+    Pipeline m_pipeline;
+
+    /// Right-hand side of each level, index 0 is unused.
+    uptr<FrameBuffer> m_rhs[MAX_LEVELS];
+
+    /// Solution pair of each level, index 0 is unused.
+    uptr<FrameBuffer> m_solution[MAX_LEVELS][2];
+
+    /// Current solution of each level.
+    int m_phase[MAX_LEVELS];
+
+    /// Number of levels, including the finest.
+    unsigned m_level_count;
+
+    /// Finest level solution pair during solve().
+    const FrameBuffer* m_fine[2];
+
+    /// Finest level right-hand side during solve().
+    const FrameBuffer* m_fine_rhs;
+
+    /// Texels written by solves so far.
+    uint64_t m_texel_passes;
+
+  private:
+    /// Deleted copy constructor.
+    FluidMultigrid(const FluidMultigrid&) = delete;
+    /// Deleted assignment.
+    FluidMultigrid& operator=(const FluidMultigrid&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param width Width of finest level.
+    /// \param height Height of finest level.
+    explicit FluidMultigrid(unsigned width, unsigned height) :
+      m_pipeline(g_shader_header, g_shader_vertex_fluid, g_shader_fragment_fluid_multigrid),
+      m_level_count(1),
+      m_fine_rhs(NULL),
+      m_texel_passes(0)
+    {
+      for(unsigned ii = 0; (ii < MAX_LEVELS); ++ii)
+      {
+        m_phase[ii] = 0;
+      }
+
+      while((m_level_count < MAX_LEVELS) && ((width >> m_level_count) >= COARSEST_SIDE) &&
+          ((height >> m_level_count) >= COARSEST_SIDE))
+      {
+        unsigned level_width = width >> m_level_count;
+        unsigned level_height = height >> m_level_count;
+
+        m_rhs[m_level_count].reset(new FrameBuffer(level_width, level_height, true, false, 4, BILINEAR, WRAP));
+        for(unsigned ii = 0; (ii < 2); ++ii)
+        {
+          m_solution[m_level_count][ii].reset(new FrameBuffer(level_width, level_height, true, false, 4, BILINEAR,
+                WRAP));
+        }
+        ++m_level_count;
+      }
+
+      std::cout << "fluid multigrid: " << m_level_count << " levels down to " << (width >> (m_level_count - 1)) <<
+        "x" << (height >> (m_level_count - 1)) << std::endl;
+    }
+
+  private:
+    /// Accessor.
+    ///
+    /// \param level Level.
+    /// \param idx Solution index (0 or 1).
+    /// \return Solution framebuffer.
+    const FrameBuffer& getSolution(unsigned level, int idx) const
+    {
+      return level ? *(m_solution[level][idx]) : *(m_fine[idx]);
+    }
+
+    /// Accessor.
+    ///
+    /// \param level Level.
+    /// \return Right-hand side framebuffer.
+    const FrameBuffer& getRhs(unsigned level) const
+    {
+      return level ? *(m_rhs[level]) : *m_fine_rhs;
+    }
+
+    /// Render one pass.
+    ///
+    /// \param control Shader control.
+    /// \param dst Framebuffer to render to.
+    /// \param src Texture sampled as solution.
+    /// \param input Texture sampled as right-hand side or coarser correction.
+    void pass(Control control, const FrameBuffer& dst, const Texture& src, const Texture& input)
+    {
+      dst.bind();
+      m_pipeline.bind();
+
+      m_pipeline.uniformFrag(g_uniform_array, static_cast<GLint>(control));
+      m_pipeline.uniformFrag(g_uniform_fbo, 0, src);
+      m_pipeline.uniformFrag(g_uniform_fluid_input, 2, input);
+
+      dnload_glRects(-1, -1, 1, 1);
+
+      m_texel_passes += dst.getWidth() * dst.getHeight();
+    }
+
+    /// Smooth a level once.
+    ///
+    /// \param level Level.
+    /// \param zero True if the current solution should be treated as zero.
+    void smooth(unsigned level, bool zero)
+    {
+      const FrameBuffer& dst = getSolution(level, 1 - m_phase[level]);
+      const Texture& rhs = getRhs(level).getTextureColor();
+
+      if(zero)
+      {
+        pass(MG_SMOOTH_ZERO, dst, rhs, rhs);
+      }
+      else
+      {
+        pass(MG_SMOOTH, dst, getSolution(level, m_phase[level]).getTextureColor(), rhs);
+      }
+      m_phase[level] = 1 - m_phase[level];
+    }
+
+    /// Run a V-cycle from given level downwards.
+    ///
+    /// Coarser levels solve for a correction starting from zero, the finest level starts from the previous
+    /// pressure.
+    ///
+    /// \param level Level.
+    void cycle(unsigned level)
+    {
+      bool coarsest = (level + 1 >= m_level_count);
+      unsigned smooth_count = coarsest ? COARSEST_SMOOTH : PRE_SMOOTH;
+
+      for(unsigned ii = 0; (ii < smooth_count); ++ii)
+      {
+        smooth(level, (0 < level) && (0 == ii));
+      }
+      if(coarsest)
+      {
+        return;
+      }
+
+      pass(MG_RESTRICT, getRhs(level + 1), getSolution(level, m_phase[level]).getTextureColor(),
+          getRhs(level).getTextureColor());
+
+      cycle(level + 1);
+
+      pass(MG_PROLONG, getSolution(level, 1 - m_phase[level]), getSolution(level, m_phase[level]).getTextureColor(),
+          getSolution(level + 1, m_phase[level + 1]).getTextureColor());
+      m_phase[level] = 1 - m_phase[level];
+
+      for(unsigned ii = 0; (ii < POST_SMOOTH); ++ii)
+      {
+        smooth(level, false);
+      }
+    }
+
+  public:
+    /// Accessor.
+    ///
+    /// \return Texels written by solves so far.
+    uint64_t getTexelPasses() const
+    {
+      return m_texel_passes;
+    }
+
+    /// Solve pressure.
+    ///
+    /// \param fine_1 Finest level solution framebuffer 1.
+    /// \param fine_2 Finest level solution framebuffer 2.
+    /// \param phase Index of the framebuffer containing current solution.
+    /// \param fine_rhs Finest level right-hand side framebuffer.
+    /// \param cycles Number of V-cycles (default: 1).
+    /// \return Index of the framebuffer containing the solution.
+    int solve(const FrameBuffer& fine_1, const FrameBuffer& fine_2, int phase, const FrameBuffer& fine_rhs,
+        unsigned cycles = 1)
+    {
+      m_fine[0] = &fine_1;
+      m_fine[1] = &fine_2;
+      m_fine_rhs = &fine_rhs;
+      m_phase[0] = phase;
+
+      for(unsigned ii = 0; (ii < cycles); ++ii)
+      {
+        cycle(0);
+      }
+
+      return m_phase[0];
+    }
+
+    /// Measure residual of the finest level.
+    ///
+    /// Reads back the second level, so this is only meant for diagnostics.
+    ///
+    /// \param solution Solution framebuffer.
+    /// \param rhs Right-hand side framebuffer.
+    /// \param relative [out] Residual relative to right-hand side.
+    /// \return Root mean square residual.
+    float measureResidual(const FrameBuffer& solution, const FrameBuffer& rhs, float& relative)
+    {
+      const FrameBuffer& dst = *(m_rhs[1]);
+      uint64_t texel_passes = m_texel_passes;
+
+      pass(MG_RESTRICT, dst, solution.getTextureColor(), rhs.getTextureColor());
+      m_texel_passes = texel_passes;
+
+      unsigned count = dst.getWidth() * dst.getHeight();
+      std::vector<float> data(count * 4);
+      dst.getTextureColor().bind(0);
+      glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, data.data());
+
+      double rhs_sum = 0.0;
+      double residual_sum = 0.0;
+      for(unsigned ii = 0; (ii < count); ++ii)
+      {
+        rhs_sum += static_cast<double>(data[ii * 4 + 0]);
+        residual_sum += static_cast<double>(data[ii * 4 + 3]);
+      }
+
+      relative = (rhs_sum > 0.0) ? static_cast<float>(std::sqrt(residual_sum / rhs_sum)) : 0.0f;
+      return static_cast<float>(std::sqrt(residual_sum / static_cast<double>(count)));
+    }
+};
+
+#endif
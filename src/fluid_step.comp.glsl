@@ -0,0 +1,292 @@
+#version 430
+
+/// Fused fluid simulation step.
+///
+/// Calculates the same step as the passes of fluid.frag, with fewer round trips through memory:
+/// - Inflow, pressure right-hand side and the first Jacobi iterations run in one dispatch.
+/// - Every following dispatch runs several Jacobi iterations.
+/// - Pressure is applied while advecting velocity and dye.
+///
+/// Jacobi tiles load a halo one texel wider per iteration into shared memory, so iterations within a dispatch
+/// need no global memory traffic. Advection tiles hold the velocity with pressure applied. Taps outside the tile
+/// are calculated from global memory, so any velocity is handled.
+///
+/// Standalone, does not use the common header.
+
+layout(local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+/// Fluid input.
+layout(binding = 0, rgba32f) readonly uniform image2D fluid_src;
+/// Fluid output.
+layout(binding = 1, rgba32f) writeonly uniform image2D fluid_dst;
+/// Pressure right-hand side in the blue channel, like the pressure framebuffer.
+layout(binding = 2, rgba32f) uniform image2D pressure;
+/// Dye output.
+layout(binding = 3, rgba32f) writeonly uniform image2D dye_dst;
+
+/// Inflow.
+layout(binding = 0) uniform sampler2D inflow;
+/// Dye input.
+layout(binding = 1) uniform sampler2D dye_src;
+
+/// Mode: 0 = inflow and first Jacobi iterations, 1 = Jacobi iterations, 2 = apply pressure and advect.
+layout(location = 0) uniform int mode;
+
+const int MODE_INFLOW = 0;
+const int MODE_JACOBI = 1;
+const int MODE_ADVECT = 2;
+
+/// Jacobi iterations per dispatch, must match the program.
+const int JACOBI_ITERATIONS = 4;
+/// Jacobi output tile side, must match the program.
+const int JACOBI_TILE = 32;
+/// Jacobi shared memory side.
+const int JACOBI_SIDE = JACOBI_TILE + JACOBI_ITERATIONS * 2;
+
+/// Advection output tile side, must match the program.
+const int ADVECT_TILE = 16;
+/// Advection halo, taps further away are calculated from global memory.
+const int ADVECT_HALO = 4;
+/// Advection shared memory side.
+const int ADVECT_SIDE = ADVECT_TILE + ADVECT_HALO * 2;
+
+/// Invocations per work group.
+const int GROUP_INVOCATIONS = 16 * 16;
+
+// Physical constants, must match fluid.frag.
+const float dt = 0.1;
+const float rho = 0.1;
+
+/// Jacobi solution pair.
+shared float jacobi_pressure[2][JACOBI_SIDE * JACOBI_SIDE];
+/// Jacobi right-hand side.
+shared float jacobi_rhs[JACOBI_SIDE * JACOBI_SIDE];
+/// Fluid with pressure applied.
+shared vec4 advect_fluid[ADVECT_SIDE * ADVECT_SIDE];
+
+/// Wrap a texel coordinate into the image, like the WRAP mode of the framebuffers.
+/// \param op Texel coordinate.
+/// \param size Image size.
+/// \return Wrapped coordinate.
+ivec2 wrap(ivec2 op, ivec2 size)
+{
+  return op - size * ivec2(floor(vec2(op) / vec2(size)));
+}
+
+/// Fluid with inflow added.
+/// \param coord Wrapped texel coordinate.
+/// \return Fluid texel.
+vec4 fluid_inflow(ivec2 coord)
+{
+  vec4 add_color = texelFetch(inflow, coord, 0);
+  vec4 ret = imageLoad(fluid_src, coord);
+
+  if(add_color.r != 0.0)
+  {
+    ret.r = add_color.r;
+  }
+  if(add_color.g != 0.0)
+  {
+    ret.g = add_color.g;
+  }
+  if(add_color.b != 0.0)
+  {
+    ret.b = add_color.b;
+  }
+  if(add_color.a != 1.0)
+  {
+    ret.a = add_color.a;
+  }
+
+  return ret;
+}
+
+/// Pressure right-hand side of fluid with inflow added.
+/// \param coord Texel coordinate.
+/// \param size Image size.
+/// \return Divergence.
+float build_pressure(ivec2 coord, ivec2 size)
+{
+  float dx = 1.0 / float(size.x);
+  float scale = 1.0 / dx;
+
+  vec4 C = fluid_inflow(wrap(coord, size));
+  vec4 T = fluid_inflow(wrap(coord + ivec2(0, 1), size));
+  vec4 R = fluid_inflow(wrap(coord + ivec2(1, 0), size));
+
+  return scale * (C.r - R.r + C.g - T.g);
+}
+
+/// Fluid with pressure applied.
+/// \param coord Texel coordinate.
+/// \param size Image size.
+/// \return Fluid texel.
+vec4 apply_pressure(ivec2 coord, ivec2 size)
+{
+  float dx = 1.0 / float(size.x);
+  float scale = dt / (rho * dx);
+
+  vec4 ret = imageLoad(fluid_src, wrap(coord, size));
+  float B = imageLoad(fluid_src, wrap(coord - ivec2(0, 1), size)).b;
+  float L = imageLoad(fluid_src, wrap(coord - ivec2(1, 0), size)).b;
+
+  ret.rg += vec2(L - ret.b, B - ret.b) * scale;
+  return ret;
+}
+
+/// Run Jacobi iterations in shared memory and write the output tile.
+/// \param origin Texel coordinate of the first shared memory texel.
+/// \param size Image size.
+/// \param inflow_added True if inflow should be added to the passed-through channels.
+void jacobi(ivec2 origin, ivec2 size, bool inflow_added)
+{
+  float dx = 1.0 / float(size.x);
+  float scale = dt / (rho * dx * dx);
+
+  // Valid area shrinks by one texel per iteration.
+  for(int ii = 0; (ii < JACOBI_ITERATIONS); ++ii)
+  {
+    int src = ii & 1;
+    int border = ii + 1;
+    int side = JACOBI_SIDE - border * 2;
+
+    for(int jj = int(gl_LocalInvocationIndex); (jj < side * side); jj += GROUP_INVOCATIONS)
+    {
+      int idx = (jj / side + border) * JACOBI_SIDE + (jj % side + border);
+      float T = jacobi_pressure[src][idx + JACOBI_SIDE];
+      float B = jacobi_pressure[src][idx - JACOBI_SIDE];
+      float L = jacobi_pressure[src][idx - 1];
+      float R = jacobi_pressure[src][idx + 1];
+      float offdiag = -scale * (T + B + L + R);
+
+      jacobi_pressure[1 - src][idx] = (jacobi_rhs[idx] - offdiag) / (4.0 * scale);
+    }
+
+    memoryBarrierShared();
+    barrier();
+  }
+
+  for(int ii = int(gl_LocalInvocationIndex); (ii < JACOBI_TILE * JACOBI_TILE); ii += GROUP_INVOCATIONS)
+  {
+    ivec2 local = ivec2(ii % JACOBI_TILE, ii / JACOBI_TILE) + JACOBI_ITERATIONS;
+    ivec2 coord = origin + local;
+    vec4 ret = inflow_added ? fluid_inflow(coord) : imageLoad(fluid_src, coord);
+
+    ret.b = jacobi_pressure[JACOBI_ITERATIONS & 1][local.y * JACOBI_SIDE + local.x];
+    imageStore(fluid_dst, coord, ret);
+  }
+}
+
+/// Sample fluid with pressure applied.
+/// \param origin Texel coordinate of the first shared memory texel.
+/// \param coord Texel coordinate.
+/// \param size Image size.
+/// \return Fluid texel.
+vec4 advect_fetch(ivec2 origin, ivec2 coord, ivec2 size)
+{
+  ivec2 local = coord - origin;
+
+  if(all(greaterThanEqual(local, ivec2(0))) && all(lessThan(local, ivec2(ADVECT_SIDE))))
+  {
+    return advect_fluid[local.y * ADVECT_SIDE + local.x];
+  }
+  return apply_pressure(coord, size);
+}
+
+/// Bilinearly sample fluid with pressure applied, like texture() on the framebuffer.
+/// \param origin Texel coordinate of the first shared memory texel.
+/// \param coord Texture coordinate.
+/// \param size Image size.
+/// \return Interpolated fluid.
+vec4 advect_sample(ivec2 origin, vec2 coord, ivec2 size)
+{
+  vec2 pos = coord * vec2(size) - 0.5;
+  vec2 base = floor(pos);
+  vec2 weight = pos - base;
+  ivec2 texel = ivec2(base);
+
+  vec4 bottom = mix(advect_fetch(origin, texel, size), advect_fetch(origin, texel + ivec2(1, 0), size), weight.x);
+  vec4 top = mix(advect_fetch(origin, texel + ivec2(0, 1), size), advect_fetch(origin, texel + ivec2(1, 1), size),
+      weight.x);
+  return mix(bottom, top, weight.y);
+}
+
+void main()
+{
+  ivec2 size = imageSize(fluid_src);
+
+  if(mode <= MODE_INFLOW)
+  {
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * JACOBI_TILE - JACOBI_ITERATIONS;
+
+    for(int ii = int(gl_LocalInvocationIndex); (ii < JACOBI_SIDE * JACOBI_SIDE); ii += GROUP_INVOCATIONS)
+    {
+      ivec2 coord = origin + ivec2(ii % JACOBI_SIDE, ii / JACOBI_SIDE);
+      float rhs = build_pressure(coord, size);
+
+      jacobi_rhs[ii] = rhs;
+      jacobi_pressure[0][ii] = fluid_inflow(wrap(coord, size)).b;
+
+      // Every texel of the tile interior is written exactly once.
+      ivec2 local = coord - origin - JACOBI_ITERATIONS;
+      if(all(greaterThanEqual(local, ivec2(0))) && all(lessThan(local, ivec2(JACOBI_TILE))))
+      {
+        imageStore(pressure, coord, vec4(0.0, 0.0, rhs, 0.0));
+      }
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    jacobi(origin, size, true);
+  }
+  else if(mode <= MODE_JACOBI)
+  {
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * JACOBI_TILE - JACOBI_ITERATIONS;
+
+    for(int ii = int(gl_LocalInvocationIndex); (ii < JACOBI_SIDE * JACOBI_SIDE); ii += GROUP_INVOCATIONS)
+    {
+      ivec2 coord = wrap(origin + ivec2(ii % JACOBI_SIDE, ii / JACOBI_SIDE), size);
+
+      jacobi_rhs[ii] = imageLoad(pressure, coord).b;
+      jacobi_pressure[0][ii] = imageLoad(fluid_src, coord).b;
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    jacobi(origin, size, false);
+  }
+  else
+  {
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * ADVECT_TILE - ADVECT_HALO;
+
+    for(int ii = int(gl_LocalInvocationIndex); (ii < ADVECT_SIDE * ADVECT_SIDE); ii += GROUP_INVOCATIONS)
+    {
+      advect_fluid[ii] = apply_pressure(origin + ivec2(ii % ADVECT_SIDE, ii / ADVECT_SIDE), size);
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    vec2 pixel_size = vec2(1.0) / vec2(size);
+    vec2 texcoord = (vec2(coord) + 0.5) * pixel_size;
+    vec2 offset_p = 0.5 * pixel_size;
+    vec2 offset_vx = 0.5 * vec2(0.0, pixel_size.y);
+    vec2 offset_vy = 0.5 * vec2(pixel_size.x, 0.0);
+
+    // Velocity components are staggered, see advect_simulationspace() in fluid.frag.
+    vec2 off_vx = advect_sample(origin, texcoord - offset_vy, size).rg;
+    float vx = advect_sample(origin, texcoord - (off_vx * pixel_size) * dt, size).r;
+    vec2 off_vy = advect_sample(origin, texcoord - offset_vx, size).rg;
+    float vy = advect_sample(origin, texcoord - (off_vy * pixel_size) * dt, size).g;
+    vec2 off_p = advect_sample(origin, texcoord - offset_p, size).rg;
+    vec2 pa = advect_sample(origin, texcoord - (off_p + offset_p) * pixel_size * dt, size).ba;
+
+    imageStore(fluid_dst, coord, vec4(vx, vy, pa.x, pa.y));
+
+    vec2 offset = advect_fetch(origin, coord, size).rg;
+    imageStore(dye_dst, coord, texture(dye_src, texcoord - offset * pixel_size * dt));
+  }
+}
@@ -0,0 +1,5 @@
+static const char *g_shader_compute_fluid_step = ""
+#if defined(USE_LD)
+"fluid_step.comp.glsl"
+#endif
+"";
@@ -3,6 +3,167 @@
 
 #include "direction.hpp"
 #include "global_data_temporary.hpp"
+#include "gpu_profiler.hpp"
+#if defined(USE_LD)
+#include "fluid_compute.hpp"
+#include "fluid_cpu.hpp"
+#include "fluid_multigrid.hpp"
+#include "precalc_compute.hpp"
+#include "verbatim_texture_residency.hpp"
+#endif
+
+#if defined(USE_LD)
+/// Milliseconds per frame the GL thread may spend uploading precalc assets.
+static int g_upload_budget = 4;
+
+/// Milliseconds before use textures are restored to full resolution, 0 to keep all textures resident.
+static int g_residency_lookahead = 0;
+#else
+/// Milliseconds per frame the GL thread may spend uploading precalc assets.
+static const int g_upload_budget = 4;
+#endif
+
+/// Fluid framebuffer formats.
+enum FluidFormat
+{
+  /// 32-bit float RGBA for every target.
+  ///
+  /// The compute shader step, the multigrid solver and fluid verification access targets as RGBA32F.
+  FLUID_FORMAT_FLOAT = 0,
+
+  /// Single channel half float pressure, 32-bit float RGBA velocity and dye.
+  FLUID_FORMAT_PACKED,
+
+  /// RG16F velocity with pressure iterated in separate R16F targets, RGBA16F dye.
+  ///
+  /// Dye is re-quantized on every advection, so the captured bands darken slightly.
+  FLUID_FORMAT_HALF,
+
+  /// Number of fluid formats.
+  FLUID_FORMAT_COUNT
+};
+
+#if defined(USE_LD)
+/// Fluid framebuffer format.
+static FluidFormat g_fluid_format = FLUID_FORMAT_PACKED;
+
+/// Get the name of a fluid format.
+///
+/// \param op Fluid format.
+/// \return Name as accepted on the command line.
+static const char* fluid_format_name(FluidFormat op)
+{
+  switch(op)
+  {
+    case FLUID_FORMAT_FLOAT:
+      return "float";
+
+    case FLUID_FORMAT_PACKED:
+      return "packed";
+
+    case FLUID_FORMAT_HALF:
+    default:
+      return "half";
+  }
+}
+
+/// Parse a fluid format from a name.
+///
+/// \param op Name.
+/// \return Fluid format.
+static FluidFormat fluid_format_parse(const std::string& op)
+{
+  for(int ii = 0; (ii < FLUID_FORMAT_COUNT); ++ii)
+  {
+    FluidFormat format = static_cast<FluidFormat>(ii);
+    if(op == fluid_format_name(format))
+    {
+      return format;
+    }
+  }
+
+  std::ostringstream sstr;
+  sstr << "invalid fluid format: '" << op << "'";
+  BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+}
+#else
+/// Fluid framebuffer format.
+static const FluidFormat g_fluid_format = FLUID_FORMAT_PACKED;
+#endif
+
+/// Get bytes per channel of fluid velocity framebuffers.
+///
+/// \return 2 for half float velocity, 4 otherwise.
+static unsigned get_fluid_bpc()
+{
+  return (g_fluid_format == FLUID_FORMAT_HALF) ? 2 : 4;
+}
+
+/// Get channel count of fluid velocity framebuffers.
+///
+/// \return 2 when pressure is iterated in separate targets, 4 when velocity targets also hold pressure.
+static unsigned get_fluid_channels()
+{
+  return (g_fluid_format == FLUID_FORMAT_HALF) ? 2 : 4;
+}
+
+/// Get bytes per channel of fluid pressure framebuffers.
+///
+/// \return 4 for 32-bit float pressure, 2 for half floats.
+static unsigned get_fluid_pressure_bpc()
+{
+  return (g_fluid_format == FLUID_FORMAT_FLOAT) ? 4 : 2;
+}
+
+/// Get channel count of fluid pressure framebuffers.
+///
+/// \return 4 for 32-bit float pressure, 1 for half floats.
+static unsigned get_fluid_pressure_channels()
+{
+  return (g_fluid_format == FLUID_FORMAT_FLOAT) ? 4 : 1;
+}
+
+/// Get bytes per channel of fluid dye framebuffers.
+///
+/// \return 2 for half float dye, 4 otherwise.
+static unsigned get_fluid_dye_bpc()
+{
+  return (g_fluid_format == FLUID_FORMAT_HALF) ? 2 : 4;
+}
+
+#if defined(USE_LD)
+/// Create the precalc cache entry for Saturn bands.
+///
+/// The key covers fluid shaders, fluid settings and the initial state. Does not need a GL context, so bands may be
+/// calculated on the CPU and cached before one exists.
+///
+/// \param temporary Temporary data with the initial fluid state.
+/// \return Cache entry, nothing read yet.
+static PrecalcCacheEntry* create_saturn_bands_cache(GlobalDataTemporary& temporary)
+{
+  PrecalcCacheKey key(1);
+  key.addShader(g_shader_header);
+  key.addShader(g_shader_vertex_fluid);
+  key.addShader(g_shader_fragment_fluid);
+  key.addShader(g_shader_fragment_fluid_multigrid);
+  key.addShader(g_shader_compute_fluid_step);
+  key.addShader(g_shader_vertex_precalc);
+  key.addShader(g_shader_fragment_precalc);
+  key.addShader(g_shader_fragment_bands_upsample);
+  key.add(FLUID_WIDTH);
+  key.add(static_cast<unsigned>(FLUID_CAPTURE_FRAME));
+  key.add(get_fluid_side());
+  key.add(static_cast<unsigned>(g_fluid_format));
+  key.add(g_fluid_compute ? 1u : 0u);
+  key.add(g_fluid_cpu ? 1u : 0u);
+  key.add(g_fluid_multigrid ? 1u : 0u);
+  key.addImage(temporary.fluid_boundary);
+  key.addImage(temporary.fluid_input);
+  key.addImage(temporary.saturn_bands);
+
+  return new PrecalcCacheEntry("saturn_bands", key);
+}
+#endif
 
 /// Global data container.
 class GlobalData
@@ -50,8 +211,10 @@ class GlobalData
     FrameBuffer m_fluid_dye_fbo_1;
     /// Fluid simulation framebuffer 4 (dye buffer 2).
     FrameBuffer m_fluid_dye_fbo_2;
-    /// Fluid simulation framebuffer 5 (pressure).
+    /// Fluid simulation framebuffer 5 (pressure, divergence when pressure is iterated in separate targets).
     FrameBuffer m_fluid_pressure_fbo;
+    /// Saturn bands captured from the fluid simulation, empty before capture.
+    uptr<FrameBuffer> m_fbo_saturn_bands;
 
     /// Font.
     Font m_font;
@@ -92,9 +255,55 @@ class GlobalData
     /// Offset array (for e.g. 'shakycam').
     seq<vec3> m_offsets;
 
+#if defined(USE_LD)
+    /// Ticks at which the latest rebuild was started.
+    int m_rebuild_ticks;
+
+    /// Compute shader precalc, only present when cube maps are generated on the GPU.
+    uptr<PrecalcCompute> m_precalc_compute;
+
+    /// Timestamp at which each asset is first shown, -1 if never.
+    int m_first_use[PRECALC_ASSET_COUNT];
+
+    /// Mask of assets still at preview resolution, waiting to be refined.
+    unsigned m_preview_assets;
+
+    /// Saturn bands upsampling program, only present when the fluid simulation is smaller than the bands.
+    uptr<Pipeline> m_pipeline_bands_upsample;
+
+    /// Fused compute shader fluid step, only present when stepping with compute shaders or verifying them.
+    uptr<FluidCompute> m_fluid_compute;
+
+    /// Multigrid fluid pressure solver, only present when solving with multigrid or measuring residuals.
+    uptr<FluidMultigrid> m_fluid_multigrid;
+
+    /// Fluid pressure framebuffer 1, only present when velocity targets do not hold pressure.
+    uptr<FrameBuffer> m_fluid_pressure_fbo_1;
+
+    /// Fluid pressure framebuffer 2, only present when velocity targets do not hold pressure.
+    uptr<FrameBuffer> m_fluid_pressure_fbo_2;
+
+    /// Cached Saturn bands, only present when the precalc cache is enabled.
+    uptr<PrecalcCacheEntry> m_saturn_bands_cache;
+
+    /// GPU pass profiler, only present when profiling.
+    uptr<GpuProfiler> m_gpu_profiler;
+
+    /// Texture residency, only present when enabled.
+    uptr<TextureResidency> m_residency;
+
+    /// Scene at latest residency update.
+    SceneEnum m_residency_scene;
+#endif
+
   public:
     /// Constructor.
-    explicit GlobalData(unsigned width, unsigned height, float fov) :
+    ///
+    /// \param width Screen width.
+    /// \param height Screen height.
+    /// \param fov Field of view.
+    /// \param temporary Temporary global data with precalc already started, ownership is taken.
+    explicit GlobalData(unsigned width, unsigned height, float fov, GlobalDataTemporary* temporary) :
       m_screen_size(static_cast<float>(width), static_cast<float>(height)),
       m_fov(fov),
       m_pipeline_fluid(g_shader_header, g_shader_vertex_fluid, g_shader_fragment_fluid),
@@ -111,14 +320,22 @@ class GlobalData
       m_pipeline_space_post(g_shader_header, g_shader_vertex_space_post, g_shader_fragment_space_post),
       m_fbo(width, height),
       m_fbo_lq(width * 2 / 3, height * 2 / 3),
-      m_fluid_fbo_1(FLUID_WIDTH, FLUID_HEIGHT, true, false, 4, BILINEAR, WRAP),
-      m_fluid_fbo_2(FLUID_WIDTH, FLUID_HEIGHT, true, false, 4, BILINEAR, WRAP),
-      m_fluid_dye_fbo_1(FLUID_WIDTH, FLUID_HEIGHT, true, false, 4, BILINEAR, WRAP),
-      m_fluid_dye_fbo_2(FLUID_WIDTH, FLUID_HEIGHT, true, false, 4, BILINEAR, WRAP),
-      m_fluid_pressure_fbo(FLUID_WIDTH, FLUID_HEIGHT, true, false, 4, BILINEAR, WRAP),
+      m_fluid_fbo_1(get_fluid_side(), get_fluid_side(), true, false, get_fluid_bpc(), BILINEAR, WRAP,
+          get_fluid_channels()),
+      m_fluid_fbo_2(get_fluid_side(), get_fluid_side(), true, false, get_fluid_bpc(), BILINEAR, WRAP,
+          get_fluid_channels()),
+      m_fluid_dye_fbo_1(get_fluid_side(), get_fluid_side(), true, false, get_fluid_dye_bpc(), BILINEAR, WRAP),
+      m_fluid_dye_fbo_2(get_fluid_side(), get_fluid_side(), true, false, get_fluid_dye_bpc(), BILINEAR, WRAP),
+      m_fluid_pressure_fbo(get_fluid_side(), get_fluid_side(), true, false, get_fluid_pressure_bpc(), BILINEAR,
+          WRAP, get_fluid_pressure_channels()),
       m_font(128, g_font_paths),
       m_direction(g_direction),
-      m_temporary(new GlobalDataTemporary())
+      m_temporary(temporary)
+#if defined(USE_LD)
+      , m_rebuild_ticks(0),
+      m_preview_assets(0),
+      m_residency_scene(NONE)
+#endif
     {
       // Create all usual ASCII7 characters.
       for(unsigned ii = static_cast<unsigned>('!'); (static_cast<unsigned>('z') >= ii); ++ii)
@@ -126,30 +343,58 @@ class GlobalData
         m_font.createCharacter(ii);
       }
 
-      // Randomize distorts. Each distort may exist for a certain amount of time depending on effect.
-      // They are mapped to an area of [-1, 1] - it is up to the effect to scale this to correct range to
-      // limit visibility.
+#if defined(USE_LD)
+      if(PRECALC_CUBE_GPU == g_precalc_cube_mode)
       {
-        const float DEGRADE = 0.9965f;
-        vec3 offset(0.0f);
-        vec3 delta(0.0f);
+        m_precalc_compute.reset(new PrecalcCompute());
+      }
+
+      if(get_fluid_side() != FLUID_WIDTH)
+      {
+        m_pipeline_bands_upsample.reset(new Pipeline(g_shader_header, g_shader_vertex_precalc,
+              g_shader_fragment_bands_upsample));
+      }
 
-        // Generate a bit more random data just to be sure.
-        for(unsigned ii = 0; (ii < (INTRO_LENGTH_TICKS + DIRECTION_SPLIT_DURATION + 1000)); ++ii)
+      if(g_fluid_compute || g_fluid_compute_verify)
+      {
+        m_fluid_compute.reset(new FluidCompute(get_fluid_side(), get_fluid_side()));
+      }
+
+      if(g_fluid_multigrid || g_fluid_residual)
+      {
+        m_fluid_multigrid.reset(new FluidMultigrid(get_fluid_side(), get_fluid_side()));
+      }
+      if(g_fluid_format == FLUID_FORMAT_HALF)
+      {
+        m_fluid_pressure_fbo_1.reset(new FrameBuffer(get_fluid_side(), get_fluid_side(), true, false,
+              get_fluid_pressure_bpc(), BILINEAR, WRAP, get_fluid_pressure_channels()));
+        m_fluid_pressure_fbo_2.reset(new FrameBuffer(get_fluid_side(), get_fluid_side(), true, false,
+              get_fluid_pressure_bpc(), BILINEAR, WRAP, get_fluid_pressure_channels()));
+      }
+      if(g_gpu_profile || !g_gpu_profile_csv.empty())
+      {
+        m_gpu_profiler.reset(new GpuProfiler());
+      }
+
+      for(unsigned ii = 0; (ii < PRECALC_ASSET_COUNT); ++ii)
+      {
+        m_first_use[ii] = -1;
+        for(int jj = static_cast<int>(NONE); (jj <= static_cast<int>(CLOUDS)); ++jj)
         {
-          m_distorts.push_back(frand(-1.0f, 1.0f));
-
-          // Delta is normalized later to whichever value is desired.
-          float dx = frand(-1.0f, 1.0f);
-          float dy = frand(-1.0f, 1.0f);
-          float dz = frand(-1.0f, 1.0f);
-          delta += vec3(dx, dy, dz);
-          offset += delta;
-          m_offsets.push_back(offset);
-          offset *= DEGRADE;
-          delta *= DEGRADE;
+          SceneEnum scene = static_cast<SceneEnum>(jj);
+          int start = m_direction.getSceneStart(scene);
+          if((0 <= start) && (scene_precalc_assets(scene) & (1u << ii)) &&
+              ((0 > m_first_use[ii]) || (start < m_first_use[ii])))
+          {
+            m_first_use[ii] = start;
+          }
         }
       }
+#endif
+
+      // Distorts were randomized before precalc started.
+      m_distorts.swap(m_temporary->distorts);
+      m_offsets.swap(m_temporary->offsets);
 
       // Saturn bands have already been calculated.
       updateSaturnBands(m_temporary->saturn_bands);
@@ -442,6 +687,54 @@ class GlobalData
       return m_fluid_pressure_fbo;
     }
 
+#if defined(USE_LD)
+    /// Accessor.
+    ///
+    /// \return Fused compute shader fluid step or NULL.
+    FluidCompute* getFluidCompute()
+    {
+      return m_fluid_compute.get();
+    }
+
+    /// Accessor.
+    ///
+    /// \return Multigrid fluid pressure solver or NULL.
+    FluidMultigrid* getFluidMultigrid()
+    {
+      return m_fluid_multigrid.get();
+    }
+
+    /// Accessor.
+    ///
+    /// Only valid when velocity targets do not hold pressure.
+    ///
+    /// \param idx Fluid pressure framebuffer index (0 or 1).
+    const FrameBuffer& getFluidPressureFbo(int idx) const
+    {
+      if(idx >= 1)
+      {
+        return *m_fluid_pressure_fbo_2;
+      }
+      return *m_fluid_pressure_fbo_1;
+    }
+
+    /// Accessor.
+    ///
+    /// \return GPU pass profiler or NULL.
+    GpuProfiler* getGpuProfiler() const
+    {
+      return m_gpu_profiler.get();
+    }
+
+    /// Create a CPU fluid simulation in the initial state.
+    ///
+    /// \return New CPU fluid simulation.
+    FluidCpu* createFluidCpu() const
+    {
+      return new FluidCpu(m_temporary->fluid_input, m_temporary->saturn_bands);
+    }
+#endif
+
     /// Accessor.
     const Font& getFont() const
     {
@@ -474,8 +767,12 @@ class GlobalData
       return m_tex_noise_volume_lq;
     }
     /// Accessor.
-    const Texture2D& getTextureSaturnBands() const
+    const Texture& getTextureSaturnBands() const
     {
+      if(m_fbo_saturn_bands)
+      {
+        return m_fbo_saturn_bands->getTextureColor();
+      }
       return m_tex_saturn_bands;
     }
     /// Accessor.
@@ -538,6 +835,230 @@ class GlobalData
       return m_temporary && m_temporary->hasPendingUpdate();
     }
 
+#if defined(USE_LD)
+    /// Cancel precalc and free temporary data.
+    ///
+    /// Returns after all precalc threads have finished.
+    void cancel()
+    {
+      if(m_temporary)
+      {
+        m_temporary->cancel();
+        m_temporary.reset();
+      }
+    }
+#endif
+
+#if defined(USE_LD)
+    /// Tell which cube map assets a scene uses.
+    ///
+    /// Must match the textures bound in draw().
+    ///
+    /// \param op Scene.
+    /// \return Mask of assets.
+    static unsigned scene_precalc_assets(SceneEnum op)
+    {
+      switch(op)
+      {
+        case SPACE:
+          return (1u << PRECALC_ASSET_SPACE) | (1u << PRECALC_ASSET_ENCELADUS) | (1u << PRECALC_ASSET_TETHYS);
+
+        case SIMPLE:
+          return (1u << PRECALC_ASSET_SPACE) | (1u << PRECALC_ASSET_TRAIL);
+
+        case ENCELADUS:
+        case CLOUDS:
+          return (1u << PRECALC_ASSET_SPACE);
+
+        default:
+          break;
+      }
+      return 0;
+    }
+
+    /// Start regenerating assets in the background.
+    ///
+    /// Assets are generated in order of first use, so the ones needed soonest during playback are replaced first.
+    ///
+    /// \param params Generator parameters.
+    /// \param assets Mask of assets to regenerate.
+    /// \return True if started, false if precalc is still running.
+    bool rebuild(const PrecalcParams& params, unsigned assets)
+    {
+      if(m_temporary)
+      {
+        return false;
+      }
+
+      PrecalcAsset order[PRECALC_ASSET_COUNT];
+      for(unsigned ii = 0; (ii < PRECALC_ASSET_COUNT); ++ii)
+      {
+        order[ii] = static_cast<PrecalcAsset>(ii);
+      }
+      std::stable_sort(order, order + PRECALC_ASSET_COUNT, [this](PrecalcAsset lhs, PrecalcAsset rhs)
+          {
+            return static_cast<unsigned>(m_first_use[lhs]) < static_cast<unsigned>(m_first_use[rhs]);
+          });
+
+      m_rebuild_ticks = get_current_ticks();
+      m_temporary.reset(new GlobalDataTemporary(params, assets));
+      m_temporary->setOrder(order);
+      m_temporary->start();
+      return true;
+    }
+
+    /// Regenerate preview assets at full resolution in the background.
+    ///
+    /// Only call after initial precalc has been finished with update(). Playback must be held with waitRefine()
+    /// whenever an asset would be shown before it has been replaced.
+    ///
+    /// \param params Generator parameters.
+    void refine(const PrecalcParams& params)
+    {
+      if(rebuild(params, PRECALC_ASSETS_ALL))
+      {
+        m_preview_assets = PRECALC_ASSETS_ALL;
+      }
+    }
+
+    /// Tell if an asset still at preview resolution is needed at given time.
+    ///
+    /// \param playback_ticks Playback timestamp.
+    /// \return True if playback must wait for refined assets.
+    bool isRefineDue(int playback_ticks) const
+    {
+      // Nothing will arrive without a rebuild running.
+      if(!m_temporary)
+      {
+        return false;
+      }
+      for(unsigned ii = 0; (ii < PRECALC_ASSET_COUNT); ++ii)
+      {
+        if((m_preview_assets & (1u << ii)) && (0 <= m_first_use[ii]) && (playback_ticks >= m_first_use[ii]))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// Wait until every asset needed at given time has been refined.
+    ///
+    /// Assets are refined in order of first use, so only the ones due are waited for.
+    ///
+    /// \param playback_ticks Playback timestamp.
+    void waitRefine(int playback_ticks)
+    {
+      int start_ticks = get_current_ticks();
+      while(isRefineDue(playback_ticks))
+      {
+        updateRebuild();
+        dnload_SDL_Delay(1);
+      }
+      std::cout << "playback held for " << (get_current_ticks() - start_ticks) << " ms at " << playback_ticks <<
+        " waiting for refined assets" << std::endl;
+    }
+
+    /// Upload regenerated assets and free the rebuild once it is done.
+    ///
+    /// Only call after initial precalc has been finished with update().
+    void updateRebuild()
+    {
+      if(!m_temporary)
+      {
+        return;
+      }
+      if(m_temporary->hasPendingUpdate())
+      {
+        updatePartial();
+      }
+      if(m_temporary->isDone())
+      {
+        m_temporary.reset();
+        std::cout << "precalc rebuild took " << (get_current_ticks() - m_rebuild_ticks) << " ms" << std::endl;
+      }
+    }
+
+    /// Get spans of all scenes in a mask.
+    ///
+    /// \param scenes Mask of scenes.
+    /// \return Spans [start, end) in order.
+    std::vector<std::pair<int, int> > getSceneSpans(unsigned scenes) const
+    {
+      std::vector<std::pair<int, int> > ret;
+
+      for(int ii = static_cast<int>(NONE); (ii <= static_cast<int>(CLOUDS)); ++ii)
+      {
+        if(scenes & (1u << ii))
+        {
+          m_direction.getSceneSpans(static_cast<SceneEnum>(ii), ret);
+        }
+      }
+      std::sort(ret.begin(), ret.end());
+
+      return ret;
+    }
+
+    /// Start managing texture residency.
+    ///
+    /// Only call after precalc, the fluid simulation is not used after it. Scene masks must match the textures
+    /// bound in draw().
+    ///
+    /// \param lookahead Milliseconds before use textures are restored.
+    void enableResidency(int lookahead)
+    {
+      const unsigned ALL = (1u << SPACE) | (1u << SIMPLE) | (1u << ENCELADUS) | (1u << CLOUDS);
+
+      Texture& saturn_bands = m_fbo_saturn_bands ? m_fbo_saturn_bands->getTextureColor() : m_tex_saturn_bands;
+
+      m_residency.reset(new TextureResidency(lookahead));
+      m_residency->add("noise_volume_hq", m_tex_noise_volume_hq, getSceneSpans(ALL));
+      m_residency->add("noise_volume_lq", m_tex_noise_volume_lq, getSceneSpans((1u << SPACE) | (1u << CLOUDS)));
+      m_residency->add("saturn_bands", saturn_bands,
+          getSceneSpans((1u << SPACE) | (1u << SIMPLE) | (1u << ENCELADUS)));
+      m_residency->add("saturn_rings", m_tex_saturn_rings, getSceneSpans(ALL));
+      m_residency->add("space", m_tex_space, getSceneSpans(ALL));
+      m_residency->add("enceladus", m_tex_enceladus, getSceneSpans(1u << SPACE));
+      m_residency->add("enceladus_surface", m_tex_enceladus_surface, getSceneSpans(1u << ENCELADUS));
+      m_residency->add("tethys", m_tex_tethys, getSceneSpans(1u << SPACE));
+      m_residency->add("trail", m_tex_trail, getSceneSpans(1u << SIMPLE));
+      m_residency->add("fluid_boundary", m_tex_fluid_boundary, getSceneSpans(0));
+      m_residency->add("fluid_input", m_tex_fluid_input, getSceneSpans(0));
+      m_residency->add("fluid_1", m_fluid_fbo_1.getTextureColor(), getSceneSpans(0));
+      m_residency->add("fluid_2", m_fluid_fbo_2.getTextureColor(), getSceneSpans(0));
+      m_residency->add("fluid_dye_1", m_fluid_dye_fbo_1.getTextureColor(), getSceneSpans(0));
+      m_residency->add("fluid_dye_2", m_fluid_dye_fbo_2.getTextureColor(), getSceneSpans(0));
+      m_residency->add("fluid_pressure", m_fluid_pressure_fbo.getTextureColor(), getSceneSpans(0));
+      if(m_fluid_pressure_fbo_1)
+      {
+        m_residency->add("fluid_pressure_1", m_fluid_pressure_fbo_1->getTextureColor(), getSceneSpans(0));
+        m_residency->add("fluid_pressure_2", m_fluid_pressure_fbo_2->getTextureColor(), getSceneSpans(0));
+      }
+    }
+
+    /// Update texture residency.
+    ///
+    /// Reports texture memory use whenever the scene changes.
+    ///
+    /// \param ticks Direction timestamp.
+    void updateResidency(int ticks)
+    {
+      if(!m_residency)
+      {
+        return;
+      }
+      m_residency->update(ticks);
+
+      SceneEnum scene = m_direction.resolveDirectionFrame(ticks).getScene();
+      if(scene != m_residency_scene)
+      {
+        std::cout << "residency: scene " << static_cast<int>(scene) << " at " << ticks << ": " <<
+          (vgl::get_data_size_texture() / (1024 * 1024)) << " MiB texture data" << std::endl;
+        m_residency_scene = scene;
+      }
+    }
+#endif
+
     /// Is temporary calculation done?
     ///
     /// \return True if yes, false if no.
@@ -568,6 +1089,12 @@ class GlobalData
       {
         return opt<Pipeline*>(&m_pipeline_precalc);
       }
+#if defined(USE_LD)
+      if(m_pipeline_bands_upsample && !m_pipeline_bands_upsample->link())
+      {
+        return opt<Pipeline*>(m_pipeline_bands_upsample.get());
+      }
+#endif
       if(!m_pipeline_font.link())
       {
         return opt<Pipeline*>(&m_pipeline_font);
@@ -614,50 +1141,166 @@ class GlobalData
 
     /// Update fluid textures.
     ///
-    /// \param fluid_boundary Fluid boundary image.
-    /// \param fluid_input Fluid input image.
-    void updateFluid(Image2DRGBA& fluid_boundary, Image2DRGBA& fluid_input)
+    /// Fluid images were created before precalc started.
+    void updateFluid()
     {
-      m_tex_fluid_boundary.update(fluid_boundary, 1, NEAREST, CLAMP);
-      m_tex_fluid_input.update(fluid_input, 4);
+      m_tex_fluid_boundary.update(m_temporary->fluid_boundary, 1, NEAREST, CLAMP);
+      m_tex_fluid_input.update(m_temporary->fluid_input, 4);
     }
 
     /// Partial update.
+    ///
+    /// Uploads ready assets until the upload budget for this frame is spent. At least one asset is uploaded so
+    /// precalc always makes progress.
     void updatePartial()
     {
-      ScopedLock guard(m_temporary->getMutex());
+      int start_ticks = get_current_ticks();
+      PrecalcAsset asset;
 
-      if(m_temporary->space)
+      while(m_temporary->takeAsset(asset))
       {
-        m_tex_space.update(*(m_temporary->space));
-        m_temporary->space.reset();
+        switch(asset)
+        {
+          case PRECALC_ASSET_SPACE:
+#if defined(USE_LD)
+            if(m_precalc_compute)
+            {
+              m_precalc_compute->generate(asset, *m_temporary, m_tex_space);
+              break;
+            }
+#endif
+            m_tex_space.update(*(m_temporary->space));
+            m_temporary->space.reset();
+            break;
+
+          case PRECALC_ASSET_ENCELADUS:
+#if defined(USE_LD)
+            if(m_precalc_compute)
+            {
+              m_precalc_compute->generate(asset, *m_temporary, m_tex_enceladus);
+              m_temporary->enceladus.reset();
+              break;
+            }
+#endif
+            m_tex_enceladus.update(*(m_temporary->enceladus), 2);
+            m_temporary->enceladus.reset();
+            break;
+
+          case PRECALC_ASSET_TETHYS:
+#if defined(USE_LD)
+            if(m_precalc_compute)
+            {
+              m_precalc_compute->generate(asset, *m_temporary, m_tex_tethys);
+              break;
+            }
+#endif
+            m_tex_tethys.update(*(m_temporary->tethys), 2);
+            m_temporary->tethys.reset();
+            break;
+
+          case PRECALC_ASSET_TRAIL:
+          default:
+            m_tex_trail.update(*(m_temporary->trail), 2, NEAREST);
+            m_temporary->trail.reset();
+            break;
+        }
+        m_temporary->releaseAsset();
+
+#if defined(USE_LD)
+        m_preview_assets &= ~(1u << asset);
+#endif
+
+        if((get_current_ticks() - start_ticks) >= g_upload_budget)
+        {
+          break;
+        }
       }
-      if(m_temporary->enceladus)
+    }
+
+    /// Updates saturn bands texture.
+    ///
+    /// \param img Image to update with.
+    void updateSaturnBands(Image2D& img)
+    {
+      m_tex_saturn_bands.update(img, 1, TRILINEAR, CLAMP);
+    }
+
+    /// Captures saturn bands from fluid dye.
+    ///
+    /// Dye is quantized on the GPU the same way a signed byte readback and upload would, without the round trip.
+    /// Bands are always FLUID_WIDTH wide, dye from a smaller simulation is upsampled.
+    ///
+    /// \param dye Dye texture.
+    void captureSaturnBands(const Texture& dye)
+    {
+      // Must match the precalc shader.
+      const int CAPTURE = 6;
+
+      m_fbo_saturn_bands.reset(new FrameBuffer(FLUID_WIDTH, FLUID_HEIGHT, true, false, 1, BILINEAR, CLAMP));
+      m_fbo_saturn_bands->bind();
+
+#if defined(USE_LD)
+      if(m_pipeline_bands_upsample)
       {
-        m_tex_enceladus.update(*(m_temporary->enceladus), 2);
-        m_temporary->enceladus.reset();
+        m_pipeline_bands_upsample->bind();
+        m_pipeline_bands_upsample->uniformFrag(g_uniform_fbo, 0, dye);
       }
-      if(m_temporary->tethys)
+      else
+#endif
       {
-        m_tex_tethys.update(*(m_temporary->tethys), 2);
-        m_temporary->tethys.reset();
+        m_pipeline_precalc.bind();
+        m_pipeline_precalc.uniformFrag(g_uniform_array, CAPTURE);
+        m_pipeline_precalc.uniformFrag(g_uniform_fbo, 0, dye);
       }
-      if(m_temporary->trail)
+
+      dnload_glRects(-1, -1, 1, 1);
+
+      m_fbo_saturn_bands->getTextureColor().generateMipmaps();
+    }
+
+#if defined(USE_LD)
+    /// Loads Saturn bands from the precalc cache.
+    ///
+    /// Must be called after updateFluid().
+    ///
+    /// \return True if bands were loaded and the fluid simulation is not needed.
+    bool loadSaturnBands()
+    {
+      if(g_precalc_cache_dir.empty())
       {
-        m_tex_trail.update(*(m_temporary->trail), 2, NEAREST);
-        m_temporary->trail.reset();
+        return false;
       }
 
-      m_temporary->signal();
+      m_saturn_bands_cache.reset(create_saturn_bands_cache(*m_temporary));
+      if(!m_saturn_bands_cache->read() || g_precalc_cache_verify)
+      {
+        return false;
+      }
+
+      PrecalcCacheEntry& bands = *m_saturn_bands_cache;
+      m_tex_saturn_bands.update(bands.getWidth(), bands.getHeight(), bands.getChannelCount(), 1, bands.getData(),
+          CLAMP, TRILINEAR);
+      return true;
     }
 
-    /// Updates saturn bands texture.
+    /// Stores Saturn bands into the precalc cache.
     ///
-    /// \param img Image to update with.
-    void updateSaturnBands(Image2D& img)
+    /// Must be called after bands have been captured. When verifying, bands read from the cache are compared
+    /// against the captured bands.
+    void storeSaturnBands()
     {
-      m_tex_saturn_bands.update(img, 1, TRILINEAR, CLAMP);
+      if(!m_saturn_bands_cache)
+      {
+        return;
+      }
+
+      const Texture& bands = getTextureSaturnBands();
+      std::vector<uint8_t> texels(FLUID_WIDTH * FLUID_HEIGHT * 4);
+      bands.bind(0);
+      glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+      m_saturn_bands_cache->write(FLUID_WIDTH, FLUID_HEIGHT, 4, texels.data());
     }
+#endif
 
     /// Update data to GPU.
     void update()
@@ -665,7 +1308,23 @@ class GlobalData
       m_tex_noise_soft.update(m_temporary->noise_2d, 2);
       m_tex_noise_volume_hq.update(m_temporary->noise_3d_hq, 2);
       m_tex_noise_volume_lq.update(m_temporary->noise_3d_lq, 1);
-      m_tex_saturn_rings.update(*(m_temporary->saturn_rings));
+#if defined(USE_LD)
+      // Rings read from the precalc cache are uploaded as is.
+      if(!m_temporary->saturn_rings)
+      {
+        if(!m_temporary->saturn_rings_cache)
+        {
+          BOOST_THROW_EXCEPTION(std::runtime_error("GlobalData::update: Saturn rings not calculated"));
+        }
+        PrecalcCacheEntry& rings = *(m_temporary->saturn_rings_cache);
+        m_tex_saturn_rings.update(rings.getWidth(), rings.getHeight(), rings.getChannelCount(), 1, rings.getData(),
+            WRAP, TRILINEAR);
+      }
+      else
+#endif
+      {
+        m_tex_saturn_rings.update(*(m_temporary->saturn_rings));
+      }
       m_tex_enceladus_surface.update(m_temporary->enceladus_surface);
 
 #if defined(USE_LD)
@@ -683,19 +1342,6 @@ class GlobalData
       std::cout << vgl::get_data_size_texture() << " bytes used for texture data" << std::endl;
 #endif
     }
-
-  public:
-    /// Run initialization.
-    /// \param pointer to global data.
-    /// \return Always 0.
-    static int initialize_func(void* global_data)
-    {
-      GlobalData* data = static_cast<GlobalData*>(global_data);
-
-      data->m_temporary->initialize();
-
-      return 0;
-    }
 };
 
 #endif
@@ -6,7 +6,10 @@
 #include "crater_map.hpp"
 #include "crawler_2d.hpp"
 #include "crawler_map.hpp"
+#include "precalc_cache.hpp"
+#include "precalc_params.hpp"
 #include "star_location_tree.hpp"
+#include "verbatim_spsc_queue.hpp"
 
 //#define DEBUG_FAST_SPACE
 //#define DEBUG_FAST_ENCELADUS
@@ -19,6 +22,30 @@ const unsigned FLUID_HEIGHT = FLUID_WIDTH;
 /// Frame count at which the fluid is captured.
 const int FLUID_CAPTURE_FRAME = 500;
 
+/// Octave weights for 3D noise.
+static const float NOISE_3D_WEIGHTS[] = { 0.1f, -0.15f, 0.2f, -0.25f, 0.3f, -0.35f, 0.4f, -0.45f, 0.5f };
+
+#if defined(USE_LD)
+/// Fluid simulation side at runtime, 0 for FLUID_WIDTH.
+static unsigned g_fluid_side = 0;
+#endif
+
+/// Get fluid simulation side.
+///
+/// Saturn bands are captured at FLUID_WIDTH regardless, smaller simulations are upsampled.
+///
+/// \return Side of the square fluid simulation.
+static unsigned get_fluid_side()
+{
+#if defined(USE_LD)
+  if(g_fluid_side)
+  {
+    return g_fluid_side;
+  }
+#endif
+  return FLUID_WIDTH;
+}
+
 /// Temporary global data container.
 class GlobalDataTemporary
 {
@@ -29,6 +56,23 @@ class GlobalDataTemporary
     /// Cube map side for moons.
     static const unsigned CUBE_MAP_SIDE_MOON = 2048;
 
+    /// Maximum number of cube maps resident as float images at a time.
+    ///
+    /// One can wait for upload while the next is calculated. Precalc only waits for the GL thread if it falls
+    /// further behind.
+    static const unsigned RESIDENT_CUBE_MAPS_MAX = 2;
+
+    /// Noise frequency for Enceladus surface.
+    static constexpr float ENCELADUS_NOISE_FREQUENCY = 0.27f;
+
+    /// Noise frequency for Tethys surface.
+    static constexpr float TETHYS_NOISE_FREQUENCY = 0.73f;
+
+#if defined(USE_LD)
+    /// Number of precalc stages for progress reporting.
+    static const unsigned PRECALC_STAGE_COUNT = 8;
+#endif
+
   public:
     /// Noise image.
     Image2DGray noise_2d;
@@ -41,6 +85,10 @@ class GlobalDataTemporary
     Image2DRGB saturn_bands;
     /// Saturn image.
     Image2DRGBAUptr saturn_rings;
+#if defined(USE_LD)
+    /// Cached Saturn rings, the image is not calculated if the cache has them.
+    uptr<PrecalcCacheEntry> saturn_rings_cache;
+#endif
 
     /// Enceladus surface image.
     Image2DGray enceladus_surface;
@@ -57,6 +105,10 @@ class GlobalDataTemporary
     ImageCubeRGBAUptr tethys;
     /// Trail image.
     ImageCubeGrayUptr trail;
+#if defined(USE_LD)
+    /// Heights carved into Enceladus, kept for verifying the compute path.
+    seq<float> enceladus_carved;
+#endif
 
     /// Stars.
     StarLocationTree star_tree;
@@ -68,18 +120,51 @@ class GlobalDataTemporary
     /// Craters for Tethys.
     CraterMap craters_tethys;
 
+    /// Fluid simulation boundary image.
+    Image2DRGBA fluid_boundary;
+    /// Fluid simulation initial state image.
+    Image2DRGBA fluid_input;
+
+    /// Distort array, handed over to global data.
+    seq<float> distorts;
+    /// Offset array, handed over to global data.
+    seq<vec3> offsets;
+
   private:
-    /// Condition variable to wait on.
-    Cond m_cond;
+    /// Assets ready for upload, every asset fits so publishing never waits for the GL thread.
+    SpscQueue<PrecalcAsset, PRECALC_ASSET_COUNT> m_ready;
 
-    /// Mutex guard.
-    Mutex m_mutex;
+    /// Number of assets allocated by precalc and not yet released by the GL thread.
+    std::atomic<unsigned> m_resident;
 
     /// Is the calculation done?
-    bool m_done;
+    std::atomic<bool> m_done;
 
-    /// Is there an update pending?
-    bool m_pending;
+#if defined(USE_LD)
+    /// Name of the stage being calculated.
+    const char* m_stage;
+
+    /// Number of stages started.
+    unsigned m_stage_index;
+
+    /// Generator parameters, copied so the parameter file may change during precalc.
+    PrecalcParams m_params;
+
+    /// Mask of assets to generate.
+    unsigned m_assets;
+
+    /// Order in which assets are generated.
+    PrecalcAsset m_order[PRECALC_ASSET_COUNT];
+
+    /// Cube map side divisor, 1 for full resolution.
+    unsigned m_cube_map_divisor;
+
+    /// Regenerating assets, Saturn data is left alone.
+    bool m_rebuild;
+#endif
+
+    /// Precalc thread, declared last to be joined before anything else is destroyed.
+    uptr<Thread> m_thread;
 
   public:
     /// Constructor.
@@ -89,14 +174,170 @@ class GlobalDataTemporary
       noise_3d_lq(64, 64, 64),
       saturn_bands(FLUID_WIDTH, 1),
       enceladus_surface(2048, 2048),
-      m_done(false),
-      m_pending(false)
+      fluid_boundary(get_fluid_side(), get_fluid_side()),
+      fluid_input(get_fluid_side(), get_fluid_side()),
+      m_resident(0),
+      m_done(false)
+#if defined(USE_LD)
+      , m_stage("saturn bands"),
+      m_stage_index(0),
+      m_params(g_precalc_params),
+      m_assets(PRECALC_ASSETS_ALL),
+      m_cube_map_divisor(1),
+      m_rebuild(false)
+#endif
     {
+#if defined(USE_LD)
+      setOrder(NULL);
+#endif
+
       // Saturn's bands need to be complete before anything else.
       func_saturn_bands(this);
+
+      // Randomize distorts. Each distort may exist for a certain amount of time depending on effect.
+      // They are mapped to an area of [-1, 1] - it is up to the effect to scale this to correct range to
+      // limit visibility.
+      {
+        const float DEGRADE = 0.9965f;
+        vec3 offset(0.0f);
+        vec3 delta(0.0f);
+
+        // Generate a bit more random data just to be sure.
+        for(unsigned ii = 0; (ii < (INTRO_LENGTH_TICKS + DIRECTION_SPLIT_DURATION + 1000)); ++ii)
+        {
+          distorts.push_back(frand(-1.0f, 1.0f));
+
+          // Delta is normalized later to whichever value is desired.
+          float dx = frand(-1.0f, 1.0f);
+          float dy = frand(-1.0f, 1.0f);
+          float dz = frand(-1.0f, 1.0f);
+          delta += vec3(dx, dy, dz);
+          offset += delta;
+          offsets.push_back(offset);
+          offset *= DEGRADE;
+          delta *= DEGRADE;
+        }
+      }
+    }
+
+#if defined(USE_LD)
+    /// Constructor for regenerating assets.
+    ///
+    /// Only the given assets and the inputs they depend on are calculated. Saturn, distorts and fluid images are
+    /// not touched.
+    ///
+    /// \param params Generator parameters.
+    /// \param assets Mask of assets to generate.
+    explicit GlobalDataTemporary(const PrecalcParams& params, unsigned assets) :
+      noise_2d(512, 512),
+      noise_3d_hq(128, 128, 128),
+      noise_3d_lq(64, 64, 64),
+      saturn_bands(1, 1),
+      enceladus_surface(2048, 2048),
+      fluid_boundary(1, 1),
+      fluid_input(1, 1),
+      m_resident(0),
+      m_done(false),
+      m_stage("rebuild"),
+      m_stage_index(0),
+      m_params(params),
+      m_assets(assets),
+      m_cube_map_divisor(1),
+      m_rebuild(true)
+    {
+      setOrder(NULL);
+    }
+#endif
+
+  public:
+    /// Accessor.
+    ///
+    /// \return Generator parameters.
+    const PrecalcParams& getParams() const
+    {
+#if defined(USE_LD)
+      return m_params;
+#else
+      return g_precalc_params;
+#endif
+    }
+
+    /// Accessor.
+    ///
+    /// \return Side length of the space cube map.
+    unsigned getCubeMapSide() const
+    {
+#if defined(USE_LD)
+      return CUBE_MAP_SIDE / m_cube_map_divisor;
+#else
+      return CUBE_MAP_SIDE;
+#endif
     }
 
+    /// Accessor.
+    ///
+    /// \return Side length of moon and trail cube maps.
+    unsigned getCubeMapSideMoon() const
+    {
+#if defined(USE_LD)
+      return CUBE_MAP_SIDE_MOON / m_cube_map_divisor;
+#else
+      return CUBE_MAP_SIDE_MOON;
+#endif
+    }
+
+#if defined(USE_LD)
+    /// Generate cube maps at reduced resolution.
+    ///
+    /// Must be called before start().
+    ///
+    /// \param divisor Side length divisor.
+    void setCubeMapDivisor(unsigned divisor)
+    {
+      m_cube_map_divisor = divisor;
+    }
+
+    /// Set the order in which assets are generated.
+    ///
+    /// Must be called before start(). Inputs shared by cube maps are always calculated first.
+    ///
+    /// \param order Every asset once, NULL for default order.
+    void setOrder(const PrecalcAsset* order)
+    {
+      for(unsigned ii = 0; (ii < PRECALC_ASSET_COUNT); ++ii)
+      {
+        m_order[ii] = order ? order[ii] : static_cast<PrecalcAsset>(ii);
+      }
+    }
+#endif
+
   private:
+    /// Tell if space and moon texels are calculated on the GPU instead.
+    ///
+    /// \return True if yes, false if no.
+    static bool is_cube_on_gpu()
+    {
+#if defined(USE_LD)
+      return (PRECALC_CUBE_GPU == g_precalc_cube_mode);
+#else
+      return false;
+#endif
+    }
+
+    /// Tell if an asset should be generated.
+    ///
+    /// \param op Asset.
+    /// \return True if yes, false if no.
+    bool hasAsset(PrecalcAsset op) const
+    {
+#if defined(USE_LD)
+      return (m_assets & (1u << op)) != 0;
+#else
+      (void)op;
+      return true;
+#endif
+    }
+
     /// Milky way calculation.
     ///
     /// \param dir Direction being faced.
@@ -113,12 +354,14 @@ class GlobalDataTemporary
       vec3 milky_up = cross(milky_rt, milky_fw);
       milky_rt = cross(milky_fw, milky_up);
 
-      vec2 pos = vec2(dnload_asinf(dot(dir, milky_rt)), dnload_asinf(dot(dir, milky_up)));
+      vec2 pos = vec2(precalc_asinf(dot(dir, milky_rt)), precalc_asinf(dot(dir, milky_up)));
 
+      float intensity = getParams().milky_way_intensity;
+      float width = getParams().milky_way_width;
       float ratio = smooth_step(0.8f, 0.0f, abs(pos.x()));
-      vec3 center = mix(vec3(0.0f), vec3(1.0f, 1.0f, 0.8f), sampleNoise2D(pos * 0.7f) + 0.1f) * smooth_step(0.3f * ratio, 0.1f * ratio, abs(pos.y())) * ratio * 0.5f;
-      float ratio2 = sqrtf(1.0f - abs(pos.x() * 1.57f));
-      vec3 overlay = mix(vec3(0.0f), vec3(0.8f, 0.8f, 1.0f), sampleNoise2D(pos + 0.2f) + 0.1f) * smooth_step(0.2f * ratio2, 0.1f * ratio2, abs(pos.y())) * ratio2 * 0.5f;
+      vec3 center = mix(vec3(0.0f), vec3(1.0f, 1.0f, 0.8f), sampleNoise2D(pos * 0.7f) + 0.1f) * smooth_step(0.3f * ratio * width, 0.1f * ratio * width, abs(pos.y())) * ratio * intensity;
+      float ratio2 = precalc_sqrtf(1.0f - abs(pos.x() * 1.57f));
+      vec3 overlay = mix(vec3(0.0f), vec3(0.8f, 0.8f, 1.0f), sampleNoise2D(pos + 0.2f) + 0.1f) * smooth_step(0.2f * ratio2 * width, 0.1f * ratio2 * width, abs(pos.y())) * ratio2 * intensity;
 
       return mix(max(center, vec3(0.0f)), max(overlay, vec3(0.0f)), 0.5f);
     }
@@ -162,120 +405,313 @@ class GlobalDataTemporary
     /// \return Noise value.
     float sampleNoise3D(const vec3& pos, const mat3& rot = mat3::identity()) const
     {
-      vec3 pos0 = pos;
-      vec3 pos1 = rot * (pos0 * 0.5f);
-      vec3 pos2 = rot * (pos1 * 0.5f);
-      vec3 pos3 = rot * (pos2 * 0.5f);
-      vec3 pos4 = rot * (pos3 * 0.5f);
-      vec3 pos5 = rot * (pos4 * 0.5f);
-      vec3 pos6 = rot * (pos5 * 0.5f);
-      vec3 pos7 = rot * (pos6 * 0.5f);
-      vec3 pos8 = rot * (pos7 * 0.5f);
+      vec3 positions[9];
+
+      positions[0] = pos;
+      for(unsigned ii = 1; (ii < 9); ++ii)
+      {
+        positions[ii] = rot * (positions[ii - 1] * 0.5f);
+      }
 
-      return noise_3d_hq.sampleLinear(pos0) * 0.1f -
-        noise_3d_hq.sampleLinear(pos1) * 0.15f +
-        noise_3d_hq.sampleLinear(pos2) * 0.2f -
-        noise_3d_hq.sampleLinear(pos3) * 0.25f +
-        noise_3d_hq.sampleLinear(pos4) * 0.3f -
-        noise_3d_hq.sampleLinear(pos5) * 0.35f +
-        noise_3d_hq.sampleLinear(pos6) * 0.4f -
-        noise_3d_hq.sampleLinear(pos7) * 0.45f +
-        noise_3d_hq.sampleLinear(pos8) * 0.5f;
+      return noise_3d_hq.sampleLinearSum(positions, NOISE_3D_WEIGHTS, getParams().noise_octaves);
     }
 
-    /// Pause for an update.
-    void updatePause()
+    /// Sample noise in 3D for a row of positions.
+    ///
+    /// Same as sampleNoise3D() for every position, a vector of positions at a time.
+    ///
+    /// \param pos Positions to sample from, planes of X, Y and Z coordinates.
+    /// \param width Number of positions.
+    /// \param rot Rotation component.
+    /// \param dst [out] Noise values.
+    void sampleNoise3D(const float* pos, unsigned width, const mat3& rot, float* dst) const
     {
-      m_pending = true;
-
-      m_cond.wait(m_mutex);
-
-      m_pending = false;
+      noise_3d_hq.sampleLinearSumRow(pos, pos + width, pos + (width * 2), width, rot, NOISE_3D_WEIGHTS,
+          getParams().noise_octaves, dst);
     }
 
-  public:
-    /// Initialization.
+    /// Scale a row of directions into sampling positions.
     ///
-    /// i.e. perform precalc.
-    void initialize()
+    /// \param px X plane.
+    /// \param py Y plane.
+    /// \param pz Z plane.
+    /// \param width Number of directions.
+    /// \param mul Multiplier.
+    /// \param dst [out] Planes of X, Y and Z coordinates, may be the same as input.
+    static void scale_row(const float* px, const float* py, const float* pz, unsigned width, float mul, float* dst)
     {
-      ScopedLock guard(m_mutex);
-
-      // Asynchronous calculation for functionality not using random elements.
-      Thread thr_saturn_rings(&func_saturn_rings, this);
+      for(unsigned ii = 0; (ii < width); ++ii)
+      {
+        dst[ii] = px[ii] * mul;
+        dst[width + ii] = py[ii] * mul;
+        dst[(width * 2) + ii] = pz[ii] * mul;
+      }
+    }
 
-      // Synchronous calculation for functionality using random elements.
-      dnload_srand(1563233668); // Intro visuals rely on this seed for reals.
-      func_noise_2d(this);
-      func_noise_3d(this);
-      func_stars(this);
-      func_craters(this);
+    /// Rotation between noise octaves on moon surfaces.
+    ///
+    /// \return Rotation matrix.
+    static mat3 moon_noise_rotation()
+    {
+      return mat3(-0.99f, -0.16f, 0.02f, 0.14f, -0.77f, 0.63f, -0.08f, 0.62f, 0.78f);
+    }
 
-      // Asynchronous cube map elements, one at a time.
+    /// Hand a finished asset over to the GL thread.
+    ///
+    /// The asset may not be touched by precalc afterwards. Only waits if the queue is full.
+    ///
+    /// \param op Asset.
+    void publish(PrecalcAsset op)
+    {
+      while(!m_ready.push(op))
       {
-        space = ImageCubeRGB::create(CUBE_MAP_SIDE);
-        Thread thr_space(&func_space, this);
+        cancel_point();
+        dnload_SDL_Delay(1);
       }
-      updatePause();
+    }
 
+    /// Reserve room for calculating an asset.
+    ///
+    /// Waits while RESIDENT_CUBE_MAPS_MAX assets are resident, independent of how full the ready queue is.
+    void reserveAsset()
+    {
+      while(m_resident.load(std::memory_order_acquire) >= RESIDENT_CUBE_MAPS_MAX)
       {
-        enceladus = ImageCubeRGBA::create(CUBE_MAP_SIDE_MOON);
-        Thread thr_enceladus(&func_enceladus, this);
+        cancel_point();
+        dnload_SDL_Delay(1);
       }
-      updatePause();
+      m_resident.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Begin a precalc stage.
+    ///
+    /// \param name Stage name for progress reporting.
+    void beginStage(const char* name)
+    {
+#if defined(USE_LD)
+      m_stage = name;
+      ++m_stage_index;
+#else
+      (void)name;
+#endif
+      cancel_point();
+    }
 
+    /// Run a precalc function, stopping at cancellation.
+    ///
+    /// Exceptions may not leave thread functions, threads return early instead.
+    ///
+    /// \param pdata Temporary global data.
+    /// \return Return value of the function, 1 if cancelled.
+    template<int (*F)(void*)> static int func_cancellable(void* pdata)
+    {
+#if defined(USE_LD)
+      try
       {
-        tethys = ImageCubeRGBA::create(CUBE_MAP_SIDE_MOON);
-        Thread thr_tethys(&func_tethys, this);
+        return F(pdata);
       }
-      updatePause();
-
+      catch(const CancelledError&)
       {
-        trail = ImageCubeGray::create(CUBE_MAP_SIDE_MOON);
-        Thread thr_trail(&func_trail, this);
+        return 1;
       }
-      updatePause();
+#else
+      return F(pdata);
+#endif
+    }
 
-      m_done = true;
+    /// Calculate a cube map asset.
+    ///
+    /// \param op Asset.
+    void initializeAsset(PrecalcAsset op)
+    {
+      switch(op)
+      {
+        case PRECALC_ASSET_SPACE:
+          beginStage("space");
+          if(!is_cube_on_gpu())
+          {
+            space = ImageCubeRGB::create(getCubeMapSide());
+            Thread thr_space(&func_cancellable<func_space>, this);
+          }
+          break;
+
+        case PRECALC_ASSET_ENCELADUS:
+          beginStage("enceladus");
+          {
+            // Planar, height-only passes (carving, normalization) only touch the height plane.
+            enceladus = ImageCubeRGBA::create(getCubeMapSideMoon(), true);
+            Thread thr_enceladus(&func_cancellable<func_enceladus>, this);
+          }
+          break;
+
+        case PRECALC_ASSET_TETHYS:
+          beginStage("tethys");
+          if(!is_cube_on_gpu())
+          {
+            tethys = ImageCubeRGBA::create(getCubeMapSideMoon());
+            Thread thr_tethys(&func_cancellable<func_tethys>, this);
+          }
+          break;
+
+        case PRECALC_ASSET_TRAIL:
+        default:
+          beginStage("trail");
+          {
+            trail = ImageCubeGray::create(getCubeMapSideMoon());
+            Thread thr_trail(&func_cancellable<func_trail>, this);
+          }
+          break;
+      }
     }
 
-    /// Accessor.
+  public:
+    /// Initialization.
     ///
-    /// \return Mutex.
-    Mutex& getMutex()
+    /// i.e. perform precalc.
+    void initialize()
     {
-      return m_mutex;
+      // Rings are joined at the end of the block, they must be complete before precalc is reported done.
+      {
+        // Asynchronous calculation for functionality not using random elements.
+#if defined(USE_LD)
+        uptr<Thread> thr_saturn_rings(m_rebuild ? NULL : new Thread(&func_saturn_rings, this));
+#else
+        Thread thr_saturn_rings(&func_saturn_rings, this);
+#endif
+
+        // Synchronous calculation for functionality using random elements. Stars are seeded by the noise, so the
+        // whole sequence is needed even if only some of the inputs are.
+        if(hasAsset(PRECALC_ASSET_SPACE) || hasAsset(PRECALC_ASSET_ENCELADUS) || hasAsset(PRECALC_ASSET_TETHYS))
+        {
+          dnload_srand(1563233668); // Intro visuals rely on this seed for reals.
+          beginStage("noise 2d");
+          func_noise_2d(this);
+          beginStage("noise 3d");
+          func_noise_3d(this);
+          beginStage("stars");
+          func_stars(this);
+          beginStage("craters");
+          func_craters(this);
+        }
+
+        // Asynchronous cube map elements, one at a time.
+        for(unsigned ii = 0; (ii < PRECALC_ASSET_COUNT); ++ii)
+        {
+#if defined(USE_LD)
+          PrecalcAsset asset = m_order[ii];
+#else
+          PrecalcAsset asset = static_cast<PrecalcAsset>(ii);
+#endif
+          if(hasAsset(asset))
+          {
+            reserveAsset();
+            initializeAsset(asset);
+            publish(asset);
+          }
+        }
+      }
+
+      m_done.store(true, std::memory_order_release);
     }
 
     /// Is there an update pending?
     ///
+    /// Only call from the GL thread.
+    ///
     /// \return True if yes, false if no.
     bool hasPendingUpdate() const
     {
-      return m_pending;
+      return !m_ready.empty();
     }
 
-    /// Is calculation done?
+    /// Is calculation done and every asset taken?
+    ///
+    /// Only call from the GL thread.
     ///
     /// \return True if yes, false if no.
     bool isDone() const
     {
-      return m_done;
+      return m_done.load(std::memory_order_acquire) && m_ready.empty();
+    }
+
+    /// Take the next asset ready for upload.
+    ///
+    /// Only call from the GL thread. The corresponding image belongs to the caller until releaseAsset().
+    ///
+    /// \param op [out] Asset.
+    /// \return True if an asset was taken, false if none was ready.
+    bool takeAsset(PrecalcAsset& op)
+    {
+      return m_ready.pop(op);
+    }
+
+    /// Release an asset from takeAsset().
+    ///
+    /// Only call from the GL thread after the corresponding image has been freed.
+    void releaseAsset()
+    {
+      m_resident.fetch_sub(1, std::memory_order_release);
+    }
+
+#if defined(USE_LD)
+    /// Cancel precalc.
+    ///
+    /// Waits until the precalc thread has finished.
+    void cancel()
+    {
+      g_cancel_token.request();
+      m_thread.reset();
     }
+#endif
 
-    /// Signal the intenal condition variable.
-    void signal()
+    /// Start precalc in a separate thread.
+    ///
+    /// Precalc does not need GL until the first partial update, so it can start before the window exists. The
+    /// random number generator is shared, nothing else may use it until precalc is done.
+    void start()
     {
-      m_cond.signal();
+      m_thread.reset(new Thread(initialize_func, this));
     }
 
   private:
+    /// Run initialization.
+    ///
+    /// \param pdata Temporary global data.
+    /// \return Always 0.
+    static int initialize_func(void* pdata)
+    {
+      GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+
+#if defined(USE_LD)
+      // Cube map and ring threads inherit the policy.
+      thread_policy_apply(THREAD_ROLE_PRECALC);
+
+      try
+      {
+        data->initialize();
+      }
+      catch(const CancelledError&)
+      {
+        std::cout << "precalc cancelled in stage " << data->m_stage_index << "/" << PRECALC_STAGE_COUNT << " (" <<
+          data->m_stage << ")" << std::endl;
+      }
+#else
+      data->initialize();
+#endif
+#if defined(USE_LD)
+      perf_report_print();
+#endif
+
+      return 0;
+    }
+
     /// 2D noise generation function.
     ///
     /// \param global_data Temporary global data.
     /// \return Always 0.
     static int func_noise_2d(void* pdata)
     {
+      PERF_STAGE("noise 2d");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
 
       data->noise_2d.noise();
@@ -292,6 +728,7 @@ class GlobalDataTemporary
     /// \return Always 0.
     static int func_noise_3d(void* pdata)
     {
+      PERF_STAGE("noise 3d");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
 
       data->noise_3d_hq.noise();
@@ -300,6 +737,9 @@ class GlobalDataTemporary
       data->noise_3d_hq.normalize(0);
       data->noise_3d_lq.normalize(0);
 
+      // High-quality noise is sampled on the CPU for every octave of sampleNoise3D().
+      data->noise_3d_hq.buildBricks();
+
       return 0;
     }
 
@@ -309,6 +749,7 @@ class GlobalDataTemporary
     /// \return Always 0.
     static int func_saturn_bands(void* pdata)
     {
+      PERF_STAGE("saturn bands");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
       const vec3 BRIGHT = vec3(0.9f, 0.8f, 0.5f);
       //const vec3 BRIGHT(1.0f, 0.95f, 0.6f);
@@ -342,8 +783,22 @@ class GlobalDataTemporary
     /// \return Always 0.
     static int func_saturn_rings(void* pdata)
     {
+      PERF_STAGE("saturn rings");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
 
+#if defined(USE_LD)
+      if(!g_precalc_cache_dir.empty())
+      {
+        PrecalcCacheKey key(1);
+        key.add(g_saturn_rings_png, sizeof(g_saturn_rings_png));
+        data->saturn_rings_cache.reset(new PrecalcCacheEntry("saturn_rings", key));
+        if(data->saturn_rings_cache->read() && !g_precalc_cache_verify)
+        {
+          return 0;
+        }
+      }
+#endif
+
       data->saturn_rings = png_read(g_saturn_rings_png);
 
       for(unsigned ii = 0; (ii < data->saturn_rings->getWidth()); ++ii)
@@ -360,6 +815,15 @@ class GlobalDataTemporary
         data->saturn_rings->setValue(ii, 0, 3, aa);
       }
 
+#if defined(USE_LD)
+      if(data->saturn_rings_cache)
+      {
+        Image2DRGBA& rings = *(data->saturn_rings);
+        uarr<uint8_t> texels = rings.getExportData();
+        data->saturn_rings_cache->write(rings.getWidth(), rings.getHeight(), rings.getChannelCount(), texels.get());
+      }
+#endif
+
       return 0;
     }
 
@@ -369,13 +833,14 @@ class GlobalDataTemporary
     /// \return Always 0.
     static int func_stars(void* pdata)
     {
+      PERF_STAGE("stars");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
-      const unsigned STAR_COUNT = 32768;
+      const PrecalcParams& params = data->getParams();
 
-      for(unsigned ii = 0; (ii < STAR_COUNT); ++ii)
+      for(unsigned ii = 0; (ii < params.star_count); ++ii)
       {
         vec3 dir = random_direction();
-        StarLocation star(dir, 0.0000022f, frand(0.1f, 1.0f));
+        StarLocation star(dir, params.star_size, frand(0.1f, 1.0f));
         data->star_tree.add(star);
       }
 
@@ -394,28 +859,73 @@ class GlobalDataTemporary
         Image2DRGB& img, void* pdata)
     {
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+      img.setPixel(ii, jj, data->calculateSpaceTexel(norm_dir, data->star_tree.calculateLuminosity(norm_dir, dir)));
+    }
 
+    /// Space texel calculation.
+    ///
+    /// \param norm_dir Normalized direction.
+    /// \param luminosity Star luminosity in that direction.
+    /// \return Space color.
+    vec3 calculateSpaceTexel(const vec3& norm_dir, float luminosity) const
+    {
 #if defined(DEBUG_FAST_SPACE)
-      img.setPixel(ii, jj, 0.0f, 0.0f, 0.0f);
       (void)norm_dir;
-      (void)dir;
-      (void)data;
+      (void)luminosity;
+      return vec3(0.0f);
 #else
-      float luminosity = data->star_tree.calculateLuminosity(norm_dir, dir);
-      vec3 milky = data->calculateMilkyWay(norm_dir) + vec3(luminosity);
-
-      img.setPixel(ii, jj, milky.x(), milky.y(), milky.z());
+      return calculateMilkyWay(norm_dir) + vec3(luminosity);
 #endif
     }
 
+    /// Space side packet functor.
+    class SpaceSideFunctor
+    {
+      private:
+        /// Temporary global data.
+        const GlobalDataTemporary& m_data;
+
+      public:
+        /// Constructor.
+        ///
+        /// \param data Temporary global data.
+        explicit SpaceSideFunctor(const GlobalDataTemporary& data) :
+          m_data(data)
+        {
+        }
+
+      public:
+        /// Calculate a row of space.
+        ///
+        /// Stars are summed a vector of texels at a time.
+        ///
+        /// \param row Row directions.
+        /// \param img Target image.
+        void operator()(const CubeMapRow& row, Image2DRGB& img) const
+        {
+          uarr<float> luminosity(row.getWidth());
+          m_data.star_tree.calculateLuminosity(row, luminosity.get());
+
+          for(unsigned ii = 0, jj = row.getRow(); (ii < row.getWidth()); ++ii)
+          {
+            img.setPixel(ii, jj, m_data.calculateSpaceTexel(row.getNormDir(ii), luminosity[ii]));
+          }
+        }
+    };
+
     /// Space calculation.
     ///
     /// \param data Temporary global data.
     /// \return Always 0.
     static int func_space(void* pdata)
     {
+      PERF_STAGE("space");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+#if defined(DEBUG_SCALAR_CUBE_MAP)
       data->space->calculateDistributed(func_space_side, data);
+#else
+      data->space->calculateDistributedPacket(SpaceSideFunctor(*data));
+#endif
       return 0;
     }
 
@@ -425,37 +935,40 @@ class GlobalDataTemporary
     /// \return Always 0.
     static int func_craters(void* pdata)
     {
+      PERF_STAGE("craters");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+      const PrecalcParams& params = data->getParams();
 
       dnload_srand(3);
 
-      for(unsigned ii = 0; (ii < 160); ++ii)
+      for(unsigned ii = 0; (ii < params.enceladus_crater_count); ++ii)
       {
         vec3 dir = random_direction();
         float csize = frand(0.2f, 1.0f);
-        data->craters_enceladus.addCrater(dir, 0.0005f + 0.003f * csize * csize * csize * csize * csize);
+        data->craters_enceladus.addCrater(dir, 0.0005f + params.enceladus_crater_size * csize * csize * csize * csize *
+            csize);
       }
 
       dnload_srand(11);
 
-      for(unsigned ii = 0; (ii < 444); ++ii)
+      for(unsigned ii = 0; (ii < params.enceladus_crawler_count); ++ii)
       {
         vec3 pos = random_direction();
         vec3 dir = random_direction();
         float power = 0.25f + frand(0.45f);
         float radius = 0.0025f + frand(0.0015f);
-        unsigned lifetime = 64 + urand(900);
+        unsigned lifetime = 64 + urand(params.enceladus_crawler_lifetime);
         float divergence = frand(0.05f);
         data->crawlers_enceladus.addCrawler(pos, dir, power, radius, 128, lifetime, divergence);
       }
 
       dnload_srand(15);
 
-      for(unsigned ii = 0; (ii < 155); ++ii)
+      for(unsigned ii = 0; (ii < params.tethys_crater_count); ++ii)
       {
         vec3 dir = random_direction();
         float csize = frand(0.3f, 1.0f);
-        data->craters_tethys.addCrater(dir, 0.001f + 0.02f * csize * csize * csize * csize);
+        data->craters_tethys.addCrater(dir, 0.001f + params.tethys_crater_size * csize * csize * csize * csize);
       }
       // Tethys has a massive crater.
       data->craters_tethys.addCrater(vec3(0.0f, 0.5f, 1.0f), 0.06f);
@@ -481,12 +994,32 @@ class GlobalDataTemporary
     static void func_enceladus_side(const vec3& norm_dir, const vec3& dir, unsigned ii, unsigned jj,
         Image2DRGBA& img, void* pdata)
     {
-      const mat3 rot(-0.99f, -0.16f, 0.02f, 0.14f, -0.77f, 0.63f, -0.08f, 0.62f, 0.78f);
+      GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+      const mat3 rot = moon_noise_rotation();
+      float noise_height = data->sampleNoise3D(norm_dir * ENCELADUS_NOISE_FREQUENCY, rot);
+      float noise_color = data->sampleNoise3D(dir * ENCELADUS_NOISE_FREQUENCY * 1.89f, rot);
+      float noise_color_blue = data->sampleNoise3D(dir * ENCELADUS_NOISE_FREQUENCY * 2.73f, rot);
+      vec3 color;
+      float height = data->calculateEnceladusTexel(norm_dir, img.getValue(ii, jj, 3), noise_height, noise_color,
+          noise_color_blue, color);
+      img.setPixel(ii, jj, color, height);
+    }
+
+    /// Enceladus texel calculation.
+    ///
+    /// \param norm_dir Normalized direction.
+    /// \param crawler_height Height carved by crawlers.
+    /// \param sample_height Noise sampled at the normalized direction.
+    /// \param sample_color Noise sampled for surface color.
+    /// \param sample_color_blue Noise sampled for blue tint.
+    /// \param color [out] Surface color.
+    /// \return Surface height.
+    float calculateEnceladusTexel(const vec3& norm_dir, float crawler_height, float sample_height, float sample_color,
+        float sample_color_blue, vec3& color) const
+    {
       const float HEIGHT_MUL_CRAWLER = 0.31f;
       const float HEIGHT_MUL_CRATER = 1.0f;
-      const float HEIGHT_MUL_NOISE = 3.13f;
-      const float FREQUENCY_MUL_NOISE = 0.27f;
-      GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+      const float HEIGHT_MUL_NOISE = getParams().enceladus_noise_height;
 
 #if defined(DEBUG_FAST_ENCELADUS)
       float noise_color = 1.0f;
@@ -495,28 +1028,85 @@ class GlobalDataTemporary
       (void)HEIGHT_MUL_CRAWLER;
       (void)HEIGHT_MUL_CRATER;
       (void)HEIGHT_MUL_NOISE;
-      (void)FREQUENCY_MUL_NOISE;
-      (void)data;
       (void)norm_dir;
-      (void)dir;
+      (void)crawler_height;
+      (void)sample_height;
+      (void)sample_color;
+      (void)sample_color_blue;
 #else
-      float noise_height = data->sampleNoise3D(norm_dir * FREQUENCY_MUL_NOISE, rot) * HEIGHT_MUL_NOISE;
-      float crater_height = data->craters_enceladus.getHeight(norm_dir) * HEIGHT_MUL_CRATER;
+      float noise_height = sample_height * HEIGHT_MUL_NOISE;
+      float crater_height = craters_enceladus.getHeight(norm_dir) * HEIGHT_MUL_CRATER;
       float crater_step_abs = smooth_step(-0.61f, 0.0f, -std::abs(crater_height));
       float crater_step_pos = smooth_step(0.0f, 0.005f, crater_height);
-      float old_height = img.getValue(ii, jj, 3) * HEIGHT_MUL_CRAWLER;
-      float new_height = noise_height + crater_height * (1.0f + crater_step_pos * dnload_tanhf(noise_height * 17.0f) * 0.4f);
+      float old_height = crawler_height * HEIGHT_MUL_CRAWLER;
+      float new_height = noise_height + crater_height * (1.0f + crater_step_pos * precalc_tanhf(noise_height * 17.0f) * 0.4f);
       float height = old_height * crater_step_abs + new_height;
 
-      float noise_color = data->sampleNoise3D(dir * FREQUENCY_MUL_NOISE * 1.89f, rot) * 0.3f + 0.65f;
-      float noise_color_blue = data->sampleNoise3D(dir * FREQUENCY_MUL_NOISE * 2.73f, rot) * 0.39f + 0.65f;
+      float noise_color = sample_color * 0.3f + 0.65f;
+      float noise_color_blue = sample_color_blue * 0.39f + 0.65f;
       float blue_diff = std::abs(noise_color_blue - noise_color);
       blue_diff *= blue_diff;
 #endif
 
-      img.setPixel(ii, jj, noise_color, noise_color, noise_color + blue_diff, height);
+      color = vec3(noise_color, noise_color, noise_color + blue_diff);
+      return height;
     }
 
+    /// Enceladus side packet functor.
+    class EnceladusSideFunctor
+    {
+      private:
+        /// Temporary global data.
+        const GlobalDataTemporary& m_data;
+
+      public:
+        /// Constructor.
+        ///
+        /// \param data Temporary global data.
+        explicit EnceladusSideFunctor(const GlobalDataTemporary& data) :
+          m_data(data)
+        {
+        }
+
+      public:
+        /// Calculate a row of Enceladus.
+        ///
+        /// Noise is sampled a vector of texels at a time.
+        ///
+        /// \param row Row directions.
+        /// \param img Target image.
+        void operator()(const CubeMapRow& row, Image2DRGBA& img) const
+        {
+          const mat3 rot = moon_noise_rotation();
+          unsigned width = row.getWidth();
+          uarr<float> positions(width * 3);
+          uarr<float> noise(width * 3);
+          float* noise_height = noise.get();
+          float* noise_color = noise.get() + width;
+          float* noise_color_blue = noise.get() + (width * 2);
+
+          scale_row(row.getNormDirX(), row.getNormDirY(), row.getNormDirZ(), width, ENCELADUS_NOISE_FREQUENCY,
+              positions.get());
+          m_data.sampleNoise3D(positions.get(), width, rot, noise_height);
+          scale_row(row.getDirX(), row.getDirY(), row.getDirZ(), width, ENCELADUS_NOISE_FREQUENCY, positions.get());
+          scale_row(positions.get(), positions.get() + width, positions.get() + (width * 2), width, 1.89f,
+              positions.get());
+          m_data.sampleNoise3D(positions.get(), width, rot, noise_color);
+          scale_row(row.getDirX(), row.getDirY(), row.getDirZ(), width, ENCELADUS_NOISE_FREQUENCY, positions.get());
+          scale_row(positions.get(), positions.get() + width, positions.get() + (width * 2), width, 2.73f,
+              positions.get());
+          m_data.sampleNoise3D(positions.get(), width, rot, noise_color_blue);
+
+          for(unsigned ii = 0, jj = row.getRow(); (ii < width); ++ii)
+          {
+            vec3 color;
+            float height = m_data.calculateEnceladusTexel(row.getNormDir(ii), img.getValue(ii, jj, 3),
+                noise_height[ii], noise_color[ii], noise_color_blue[ii], color);
+            img.setPixel(ii, jj, color, height);
+          }
+        }
+    };
+
     /// Tethys side calculation.
     ///
     /// \param norm_dir Normalized direction.
@@ -528,39 +1118,101 @@ class GlobalDataTemporary
     static void func_tethys_side(const vec3& norm_dir, const vec3& dir, unsigned ii, unsigned jj,
         Image2DRGBA& img, void* pdata)
     {
-      const mat3 rot(-0.99f, -0.16f, 0.02f, 0.14f, -0.77f, 0.63f, -0.08f, 0.62f, 0.78f);
-      const float HEIGHT_MUL_CRATER = 1.0f;
-      const float HEIGHT_MUL_NOISE = 0.63f;
-      const float FREQUENCY_MUL_NOISE = 0.73f;
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+      const mat3 rot = moon_noise_rotation();
+      float noise_height = data->sampleNoise3D(norm_dir * TETHYS_NOISE_FREQUENCY, rot);
+      float noise_luminance = data->sampleNoise3D(dir * 3.1f, rot);
+      float luminance;
+      float height = data->calculateTethysTexel(norm_dir, noise_height, noise_luminance, luminance);
+      img.setPixel(ii, jj, luminance, luminance, luminance, height);
+    }
+
+    /// Tethys texel calculation.
+    ///
+    /// \param norm_dir Normalized direction.
+    /// \param sample_height Noise sampled at the normalized direction.
+    /// \param sample_luminance Noise sampled for surface luminance.
+    /// \param luminance [out] Surface luminance.
+    /// \return Surface height.
+    float calculateTethysTexel(const vec3& norm_dir, float sample_height, float sample_luminance,
+        float& luminance) const
+    {
+      const float HEIGHT_MUL_CRATER = 1.0f;
+      const float HEIGHT_MUL_NOISE = getParams().tethys_noise_height;
 
 #if defined(DEBUG_FAST_TETHYS)
-      float luminance = 1.0f;
-      float height = 1.0f;
+      luminance = 1.0f;
       (void)HEIGHT_MUL_CRATER;
       (void)HEIGHT_MUL_NOISE;
-      (void)FREQUENCY_MUL_NOISE;
       (void)norm_dir;
-      (void)dir;
-      (void)data;
+      (void)sample_height;
+      (void)sample_luminance;
+      return 1.0f;
 #else
-      float height_craters = data->craters_tethys.getHeight(norm_dir) * HEIGHT_MUL_CRATER;
+      float height_craters = craters_tethys.getHeight(norm_dir) * HEIGHT_MUL_CRATER;
       float crater_step_pos = smooth_step(0.0f, 0.005f, height_craters);
-      float height_noise = data->sampleNoise3D(norm_dir * FREQUENCY_MUL_NOISE, rot) * HEIGHT_MUL_NOISE;
-      float height = height_noise + height_craters * (1.0f + crater_step_pos * dnload_tanhf(height_noise * 9.0f));
+      float height_noise = sample_height * HEIGHT_MUL_NOISE;
 
-      float luminance = data->sampleNoise3D(dir * 3.1f, rot) * 0.5f + 0.5f;
+      luminance = sample_luminance * 0.5f + 0.5f;
+      return height_noise + height_craters * (1.0f + crater_step_pos * precalc_tanhf(height_noise * 9.0f));
 #endif
-
-      img.setPixel(ii, jj, luminance, luminance, luminance, height);
     }
 
+    /// Tethys side packet functor.
+    class TethysSideFunctor
+    {
+      private:
+        /// Temporary global data.
+        const GlobalDataTemporary& m_data;
+
+      public:
+        /// Constructor.
+        ///
+        /// \param data Temporary global data.
+        explicit TethysSideFunctor(const GlobalDataTemporary& data) :
+          m_data(data)
+        {
+        }
+
+      public:
+        /// Calculate a row of Tethys.
+        ///
+        /// Noise is sampled a vector of texels at a time.
+        ///
+        /// \param row Row directions.
+        /// \param img Target image.
+        void operator()(const CubeMapRow& row, Image2DRGBA& img) const
+        {
+          const mat3 rot = moon_noise_rotation();
+          unsigned width = row.getWidth();
+          uarr<float> positions(width * 3);
+          uarr<float> noise(width * 2);
+          float* noise_height = noise.get();
+          float* noise_luminance = noise.get() + width;
+
+          scale_row(row.getNormDirX(), row.getNormDirY(), row.getNormDirZ(), width, TETHYS_NOISE_FREQUENCY,
+              positions.get());
+          m_data.sampleNoise3D(positions.get(), width, rot, noise_height);
+          scale_row(row.getDirX(), row.getDirY(), row.getDirZ(), width, 3.1f, positions.get());
+          m_data.sampleNoise3D(positions.get(), width, rot, noise_luminance);
+
+          for(unsigned ii = 0, jj = row.getRow(); (ii < width); ++ii)
+          {
+            float luminance;
+            float height = m_data.calculateTethysTexel(row.getNormDir(ii), noise_height[ii], noise_luminance[ii],
+                luminance);
+            img.setPixel(ii, jj, luminance, luminance, luminance, height);
+          }
+        }
+    };
+
     /// Enceladus calculation.
     ///
     /// \param data Temporary global data.
     /// \return Always 0.
     static int func_enceladus(void* pdata)
     {
+      PERF_STAGE("enceladus");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
 
       // Carve gorges into 2D data.
@@ -590,8 +1242,26 @@ class GlobalDataTemporary
       dnload_srand(4);
       data->crawlers_enceladus.carve(*(data->enceladus));
 
+#if defined(USE_LD)
+      if(PRECALC_CUBE_VERIFY == g_precalc_cube_mode)
+      {
+        unsigned side = data->getCubeMapSideMoon();
+        data->enceladus_carved.resize(side * side * 6);
+        data->enceladus->getChannelData(3, data->enceladus_carved.getData());
+      }
+#endif
+      // Compute path calculates the rest from the carved heights.
+      if(is_cube_on_gpu())
+      {
+        return 0;
+      }
+
       // Add other height and color data.
+#if defined(DEBUG_SCALAR_CUBE_MAP)
       data->enceladus->calculateDistributed(func_enceladus_side, data);
+#else
+      data->enceladus->calculateDistributedPacket(EnceladusSideFunctor(*data));
+#endif
       data->enceladus->normalizeSides(3);
 
       return 0;
@@ -603,8 +1273,13 @@ class GlobalDataTemporary
     /// \return Always 0.
     static int func_tethys(void* pdata)
     {
+      PERF_STAGE("tethys");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+#if defined(DEBUG_SCALAR_CUBE_MAP)
       data->tethys->calculateDistributed(func_tethys_side, data);
+#else
+      data->tethys->calculateDistributedPacket(TethysSideFunctor(*data));
+#endif
       data->tethys->normalizeSides(3);
       return 0;
     }
@@ -615,14 +1290,16 @@ class GlobalDataTemporary
     /// \return Always 0.
     static int func_trail(void* pdata)
     {
+      PERF_STAGE("trail");
       GlobalDataTemporary* data = static_cast<GlobalDataTemporary*>(pdata);
+      const PrecalcParams& params = data->getParams();
 
       // Carve trail into 3D data.
       dnload_srand(8);
       data->trail->clear(0, 0.0f);
       vec3 pos = random_direction();
       vec3 dir = random_direction();
-      Crawler crw(pos, dir, 1.0f, 0.011f, 128, 19000, 0.011f);
+      Crawler crw(pos, dir, 1.0f, params.trail_radius, 128, params.trail_lifetime, 0.011f);
       crw.carve(*(data->trail), 0.001f);
 
       // Add other height and color data.
@@ -181,18 +181,7 @@ bool GlslShader::compile(bool pipeline)
 
   for(const std::string &vv : m_files)
   {
-    fs::path name = find_file(vv);
-    if(name.empty())
-    {
-      std::ostringstream sstr;
-      sstr << "could not find suitable file source for " << fs::path(vv);
-      BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
-    }
-
-    std::string source = read_file(name);
-    std::string processed = glsl_wave_preprocess(source);
-
-    parts.push_back(processed);
+    parts.push_back(read_source(vv));
   }
 
   std::vector<const GLchar*> glsl_parts;
@@ -228,6 +217,19 @@ bool GlslShader::compile(bool pipeline)
   return true;
 }
 
+std::string GlslShader::read_source(const std::string &name)
+{
+  fs::path filename = find_file(name);
+  if(filename.empty())
+  {
+    std::ostringstream sstr;
+    sstr << "could not find suitable file source for " << fs::path(name);
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+
+  return glsl_wave_preprocess(read_file(filename));
+}
+
 std::string GlslShader::getName() const
 {
   std::ostringstream sstr;
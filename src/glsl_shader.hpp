@@ -97,6 +97,12 @@ class GlslShader
     }
 
   public:
+    /// Read and preprocess shader source.
+    ///
+    /// \param name Source file.
+    /// \return Preprocessed source.
+    static std::string read_source(const std::string &name);
+
     /// Create a new shader.
     ///
     /// \param type Shader type.
@@ -0,0 +1,467 @@
+#ifndef GPU_PROFILER_HPP
+#define GPU_PROFILER_HPP
+
+#if defined(USE_LD)
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// Measure GPU time of rendering passes and show it on screen.
+static bool g_gpu_profile = false;
+
+/// File to write GPU pass times per section into, empty for none.
+static std::string g_gpu_profile_csv;
+
+/// Rendering passes measured by the GPU profiler.
+enum GpuPass
+{
+  /// Fluid simulation steps.
+  GPU_PASS_FLUID = 0,
+
+  /// Huygens sketch.
+  GPU_PASS_HUYGENS,
+
+  /// Huygens sketch post-processing.
+  GPU_PASS_HUYGENS_POST,
+
+  /// Space around Saturn.
+  GPU_PASS_SPACE,
+
+  /// Space post-processing.
+  GPU_PASS_SPACE_POST,
+
+  /// Simple space around Saturn.
+  GPU_PASS_SIMPLE,
+
+  /// Simple space post-processing.
+  GPU_PASS_SIMPLE_POST,
+
+  /// Enceladus surface.
+  GPU_PASS_ENCELADUS,
+
+  /// Enceladus post-processing.
+  GPU_PASS_ENCELADUS_POST,
+
+  /// Saturn clouds.
+  GPU_PASS_CLOUDS,
+
+  /// Saturn clouds post-processing.
+  GPU_PASS_CLOUDS_POST,
+
+  /// Text blurbs.
+  GPU_PASS_TEXT,
+
+  /// Number of passes.
+  GPU_PASS_COUNT
+};
+
+/// Get name of a pass.
+///
+/// \param op Pass.
+/// \return Pass name.
+inline const char* gpu_pass_name(GpuPass op)
+{
+  static const char* names[GPU_PASS_COUNT] =
+  {
+    "fluid",
+    "huygens",
+    "huygens_post",
+    "space",
+    "space_post",
+    "simple",
+    "simple_post",
+    "enceladus",
+    "enceladus_post",
+    "clouds",
+    "clouds_post",
+    "text",
+  };
+  return names[op];
+}
+
+/// Measures GPU time of rendering passes.
+///
+/// Every pass instance is bracketed with a pair of timestamp queries. Timestamps are used instead of elapsed time
+/// queries, since the fluid budget already keeps an elapsed time query active around fluid steps and those can
+/// not nest. Queries of a frame are read only once available, a ring of frames keeps them in flight, so
+/// measurement never stalls the pipeline. Frames whose results are not available when their slot is needed again
+/// are dropped.
+///
+/// Times are averaged for display and accumulated per section, usually a scene, for writing into a file.
+class GpuProfiler
+{
+  private:
+    /// Number of frames in flight at most.
+    static const unsigned FRAME_COUNT = 4;
+
+    /// Number of timed pass instances per frame at most.
+    static const unsigned PAIR_COUNT = 64;
+
+    /// Weight of a new frame in displayed averages.
+    static constexpr double AVERAGE_WEIGHT = 0.1;
+
+    /// Queries of one frame.
+    struct Frame
+    {
+      /// Begin and end timestamp query for every pass instance.
+      GLuint m_queries[PAIR_COUNT * 2];
+
+      /// Pass of every pass instance.
+      GpuPass m_passes[PAIR_COUNT];
+
+      /// Number of pass instances.
+      unsigned m_count;
+
+      /// Index of the section the frame belongs to.
+      unsigned m_section;
+    };
+
+    /// Accumulated pass times of one section.
+    struct Section
+    {
+      /// Section name.
+      std::string m_name;
+
+      /// Number of frames.
+      unsigned m_frames;
+
+      /// Total time of every pass in nanoseconds.
+      double m_total[GPU_PASS_COUNT];
+
+      /// Longest time of every pass within one frame in nanoseconds.
+      double m_max[GPU_PASS_COUNT];
+
+      /// Longest time of all passes within one frame in nanoseconds.
+      double m_max_frame;
+
+      /// Constructor.
+      ///
+      /// \param name Section name.
+      explicit Section(const std::string& name) :
+        m_name(name),
+        m_frames(0),
+        m_max_frame(0.0)
+      {
+        for(unsigned ii = 0; (ii < GPU_PASS_COUNT); ++ii)
+        {
+          m_total[ii] = 0.0;
+          m_max[ii] = 0.0;
+        }
+      }
+    };
+
+  private:
+    /// Frame query ring.
+    Frame m_frames[FRAME_COUNT];
+
+    /// Number of frames issued.
+    unsigned m_issued;
+
+    /// Number of frames collected or dropped.
+    unsigned m_collected;
+
+    /// Number of frames dropped.
+    unsigned m_dropped;
+
+    /// True between beginFrame() and endFrame().
+    bool m_recording;
+
+    /// True between begin() and end() of a timed pass instance.
+    bool m_timing;
+
+    /// Averaged pass times in milliseconds.
+    double m_average[GPU_PASS_COUNT];
+
+    /// Sections in order of appearance.
+    std::vector<Section> m_sections;
+
+  private:
+    /// Deleted copy constructor.
+    GpuProfiler(const GpuProfiler&) = delete;
+    /// Deleted assignment.
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+  public:
+    /// Constructor.
+    GpuProfiler() :
+      m_issued(0),
+      m_collected(0),
+      m_dropped(0),
+      m_recording(false),
+      m_timing(false)
+    {
+      for(unsigned ii = 0; (ii < FRAME_COUNT); ++ii)
+      {
+        glGenQueries(PAIR_COUNT * 2, m_frames[ii].m_queries);
+        m_frames[ii].m_count = 0;
+        m_frames[ii].m_section = 0;
+      }
+      for(unsigned ii = 0; (ii < GPU_PASS_COUNT); ++ii)
+      {
+        m_average[ii] = 0.0;
+      }
+    }
+
+    /// Destructor.
+    ~GpuProfiler()
+    {
+      for(unsigned ii = 0; (ii < FRAME_COUNT); ++ii)
+      {
+        glDeleteQueries(PAIR_COUNT * 2, m_frames[ii].m_queries);
+      }
+    }
+
+  private:
+    /// Find or add a section.
+    ///
+    /// \param name Section name.
+    /// \return Section index.
+    unsigned findSection(const char* name)
+    {
+      for(unsigned ii = 0; (ii < m_sections.size()); ++ii)
+      {
+        if(m_sections[ii].m_name == name)
+        {
+          return ii;
+        }
+      }
+      m_sections.push_back(Section(name));
+      return static_cast<unsigned>(m_sections.size() - 1);
+    }
+
+    /// Collect results of frames that are available.
+    void collect()
+    {
+      while(m_collected < m_issued)
+      {
+        const Frame& frame = m_frames[m_collected % FRAME_COUNT];
+
+        // Timestamps complete in order, the last one being available means all of them are.
+        if(frame.m_count)
+        {
+          GLint available = 0;
+          glGetQueryObjectiv(frame.m_queries[frame.m_count * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+          if(!available)
+          {
+            return;
+          }
+        }
+
+        double times[GPU_PASS_COUNT];
+        for(unsigned ii = 0; (ii < GPU_PASS_COUNT); ++ii)
+        {
+          times[ii] = 0.0;
+        }
+        for(unsigned ii = 0; (ii < frame.m_count); ++ii)
+        {
+          GLuint64 start = 0;
+          GLuint64 end = 0;
+          glGetQueryObjectui64v(frame.m_queries[ii * 2 + 0], GL_QUERY_RESULT, &start);
+          glGetQueryObjectui64v(frame.m_queries[ii * 2 + 1], GL_QUERY_RESULT, &end);
+          times[frame.m_passes[ii]] += static_cast<double>(end - start);
+        }
+
+        Section& section = m_sections[frame.m_section];
+        double frame_time = 0.0;
+        for(unsigned ii = 0; (ii < GPU_PASS_COUNT); ++ii)
+        {
+          m_average[ii] += (times[ii] / 1000000.0 - m_average[ii]) * AVERAGE_WEIGHT;
+          section.m_total[ii] += times[ii];
+          section.m_max[ii] = std::max(times[ii], section.m_max[ii]);
+          frame_time += times[ii];
+        }
+        section.m_max_frame = std::max(frame_time, section.m_max_frame);
+        ++section.m_frames;
+        ++m_collected;
+      }
+    }
+
+  public:
+    /// Accessor.
+    ///
+    /// \param op Pass.
+    /// \return Averaged time of the pass in milliseconds.
+    double getAverage(GpuPass op) const
+    {
+      return m_average[op];
+    }
+
+    /// Begin a frame.
+    ///
+    /// \param section Name of the section the frame belongs to.
+    void beginFrame(const char* section)
+    {
+      collect();
+
+      // Drop the oldest frame instead of waiting for it.
+      if(m_issued - m_collected >= FRAME_COUNT)
+      {
+        ++m_collected;
+        ++m_dropped;
+      }
+
+      Frame& frame = m_frames[m_issued % FRAME_COUNT];
+      frame.m_count = 0;
+      frame.m_section = findSection(section);
+      m_recording = true;
+    }
+
+    /// End a frame.
+    void endFrame()
+    {
+      if(m_recording)
+      {
+        ++m_issued;
+        m_recording = false;
+      }
+    }
+
+    /// Begin timing a pass instance.
+    ///
+    /// Pass instances do not nest, instances begun while another is being timed are not timed.
+    ///
+    /// \param op Pass.
+    /// \return True if the pass instance is timed.
+    bool begin(GpuPass op)
+    {
+      Frame& frame = m_frames[m_issued % FRAME_COUNT];
+      if(!m_recording || m_timing || (frame.m_count >= PAIR_COUNT))
+      {
+        return false;
+      }
+
+      frame.m_passes[frame.m_count] = op;
+      glQueryCounter(frame.m_queries[frame.m_count * 2 + 0], GL_TIMESTAMP);
+      m_timing = true;
+      return true;
+    }
+
+    /// End timing a pass instance.
+    void end()
+    {
+      Frame& frame = m_frames[m_issued % FRAME_COUNT];
+      glQueryCounter(frame.m_queries[frame.m_count * 2 + 1], GL_TIMESTAMP);
+      ++frame.m_count;
+      m_timing = false;
+    }
+
+    /// Wait for frames in flight and collect their results.
+    void flush()
+    {
+      glFinish();
+      collect();
+    }
+
+    /// Print pass times per section.
+    void report() const
+    {
+      for(const Section& section : m_sections)
+      {
+        if(!section.m_frames)
+        {
+          continue;
+        }
+
+        double frames = static_cast<double>(section.m_frames);
+        std::cout << "gpu profile " << section.m_name << " (" << section.m_frames << " frames):";
+        for(unsigned ii = 0; (ii < GPU_PASS_COUNT); ++ii)
+        {
+          if(section.m_total[ii] > 0.0)
+          {
+            std::cout << " " << gpu_pass_name(static_cast<GpuPass>(ii)) << " " <<
+              (section.m_total[ii] / frames / 1000000.0) << " ms";
+          }
+        }
+        std::cout << std::endl;
+      }
+      if(m_dropped)
+      {
+        std::cout << "gpu profile: " << m_dropped << " frames dropped" << std::endl;
+      }
+    }
+
+    /// Write pass times per section into a CSV file.
+    ///
+    /// \param filename File to write.
+    void write(const std::string& filename) const
+    {
+      std::ofstream fd(filename.c_str());
+      if(!fd)
+      {
+        std::ostringstream sstr;
+        sstr << "could not write GPU profile '" << filename << "'";
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+
+      fd << "section,frames,pass,mean_ms,max_ms\n";
+      for(const Section& section : m_sections)
+      {
+        if(!section.m_frames)
+        {
+          continue;
+        }
+
+        double frames = static_cast<double>(section.m_frames);
+        double frame_total = 0.0;
+        for(unsigned ii = 0; (ii < GPU_PASS_COUNT); ++ii)
+        {
+          if(section.m_total[ii] > 0.0)
+          {
+            fd << section.m_name << "," << section.m_frames << "," << gpu_pass_name(static_cast<GpuPass>(ii)) <<
+              "," << (section.m_total[ii] / frames / 1000000.0) << "," << (section.m_max[ii] / 1000000.0) << "\n";
+            frame_total += section.m_total[ii];
+          }
+        }
+        fd << section.m_name << "," << section.m_frames << ",total," << (frame_total / frames / 1000000.0) << "," <<
+          (section.m_max_frame / 1000000.0) << "\n";
+      }
+    }
+};
+
+/// Times a pass instance for the duration of a scope.
+class GpuPassScope
+{
+  private:
+    /// Profiler, NULL if not timing.
+    GpuProfiler* m_profiler;
+
+  private:
+    /// Deleted copy constructor.
+    GpuPassScope(const GpuPassScope&) = delete;
+    /// Deleted assignment.
+    GpuPassScope& operator=(const GpuPassScope&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param profiler Profiler, may be NULL.
+    /// \param op Pass.
+    explicit GpuPassScope(GpuProfiler* profiler, GpuPass op) :
+      m_profiler((profiler && profiler->begin(op)) ? profiler : NULL)
+    {
+    }
+
+    /// Destructor.
+    ~GpuPassScope()
+    {
+      if(m_profiler)
+      {
+        m_profiler->end();
+      }
+    }
+};
+
+/// Time the enclosing scope as a rendering pass.
+#define GPU_PASS(data, op) GpuPassScope gpu_pass_scope((data).getGpuProfiler(), op)
+
+#else
+
+#define GPU_PASS(data, op)
+
+#endif
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+#if defined(USE_LD)
+
+#if defined(USE_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstring>
+
+/// Offscreen rendering context.
+///
+/// Creates an EGL context without a window, preferring the Mesa surfaceless platform and falling back to a
+/// pbuffer on the default display. Software rasterizers such as llvmpipe work without a display server. The
+/// framebuffer created afterwards replaces the window as the default render target.
+class Headless
+{
+  private:
+#if defined(USE_EGL)
+    /// EGL display.
+    EGLDisplay m_display;
+
+    /// EGL pbuffer surface, only used if surfaceless contexts are not supported.
+    EGLSurface m_surface;
+
+    /// EGL context.
+    EGLContext m_context;
+#endif
+
+    /// Render target standing in for the window.
+    uptr<FrameBuffer> m_fbo;
+
+  private:
+    /// Deleted copy constructor.
+    Headless(const Headless&) = delete;
+    /// Deleted assignment.
+    Headless& operator=(const Headless&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// Creates the context and makes it current.
+    explicit Headless()
+#if defined(USE_EGL)
+      : m_display(EGL_NO_DISPLAY),
+      m_surface(EGL_NO_SURFACE),
+      m_context(EGL_NO_CONTEXT)
+#endif
+    {
+#if defined(USE_EGL)
+      m_display = get_display();
+      EGLint major = 0;
+      EGLint minor = 0;
+      if((EGL_NO_DISPLAY == m_display) || !eglInitialize(m_display, &major, &minor))
+      {
+        BOOST_THROW_EXCEPTION(std::runtime_error("could not initialize EGL display"));
+      }
+      if(!eglBindAPI(EGL_OPENGL_API))
+      {
+        BOOST_THROW_EXCEPTION(std::runtime_error("EGL display does not support desktop OpenGL"));
+      }
+
+      static const EGLint CONFIG_ATTRIBUTES[] =
+      {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE
+      };
+      EGLConfig config;
+      EGLint config_count = 0;
+      if(!eglChooseConfig(m_display, CONFIG_ATTRIBUTES, &config, 1, &config_count) || (0 >= config_count))
+      {
+        BOOST_THROW_EXCEPTION(std::runtime_error("no EGL config for offscreen OpenGL rendering"));
+      }
+
+      // No version or profile requested, same as the context SDL would create.
+      m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, NULL);
+      if(EGL_NO_CONTEXT == m_context)
+      {
+        std::ostringstream sstr;
+        sstr << "could not create EGL context: 0x" << std::hex << eglGetError();
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+
+      // Rendering goes to framebuffer objects, a drawable is only needed if the context can not go without one.
+      if(!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+      {
+        static const EGLint PBUFFER_ATTRIBUTES[] =
+        {
+          EGL_WIDTH, 1,
+          EGL_HEIGHT, 1,
+          EGL_NONE
+        };
+        m_surface = eglCreatePbufferSurface(m_display, config, PBUFFER_ATTRIBUTES);
+        if((EGL_NO_SURFACE == m_surface) || !eglMakeCurrent(m_display, m_surface, m_surface, m_context))
+        {
+          std::ostringstream sstr;
+          sstr << "could not make EGL context current: 0x" << std::hex << eglGetError();
+          BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+        }
+      }
+
+      std::cout << "headless: EGL " << major << "." << minor << ", " << eglQueryString(m_display, EGL_VENDOR) <<
+        ((EGL_NO_SURFACE == m_surface) ? ", surfaceless" : ", pbuffer") << std::endl;
+#else
+      BOOST_THROW_EXCEPTION(std::runtime_error("headless rendering requires a build with EGL"));
+#endif
+    }
+
+    /// Destructor.
+    ~Headless()
+    {
+      if(m_fbo)
+      {
+        FrameBuffer::replace_default_frame_buffer(NULL);
+        m_fbo.reset();
+      }
+#if defined(USE_EGL)
+      eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+      eglDestroyContext(m_display, m_context);
+      if(EGL_NO_SURFACE != m_surface)
+      {
+        eglDestroySurface(m_display, m_surface);
+      }
+      eglTerminate(m_display);
+#endif
+    }
+
+  public:
+    /// Create the render target standing in for the window.
+    ///
+    /// Must be called after OpenGL entry points have been loaded.
+    ///
+    /// \param width Screen width.
+    /// \param height Screen height.
+    void createFrameBuffer(unsigned width, unsigned height)
+    {
+      m_fbo.reset(new FrameBuffer(width, height, true, true, 1, NEAREST));
+      FrameBuffer::replace_default_frame_buffer(m_fbo.get());
+      std::cout << "headless: " << glGetString(GL_RENDERER) << ", " << width << "x" << height << std::endl;
+    }
+
+  private:
+#if defined(USE_EGL)
+    /// Get display to render on.
+    ///
+    /// \return Surfaceless display if available, default display otherwise.
+    static EGLDisplay get_display()
+    {
+#if defined(EGL_PLATFORM_SURFACELESS_MESA)
+      const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+      if(extensions && strstr(extensions, "EGL_MESA_platform_surfaceless"))
+      {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+          reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if(get_platform_display)
+        {
+          EGLDisplay ret = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+          if(EGL_NO_DISPLAY != ret)
+          {
+            return ret;
+          }
+        }
+      }
+#endif
+      return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+#endif
+};
+
+#endif
+
+#endif
@@ -106,6 +106,11 @@ typedef uint8_t sample_t;
 /// Global SDL window storage.
 static SDL_Window *g_sdl_window;
 
+#if defined(USE_LD)
+/// Render offscreen without a window, audio or input.
+static bool g_headless = false;
+#endif
+
 /// Font paths to try.
 static const char* g_font_paths[] =
 {
@@ -387,6 +392,14 @@ static bool is_quit_event(const SDL_Event& event)
 /// Uses global data.
 static void swap_buffers()
 {
+#if defined(USE_LD)
+  if(g_headless)
+  {
+    // Nothing to present, wait for the frame instead so frame times stay comparable.
+    glFinish();
+    return;
+  }
+#endif
   dnload_SDL_GL_SwapWindow(g_sdl_window);
 }
 
@@ -398,6 +411,9 @@ static void swap_buffers()
 #include "synth.h"
 #endif
 
+// Audio and synth threads are scheduled according to thread policy.
+#include "verbatim_thread_policy.hpp"
+
 /// Generic buffer for audio generation temp.
 static uint8_t g_buffer[SYNTH_WORK_SIZE + (INTRO_LENGTH_BYTES * 9 / 8)];
 
@@ -422,6 +438,13 @@ static void audio_callback(void *userdata, Uint8 *stream, int len)
   (void)userdata;
 
 #if defined(USE_LD)
+  static bool policy_applied = false;
+  if(!policy_applied)
+  {
+    thread_policy_apply(THREAD_ROLE_AUDIO);
+    policy_applied = true;
+  }
+
   if(g_next_audio_position >= 0)
   {
     g_audio_position = g_next_audio_position;
@@ -493,6 +516,7 @@ static void audio_master_fx(float *buf, size_t n_samples) {
 static int synth_func(void* data)
 {
 #if defined(USE_LD)
+  thread_policy_apply(THREAD_ROLE_PRECALC);
 
   // Fill audio data with 0 before doing anything to prevent noise if exceeding wave file length.
   {
@@ -593,6 +617,8 @@ static SDL_AudioSpec audio_spec =
 //######################################
 
 #include "verbatim_cond.hpp"
+#include "verbatim_cpu.hpp"
+#include "verbatim_fast_math.hpp"
 #include "verbatim_font.hpp"
 #include "verbatim_frame_buffer.hpp"
 #include "verbatim_image_2d_gray.hpp"
@@ -605,6 +631,7 @@ static SDL_AudioSpec audio_spec =
 #include "verbatim_mat2.hpp"
 #include "verbatim_mat3.hpp"
 #include "verbatim_opt.hpp"
+#include "verbatim_perf.hpp"
 #include "verbatim_png.hpp"
 #include "verbatim_spline.hpp"
 #include "verbatim_texture_3d.hpp"
@@ -636,13 +663,13 @@ static vec3 random_direction()
     sqr2 = x2 * x2;
 
     // Acceptable point, can stop randomizing.
-    if(dnload_sqrtf(sqr1 + sqr2) < 1.0f)
+    if(precalc_sqrtf(sqr1 + sqr2) < 1.0f)
     {
       break;
     }
   }
 
-  float root1 = dnload_sqrtf(1.0f - sqr1 - sqr2);
+  float root1 = precalc_sqrtf(1.0f - sqr1 - sqr2);
   float px = 2.0f * x1 * root1;
   float py = 2.0f * x2 * root1;
   float pz = 1.0f - 2.0f * (sqr1 + sqr2);
@@ -687,6 +714,13 @@ static vec3 random_direction()
 #include "space_post.vert.glsl.hpp" // g_shader_vertex_space_post
 #include "space_post.frag.glsl.hpp" // g_shader_fragment_space_post
 
+#if defined(USE_LD)
+#include "bands_upsample.frag.glsl.hpp" // g_shader_fragment_bands_upsample
+#include "fluid_multigrid.frag.glsl.hpp" // g_shader_fragment_fluid_multigrid
+#include "fluid_step.comp.glsl.hpp" // g_shader_compute_fluid_step
+#include "precalc_cube.comp.glsl.hpp" // g_shader_compute_precalc_cube
+#endif
+
 /// Fixed uniform location.
 static const GLint g_uniform_array = 0;
 
@@ -920,6 +954,11 @@ class Pipeline
 //######################################
 
 #include "global_data.hpp"
+#if defined(USE_LD)
+#include "benchmark.hpp"
+#include "fluid_budget.hpp"
+#include "headless.hpp"
+#endif
 
 //######################################
 // Drawing #############################
@@ -998,6 +1037,7 @@ void draw_text_blurb_array(const TextLocation* blurb, const GlobalData& data, co
     const vec3& col, const vec3& inv_col, float fs, bool centered, const vec2& offset, const vec2 rand_offset,
     int scene_time, int start_time, int duration, int ticks)
 {
+  GPU_PASS(data, GPU_PASS_TEXT);
   vgl::blend_mode(vgl::PREMULTIPLIED);
 
 
@@ -1039,6 +1079,113 @@ void draw_text_blurb_array(const TextLocation* blurb, const GlobalData& data, co
   vgl::blend_mode(vgl::DISABLED);
 }
 
+#if defined(USE_LD)
+/// Get GPU profile section of a frame.
+///
+/// \param scene Scene.
+/// \param ticks Tick count (ms), advanced past the split scene.
+/// \return Section name.
+static const char* gpu_profile_section(SceneEnum scene, int ticks)
+{
+  switch(scene)
+  {
+    case SPACE:
+      return ((ticks >= DIRECTION_SPLIT_START) && (ticks < DIRECTION_SPLIT_END)) ? "space_split" : "space";
+
+    case SIMPLE:
+      return "simple";
+
+    case ENCELADUS:
+      return "enceladus";
+
+    case CLOUDS:
+      return "clouds";
+
+    default:
+      break;
+  }
+  return "huygens";
+}
+
+/// Draw averaged GPU pass times on screen.
+///
+/// Draws into the currently bound framebuffer, does nothing unless the overlay is enabled.
+///
+/// \param data Global data instance.
+static void draw_gpu_profile(const GlobalData& data)
+{
+  const GpuProfiler* gpu_profiler = data.getGpuProfiler();
+  if(!g_gpu_profile || !gpu_profiler)
+  {
+    return;
+  }
+
+  const float FONT_SIZE = 0.04f;
+  float uniform_array[15] = { 0.0f };
+  uniform_array[9] = static_cast<float>(data.getScreenWidth());
+  uniform_array[10] = static_cast<float>(data.getScreenHeight());
+  uniform_array[11] = data.getFov();
+
+  vgl::blend_mode(vgl::PREMULTIPLIED);
+
+  const Pipeline& pipeline_font = data.getPipelineFont();
+  pipeline_font.bind();
+
+  pipeline_font.uniformVert3fv(g_uniform_array, 5, uniform_array);
+  pipeline_font.uniformFrag3fv(g_uniform_glyph_color, vec3(1.0f));
+  pipeline_font.uniformFrag3fv(g_uniform_glyph_inverse_color, vec3(0.0f));
+  draw_send_distort(pipeline_font, data, 0);
+
+  float px = 0.05f - uniform_array[9] / uniform_array[10];
+  float py = 1.0f - FONT_SIZE * 2.0f;
+  double total = 0.0;
+  for(unsigned ii = 0; (ii < GPU_PASS_COUNT); ++ii)
+  {
+    GpuPass pass = static_cast<GpuPass>(ii);
+    double ms = gpu_profiler->getAverage(pass);
+    total += ms;
+
+    // Skip passes not drawn lately.
+    if(ms < 0.01)
+    {
+      continue;
+    }
+
+    std::ostringstream sstr;
+    sstr << gpu_pass_name(pass) << " " << std::fixed << std::setprecision(2) << ms << " ms";
+    data.drawText(g_uniform_glyph_rectangle, g_uniform_glyph_phase, g_uniform_glyph, px, py, FONT_SIZE, 0.5f,
+        sstr.str().c_str());
+    py -= FONT_SIZE * 1.5f;
+  }
+
+  std::ostringstream sstr;
+  sstr << "total " << std::fixed << std::setprecision(2) << total << " ms";
+  data.drawText(g_uniform_glyph_rectangle, g_uniform_glyph_phase, g_uniform_glyph, px, py, FONT_SIZE, 0.5f,
+      sstr.str().c_str());
+
+  vgl::blend_mode(vgl::DISABLED);
+}
+
+/// Print GPU pass times and write them into a file if requested.
+///
+/// \param data Global data instance.
+static void gpu_profile_finish(const GlobalData& data)
+{
+  GpuProfiler* gpu_profiler = data.getGpuProfiler();
+  if(!gpu_profiler)
+  {
+    return;
+  }
+
+  gpu_profiler->flush();
+  gpu_profiler->report();
+  if(!g_gpu_profile_csv.empty())
+  {
+    gpu_profiler->write(g_gpu_profile_csv);
+  }
+}
+#endif
+
 /// Draw the world.
 ///
 /// \param ticks Tick count (ms).
@@ -1051,6 +1198,10 @@ static void draw(int ticks, GlobalData& data)
     ticks += DIRECTION_SPLIT_DURATION;
   }
 
+#if defined(USE_LD)
+  data.updateResidency(ticks);
+#endif
+
   // Uniform data.
   // 0: X position.
   // 1: Y position.
@@ -1071,6 +1222,13 @@ static void draw(int ticks, GlobalData& data)
 
   DirectionFrame frame = data.resolveDirectionFrame(ticks);
   setFrameUniforms(uniform_array, frame);
+#if defined(USE_LD)
+  GpuProfiler* gpu_profiler = data.getGpuProfiler();
+  if(gpu_profiler)
+  {
+    gpu_profiler->beginFrame(gpu_profile_section(frame.getScene(), ticks));
+  }
+#endif
   uniform_array[9] = static_cast<float>(data.getScreenWidth());
   uniform_array[10] = static_cast<float>(data.getScreenHeight());
   uniform_array[11] = data.getFov();
@@ -1125,6 +1283,7 @@ static void draw(int ticks, GlobalData& data)
     // Render.
     data.getFbo().bind();
     {
+      GPU_PASS(data, GPU_PASS_HUYGENS);
       const Pipeline& pipeline_huygens = data.getPipelineHuygens();
       pipeline_huygens.bind();
 
@@ -1155,6 +1314,7 @@ static void draw(int ticks, GlobalData& data)
     }
     else
     {
+      GPU_PASS(data, GPU_PASS_TEXT);
       const Pipeline& pipeline_font = data.getPipelineFont();
       pipeline_font.bind();
 
@@ -1173,6 +1333,7 @@ static void draw(int ticks, GlobalData& data)
     // Blit.
     data.bindDefaultFrameBuffer();
     {
+      GPU_PASS(data, GPU_PASS_HUYGENS_POST);
       const Pipeline& pipeline_huygens_post = data.getPipelineHuygensPost();
       pipeline_huygens_post.bind();
 
@@ -1215,6 +1376,7 @@ static void draw(int ticks, GlobalData& data)
       // Render.
       data.getFbo().bind();
       {
+        GPU_PASS(data, GPU_PASS_SPACE);
         const Pipeline& pipeline_space = data.getPipelineSpace();
         pipeline_space.bind();
 
@@ -1267,6 +1429,7 @@ static void draw(int ticks, GlobalData& data)
     // Blit.
     data.bindDefaultFrameBuffer();
     {
+      GPU_PASS(data, GPU_PASS_SPACE_POST);
       const Pipeline& pipeline_space_post = data.getPipelineSpacePost();
       pipeline_space_post.bind();
 
@@ -1286,6 +1449,7 @@ static void draw(int ticks, GlobalData& data)
     // Render.
     data.getFbo().bind();
     {
+      GPU_PASS(data, GPU_PASS_SIMPLE);
       const Pipeline& pipeline_simple = data.getPipelineSimple();
       pipeline_simple.bind();
 
@@ -1314,6 +1478,7 @@ static void draw(int ticks, GlobalData& data)
     // Blit.
     data.bindDefaultFrameBuffer();
     {
+      GPU_PASS(data, GPU_PASS_SIMPLE_POST);
       const Pipeline& pipeline_simple_post = data.getPipelineSimplePost();
       pipeline_simple_post.bind();
 
@@ -1334,6 +1499,7 @@ static void draw(int ticks, GlobalData& data)
     // Render.
     data.getFbo().bind();
     {
+      GPU_PASS(data, GPU_PASS_ENCELADUS);
       const Pipeline& pipeline_enceladus = data.getPipelineEnceladus();
       pipeline_enceladus.bind();
 
@@ -1352,6 +1518,7 @@ static void draw(int ticks, GlobalData& data)
     // Blit.
     data.bindDefaultFrameBuffer();
     {
+      GPU_PASS(data, GPU_PASS_ENCELADUS_POST);
       const Pipeline& pipeline_space_post = data.getPipelineSpacePost();
       pipeline_space_post.bind();
 
@@ -1398,6 +1565,7 @@ static void draw(int ticks, GlobalData& data)
     // Render.
     data.getFboLq().bind();
     {
+      GPU_PASS(data, GPU_PASS_CLOUDS);
       const Pipeline& pipeline_clouds = data.getPipelineClouds();
       pipeline_clouds.bind();
 
@@ -1417,6 +1585,7 @@ static void draw(int ticks, GlobalData& data)
     // Blit.
     data.bindDefaultFrameBuffer();
     {
+      GPU_PASS(data, GPU_PASS_CLOUDS_POST);
       const Pipeline& pipeline_clouds_post = data.getPipelineCloudsPost();
       pipeline_clouds_post.bind();
 
@@ -1431,6 +1600,14 @@ static void draw(int ticks, GlobalData& data)
     }
   }
 
+#if defined(USE_LD)
+  if(gpu_profiler)
+  {
+    draw_gpu_profile(data);
+    gpu_profiler->endFrame();
+  }
+#endif
+
 #if defined(USE_LD) || (defined(EXTRA_GLGETERROR) && (EXTRA_GLGETERROR != 0))
   vgl::error_check();
 #endif
@@ -1488,6 +1665,9 @@ void draw_fluid_show(const Texture& tex, GlobalData& data)
 
     dnload_glRects(-1, -1, 1, 1);
   }
+#if defined(USE_LD)
+  draw_gpu_profile(data);
+#endif
   swap_buffers();
 }
 
@@ -1500,10 +1680,12 @@ void draw_fluid_show(const Texture& tex, GlobalData& data)
 ///
 /// \param control Current fluid control.
 /// \param show_dye Show dye instead of control fluid.
+/// \param present Show the fluid on screen.
 /// \param phase Current fluid phase.
 /// \param data Global data instance.
 /// \return Next phase for main fluid framebuffers.
-int draw_fluid(bool update_fluid, bool show_dye, int control, int phase, int dye_phase, GlobalData& data)
+int draw_fluid(bool update_fluid, bool show_dye, bool present, int control, int phase, int dye_phase,
+    GlobalData& data)
 {
   // Initial phase. Copy starting input to fluid FBO, copy dye input to dye FBO.
   if(control == 0)
@@ -1522,14 +1704,42 @@ int draw_fluid(bool update_fluid, bool show_dye, int control, int phase, int dye
       draw_fluid_inner(65535, data, src, dst, data.getTextureSaturnBands());
     }
 
+#if defined(USE_LD)
+    if(g_fluid_format == FLUID_FORMAT_HALF)
+    {
+      glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+      for(int ii = 0; (ii < 2); ++ii)
+      {
+        data.getFluidPressureFbo(ii).bind();
+        glClear(GL_COLOR_BUFFER_BIT);
+      }
+    }
+#endif
+
     phase = 1 - phase;
     dye_phase = 1 - dye_phase;
   }
 
   if(update_fluid && (control != 0))
   {
+    GPU_PASS(data, GPU_PASS_FLUID);
     const int PROJECT_COUNT = 20;
+#if defined(USE_LD)
+    // Passes for pressure iterated in separate targets, after the passes run in order.
+    const int PROJECT_SEPARATE = PROJECT_COUNT + 5;
+    const int APPLY_PRESSURE_SEPARATE = PROJECT_SEPARATE + 1;
+#endif
 
+#if defined(USE_LD)
+    if(g_fluid_compute)
+    {
+      phase = data.getFluidCompute()->step(data.getFluidFbo(0), data.getFluidFbo(1), phase,
+          data.getFluidPressureFbo(), data.getFluidDyeFbo(dye_phase), data.getFluidDyeFbo(1 - dye_phase),
+          data.getTextureFluidInput(), PROJECT_COUNT);
+      dye_phase = 1 - dye_phase;
+    }
+    else
+#endif
     // Normal operation, run phases.
     for(int cc = 0; (cc <= PROJECT_COUNT + 4); ++cc)
     {
@@ -1566,21 +1776,64 @@ int draw_fluid(bool update_fluid, bool show_dye, int control, int phase, int dye
       // Project.
       else if((cc >= 2) && (cc < PROJECT_COUNT + 2))
       {
-        while(cc < PROJECT_COUNT + 2)
+#if defined(USE_LD)
+        FluidMultigrid* multigrid = data.getFluidMultigrid();
+        float relative_before = 0.0f;
+        float residual_before = 0.0f;
+        uint64_t texel_passes = multigrid ? multigrid->getTexelPasses() : 0;
+        if(g_fluid_residual)
+        {
+          residual_before = multigrid->measureResidual(data.getFluidFbo(phase), data.getFluidPressureFbo(),
+              relative_before);
+        }
+
+        if(g_fluid_multigrid)
+        {
+          phase = multigrid->solve(data.getFluidFbo(0), data.getFluidFbo(1), phase, data.getFluidPressureFbo());
+          cc = PROJECT_COUNT + 1;
+        }
+        else if(g_fluid_format == FLUID_FORMAT_HALF)
+        {
+          for(int ii = 0; (ii < PROJECT_COUNT); ++ii)
+          {
+            const FrameBuffer& src = data.getFluidPressureFbo(ii & 1);
+            const FrameBuffer& dst = data.getFluidPressureFbo(1 - (ii & 1));
+
+            draw_fluid_inner(PROJECT_SEPARATE, data, src, dst, data.getFluidPressureFbo().getTextureColor());
+          }
+          cc = PROJECT_COUNT + 1;
+        }
+        else
+#endif
         {
-          const FrameBuffer& src = data.getFluidFbo(phase);
-          const FrameBuffer& dst = data.getFluidFbo(1 - phase);
+          while(cc < PROJECT_COUNT + 2)
+          {
+            const FrameBuffer& src = data.getFluidFbo(phase);
+            const FrameBuffer& dst = data.getFluidFbo(1 - phase);
 
-          draw_fluid_inner(cc, data, src, dst, data.getFluidPressureFbo().getTextureColor());
+            draw_fluid_inner(cc, data, src, dst, data.getFluidPressureFbo().getTextureColor());
 
-          phase = 1 - phase;
+            phase = 1 - phase;
 
 #if defined(FLUID_EXTRA_DEBUG) && FLUID_EXTRA_DEBUG
-          tex = &(data.getFluidFbo(phase).getTextureColor());
+            tex = &(data.getFluidFbo(phase).getTextureColor());
 #endif
-          ++cc;
+            ++cc;
+          }
+          --cc;
+        }
+
+#if defined(USE_LD)
+        if(g_fluid_residual)
+        {
+          float relative = 0.0f;
+          float residual = multigrid->measureResidual(data.getFluidFbo(phase), data.getFluidPressureFbo(), relative);
+          texel_passes = g_fluid_multigrid ? (multigrid->getTexelPasses() - texel_passes) :
+            (static_cast<uint64_t>(PROJECT_COUNT) * get_fluid_side() * get_fluid_side());
+          std::cout << "fluid residual: " << residual_before << " -> " << residual << " (relative " <<
+            relative_before << " -> " << relative << ") in " << (texel_passes / 1000000) << " Mtexels" << std::endl;
         }
-        --cc;
+#endif
       }
       // Dye advect.
       else if(cc == PROJECT_COUNT + 3)
@@ -1602,6 +1855,14 @@ int draw_fluid(bool update_fluid, bool show_dye, int control, int phase, int dye
         const FrameBuffer& src = data.getFluidFbo(phase);
         const FrameBuffer& dst = data.getFluidFbo(1 - phase);
 
+#if defined(USE_LD)
+        if((g_fluid_format == FLUID_FORMAT_HALF) && (cc == PROJECT_COUNT + 2))
+        {
+          draw_fluid_inner(APPLY_PRESSURE_SEPARATE, data, src, dst,
+              data.getFluidPressureFbo(PROJECT_COUNT & 1).getTextureColor());
+        }
+        else
+#endif
         draw_fluid_inner(cc, data, src, dst, data.getFluidPressureFbo().getTextureColor());
 
         phase = 1 - phase;
@@ -1681,20 +1942,23 @@ int draw_fluid(bool update_fluid, bool show_dye, int control, int phase, int dye
     }
   }
 
+  if(present)
+  {
 #if defined(USE_LD)
-  if(show_dye)
+    if(show_dye)
 #endif
-  {
-    const Texture& tex = data.getFluidDyeFbo(dye_phase).getTextureColor();
-    draw_fluid_show(tex, data);
-  }
+    {
+      const Texture& tex = data.getFluidDyeFbo(dye_phase).getTextureColor();
+      draw_fluid_show(tex, data);
+    }
 #if defined(USE_LD)
-  else
-  {
-    const Texture& tex = data.getFluidFbo(phase).getTextureColor();
-    draw_fluid_show(tex, data);
-  }
+    else
+    {
+      const Texture& tex = data.getFluidFbo(phase).getTextureColor();
+      draw_fluid_show(tex, data);
+    }
 #endif
+  }
 
 #if defined(USE_LD) || (defined(EXTRA_GLGETERROR) && (EXTRA_GLGETERROR != 0))
   vgl::error_check();
@@ -1703,6 +1967,205 @@ int draw_fluid(bool update_fluid, bool show_dye, int control, int phase, int dye
   return phase;
 }
 
+#if defined(USE_LD)
+/// Number of steps cross-checked by fluid_compute_verify().
+static const int FLUID_VERIFY_STEPS = 16;
+
+/// Largest relative fluid difference not reported as a mismatch.
+static const float FLUID_VERIFY_TOLERANCE = 1.0f / 1024.0f;
+
+/// Largest dye difference not reported as a mismatch, dye is captured with 8 bits per channel.
+static const float FLUID_VERIFY_DYE_TOLERANCE = 1.0f / 255.0f;
+
+/// Cross-check compute shader fluid steps against fragment passes.
+///
+/// Every step runs both paths from the same state and continues from the compute shader result, so differences
+/// do not accumulate.
+///
+/// \param data Global data instance.
+/// \return True if all steps match.
+static bool fluid_compute_verify(GlobalData& data)
+{
+  int phase = draw_fluid(false, true, false, 0, 0, 0, data);
+  int dye_phase = 1;
+  int fragment_ticks = 0;
+  int compute_ticks = 0;
+  bool ret = true;
+
+  for(int ii = 0; (ii < FLUID_VERIFY_STEPS); ++ii)
+  {
+    std::vector<float> fluid;
+    std::vector<float> dye;
+    std::vector<float> fragment_fluid;
+    std::vector<float> fragment_dye;
+    std::vector<float> compute_fluid;
+    std::vector<float> compute_dye;
+
+    FluidCompute::read(data.getFluidFbo(phase), fluid);
+    FluidCompute::read(data.getFluidDyeFbo(dye_phase), dye);
+
+    g_fluid_compute = false;
+    glFinish();
+    int start_ticks = get_current_ticks();
+    int fragment_phase = draw_fluid(true, true, false, 1, phase, dye_phase, data);
+    glFinish();
+    fragment_ticks += get_current_ticks() - start_ticks;
+    FluidCompute::read(data.getFluidFbo(fragment_phase), fragment_fluid);
+    FluidCompute::read(data.getFluidDyeFbo(1 - dye_phase), fragment_dye);
+
+    FluidCompute::write(data.getFluidFbo(phase), fluid);
+    FluidCompute::write(data.getFluidDyeFbo(dye_phase), dye);
+
+    g_fluid_compute = true;
+    glFinish();
+    start_ticks = get_current_ticks();
+    phase = draw_fluid(true, true, false, 1, phase, dye_phase, data);
+    glFinish();
+    compute_ticks += get_current_ticks() - start_ticks;
+    dye_phase = 1 - dye_phase;
+    FluidCompute::read(data.getFluidFbo(phase), compute_fluid);
+    FluidCompute::read(data.getFluidDyeFbo(dye_phase), compute_dye);
+
+    float fluid_relative;
+    float dye_relative;
+    float fluid_error = FluidCompute::compare(fragment_fluid, compute_fluid, fluid_relative);
+    float dye_error = FluidCompute::compare(fragment_dye, compute_dye, dye_relative);
+    bool success = (fluid_relative <= FLUID_VERIFY_TOLERANCE) && (dye_error <= FLUID_VERIFY_DYE_TOLERANCE);
+
+    std::cout << "fluid step " << ii << ": " << (success ? "match" : "MISMATCH") << ", fluid max error " <<
+      fluid_error << " (relative " << fluid_relative << "), dye max error " << dye_error << std::endl;
+    ret = success && ret;
+  }
+
+  std::cout << "fluid steps took " << fragment_ticks << " ms with fragment passes, " << compute_ticks <<
+    " ms with compute shader" << std::endl;
+  return ret;
+}
+
+/// Cross-check CPU fluid steps against GPU fluid steps.
+///
+/// Every step runs both from the same state and continues from the GPU result, so differences do not accumulate.
+///
+/// \param data Global data instance.
+/// \return True if the initial state and all steps match.
+static bool fluid_cpu_verify(GlobalData& data)
+{
+  uptr<FluidCpu> fluid(data.createFluidCpu());
+  int phase = draw_fluid(false, true, false, 0, 0, 0, data);
+  int dye_phase = 1;
+  int gpu_ticks = 0;
+  int cpu_ticks = 0;
+  bool ret = true;
+
+  for(int ii = -1; (ii < FLUID_VERIFY_STEPS); ++ii)
+  {
+    std::vector<float> gpu_fluid;
+    std::vector<float> gpu_dye;
+    std::vector<float> cpu_fluid;
+    std::vector<float> cpu_dye;
+
+    // First round only compares the initial state.
+    if(ii >= 0)
+    {
+      FluidCompute::read(data.getFluidFbo(phase), gpu_fluid);
+      FluidCompute::read(data.getFluidDyeFbo(dye_phase), gpu_dye);
+      fluid->setState(gpu_fluid, gpu_dye);
+
+      int start_ticks = get_current_ticks();
+      fluid->step();
+      cpu_ticks += get_current_ticks() - start_ticks;
+
+      glFinish();
+      start_ticks = get_current_ticks();
+      phase = draw_fluid(true, true, false, 1, phase, dye_phase, data);
+      glFinish();
+      gpu_ticks += get_current_ticks() - start_ticks;
+      dye_phase = 1 - dye_phase;
+    }
+    fluid->getState(cpu_fluid, cpu_dye);
+    FluidCompute::read(data.getFluidFbo(phase), gpu_fluid);
+    FluidCompute::read(data.getFluidDyeFbo(dye_phase), gpu_dye);
+
+    float fluid_relative;
+    float dye_relative;
+    float fluid_error = FluidCompute::compare(gpu_fluid, cpu_fluid, fluid_relative);
+    float dye_error = FluidCompute::compare(gpu_dye, cpu_dye, dye_relative);
+    bool success = (fluid_relative <= FLUID_VERIFY_TOLERANCE) && (dye_error <= FLUID_VERIFY_DYE_TOLERANCE);
+
+    std::ostringstream sstr;
+    if(ii >= 0)
+    {
+      sstr << "step " << ii;
+    }
+    else
+    {
+      sstr << "initial state";
+    }
+    std::cout << "fluid " << sstr.str() << ": " << (success ? "match" : "MISMATCH") << ", fluid max error " <<
+      fluid_error << " (relative " << fluid_relative << "), dye max error " << dye_error << std::endl;
+    ret = success && ret;
+  }
+
+  std::cout << "fluid steps took " << gpu_ticks << " ms on GPU, " << cpu_ticks << " ms on CPU" << std::endl;
+  return ret;
+}
+
+/// Run the fluid simulation on the CPU up to the capture frame.
+///
+/// \param fluid CPU fluid simulation.
+/// \param bands [out] Saturn bands captured from dye, must be the size of the simulation.
+static void fluid_cpu_run(FluidCpu& fluid, Image2D& bands)
+{
+  int start_ticks = get_current_ticks();
+
+  // Same number of steps as before capture in the precalc loop.
+  for(int ii = 0; (ii < FLUID_CAPTURE_FRAME); ++ii)
+  {
+    fluid.step();
+  }
+  fluid.capture(bands);
+
+  std::cout << "fluid: " << FLUID_CAPTURE_FRAME << " steps on CPU in " << (get_current_ticks() - start_ticks) <<
+    " ms" << std::endl;
+}
+
+/// Run the fluid simulation on the CPU and capture Saturn bands from it.
+///
+/// \param data Global data instance.
+static void fluid_cpu_capture(GlobalData& data)
+{
+  uptr<FluidCpu> fluid(data.createFluidCpu());
+  Image2DRGBA bands(fluid->getWidth(), fluid->getHeight());
+
+  fluid_cpu_run(*fluid, bands);
+  data.updateSaturnBands(bands);
+}
+
+/// Run the fluid simulation on the CPU and store Saturn bands into the precalc cache.
+///
+/// Needs no GL context, bands are stored as the texels the GL path would upload from the same capture.
+///
+/// \param temporary Temporary data with the initial fluid state.
+static void fluid_cpu_cache(GlobalDataTemporary& temporary)
+{
+  uptr<PrecalcCacheEntry> entry(create_saturn_bands_cache(temporary));
+  if(entry->read() && !g_precalc_cache_verify)
+  {
+    return;
+  }
+
+  FluidCpu fluid(temporary.fluid_input, temporary.saturn_bands);
+  Image2DRGBA bands(fluid.getWidth(), fluid.getHeight());
+
+  fluid_cpu_run(fluid, bands);
+  uarr<uint8_t> texels = bands.getExportData(1);
+  if(!entry->write(bands.getWidth(), bands.getHeight(), 4, texels.get()))
+  {
+    BOOST_THROW_EXCEPTION(std::runtime_error("CPU Saturn bands do not match the precalc cache"));
+  }
+}
+#endif
+
 //######################################
 // Fluid simulation ####################
 //######################################
@@ -1818,16 +2281,175 @@ void _start()
 #endif
 {
   dnload();
-  dnload_SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
-  g_sdl_window = dnload_SDL_CreateWindow(NULL, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-      static_cast<int>(screen_w), static_cast<int>(screen_h),
-      SDL_WINDOW_OPENGL | (flag_fullscreen ? SDL_WINDOW_FULLSCREEN : 0));
-  dnload_SDL_GL_CreateContext(g_sdl_window);
-  dnload_SDL_ShowCursor(g_flag_developer);
+#if defined(USE_LD)
+  thread_policy_initialize();
+#else
+  cpu_initialize();
+#endif
+
+#if defined(USE_LD)
+  // Generator parameters must be known before precalc starts.
+  PrecalcParamsWatcher params_watcher(g_precalc_params_filename);
+#endif
+
+  // CPU precalc does not need GL, start it before window creation and shader compilation.
+  GlobalDataTemporary* temporary = new GlobalDataTemporary();
+#if defined(USE_LD)
+  // Recording, offscreen playback and verification need final assets from the start.
+  bool precalc_preview = g_precalc_progressive && !flag_record && !g_headless &&
+    (PRECALC_CUBE_VERIFY != g_precalc_cube_mode);
+  if(precalc_preview)
+  {
+    temporary->setCubeMapDivisor(PRECALC_PREVIEW_DIVISOR);
+  }
+#endif
+
+  // Create fluid textures. Random number generator is shared with precalc, so do this before starting it.
+  {
+    Image2DRGBA& boundary = temporary->fluid_boundary;
+    Image2DRGBA& initial = temporary->fluid_input;
+    const unsigned fluid_side = get_fluid_side();
+
+    for(unsigned ii = 0; ii < fluid_side; ii++)
+    {
+      boundary.setPixel(0, ii, 1, 0.5f, 0.0f, 1.0f);
+      boundary.setPixel(fluid_side - 1, ii, 0.0f, 0.5f, 0.0f, 1.0f);
+    }
+    // Inside, have everything return the same pixel, with 1.0 mul
+    for(unsigned ii = 1; ii < fluid_side - 1; ii++)
+    {
+      for(unsigned jj = 0; jj < fluid_side; jj++)
+      {
+        boundary.setPixel(ii, jj, 0.5f, 0.5f, 1.0f, 1.0f);
+      }
+    }
+
+    // Initial condition and iterative too
+    AddInflow(initial, 0, 0, fluid_side, fluid_side, vec2(0.0f, 0.0f), 1.0f); // clear
+    //AddInflow(initial, FLUID_WIDTH*0.45, 0.2*FLUID_HEIGHT, FLUID_WIDTH*0.1, 1, vec2(0.0f, 3.0f), 0.0f);
+
+    dnload_srand(0);
+    // Large amount of 1-pixel disturbances. Velocities are in texels per step, so scale them to move the same
+    // fraction of the simulation per step regardless of its size. Disturbance count stays the same as well.
+    float inflow_speed = 3.0f * static_cast<float>(fluid_side) / static_cast<float>(FLUID_WIDTH);
+    for(unsigned ii = 0; ii < FLUID_WIDTH; ii++)
+    {
+      AddInflow(initial, ii * fluid_side / FLUID_WIDTH, urand(fluid_side), 1, 1, vec2(0.0f, inflow_speed), 0.0f);
+    }
+    //AddInflow(initial, 64, 64, 1, 1, vec2(0.0f, 3.0f), 0.0f);
+          
+    /*
+    //(0, 0) corner
+    boundary.setPixel(0, 0, 1.0, 1.0, 0.0, 0.0);
+    //(0, MAX) corner
+    boundary.setPixel(0, FLUID_HEIGHT-1, 1.0, 0.0, 0.0, 0.0);
+    //(MAX, 0) corner
+    boundary.setPixel(FLUID_WIDTH-1, 0, 0.0, 1.0, 0.0, 0.0);
+    //(MAX, MAX) corner
+    boundary.setPixel(FLUID_WIDTH-1, FLUID_HEIGHT-1, 0.0, 0.0, 0.0, 0.0);
+    // Left and Right boundary
+    for(unsigned ii = 1; ii < FLUID_HEIGHT-1; ii++)
+    {
+      boundary.setPixel(0, ii, 1, 0.5, 0.0, 1.0);
+      boundary.setPixel(FLUID_WIDTH-1, ii, 0.0, 0.5, 0.0, 1.0);
+    }
+    // Top and Bottom boundary
+    for(unsigned ii = 1; ii < FLUID_WIDTH - 1; ii++)
+    {
+      boundary.setPixel(ii, 0, 0.5, 1, 1.0, 0.0);
+      boundary.setPixel(ii, FLUID_HEIGHT - 1, 0.5, 0.0, 1.0, 0.0);
+    }
+
+    // Inside, have everything return the same pixel, with 1.0 mul
+    for(unsigned ii = 1; ii < FLUID_WIDTH - 1; ii++)
+    {
+      for(unsigned jj = 1; jj < FLUID_HEIGHT - 1; jj++)
+      {
+        boundary.setPixel(ii, jj, 0.5, 0.5, 1.0, 1.0);
+      }
+    }
+
+    // Initial state.
+    for(unsigned ii = 0; (ii < FLUID_WIDTH); ++ii)
+    {
+      for(unsigned jj = 0; (jj < FLUID_WIDTH); ++jj)
+      {
+        initial.setPixel(ii, jj, 0.0, 0.0, 0.0, 0.0);
+      }
+    }
+
+    // Initial state.
+    for (unsigned ii = 900; (ii < 1000); ++ii)
+    {
+      for (unsigned jj = 900; (jj < 1000); ++jj)
+      {
+        initial.setPixel(ii, jj, 1.0, 1.0, 1.0, 1.0);
+      }
+    }*/
+    /*for (unsigned ii = 0; (ii < FLUID_WIDTH); ++ii)
+    {
+      for (unsigned jj = 0; (jj < FLUID_HEIGHT); ++jj)
+      {
+        initial.setPixel(ii, jj, 0.0f, (static_cast<float>(ii) / (FLUID_WIDTH - 1) - 0.5f), 0.0f, 1.0f);
+      }
+    }*/
+    
+    /*for (unsigned ii = 0; ii < FLUID_WIDTH; ++ii)
+    {
+      for (unsigned jj = 0; jj < FLUID_HEIGHT; ++jj)
+      {
+        float vx = frand(-1.0f, 1.0f);
+        float vy = frand(-1.0f, 1.0f);
+        initial.setPixel(ii, jj, vx, vy, 0.0f, 0.0);
+      }
+    }*/
+  }
+
+#if defined(USE_LD)
+  // Only the fluid initial state is needed, skip precalc and never create a window or a GL context.
+  if(g_fluid_cpu_cache)
+  {
+    uptr<GlobalDataTemporary> cached(temporary);
+    dnload_SDL_Init(SDL_INIT_TIMER);
+    fluid_cpu_cache(*cached);
+    dnload_SDL_Quit();
+    return;
+  }
+#endif
+
+  temporary->start();
+
+#if defined(USE_LD)
+  // SDL is only used for timing when rendering offscreen.
+  int headless_start = 0;
+  uptr<Headless> headless;
+  if(g_headless)
+  {
+    dnload_SDL_Init(SDL_INIT_TIMER);
+    headless_start = get_current_ticks();
+    headless.reset(new Headless());
+  }
+  else
+#endif
+  {
+    dnload_SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+    g_sdl_window = dnload_SDL_CreateWindow(NULL, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+        static_cast<int>(screen_w), static_cast<int>(screen_h),
+        SDL_WINDOW_OPENGL | (flag_fullscreen ? SDL_WINDOW_FULLSCREEN : 0));
+    dnload_SDL_GL_CreateContext(g_sdl_window);
+    dnload_SDL_ShowCursor(g_flag_developer);
+  }
 
 #if defined(USE_LD)
   {
     GLenum err = glewInit();
+#if defined(GLEW_ERROR_NO_GLX_DISPLAY)
+    // GLX builds of GLEW look for a GLX display after loading entry points, there is none for an EGL context.
+    if(headless && (GLEW_ERROR_NO_GLX_DISPLAY == err))
+    {
+      err = GLEW_OK;
+    }
+#endif
     if(GLEW_OK != err)
     {
       std::ostringstream sstr;
@@ -1835,13 +2457,38 @@ void _start()
       BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
     }
   }
+
+  if(headless)
+  {
+    headless->createFrameBuffer(screen_w, screen_h);
+  }
+
+  // Threads spawned by the GL driver have already been created, only the render thread is pinned.
+  thread_policy_apply(THREAD_ROLE_RENDER);
+
+  if(PRECALC_CUBE_VERIFY == g_precalc_cube_mode)
+  {
+    uptr<GlobalDataTemporary> verified(temporary);
+    bool success = PrecalcCompute().verify(*verified);
+    verified.reset();
+    dnload_SDL_Quit();
+    if(!success)
+    {
+      BOOST_THROW_EXCEPTION(std::runtime_error("compute shader precalc does not match CPU precalc"));
+    }
+    return;
+  }
 #endif
 
-  GlobalData global_data(screen_w, screen_h, 0.55f);
+  GlobalData global_data(screen_w, screen_h, 0.55f, temporary);
 
   // Initial states.
   vgl::blend_mode(vgl::DISABLED);
 
+#if defined(USE_LD)
+  bool precalc_cancelled = false;
+#endif
+
   // Begin precalc loop.
   {
 #if 0
@@ -1864,106 +2511,41 @@ void _start()
     tex.update(img);
 #endif
 
-    Image2DRGBA boundary(FLUID_WIDTH, FLUID_HEIGHT);
-    Image2DRGBA initial(FLUID_WIDTH, FLUID_HEIGHT);
-    // Create fluid textures.
-    {
-      for(unsigned ii = 0; ii < FLUID_HEIGHT; ii++)
-      {
-        boundary.setPixel(0, ii, 1, 0.5f, 0.0f, 1.0f);
-        boundary.setPixel(FLUID_WIDTH - 1, ii, 0.0f, 0.5f, 0.0f, 1.0f);
-      }
-      // Inside, have everything return the same pixel, with 1.0 mul
-      for(unsigned ii = 1; ii < FLUID_WIDTH - 1; ii++)
-      {
-        for(unsigned jj = 0; jj < FLUID_HEIGHT; jj++)
-        {
-          boundary.setPixel(ii, jj, 0.5f, 0.5f, 1.0f, 1.0f);
-        }
-      }
-
-      // Initial condition and iterative too
-      AddInflow(initial, 0, 0, FLUID_WIDTH, FLUID_HEIGHT, vec2(0.0f, 0.0f), 1.0f); // clear
-      //AddInflow(initial, FLUID_WIDTH*0.45, 0.2*FLUID_HEIGHT, FLUID_WIDTH*0.1, 1, vec2(0.0f, 3.0f), 0.0f);
-
-      dnload_srand(0);
-      // Large amount of 1-pixel disturbances
-      for(unsigned ii = 0; ii < FLUID_WIDTH; ii++)
-      {
-        AddInflow(initial, ii, urand(FLUID_HEIGHT), 1, 1, vec2(0.0f, 3.0f), 0.0f);
-      }
-      //AddInflow(initial, 64, 64, 1, 1, vec2(0.0f, 3.0f), 0.0f);
-            
-      /*
-      //(0, 0) corner
-      boundary.setPixel(0, 0, 1.0, 1.0, 0.0, 0.0);
-      //(0, MAX) corner
-      boundary.setPixel(0, FLUID_HEIGHT-1, 1.0, 0.0, 0.0, 0.0);
-      //(MAX, 0) corner
-      boundary.setPixel(FLUID_WIDTH-1, 0, 0.0, 1.0, 0.0, 0.0);
-      //(MAX, MAX) corner
-      boundary.setPixel(FLUID_WIDTH-1, FLUID_HEIGHT-1, 0.0, 0.0, 0.0, 0.0);
-      // Left and Right boundary
-      for(unsigned ii = 1; ii < FLUID_HEIGHT-1; ii++)
-      {
-        boundary.setPixel(0, ii, 1, 0.5, 0.0, 1.0);
-        boundary.setPixel(FLUID_WIDTH-1, ii, 0.0, 0.5, 0.0, 1.0);
-      }
-      // Top and Bottom boundary
-      for(unsigned ii = 1; ii < FLUID_WIDTH - 1; ii++)
-      {
-        boundary.setPixel(ii, 0, 0.5, 1, 1.0, 0.0);
-        boundary.setPixel(ii, FLUID_HEIGHT - 1, 0.5, 0.0, 1.0, 0.0);
-      }
+    global_data.updateFluid();
 
-      // Inside, have everything return the same pixel, with 1.0 mul
-      for(unsigned ii = 1; ii < FLUID_WIDTH - 1; ii++)
+#if defined(USE_LD)
+    if(g_fluid_compute_verify)
+    {
+      bool success = fluid_compute_verify(global_data);
+      global_data.cancel();
+      dnload_SDL_Quit();
+      if(!success)
       {
-        for(unsigned jj = 1; jj < FLUID_HEIGHT - 1; jj++)
-        {
-          boundary.setPixel(ii, jj, 0.5, 0.5, 1.0, 1.0);
-        }
+        BOOST_THROW_EXCEPTION(std::runtime_error("compute shader fluid step does not match fragment passes"));
       }
-
-      // Initial state.
-      for(unsigned ii = 0; (ii < FLUID_WIDTH); ++ii)
+      return;
+    }
+    if(g_fluid_cpu_verify)
+    {
+      bool success = fluid_cpu_verify(global_data);
+      global_data.cancel();
+      dnload_SDL_Quit();
+      if(!success)
       {
-        for(unsigned jj = 0; (jj < FLUID_WIDTH); ++jj)
-        {
-          initial.setPixel(ii, jj, 0.0, 0.0, 0.0, 0.0);
-        }
+        BOOST_THROW_EXCEPTION(std::runtime_error("CPU fluid step does not match GPU fluid step"));
       }
-
-      // Initial state.
-      for (unsigned ii = 900; (ii < 1000); ++ii)
-      {
-        for (unsigned jj = 900; (jj < 1000); ++jj)
-        {
-          initial.setPixel(ii, jj, 1.0, 1.0, 1.0, 1.0);
-        }
-      }*/
-      /*for (unsigned ii = 0; (ii < FLUID_WIDTH); ++ii)
-      {
-        for (unsigned jj = 0; (jj < FLUID_HEIGHT); ++jj)
-        {
-          initial.setPixel(ii, jj, 0.0f, (static_cast<float>(ii) / (FLUID_WIDTH - 1) - 0.5f), 0.0f, 1.0f);
-        }
-      }*/
-      
-      /*for (unsigned ii = 0; ii < FLUID_WIDTH; ++ii)
-      {
-        for (unsigned jj = 0; jj < FLUID_HEIGHT; ++jj)
-        {
-          float vx = frand(-1.0f, 1.0f);
-          float vy = frand(-1.0f, 1.0f);
-          initial.setPixel(ii, jj, vx, vy, 0.0f, 0.0);
-        }
-      }*/
-      global_data.updateFluid(boundary, initial);
+      return;
+    }
+    // Bands read from the precalc cache need no fluid simulation.
+    bool bands_cached = global_data.loadSaturnBands();
+    if(g_fluid_cpu && !bands_cached)
+    {
+      fluid_cpu_capture(global_data);
+      global_data.storeSaturnBands();
     }
+#endif
 
-    // Offload precalc to other threads.
-    Thread thr_init(GlobalData::initialize_func, &global_data);
+    // Precalc is already running, offload synth to another thread.
     Thread thr_synth(synth_func, g_audio_buffer);
 
     int prev_ticks = get_current_ticks();
@@ -1974,7 +2556,10 @@ void _start()
     bool quit = false;
 #if defined(USE_LD)
     bool show_dye = true;
-    bool update_fluid = true;
+    // Bands may already be captured from the CPU simulation or read from the cache.
+    bool update_fluid = !(g_fluid_cpu || bands_cached);
+    quit = !update_fluid;
+    FluidBudget fluid_budget(g_fluid_budget);
 #else
     const bool show_dye = true;    
     const bool update_fluid = true;
@@ -2041,6 +2626,8 @@ void _start()
                 break;
 
               case SDLK_ESCAPE:
+                // First escape only stops the fluid, escape after that cancels precalc.
+                precalc_cancelled = quit;
                 quit = true;
                 break;
 
@@ -2060,8 +2647,16 @@ void _start()
                 break;
             }
           }
+          else if(SDL_QUIT == event.type)
+          {
+            precalc_cancelled = true;
+          }
         }
       }
+      if(precalc_cancelled)
+      {
+        break;
+      }
 #endif
 
       // Wait until next display.
@@ -2077,9 +2672,32 @@ void _start()
         dnload_SDL_Delay(0);
       }
 
-      // Update fluid simulation.
+      // Update fluid simulation. Steps before capture are not paced, as many run as fit in the budget.
+#if defined(USE_LD)
+      unsigned fluid_steps = 1;
+      if(update_fluid && (fluid_control != 0) && (fluid_frame <= FLUID_CAPTURE_FRAME))
+      {
+        fluid_steps = fluid_budget.getStepCount(static_cast<unsigned>(FLUID_CAPTURE_FRAME + 1 - fluid_frame));
+      }
+      GpuProfiler* gpu_profiler = global_data.getGpuProfiler();
+      if(gpu_profiler)
       {
-        fluid_phase = draw_fluid(update_fluid, show_dye, fluid_control, fluid_phase, dye_phase, global_data);
+        gpu_profiler->beginFrame("precalc");
+      }
+      for(unsigned ii = 0; (ii < fluid_steps); ++ii)
+#endif
+      {
+#if defined(USE_LD)
+        bool present = (ii + 1 >= fluid_steps);
+        fluid_budget.begin();
+#else
+        const bool present = true;
+#endif
+        fluid_phase = draw_fluid(update_fluid, show_dye, present, fluid_control, fluid_phase, dye_phase,
+            global_data);
+#if defined(USE_LD)
+        fluid_budget.end();
+#endif
         if(update_fluid || (fluid_control == 0))
         {
           dye_phase = 1 - dye_phase;
@@ -2087,27 +2705,11 @@ void _start()
           // Capture fluid frame.
           if(fluid_frame == FLUID_CAPTURE_FRAME)
           {
-            // Capture data.
-            uarr<uint8_t> capture_array(FLUID_WIDTH * FLUID_HEIGHT * 4);
-            global_data.getFluidDyeFbo(dye_phase).bind();
-            dnload_glReadPixels(0, 0, FLUID_WIDTH, FLUID_HEIGHT, GL_RGBA, GL_BYTE, capture_array.get());
-
-            // Write data to image.
-            Image2DRGBA capture_image(FLUID_WIDTH, FLUID_HEIGHT);
-            for(unsigned ii = 0; (ii < FLUID_WIDTH); ++ii)
-            {
-              for(unsigned jj = 0; (jj < FLUID_HEIGHT); ++jj)
-              {
-                // Texture looks ok in fluidsim, but shit on actual saturn without multiply [jaguar.jpg].
-                unsigned idx = (jj * FLUID_WIDTH + ii) * 4;
-                float rr = static_cast<float>(capture_array[idx + 0]) * (1.0f / 255.0f);
-                float gg = static_cast<float>(capture_array[idx + 1]) * (1.0f / 255.0f);
-                float bb = static_cast<float>(capture_array[idx + 2]) * (1.0f / 255.0f);
-                float aa = 1.0f;
-                capture_image.setPixel(ii, jj, rr, gg, bb, aa);
-              }
-            }
-            global_data.updateSaturnBands(capture_image);
+            global_data.captureSaturnBands(global_data.getFluidDyeFbo(dye_phase).getTextureColor());
+#if defined(USE_LD)
+            global_data.storeSaturnBands();
+            fluid_budget.report();
+#endif
             quit = true; // Can exit precalc now.
           }
 
@@ -2115,6 +2717,12 @@ void _start()
         }
         fluid_control = 1;
       }
+#if defined(USE_LD)
+      if(gpu_profiler)
+      {
+        gpu_profiler->endFrame();
+      }
+#endif
 
       // May need to do partial update if necessary.
       if(global_data.hasPendingUpdate())
@@ -2124,14 +2732,40 @@ void _start()
     }
   }
 
+#if defined(USE_LD)
+  if(precalc_cancelled)
+  {
+    int cancel_ticks = get_current_ticks();
+    global_data.cancel();
+    std::cout << "precalc shutdown took " << (get_current_ticks() - cancel_ticks) << " ms" << std::endl;
+    dnload_SDL_Quit();
+    return;
+  }
+#endif
+
   // Perform remaining updates to GPU.
   global_data.update();
 
 #if defined(USE_LD)
-  if(flag_record)
+  // Replace low-resolution cube maps during playback, in order of first use.
+  if(precalc_preview)
+  {
+    global_data.refine(g_precalc_params);
+  }
+
+  if(0 < g_residency_lookahead)
+  {
+    global_data.enableResidency(g_residency_lookahead);
+  }
+#endif
+
+#if defined(USE_LD)
+  // Offscreen playback steps time like recording, there is no audio to follow.
+  if(flag_record || headless)
   {
     SDL_Event event;
     int frame_idx = 0;
+    int playback_start = get_current_ticks();
 
     // audio
     SDL_PauseAudio(1);
@@ -2155,11 +2789,22 @@ void _start()
       }
 
       draw(ticks, global_data);
-      write_frame(screen_w, screen_h, frame_idx);
+      if(flag_record)
+      {
+        write_frame(screen_w, screen_h, frame_idx);
+      }
       swap_buffers();
       ++frame_idx;
     }
 
+    if(headless)
+    {
+      int playback_ticks = get_current_ticks() - playback_start;
+      std::cout << "headless: precalc " << (playback_start - headless_start) << " ms, " << frame_idx <<
+        " frames in " << playback_ticks << " ms (" << (static_cast<float>(playback_ticks) /
+            static_cast<float>(frame_idx)) << " ms/frame)" << std::endl;
+    }
+    gpu_profile_finish(global_data);
     dnload_SDL_Quit();
     return;
   }
@@ -2436,6 +3081,30 @@ void _start()
       g_pos += (movement_rt * rt) + (movement_up * g_up) + (movement_fw * g_fw);
     }
 
+    // Regenerate assets whose parameters have changed.
+    params_watcher.poll(get_current_ticks());
+    if(params_watcher.getPending() && global_data.rebuild(g_precalc_params, params_watcher.getPending()))
+    {
+      params_watcher.clearPending();
+    }
+    global_data.updateRebuild();
+
+    // Full resolution assets are due before their first scene, hold playback and audio until they have arrived.
+    if(global_data.isRefineDue(playback_ticks))
+    {
+      int wait_ticks = get_current_ticks();
+      if(!g_flag_developer)
+      {
+        SDL_PauseAudio(1);
+      }
+      global_data.waitRefine(playback_ticks);
+      if(!g_flag_developer)
+      {
+        SDL_PauseAudio(0);
+      }
+      prev_ticks += get_current_ticks() - wait_ticks;
+    }
+
     // Clamp time if on developer mode.
     if(g_flag_developer)
     {
@@ -2515,6 +3184,12 @@ void _start()
     }
   }
 
+#if defined(USE_LD)
+  gpu_profile_finish(global_data);
+
+  // Do not wait for a rebuild that may still be running.
+  global_data.cancel();
+#endif
   dnload_SDL_Quit();
 #if !defined(USE_LD)
   asm_exit();
@@ -2537,6 +3212,10 @@ int DNLOAD_MAIN(int argc, char **argv)
   unsigned screen_h = SCREEN_H;
   bool fullscreen = true;
   bool record = false;
+  CpuLevel cpu_level = CPU_LEVEL_COUNT;
+  bool benchmark = false;
+  std::string benchmark_filter;
+  std::string benchmark_out;
 
 #if !defined(DEBUG)
   try
@@ -2546,39 +3225,226 @@ int DNLOAD_MAIN(int argc, char **argv)
     {
       po::options_description desc("Options");
       desc.add_options()
+        ("benchmark", "Run microbenchmarks of precalc primitives and exit.")
+        ("benchmark-filter", po::value<std::string>(), "Only run benchmarks with names containing this string.")
+        ("benchmark-out", po::value<std::string>(), "Write benchmark results into a JSON file.")
+        ("cpu-level", po::value<std::string>(), "Force CPU level for precalc kernels: 'baseline', 'avx2' or 'avx512'.")
         ("developer,d", "Developer mode.")
+        ("fluid-budget", po::value<int>(),
+         "GPU milliseconds per frame for fluid steps during precalc, 0 for one step per frame (default: 12).")
+        ("fluid-compute", "Run fluid steps with a fused compute shader instead of fragment passes.")
+        ("fluid-cpu", "Run the fluid simulation on the CPU and capture Saturn bands from it before precalc.")
+        ("fluid-cpu-cache",
+         "Run the fluid simulation on the CPU, store Saturn bands into the precalc cache without a GL context and "
+         "exit. Needs --precalc-cache, implies --fluid-cpu.")
+        ("fluid-format", po::value<std::string>(),
+         "Fluid framebuffer format: 'float', 'packed' or 'half' (default: packed). Compute, multigrid, residual and "
+         "verification paths need 'float'.")
+        ("fluid-multigrid", "Solve fluid pressure with multigrid V-cycles instead of Jacobi iteration.")
+        ("fluid-residual", "Print fluid pressure residual before and after each solve.")
+        ("fluid-size", po::value<unsigned>(),
+         "Fluid simulation side, captured bands are upsampled to 2048 (default: 2048).")
+        ("full-precalc", "Wait for full resolution cube maps before playback instead of refining them during it.")
+        ("gpu-precalc", "Generate space and moon cube maps with compute shaders.")
+        ("gpu-profile", "Show GPU time of each rendering pass on screen.")
+        ("gpu-profile-csv", po::value<std::string>(),
+         "Write GPU time of each rendering pass per scene into a CSV file.")
+        ("headless", "Render offscreen through EGL without a window, audio or input, print timing and exit.")
         ("help,h", "Print help text.")
+        ("perf-counters", "Report hardware performance counters for each precalc stage.")
+        ("params", po::value<std::string>(),
+         "Read precalc parameters from file, changes regenerate affected assets (created if missing).")
+        ("precalc-cache", po::value<std::string>(),
+         "Directory for caching Saturn bands and rings, warm starts skip the fluid simulation and ring decoding.")
+        ("precalc-nice", po::value<int>(), "Nice value for precalc and synth threads (default: 10).")
         ("record,R", "Do not play intro normally, instead save frames as .png -files.")
+        ("reserve-cores", po::value<int>(),
+         "Cores to keep free of precalc for render and audio threads, 0 to disable (default: automatic).")
+        ("residency", po::value<int>(),
+         "Reduce textures not used within given milliseconds to 1/8 resolution, 0 to disable (default: 0).")
         ("resolution,r", po::value<std::string>(), "Resolution to use, specify as 'WIDTHxHEIGHT' or 'HEIGHTp'.")
+        ("upload-budget", po::value<int>(), "Milliseconds per frame for uploading precalc results (default: 4).")
+        ("verify-fast-math", "Verify fast math functions against libm and exit.")
+        ("verify-fluid-compute", "Verify compute shader fluid steps against fragment passes and exit.")
+        ("verify-fluid-cpu", "Verify CPU fluid steps against GPU fluid steps and exit.")
+        ("verify-gpu-precalc", "Verify compute shader cube maps against CPU precalc and exit.")
+        ("verify-precalc-cache", "Recalculate results found in the precalc cache and compare them against it.")
         ("window,w", "Start in window instead of full-screen.");
 
       po::variables_map vmap;
       po::store(po::command_line_parser(argc, argv).options(desc).run(), vmap);
       po::notify(vmap);
 
+      if(vmap.count("benchmark"))
+      {
+        benchmark = true;
+      }
+      if(vmap.count("benchmark-filter"))
+      {
+        benchmark_filter = vmap["benchmark-filter"].as<std::string>();
+      }
+      if(vmap.count("benchmark-out"))
+      {
+        benchmark_out = vmap["benchmark-out"].as<std::string>();
+      }
+      if(vmap.count("cpu-level"))
+      {
+        cpu_level = cpu_level_parse(vmap["cpu-level"].as<std::string>());
+      }
       if(vmap.count("developer"))
       {
         g_flag_developer = true;
       }
+      if(vmap.count("fluid-budget"))
+      {
+        g_fluid_budget = vmap["fluid-budget"].as<int>();
+      }
+      if(vmap.count("fluid-compute"))
+      {
+        g_fluid_compute = true;
+      }
+      if(vmap.count("fluid-cpu"))
+      {
+        g_fluid_cpu = true;
+      }
+      if(vmap.count("fluid-cpu-cache"))
+      {
+        g_fluid_cpu = true;
+        g_fluid_cpu_cache = true;
+      }
+      if(vmap.count("fluid-format"))
+      {
+        g_fluid_format = fluid_format_parse(vmap["fluid-format"].as<std::string>());
+      }
+      if(vmap.count("fluid-multigrid"))
+      {
+        g_fluid_multigrid = true;
+      }
+      if(vmap.count("fluid-residual"))
+      {
+        g_fluid_residual = true;
+      }
+      if(vmap.count("fluid-size"))
+      {
+        g_fluid_side = vmap["fluid-size"].as<unsigned>();
+        if(!g_fluid_side || (g_fluid_side % 32) || (g_fluid_side > FLUID_WIDTH))
+        {
+          std::ostringstream sstr;
+          sstr << "fluid size " << g_fluid_side << " is not a multiple of 32 up to " << FLUID_WIDTH;
+          BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+        }
+      }
+      if(vmap.count("full-precalc"))
+      {
+        g_precalc_progressive = false;
+      }
+      if(vmap.count("gpu-precalc"))
+      {
+        g_precalc_cube_mode = PRECALC_CUBE_GPU;
+      }
+      if(vmap.count("gpu-profile"))
+      {
+        g_gpu_profile = true;
+      }
+      if(vmap.count("gpu-profile-csv"))
+      {
+        g_gpu_profile_csv = vmap["gpu-profile-csv"].as<std::string>();
+      }
+      if(vmap.count("headless"))
+      {
+        g_headless = true;
+      }
       if(vmap.count("help"))
       {
         std::cout << usage << desc << std::endl;
         return 0;
       }
+      if(vmap.count("params"))
+      {
+        g_precalc_params_filename = vmap["params"].as<std::string>();
+      }
+      if(vmap.count("perf-counters"))
+      {
+#if defined(PERF_COUNTERS)
+        g_perf_enabled = true;
+#else
+        std::cerr << "performance counters not available on this platform" << std::endl;
+#endif
+      }
+      if(vmap.count("precalc-cache"))
+      {
+        g_precalc_cache_dir = vmap["precalc-cache"].as<std::string>();
+      }
+      if(vmap.count("precalc-nice"))
+      {
+        g_thread_precalc_nice = vmap["precalc-nice"].as<int>();
+      }
       if(vmap.count("record"))
       {
         record = true;
       }
+      if(vmap.count("reserve-cores"))
+      {
+        g_thread_reserved_cores = vmap["reserve-cores"].as<int>();
+      }
+      if(vmap.count("residency"))
+      {
+        g_residency_lookahead = vmap["residency"].as<int>();
+      }
       if(vmap.count("resolution"))
       {
         boost::tie(screen_w, screen_h) = parse_resolution(vmap["resolution"].as<std::string>());
       }
+      if(vmap.count("upload-budget"))
+      {
+        g_upload_budget = vmap["upload-budget"].as<int>();
+      }
+      if(vmap.count("verify-fast-math"))
+      {
+        return fast_math_verify() ? 0 : 1;
+      }
+      if(vmap.count("verify-fluid-compute"))
+      {
+        g_fluid_compute_verify = true;
+      }
+      if(vmap.count("verify-fluid-cpu"))
+      {
+        g_fluid_cpu_verify = true;
+      }
+      if(vmap.count("verify-gpu-precalc"))
+      {
+        g_precalc_cube_mode = PRECALC_CUBE_VERIFY;
+      }
+      if(vmap.count("verify-precalc-cache"))
+      {
+        g_precalc_cache_verify = true;
+      }
       if(vmap.count("window"))
       {
         fullscreen = false;
       }
+
+      if(g_fluid_cpu_cache && g_precalc_cache_dir.empty())
+      {
+        BOOST_THROW_EXCEPTION(std::runtime_error("--fluid-cpu-cache needs --precalc-cache"));
+      }
+      if((g_fluid_format != FLUID_FORMAT_FLOAT) && (g_fluid_compute || g_fluid_compute_verify ||
+            g_fluid_cpu_verify || g_fluid_multigrid || g_fluid_residual))
+      {
+        std::ostringstream sstr;
+        sstr << "fluid format '" << fluid_format_name(g_fluid_format) <<
+          "' does not work with compute, multigrid, residual or verification paths, use '" <<
+          fluid_format_name(FLUID_FORMAT_FLOAT) << "'";
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
     }
 
+    cpu_initialize(cpu_level);
+    if(benchmark)
+    {
+      benchmark_run_all(benchmark_filter, benchmark_out);
+      return 0;
+    }
     intro(screen_w, screen_h, fullscreen, record);
   }
 #if !defined(DEBUG)
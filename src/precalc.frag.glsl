@@ -6,6 +6,7 @@ const int DYE = 2;
 const int PRESSURE = 3;
 const int VX = 4;
 const int VY = 5;
+const int CAPTURE = 6;
 
 in vec2 texcoord;
 
@@ -37,6 +38,12 @@ void main()
     float vy = texture(tex, texcoord).g;
     output_color = vec4(vy, -vy, 0.0, 1.0);
   }
+  // Quantize dye like a signed byte readback, for Saturn bands.
+  else if(control==CAPTURE)
+  {
+    vec3 dye = round(clamp(texture(tex, texcoord).rgb, -1.0, 1.0) * 127.0);
+    output_color = vec4(max(dye, 0.0) / 255.0, 1.0);
+  }
   // Show texture as-is.
   else
   {
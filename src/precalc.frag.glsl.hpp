@@ -4,7 +4,7 @@ static const char *g_shader_fragment_precalc = ""
 #else
 "layout(location=0)uniform int m;"
 "layout(location=5)uniform sampler2D u;"
-"int A=1,U=2,L=3,T=4,N=5;"
+"int A=1,U=2,L=3,T=4,N=5,R=6;"
 "in vec2 e;"
 "out vec4 o;"
 "void main()"
@@ -30,6 +30,11 @@ static const char *g_shader_fragment_precalc = ""
 "float t=texture(u,e).t;"
 "o=vec4(t,-t,.0,1.);"
 "}"
+"else if(m==R)"
+"{"
+"vec3 t=round(clamp(texture(u,e).stp,-1.,1.)*127.);"
+"o=vec4(max(t,.0)/255.,1.);"
+"}"
 "else o=texture(u,e);"
 "}"
 #endif
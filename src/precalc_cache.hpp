@@ -0,0 +1,309 @@
+#ifndef PRECALC_CACHE_HPP
+#define PRECALC_CACHE_HPP
+
+#if defined(USE_LD)
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+/// Directory for cached precalc results, empty to disable the cache.
+static std::string g_precalc_cache_dir;
+
+/// Recalculate cached precalc results anyway and compare them against the cache.
+static bool g_precalc_cache_verify = false;
+
+/// Cache key built from everything a precalc result depends on.
+///
+/// 64-bit FNV-1a hash.
+class PrecalcCacheKey
+{
+  private:
+    /// Hash state.
+    uint64_t m_hash;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param version Version of the calculation, bump when code the key can not see changes.
+    explicit PrecalcCacheKey(unsigned version) :
+      m_hash(0xcbf29ce484222325ull)
+    {
+      add(version);
+    }
+
+  public:
+    /// Add raw data.
+    ///
+    /// \param data Data.
+    /// \param size Size in bytes.
+    void add(const void* data, size_t size)
+    {
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+      for(size_t ii = 0; (ii < size); ++ii)
+      {
+        m_hash = (m_hash ^ bytes[ii]) * 0x100000001b3ull;
+      }
+    }
+
+    /// Add an integer.
+    ///
+    /// \param op Value.
+    void add(unsigned op)
+    {
+      add(&op, sizeof(op));
+    }
+
+    /// Add shader source.
+    ///
+    /// \param name Shader file name.
+    void addShader(const char* name)
+    {
+      std::string source = GlslShader::read_source(name);
+      add(source.data(), source.size());
+    }
+
+    /// Add image contents.
+    ///
+    /// \param img Image.
+    void addImage(Image& img)
+    {
+      uarr<uint8_t> data = img.getExportData(4);
+      add(img.getChannelCount());
+      add(data.get(), img.getElementCount() * sizeof(float));
+    }
+
+    /// Accessor.
+    ///
+    /// \return Hash value.
+    uint64_t get() const
+    {
+      return m_hash;
+    }
+};
+
+/// Cached precalc result.
+///
+/// Results are stored as 8-bit texels ready for upload. A stale key or a corrupt file is a cache miss, the
+/// result is then calculated and written again.
+class PrecalcCacheEntry
+{
+  private:
+    /// File magic, "PCC1".
+    static const uint32_t MAGIC = 0x31434350;
+
+  private:
+    /// Name for reporting.
+    std::string m_name;
+
+    /// Cache file.
+    boost::filesystem::path m_filename;
+
+    /// Key of the result.
+    uint64_t m_key;
+
+    /// Width of cached result.
+    unsigned m_width;
+
+    /// Height of cached result.
+    unsigned m_height;
+
+    /// Channel count of cached result.
+    unsigned m_channels;
+
+    /// Cached texels, empty if nothing was read.
+    std::vector<uint8_t> m_data;
+
+  private:
+    /// Deleted copy constructor.
+    PrecalcCacheEntry(const PrecalcCacheEntry&) = delete;
+    /// Deleted assignment.
+    PrecalcCacheEntry& operator=(const PrecalcCacheEntry&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param name Result name, also names the cache file.
+    /// \param key Key of the result.
+    explicit PrecalcCacheEntry(const std::string& name, const PrecalcCacheKey& key) :
+      m_name(name),
+      m_filename(boost::filesystem::path(g_precalc_cache_dir) / (name + ".cache")),
+      m_key(key.get()),
+      m_width(0),
+      m_height(0),
+      m_channels(0)
+    {
+    }
+
+  private:
+    /// Checksum of texels.
+    ///
+    /// \param data Texels.
+    /// \param size Size in bytes.
+    /// \return Checksum.
+    static uint64_t checksum(const uint8_t* data, size_t size)
+    {
+      PrecalcCacheKey ret(0);
+      ret.add(data, size);
+      return ret.get();
+    }
+
+  public:
+    /// Accessor.
+    ///
+    /// \return Width of cached result.
+    unsigned getWidth() const
+    {
+      return m_width;
+    }
+
+    /// Accessor.
+    ///
+    /// \return Height of cached result.
+    unsigned getHeight() const
+    {
+      return m_height;
+    }
+
+    /// Accessor.
+    ///
+    /// \return Channel count of cached result.
+    unsigned getChannelCount() const
+    {
+      return m_channels;
+    }
+
+    /// Accessor.
+    ///
+    /// \return Cached texels.
+    uint8_t* getData()
+    {
+      return m_data.data();
+    }
+
+    /// Read the result from the cache.
+    ///
+    /// \return True if a result with a matching key was read, false on a cache miss.
+    bool read()
+    {
+      std::ifstream fd(m_filename.string().c_str(), std::ios::binary);
+      if(!fd)
+      {
+        return false;
+      }
+
+      uint32_t magic = 0;
+      uint64_t key = 0;
+      uint32_t dimensions[3] = { 0, 0, 0 };
+      uint64_t sum = 0;
+      fd.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+      fd.read(reinterpret_cast<char*>(&key), sizeof(key));
+      fd.read(reinterpret_cast<char*>(dimensions), sizeof(dimensions));
+      fd.read(reinterpret_cast<char*>(&sum), sizeof(sum));
+      if(!fd || (MAGIC != magic) || (m_key != key))
+      {
+        std::cout << "precalc cache " << m_name << ": stale" << std::endl;
+        return false;
+      }
+
+      std::vector<uint8_t> data(dimensions[0] * dimensions[1] * dimensions[2]);
+      fd.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+      if(!fd || (checksum(data.data(), data.size()) != sum))
+      {
+        std::cout << "precalc cache " << m_name << ": corrupt" << std::endl;
+        return false;
+      }
+
+      m_width = dimensions[0];
+      m_height = dimensions[1];
+      m_channels = dimensions[2];
+      m_data.swap(data);
+      std::cout << "precalc cache " << m_name << ": hit" << std::endl;
+      return true;
+    }
+
+    /// Store a calculated result into the cache.
+    ///
+    /// If a result was read from the cache, it is compared against the calculated result first.
+    ///
+    /// \param width Width.
+    /// \param height Height.
+    /// \param channels Channel count.
+    /// \param data Texels.
+    /// \return False if a result read from the cache does not match, true otherwise.
+    bool write(unsigned width, unsigned height, unsigned channels, const uint8_t* data)
+    {
+      size_t size = width * height * channels;
+      bool ret = true;
+
+      if(!m_data.empty())
+      {
+        ret = compare(width, height, channels, data);
+      }
+
+      boost::system::error_code err;
+      boost::filesystem::create_directories(m_filename.parent_path(), err);
+      std::ofstream fd(m_filename.string().c_str(), std::ios::binary);
+      if(!fd)
+      {
+        // Results may be stored from precalc threads, a missing cache is not worth stopping for.
+        std::cerr << "could not write precalc cache file " << m_filename << std::endl;
+        return ret;
+      }
+
+      uint32_t magic = MAGIC;
+      uint32_t dimensions[3] = { width, height, channels };
+      uint64_t sum = checksum(data, size);
+      fd.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+      fd.write(reinterpret_cast<const char*>(&m_key), sizeof(m_key));
+      fd.write(reinterpret_cast<const char*>(dimensions), sizeof(dimensions));
+      fd.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+      fd.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+      return ret;
+    }
+
+  private:
+    /// Compare a calculated result against the cached result and report.
+    ///
+    /// \param width Width.
+    /// \param height Height.
+    /// \param channels Channel count.
+    /// \param data Texels.
+    /// \return True if results match.
+    bool compare(unsigned width, unsigned height, unsigned channels, const uint8_t* data) const
+    {
+      if((width != m_width) || (height != m_height) || (channels != m_channels))
+      {
+        std::cout << "precalc cache " << m_name << ": MISMATCH, cached " << m_width << "x" << m_height << "x" <<
+          m_channels << ", calculated " << width << "x" << height << "x" << channels << std::endl;
+        return false;
+      }
+
+      unsigned differ = 0;
+      int max_difference = 0;
+      for(size_t ii = 0; (ii < m_data.size()); ++ii)
+      {
+        int difference = std::abs(static_cast<int>(m_data[ii]) - static_cast<int>(data[ii]));
+        if(difference)
+        {
+          max_difference = std::max(difference, max_difference);
+          ++differ;
+        }
+      }
+
+      std::cout << "precalc cache " << m_name << ": " << (differ ? "MISMATCH" : "match") << ", " << differ <<
+        " of " << m_data.size() << " bytes differ, max difference " << max_difference << std::endl;
+      return !differ;
+    }
+};
+
+#endif
+
+#endif
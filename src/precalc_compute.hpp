@@ -0,0 +1,419 @@
+#ifndef PRECALC_COMPUTE_HPP
+#define PRECALC_COMPUTE_HPP
+
+#include "global_data_temporary.hpp"
+
+/// Generates precalc cube maps with compute shaders.
+///
+/// Texels match the CPU functions of GlobalDataTemporary. Inputs (noise, stars, craters, carved heights) are
+/// still generated on the CPU. Trail is not supported, it is a single sequential random walk.
+class PrecalcCompute
+{
+  private:
+    /// Work group size in both image dimensions, must match the shader.
+    static const unsigned GROUP_SIZE = 8;
+
+    /// Star cells per cube map side, must match the shader.
+    static const unsigned STAR_CELLS = 64 * 64;
+
+    /// Largest difference from the CPU not reported as a mismatch.
+    static constexpr float VERIFY_TOLERANCE = 2.0f / 255.0f;
+
+    /// Fraction of texels that may mismatch.
+    static constexpr float VERIFY_MISMATCH_RATIO = 0.001f;
+
+    /// Fraction of space texels that may mismatch.
+    ///
+    /// Star radius is only a few dozen float ulps below 1, so rounding differences in normalization and dot
+    /// products move star edges visibly.
+    static constexpr float VERIFY_MISMATCH_RATIO_SPACE = 0.01f;
+
+    /// Shader storage buffers, values are binding points.
+    enum Buffer
+    {
+      BUFFER_NOISE_2D = 0,
+      BUFFER_NOISE_3D,
+      BUFFER_STARS,
+      BUFFER_STAR_CELLS,
+      BUFFER_CRATERS,
+      BUFFER_HEIGHTS,
+      BUFFER_HEIGHT_RANGE,
+      BUFFER_COUNT
+    };
+
+    /// Shader modes.
+    enum Mode
+    {
+      MODE_SPACE = 0,
+      MODE_ENCELADUS,
+      MODE_TETHYS,
+      MODE_NORMALIZE
+    };
+
+    /// Uniform location.
+    static const GLint UNIFORM_MODE = 0;
+    /// Uniform location.
+    static const GLint UNIFORM_SIDE = 1;
+    /// Uniform location.
+    static const GLint UNIFORM_NOISE_2D_SIZE = 2;
+    /// Uniform location.
+    static const GLint UNIFORM_NOISE_3D_SIZE = 3;
+    /// Uniform location.
+    static const GLint UNIFORM_NOISE_OCTAVES = 4;
+    /// Uniform location.
+    static const GLint UNIFORM_CRATER_COUNT = 5;
+    /// Uniform location.
+    static const GLint UNIFORM_NOISE_HEIGHT_MUL = 6;
+    /// Uniform location.
+    static const GLint UNIFORM_MILKY_WAY_PARAMS = 7;
+
+  private:
+    /// Compute program.
+    GlslProgram m_program;
+
+    /// Shader storage buffers.
+    GLuint m_buffers[BUFFER_COUNT];
+
+  private:
+    /// Deleted copy constructor.
+    PrecalcCompute(const PrecalcCompute&) = delete;
+    /// Deleted assignment.
+    PrecalcCompute& operator=(const PrecalcCompute&) = delete;
+
+  public:
+    /// Constructor.
+    PrecalcCompute()
+    {
+      m_program.addShader(GL_COMPUTE_SHADER, g_shader_compute_precalc_cube);
+      if(!m_program.link())
+      {
+        std::ostringstream sstr;
+        sstr << "compute program creation failure: " << m_program.getName();
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+
+      glGenBuffers(BUFFER_COUNT, m_buffers);
+      for(unsigned ii = 0; (ii < BUFFER_COUNT); ++ii)
+      {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ii, m_buffers[ii]);
+      }
+    }
+
+    /// Destructor.
+    ~PrecalcCompute()
+    {
+      glDeleteBuffers(BUFFER_COUNT, m_buffers);
+    }
+
+  private:
+    /// Fill a shader storage buffer.
+    ///
+    /// \param op Buffer.
+    /// \param size Size in bytes.
+    /// \param data Data, may be NULL.
+    void bufferData(Buffer op, size_t size, const void* data)
+    {
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffers[op]);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(size), data, GL_STATIC_DRAW);
+    }
+
+    /// Fill a shader storage buffer with image data.
+    ///
+    /// \param op Buffer.
+    /// \param img Single-channel image.
+    void bufferImage(Buffer op, Image& img)
+    {
+      uarr<uint8_t> data = img.getExportData(4);
+      bufferData(op, img.getElementCount() * sizeof(float), data.get());
+    }
+
+    /// Fill the star buffers.
+    ///
+    /// \param tree Star location tree.
+    void bufferStars(const StarLocationTree& tree)
+    {
+      std::vector<float> stars;
+      std::vector<unsigned> cells;
+
+      for(unsigned ii = 0; (ii <= StarLocationSide::POS_Z); ++ii)
+      {
+        const StarLocationSide& side = tree.getSide(static_cast<StarLocationSide::Bin>(ii));
+        if(side.getCellCount() != STAR_CELLS)
+        {
+          std::ostringstream sstr;
+          sstr << "star side has " << side.getCellCount() << " cells, compute shader expects " << STAR_CELLS;
+          BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+        }
+
+        for(unsigned jj = 0; (jj < STAR_CELLS); ++jj)
+        {
+          cells.push_back(static_cast<unsigned>(stars.size() / 8));
+          for(const StarLocation& vv : side.getCell(jj))
+          {
+            const vec3& dir = vv.getDirection();
+            float star[] = { dir[0], dir[1], dir[2], vv.getRadius(), vv.getLuminosity(), 0.0f, 0.0f, 0.0f };
+            stars.insert(stars.end(), star, star + 8);
+          }
+        }
+      }
+      cells.push_back(static_cast<unsigned>(stars.size() / 8));
+
+      // Empty buffers are not allowed.
+      stars.resize(std::max(stars.size(), static_cast<size_t>(8)), 0.0f);
+
+      bufferData(BUFFER_STARS, stars.size() * sizeof(float), &(stars[0]));
+      bufferData(BUFFER_STAR_CELLS, cells.size() * sizeof(unsigned), &(cells[0]));
+    }
+
+    /// Fill the crater buffer.
+    ///
+    /// \param craters Crater map.
+    void bufferCraters(const CraterMap& craters)
+    {
+      std::vector<float> data;
+
+      for(const Crater& vv : craters.getCraters())
+      {
+        const vec3& center = vv.getCenter();
+        float crater[] = { center[0], center[1], center[2], vv.getRadius() };
+        data.insert(data.end(), crater, crater + 4);
+      }
+
+      // Empty buffers are not allowed.
+      data.resize(std::max(data.size(), static_cast<size_t>(4)), 0.0f);
+
+      bufferData(BUFFER_CRATERS, data.size() * sizeof(float), &(data[0]));
+      glUniform1ui(UNIFORM_CRATER_COUNT, craters.getCraters().size());
+    }
+
+    /// Run the shader over all sides.
+    ///
+    /// \param mode Mode.
+    /// \param side Cube map side.
+    void dispatch(Mode mode, unsigned side)
+    {
+      unsigned groups = (side + GROUP_SIZE - 1) / GROUP_SIZE;
+
+      glUniform1i(UNIFORM_MODE, mode);
+      glDispatchCompute(groups, groups, 6);
+    }
+
+    /// Generate a moon.
+    ///
+    /// \param mode Mode.
+    /// \param data Temporary data.
+    /// \param craters Crater map.
+    /// \param heights Heights carved by crawlers, NULL for none.
+    /// \param noise_height_mul Noise height multiplier.
+    /// \param tex Target texture.
+    void generateMoon(Mode mode, GlobalDataTemporary& data, const CraterMap& craters, const float* heights,
+        float noise_height_mul, TextureCube& tex)
+    {
+      const unsigned side = data.getCubeMapSideMoon();
+      const GLuint HEIGHT_RANGE_EMPTY[] = { 0xFFFFFFFFu, 0u };
+
+      tex.allocate(side, GL_RGBA16);
+      glBindImageTexture(1, tex.getId(), 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16);
+
+      bufferImage(BUFFER_NOISE_3D, data.noise_3d_hq);
+      bufferCraters(craters);
+      bufferData(BUFFER_HEIGHTS, side * side * 6 * sizeof(float), heights);
+      bufferData(BUFFER_HEIGHT_RANGE, sizeof(HEIGHT_RANGE_EMPTY), HEIGHT_RANGE_EMPTY);
+
+      glUniform1ui(UNIFORM_NOISE_3D_SIZE, data.noise_3d_hq.getWidth());
+      glUniform1ui(UNIFORM_NOISE_OCTAVES, data.getParams().noise_octaves);
+      glUniform1f(UNIFORM_NOISE_HEIGHT_MUL, noise_height_mul);
+      dispatch(mode, side);
+
+      // Normalization needs all heights.
+      glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+      dispatch(MODE_NORMALIZE, side);
+    }
+
+  public:
+    /// Generate a cube map into a texture.
+    ///
+    /// The CPU image of the asset is not used except for heights carved into Enceladus.
+    ///
+    /// \param asset Asset, trail is not supported.
+    /// \param data Temporary data with inputs ready.
+    /// \param tex Target texture.
+    void generate(PrecalcAsset asset, GlobalDataTemporary& data, TextureCube& tex)
+    {
+      const PrecalcParams& params = data.getParams();
+
+      glUseProgram(m_program.getId());
+      glUniform1ui(UNIFORM_SIDE, (PRECALC_ASSET_SPACE == asset) ? data.getCubeMapSide() :
+          data.getCubeMapSideMoon());
+
+      switch(asset)
+      {
+        case PRECALC_ASSET_SPACE:
+          {
+            const unsigned side = data.getCubeMapSide();
+
+            tex.allocate(side, GL_RGBA8);
+            glBindImageTexture(0, tex.getId(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+            bufferImage(BUFFER_NOISE_2D, data.noise_2d);
+            bufferStars(data.star_tree);
+            glUniform1ui(UNIFORM_NOISE_2D_SIZE, data.noise_2d.getWidth());
+            glUniform2f(UNIFORM_MILKY_WAY_PARAMS, params.milky_way_intensity, params.milky_way_width);
+            dispatch(MODE_SPACE, side);
+          }
+          break;
+
+        case PRECALC_ASSET_ENCELADUS:
+          if(data.enceladus_carved.empty())
+          {
+            std::vector<float> carved(data.getCubeMapSideMoon() * data.getCubeMapSideMoon() * 6);
+            data.enceladus->getChannelData(3, &(carved[0]));
+            generateMoon(MODE_ENCELADUS, data, data.craters_enceladus, &(carved[0]),
+                params.enceladus_noise_height, tex);
+          }
+          else
+          {
+            generateMoon(MODE_ENCELADUS, data, data.craters_enceladus, data.enceladus_carved.getData(),
+                params.enceladus_noise_height, tex);
+          }
+          break;
+
+        case PRECALC_ASSET_TETHYS:
+          generateMoon(MODE_TETHYS, data, data.craters_tethys, NULL, params.tethys_noise_height, tex);
+          break;
+
+        default:
+          {
+            std::ostringstream sstr;
+            sstr << "precalc asset " << asset << " can not be generated with compute shaders";
+            BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+          }
+      }
+
+      glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+      tex.updateFiltering();
+
+      // Rendering uses program pipelines, which a current program would override.
+      glUseProgram(0);
+    }
+
+  private:
+    /// Compare a generated texture against a CPU image.
+    ///
+    /// \param name Asset name for reporting.
+    /// \param tex Generated texture.
+    /// \param img CPU image.
+    /// \param bpc Bytes per component of the texture.
+    /// \param mismatch_ratio Fraction of texels that may mismatch.
+    /// \return True if the texture matches.
+    template<typename T> static bool compare(const char* name, const TextureCube& tex, ImageCube<T>& img,
+        unsigned bpc, float mismatch_ratio)
+    {
+      T* sides[] =
+      {
+        &img.getSideNegX(), &img.getSidePosX(), &img.getSideNegY(),
+        &img.getSidePosY(), &img.getSideNegZ(), &img.getSidePosZ()
+      };
+      unsigned channels = img.getSideNegX().getChannelCount();
+      unsigned side = img.getSideNegX().getWidth();
+      float max_value = (bpc == 2) ? 65535.0f : 255.0f;
+      std::vector<uint8_t> texels(side * side * 4 * bpc);
+      float max_error = 0.0f;
+      unsigned mismatches = 0;
+
+      tex.bind(0);
+      glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+      for(unsigned ii = 0; (ii < 6); ++ii)
+      {
+        // GL sides are ordered +X, -X, +Y, -Y, +Z, -Z.
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + (ii ^ 1), 0, GL_RGBA,
+            (bpc == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, &(texels[0]));
+        uarr<uint8_t> expected = sides[ii]->getExportData(bpc);
+
+        for(unsigned jj = 0; (jj < side * side); ++jj)
+        {
+          float texel_error = 0.0f;
+          for(unsigned kk = 0; (kk < channels); ++kk)
+          {
+            unsigned gpu_idx = jj * 4 + kk;
+            unsigned cpu_idx = jj * channels + kk;
+            float gpu = (bpc == 2) ? reinterpret_cast<const uint16_t*>(&(texels[0]))[gpu_idx] : texels[gpu_idx];
+            float cpu = (bpc == 2) ? reinterpret_cast<const uint16_t*>(expected.get())[cpu_idx] :
+              expected[cpu_idx];
+            texel_error = std::max(std::abs(gpu - cpu) / max_value, texel_error);
+          }
+          max_error = std::max(texel_error, max_error);
+          if(texel_error > VERIFY_TOLERANCE)
+          {
+            ++mismatches;
+          }
+        }
+      }
+
+      unsigned texel_count = side * side * 6;
+      bool ret = (static_cast<float>(mismatches) <= static_cast<float>(texel_count) * mismatch_ratio);
+      std::cout << name << ": " << (ret ? "match" : "MISMATCH") << ", " << mismatches << "/" << texel_count <<
+        " texels off by more than " << VERIFY_TOLERANCE << ", max error " << max_error << std::endl;
+      return ret;
+    }
+
+  public:
+    /// Compare compute shader cube maps against CPU precalc.
+    ///
+    /// Takes assets from temporary data as they become ready, CPU images are freed after comparison.
+    ///
+    /// \param data Temporary data with precalc started in verification mode.
+    /// \return True if all cube maps match.
+    bool verify(GlobalDataTemporary& data)
+    {
+      bool ret = true;
+
+      while(!data.isDone())
+      {
+        PrecalcAsset asset;
+        if(!data.takeAsset(asset))
+        {
+          dnload_SDL_Delay(10);
+          continue;
+        }
+
+        if(PRECALC_ASSET_TRAIL == asset)
+        {
+          data.trail.reset();
+          data.releaseAsset();
+          continue;
+        }
+
+        TextureCube tex;
+        int start_ticks = get_current_ticks();
+        generate(asset, data, tex);
+        glFinish();
+        std::cout << "compute precalc took " << (get_current_ticks() - start_ticks) << " ms, ";
+
+        switch(asset)
+        {
+          case PRECALC_ASSET_SPACE:
+            ret = compare("space", tex, *(data.space), 1, VERIFY_MISMATCH_RATIO_SPACE) && ret;
+            data.space.reset();
+            break;
+
+          case PRECALC_ASSET_ENCELADUS:
+            ret = compare("enceladus", tex, *(data.enceladus), 2, VERIFY_MISMATCH_RATIO) && ret;
+            data.enceladus.reset();
+            break;
+
+          case PRECALC_ASSET_TETHYS:
+          default:
+            ret = compare("tethys", tex, *(data.tethys), 2, VERIFY_MISMATCH_RATIO) && ret;
+            data.tethys.reset();
+            break;
+        }
+        data.releaseAsset();
+      }
+
+      return ret;
+    }
+};
+
+#endif
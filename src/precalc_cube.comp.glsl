@@ -0,0 +1,508 @@
+#version 430
+
+/// Precalc cube map generation.
+///
+/// Calculates the same texels as the CPU functions in GlobalDataTemporary. One invocation calculates one texel,
+/// the third dispatch dimension selects the side in CPU order -X, +X, -Y, +Y, -Z, +Z.
+///
+/// Standalone, does not use the common header.
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+/// Space output.
+layout(binding = 0, rgba8) writeonly uniform imageCube space_image;
+/// Moon output, color and normalized height.
+layout(binding = 1, rgba16) uniform imageCube moon_image;
+
+/// 2D noise, row by row.
+layout(std430, binding = 0) readonly buffer Noise2D
+{
+  float noise_2d[];
+};
+/// 3D noise, slice by slice.
+layout(std430, binding = 1) readonly buffer Noise3D
+{
+  float noise_3d[];
+};
+/// Two elements per star: direction and radius, luminosity.
+layout(std430, binding = 2) readonly buffer Stars
+{
+  vec4 stars[];
+};
+/// First star of every star cell, one extra element to terminate the last cell.
+layout(std430, binding = 3) readonly buffer StarCells
+{
+  uint star_cells[];
+};
+/// Crater center and radius.
+layout(std430, binding = 4) readonly buffer Craters
+{
+  vec4 craters[];
+};
+/// Moon heights, initially heights carved by crawlers if any.
+layout(std430, binding = 5) buffer Heights
+{
+  float heights[];
+};
+/// Moon height minimum and maximum as ordered integers.
+layout(std430, binding = 6) buffer HeightRange
+{
+  uint height_range[2];
+};
+
+/// Mode: 0 = space, 1 = Enceladus, 2 = Tethys, 3 = normalize moon heights.
+layout(location = 0) uniform int mode;
+/// Cube map side length.
+layout(location = 1) uniform uint side;
+/// 2D noise side length.
+layout(location = 2) uniform uint noise_2d_size;
+/// 3D noise side length.
+layout(location = 3) uniform uint noise_3d_size;
+/// Noise octaves for moons.
+layout(location = 4) uniform uint noise_octaves;
+/// Number of craters.
+layout(location = 5) uniform uint crater_count;
+/// Noise height multiplier for moons.
+layout(location = 6) uniform float noise_height_mul;
+/// Milky way intensity and width.
+layout(location = 7) uniform vec2 milky_way_params;
+
+/// Star cell subdivisions per side, must match StarLocationSide.
+const int STAR_SUBDIVISIONS = 64;
+
+/// Noise rotation for moons.
+const mat3 NOISE_ROTATION = mat3(-0.99, -0.16, 0.02, 0.14, -0.77, 0.63, -0.08, 0.62, 0.78);
+
+/// Shared height minimum for the work group.
+shared uint group_min;
+/// Shared height maximum for the work group.
+shared uint group_max;
+
+/// Congruence function.
+/// \param val Value.
+/// \return Value in [0, 1[.
+float congr(float val)
+{
+  if(0.0 <= val)
+  {
+    return mod(val, 1.0);
+  }
+  return 1.0 - mod(-val, 1.0);
+}
+
+/// Smooth step, edges may be in either order.
+/// \param edge0 First edge.
+/// \param edge1 Second edge.
+/// \param value Value.
+/// \return Smoothly stepped value.
+float smooth_step(float edge0, float edge1, float value)
+{
+  float ret = clamp((value - edge0) / (edge1 - edge0), 0.0, 1.0);
+  return ret * ret * (3.0 - 2.0 * ret);
+}
+
+/// Smooth mix.
+/// \param lhs Left-hand-side operand.
+/// \param rhs Right-hand-side operand.
+/// \param ratio Mixing ratio.
+/// \return Mixed value.
+float smooth_mix(float lhs, float rhs, float ratio)
+{
+  return lhs + (rhs - lhs) * smooth_step(0.0, 1.0, ratio);
+}
+
+/// Hyperbolic tangent that does not overflow.
+/// \param op Value.
+/// \return Hyperbolic tangent.
+float tanh_clamped(float op)
+{
+  return tanh(clamp(op, -10.0, 10.0));
+}
+
+/// Find texel and fraction for noise sampling.
+/// \param coord Coordinate.
+/// \param size Noise side length.
+/// \param texel [out] Texel.
+/// \return Fraction towards next texel.
+float noise_texel(float coord, uint size, out uint texel)
+{
+  float cc = congr(coord) * float(size);
+  texel = uint(cc);
+  // Wrap to 0 if floating point inaccuracy ended up at the side length.
+  if(texel >= size)
+  {
+    texel = 0u;
+    return 0.0;
+  }
+  return cc - float(texel);
+}
+
+/// Sample 2D noise.
+/// \param pos Position.
+/// \return Noise value.
+float sample_noise_2d(vec2 pos)
+{
+  uint x1;
+  uint y1;
+  float fract_x = noise_texel(pos.x, noise_2d_size, x1);
+  float fract_y = noise_texel(pos.y, noise_2d_size, y1);
+  uint x2 = (x1 + 1u) % noise_2d_size;
+  uint y2 = ((y1 + 1u) % noise_2d_size) * noise_2d_size;
+  y1 *= noise_2d_size;
+
+  return smooth_mix(
+      smooth_mix(noise_2d[y1 + x1], noise_2d[y1 + x2], fract_x),
+      smooth_mix(noise_2d[y2 + x1], noise_2d[y2 + x2], fract_x),
+      fract_y);
+}
+
+/// Sample 3D noise.
+/// \param pos Position.
+/// \return Noise value.
+float sample_noise_3d(vec3 pos)
+{
+  uint x1;
+  uint y1;
+  uint z1;
+  float fract_x = noise_texel(pos.x, noise_3d_size, x1);
+  float fract_y = noise_texel(pos.y, noise_3d_size, y1);
+  float fract_z = noise_texel(pos.z, noise_3d_size, z1);
+  uint x2 = (x1 + 1u) % noise_3d_size;
+  uint y2 = ((y1 + 1u) % noise_3d_size) * noise_3d_size;
+  uint z2 = ((z1 + 1u) % noise_3d_size) * noise_3d_size * noise_3d_size;
+  y1 *= noise_3d_size;
+  z1 *= noise_3d_size * noise_3d_size;
+
+  float zz1 = smooth_mix(
+      smooth_mix(noise_3d[z1 + y1 + x1], noise_3d[z1 + y1 + x2], fract_x),
+      smooth_mix(noise_3d[z1 + y2 + x1], noise_3d[z1 + y2 + x2], fract_x),
+      fract_y);
+  float zz2 = smooth_mix(
+      smooth_mix(noise_3d[z2 + y1 + x1], noise_3d[z2 + y1 + x2], fract_x),
+      smooth_mix(noise_3d[z2 + y2 + x1], noise_3d[z2 + y2 + x2], fract_x),
+      fract_y);
+  return smooth_mix(zz1, zz2, fract_z);
+}
+
+/// Octave sum of 2D noise.
+/// \param pos Position.
+/// \return Noise value.
+float sample_noise_2d_octaves(vec2 pos)
+{
+  const float WEIGHTS[9] = float[](0.1, -0.15, 0.2, -0.25, 0.3, -0.35, 0.4, -0.45, 0.5);
+  float ret = sample_noise_2d(pos) * WEIGHTS[0];
+  for(int ii = 1; (ii < 9); ++ii)
+  {
+    pos *= 0.5;
+    ret += sample_noise_2d(pos) * WEIGHTS[ii];
+  }
+  return ret;
+}
+
+/// Octave sum of 3D noise.
+/// \param pos Position.
+/// \return Noise value.
+float sample_noise_3d_octaves(vec3 pos)
+{
+  const float WEIGHTS[9] = float[](0.1, -0.15, 0.2, -0.25, 0.3, -0.35, 0.4, -0.45, 0.5);
+  float ret = sample_noise_3d(pos) * WEIGHTS[0];
+  for(uint ii = 1u; (ii < noise_octaves); ++ii)
+  {
+    pos = NOISE_ROTATION * (pos * 0.5);
+    ret += sample_noise_3d(pos) * WEIGHTS[ii];
+  }
+  return ret;
+}
+
+/// Milky way color.
+/// \param dir Normalized direction.
+/// \param color [out] Color.
+/// \return False if the CPU would calculate NaN, which exports as black.
+bool milky_way(vec3 dir, out vec3 color)
+{
+  color = vec3(0.0);
+
+  vec3 milky_fw = normalize(vec3(1.0, 0.1, -0.2));
+  if(dot(milky_fw, dir) <= 0.0)
+  {
+    return true;
+  }
+
+  vec3 milky_rt = normalize(vec3(0.8, 0.6, 0.1));
+  vec3 milky_up = cross(milky_rt, milky_fw);
+  milky_rt = cross(milky_fw, milky_up);
+
+  vec2 pos = vec2(asin(dot(dir, milky_rt)), asin(dot(dir, milky_up)));
+
+  // Square root of a negative number on the CPU.
+  float overlay_width = 1.0 - abs(pos.x * 1.57);
+  if(overlay_width < 0.0)
+  {
+    return false;
+  }
+
+  float intensity = milky_way_params.x;
+  float width = milky_way_params.y;
+  float ratio = smooth_step(0.8, 0.0, abs(pos.x));
+  vec3 center = vec3(1.0, 1.0, 0.8) * (sample_noise_2d_octaves(pos * 0.7) + 0.1) *
+    smooth_step(0.3 * ratio * width, 0.1 * ratio * width, abs(pos.y)) * ratio * intensity;
+  float ratio2 = sqrt(overlay_width);
+  vec3 overlay = vec3(0.8, 0.8, 1.0) * (sample_noise_2d_octaves(pos + 0.2) + 0.1) *
+    smooth_step(0.2 * ratio2 * width, 0.1 * ratio2 * width, abs(pos.y)) * ratio2 * intensity;
+
+  center = max(center, vec3(0.0));
+  color = center + (max(overlay, vec3(0.0)) - center) * 0.5;
+  return true;
+}
+
+/// Map a coordinate to a star cell.
+/// \param coord Coordinate in [-1, 1].
+/// \return Cell coordinate.
+int star_subdivision(float coord)
+{
+  return min(int((coord + 1.0) * 0.5 * float(STAR_SUBDIVISIONS)), STAR_SUBDIVISIONS - 1);
+}
+
+/// Star luminosity.
+/// \param norm_dir Normalized direction.
+/// \param dir Direction mapped to cube map boundary.
+/// \return Luminosity.
+float star_luminosity(vec3 norm_dir, vec3 dir)
+{
+  float ret = 0.0;
+
+  for(int bin = 0; (bin < 6); ++bin)
+  {
+    vec2 coords = (bin < 2) ? dir.zy : ((bin < 4) ? dir.xz : dir.xy);
+    int ix = star_subdivision(coords.x);
+    int iy = star_subdivision(coords.y);
+    float luminosity = 0.0;
+
+    for(int jj = max(iy - 1, 0); (jj <= min(iy + 1, STAR_SUBDIVISIONS - 1)); ++jj)
+    {
+      for(int ii = max(ix - 1, 0); (ii <= min(ix + 1, STAR_SUBDIVISIONS - 1)); ++ii)
+      {
+        int cell = (bin * STAR_SUBDIVISIONS + jj) * STAR_SUBDIVISIONS + ii;
+        for(uint kk = star_cells[cell]; (kk < star_cells[cell + 1]); ++kk)
+        {
+          vec4 star = stars[kk * 2u];
+          float angle = dot(norm_dir, star.xyz);
+          float lower_bound = 1.0 - star.w;
+          if(angle >= lower_bound)
+          {
+            float strength = (angle - lower_bound) / star.w;
+            luminosity += strength * stars[kk * 2u + 1u].x * strength * strength;
+          }
+        }
+      }
+    }
+
+    ret += luminosity;
+  }
+
+  return ret;
+}
+
+/// Crater form function.
+/// \param op Distance from center, 0 to 1.
+/// \return Height value.
+float crater_func(float op)
+{
+  const float RIMPOINT = 0.25;
+  float stepfunction = 0.5 + tanh_clamped(20.0 * (op - RIMPOINT)) * 0.5;
+  float y1 = (3.0 * op) * (3.0 * op) - 1.0;
+  float y2 = 0.25 * (sin((op - RIMPOINT) * (3.1415927 / (1.0 - RIMPOINT)) + 1.5707964) + 1.0);
+  return stepfunction * y2 + (1.0 - stepfunction) * y1;
+}
+
+/// Height from craters.
+/// \param dir Normalized direction.
+/// \return Height.
+float crater_height(vec3 dir)
+{
+  float height = 0.0;
+  bool found = false;
+
+  for(uint ii = 0u; (ii < crater_count); ++ii)
+  {
+    vec4 crater = craters[ii];
+    float angle = dot(dir, crater.xyz);
+    float lower_bound = 1.0 - crater.w;
+    if(angle > lower_bound)
+    {
+      float dist = 1.0 - min((angle - lower_bound) / crater.w, 1.0);
+      float value = crater_func(dist) * sqrt(sqrt(sqrt(crater.w)));
+      // Newer craters overwrite old ones.
+      height = found ? (dist * height + value) : value;
+      found = true;
+    }
+  }
+
+  return height;
+}
+
+/// Enceladus texel.
+/// \param norm_dir Normalized direction.
+/// \param dir Direction mapped to cube map boundary.
+/// \param crawler_height Height carved by crawlers.
+/// \param color [out] Surface color.
+/// \return Surface height.
+float enceladus_texel(vec3 norm_dir, vec3 dir, float crawler_height, out vec3 color)
+{
+  const float FREQUENCY_MUL_NOISE = 0.27;
+
+  float noise_height = sample_noise_3d_octaves(norm_dir * FREQUENCY_MUL_NOISE) * noise_height_mul;
+  float height_craters = crater_height(norm_dir);
+  float crater_step_abs = smooth_step(-0.61, 0.0, -abs(height_craters));
+  float crater_step_pos = smooth_step(0.0, 0.005, height_craters);
+  float old_height = crawler_height * 0.31;
+  float new_height = noise_height + height_craters *
+    (1.0 + crater_step_pos * tanh_clamped(noise_height * 17.0) * 0.4);
+
+  float noise_color = sample_noise_3d_octaves(dir * FREQUENCY_MUL_NOISE * 1.89) * 0.3 + 0.65;
+  float noise_color_blue = sample_noise_3d_octaves(dir * FREQUENCY_MUL_NOISE * 2.73) * 0.39 + 0.65;
+  float blue_diff = abs(noise_color_blue - noise_color);
+
+  color = vec3(noise_color, noise_color, noise_color + blue_diff * blue_diff);
+  return old_height * crater_step_abs + new_height;
+}
+
+/// Tethys texel.
+/// \param norm_dir Normalized direction.
+/// \param dir Direction mapped to cube map boundary.
+/// \param color [out] Surface color.
+/// \return Surface height.
+float tethys_texel(vec3 norm_dir, vec3 dir, out vec3 color)
+{
+  float height_craters = crater_height(norm_dir);
+  float crater_step_pos = smooth_step(0.0, 0.005, height_craters);
+  float height_noise = sample_noise_3d_octaves(norm_dir * 0.73) * noise_height_mul;
+
+  color = vec3(sample_noise_3d_octaves(dir * 3.1) * 0.5 + 0.5);
+  return height_noise + height_craters * (1.0 + crater_step_pos * tanh_clamped(height_noise * 9.0));
+}
+
+/// Direction mapped to cube map boundary.
+/// \param face Side in CPU order.
+/// \param fi Relative image coordinate X.
+/// \param fj Relative image coordinate Y.
+/// \return Direction.
+vec3 cube_direction(uint face, float fi, float fj)
+{
+  switch(face)
+  {
+    case 0u:
+      return vec3(-1.0, 1.0 - fj, -1.0 + fi);
+
+    case 1u:
+      return vec3(1.0, 1.0 - fj, 1.0 - fi);
+
+    case 2u:
+      return vec3(-1.0 + fi, -1.0, 1.0 - fj);
+
+    case 3u:
+      return vec3(-1.0 + fi, 1.0, -1.0 + fj);
+
+    case 4u:
+      return vec3(1.0 - fi, 1.0 - fj, -1.0);
+
+    default:
+      break;
+  }
+  return vec3(-1.0 + fi, 1.0 - fj, 1.0);
+}
+
+/// Convert a float into an unsigned integer with the same ordering.
+/// \param op Float.
+/// \return Ordered integer.
+uint float_to_ordered(float op)
+{
+  uint bits = floatBitsToUint(op);
+  return ((bits & 0x80000000u) != 0u) ? ~bits : (bits | 0x80000000u);
+}
+
+/// Convert an ordered integer back into float.
+/// \param op Ordered integer.
+/// \return Float.
+float ordered_to_float(uint op)
+{
+  return uintBitsToFloat(((op & 0x80000000u) != 0u) ? (op & 0x7FFFFFFFu) : ~op);
+}
+
+void main()
+{
+  uvec3 id = gl_GlobalInvocationID;
+  bool inside = (id.x < side) && (id.y < side);
+  // GL layers are ordered +X, -X, +Y, -Y, +Z, -Z.
+  ivec3 coord = ivec3(id.xy, id.z ^ 1u);
+  uint idx = (id.z * side + id.y) * side + id.x;
+
+  if(3 == mode)
+  {
+    if(inside)
+    {
+      float min_value = ordered_to_float(height_range[0]);
+      float max_value = ordered_to_float(height_range[1]);
+      vec4 color = imageLoad(moon_image, coord);
+      color.a = heights[idx];
+      if(max_value != min_value)
+      {
+        float mul = 1.0 / (max_value - min_value);
+        color.a = color.a * mul - mul * min_value;
+      }
+      imageStore(moon_image, coord, color);
+    }
+    return;
+  }
+
+  float side_mul = 1.0 / (float(side) * 0.5);
+  vec3 dir = cube_direction(id.z, float(id.x) * side_mul, float(id.y) * side_mul);
+  vec3 norm_dir = normalize(dir);
+
+  if(0 == mode)
+  {
+    if(inside)
+    {
+      vec3 color;
+      if(milky_way(norm_dir, color))
+      {
+        color += vec3(star_luminosity(norm_dir, dir));
+      }
+      else
+      {
+        color = vec3(0.0);
+      }
+      imageStore(space_image, coord, vec4(color, 1.0));
+    }
+    return;
+  }
+
+  if(0u == gl_LocalInvocationIndex)
+  {
+    group_min = 0xFFFFFFFFu;
+    group_max = 0u;
+  }
+  memoryBarrierShared();
+  barrier();
+
+  if(inside)
+  {
+    vec3 color;
+    float height = (1 == mode) ? enceladus_texel(norm_dir, dir, heights[idx], color) :
+      tethys_texel(norm_dir, dir, color);
+    heights[idx] = height;
+    imageStore(moon_image, coord, vec4(color, 0.0));
+
+    uint ordered = float_to_ordered(height);
+    atomicMin(group_min, ordered);
+    atomicMax(group_max, ordered);
+  }
+  memoryBarrierShared();
+  barrier();
+
+  if(0u == gl_LocalInvocationIndex)
+  {
+    atomicMin(height_range[0], group_min);
+    atomicMax(height_range[1], group_max);
+  }
+}
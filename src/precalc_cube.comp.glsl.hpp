@@ -0,0 +1,5 @@
+static const char *g_shader_compute_precalc_cube = ""
+#if defined(USE_LD)
+"precalc_cube.comp.glsl"
+#endif
+"";
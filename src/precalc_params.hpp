@@ -0,0 +1,415 @@
+#ifndef PRECALC_PARAMS_HPP
+#define PRECALC_PARAMS_HPP
+
+#if defined(USE_LD)
+#include <fstream>
+#include <sstream>
+#include <string>
+#endif
+
+/// Cube map assets handed over from precalc to the GL thread.
+enum PrecalcAsset
+{
+  /// Space cube map.
+  PRECALC_ASSET_SPACE = 0,
+
+  /// Enceladus cube map.
+  PRECALC_ASSET_ENCELADUS,
+
+  /// Tethys cube map.
+  PRECALC_ASSET_TETHYS,
+
+  /// Trail cube map.
+  PRECALC_ASSET_TRAIL,
+
+  /// Number of assets.
+  PRECALC_ASSET_COUNT
+};
+
+/// Mask of all precalc assets.
+const unsigned PRECALC_ASSETS_ALL = (1u << PRECALC_ASSET_COUNT) - 1;
+
+/// Generator parameters for precalc.
+///
+/// Release builds only use the defaults, developer builds may read them from a file.
+struct PrecalcParams
+{
+  /// Number of stars.
+  unsigned star_count = 32768;
+  /// Star size.
+  float star_size = 0.0000022f;
+  /// Milky way brightness.
+  float milky_way_intensity = 0.5f;
+  /// Milky way width multiplier.
+  float milky_way_width = 1.0f;
+
+  /// Noise octaves sampled for moon surfaces, 1 to 9.
+  unsigned noise_octaves = 9;
+
+  /// Number of craters on Enceladus.
+  unsigned enceladus_crater_count = 160;
+  /// Crater size multiplier on Enceladus.
+  float enceladus_crater_size = 0.003f;
+  /// Number of crawlers carving gorges on Enceladus.
+  unsigned enceladus_crawler_count = 444;
+  /// Maximum crawler lifetime on Enceladus.
+  unsigned enceladus_crawler_lifetime = 900;
+  /// Noise height multiplier on Enceladus.
+  float enceladus_noise_height = 3.13f;
+
+  /// Number of craters on Tethys.
+  unsigned tethys_crater_count = 155;
+  /// Crater size multiplier on Tethys.
+  float tethys_crater_size = 0.02f;
+  /// Noise height multiplier on Tethys.
+  float tethys_noise_height = 0.63f;
+
+  /// Lifetime of the trail crawler.
+  unsigned trail_lifetime = 19000;
+  /// Radius of the trail crawler.
+  float trail_radius = 0.011f;
+};
+
+#if defined(USE_LD)
+
+/// Current precalc parameters.
+static PrecalcParams g_precalc_params;
+
+/// Parameter file to watch, empty to use defaults.
+static std::string g_precalc_params_filename;
+
+/// Where space and moon cube map texels are calculated.
+enum PrecalcCubeMode
+{
+  /// CPU precalc threads.
+  PRECALC_CUBE_CPU,
+
+  /// Compute shaders on the GL thread, the CPU only prepares inputs.
+  PRECALC_CUBE_GPU,
+
+  /// Both, comparing results and exiting afterwards.
+  PRECALC_CUBE_VERIFY
+};
+
+/// Cube map precalc mode.
+static PrecalcCubeMode g_precalc_cube_mode = PRECALC_CUBE_CPU;
+
+/// Start playback with low-resolution cube maps and refine them in the background.
+static bool g_precalc_progressive = true;
+
+/// Cube map side divisor for low-resolution assets generated before playback.
+static const unsigned PRECALC_PREVIEW_DIVISOR = 4;
+
+/// Get the name of a precalc asset.
+///
+/// \param op Asset.
+/// \return Name.
+inline const char* precalc_asset_name(PrecalcAsset op)
+{
+  static const char* names[] = { "space", "enceladus", "tethys", "trail" };
+  return names[op];
+}
+
+/// Description of a single precalc parameter.
+struct PrecalcParamInfo
+{
+  /// Parameter name.
+  const char* name;
+  /// Member if unsigned.
+  unsigned PrecalcParams::* value_unsigned;
+  /// Member if float.
+  float PrecalcParams::* value_float;
+  /// Mask of assets depending on this parameter.
+  unsigned assets;
+};
+
+/// Get descriptions of all precalc parameters.
+///
+/// \param count [out] Number of parameters.
+/// \return Parameter array.
+inline const PrecalcParamInfo* precalc_params_info(unsigned& count)
+{
+  static const unsigned SPACE = 1u << PRECALC_ASSET_SPACE;
+  static const unsigned ENCELADUS = 1u << PRECALC_ASSET_ENCELADUS;
+  static const unsigned TETHYS = 1u << PRECALC_ASSET_TETHYS;
+  static const unsigned TRAIL = 1u << PRECALC_ASSET_TRAIL;
+  static const PrecalcParamInfo info[] =
+  {
+    { "star_count", &PrecalcParams::star_count, NULL, SPACE },
+    { "star_size", NULL, &PrecalcParams::star_size, SPACE },
+    { "milky_way_intensity", NULL, &PrecalcParams::milky_way_intensity, SPACE },
+    { "milky_way_width", NULL, &PrecalcParams::milky_way_width, SPACE },
+    { "noise_octaves", &PrecalcParams::noise_octaves, NULL, ENCELADUS | TETHYS },
+    { "enceladus_crater_count", &PrecalcParams::enceladus_crater_count, NULL, ENCELADUS },
+    { "enceladus_crater_size", NULL, &PrecalcParams::enceladus_crater_size, ENCELADUS },
+    { "enceladus_crawler_count", &PrecalcParams::enceladus_crawler_count, NULL, ENCELADUS },
+    { "enceladus_crawler_lifetime", &PrecalcParams::enceladus_crawler_lifetime, NULL, ENCELADUS },
+    { "enceladus_noise_height", NULL, &PrecalcParams::enceladus_noise_height, ENCELADUS },
+    { "tethys_crater_count", &PrecalcParams::tethys_crater_count, NULL, TETHYS },
+    { "tethys_crater_size", NULL, &PrecalcParams::tethys_crater_size, TETHYS },
+    { "tethys_noise_height", NULL, &PrecalcParams::tethys_noise_height, TETHYS },
+    { "trail_lifetime", &PrecalcParams::trail_lifetime, NULL, TRAIL },
+    { "trail_radius", NULL, &PrecalcParams::trail_radius, TRAIL },
+  };
+  count = sizeof(info) / sizeof(info[0]);
+  return info;
+}
+
+/// Tell which assets differ between two parameter sets.
+///
+/// \param lhs Left-hand-side operand.
+/// \param rhs Right-hand-side operand.
+/// \return Mask of assets that need to be regenerated.
+inline unsigned precalc_params_diff(const PrecalcParams& lhs, const PrecalcParams& rhs)
+{
+  unsigned count;
+  const PrecalcParamInfo* info = precalc_params_info(count);
+  unsigned ret = 0;
+
+  for(unsigned ii = 0; (ii < count); ++ii)
+  {
+    const PrecalcParamInfo& param = info[ii];
+    if(param.value_unsigned ? (lhs.*param.value_unsigned != rhs.*param.value_unsigned) :
+        (lhs.*param.value_float != rhs.*param.value_float))
+    {
+      ret |= param.assets;
+    }
+  }
+  return ret;
+}
+
+/// Read precalc parameters from a file.
+///
+/// Each line contains a parameter name and a value, '#' starts a comment. Parameters not present in the file
+/// keep their values.
+///
+/// \param filename File to read.
+/// \param params [out] Parameters.
+inline void precalc_params_read(const std::string& filename, PrecalcParams& params)
+{
+  std::ifstream fd(filename.c_str());
+  if(!fd)
+  {
+    std::ostringstream sstr;
+    sstr << "could not open precalc parameter file '" << filename << "'";
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+
+  unsigned count;
+  const PrecalcParamInfo* info = precalc_params_info(count);
+  PrecalcParams ret = params;
+  std::string line;
+
+  for(unsigned line_number = 1; std::getline(fd, line); ++line_number)
+  {
+    std::istringstream sstr(line.substr(0, line.find('#')));
+    std::string name;
+    if(!(sstr >> name))
+    {
+      continue;
+    }
+
+    const PrecalcParamInfo* param = NULL;
+    for(unsigned ii = 0; (ii < count); ++ii)
+    {
+      if(name == info[ii].name)
+      {
+        param = &(info[ii]);
+        break;
+      }
+    }
+    bool success = (NULL != param);
+    if(success)
+    {
+      success = param->value_unsigned ? static_cast<bool>(sstr >> ret.*(param->value_unsigned)) :
+        static_cast<bool>(sstr >> ret.*(param->value_float));
+    }
+    if(!success || (sstr >> std::ws, !sstr.eof()))
+    {
+      std::ostringstream err;
+      err << filename << ":" << line_number << ": invalid parameter: '" << line << "'";
+      BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+    }
+  }
+
+  if((ret.noise_octaves < 1) || (ret.noise_octaves > 9))
+  {
+    std::ostringstream sstr;
+    sstr << filename << ": noise_octaves must be between 1 and 9, got " << ret.noise_octaves;
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+
+  params = ret;
+}
+
+/// Write precalc parameters into a file.
+///
+/// \param filename File to write.
+/// \param params Parameters.
+inline void precalc_params_write(const std::string& filename, const PrecalcParams& params)
+{
+  std::ofstream fd(filename.c_str());
+  if(!fd)
+  {
+    std::ostringstream sstr;
+    sstr << "could not write precalc parameter file '" << filename << "'";
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+
+  unsigned count;
+  const PrecalcParamInfo* info = precalc_params_info(count);
+
+  fd << "# Precalc parameters, edit while the intro is running to regenerate affected assets.\n";
+  for(unsigned ii = 0; (ii < count); ++ii)
+  {
+    const PrecalcParamInfo& param = info[ii];
+    fd << param.name << " ";
+    if(param.value_unsigned)
+    {
+      fd << params.*(param.value_unsigned);
+    }
+    else
+    {
+      fd << params.*(param.value_float);
+    }
+    fd << "\n";
+  }
+}
+
+/// Watches a precalc parameter file for changes.
+class PrecalcParamsWatcher
+{
+  private:
+    /// Milliseconds between checks of the file.
+    static const int POLL_INTERVAL = 250;
+
+  private:
+    /// File name, empty if not watching.
+    std::string m_filename;
+
+    /// Last seen modification time.
+    std::time_t m_write_time;
+
+    /// Ticks at which to check the file next.
+    int m_next_poll;
+
+    /// Mask of assets waiting to be regenerated.
+    unsigned m_pending;
+
+  private:
+    /// Deleted copy constructor.
+    PrecalcParamsWatcher(const PrecalcParamsWatcher&) = delete;
+    /// Deleted assignment.
+    PrecalcParamsWatcher& operator=(const PrecalcParamsWatcher&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// Reads the file into global precalc parameters. If the file does not exist, it is created with the
+    /// defaults.
+    ///
+    /// \param filename File name, empty to not watch anything.
+    explicit PrecalcParamsWatcher(const std::string& filename) :
+      m_filename(filename),
+      m_write_time(0),
+      m_next_poll(0),
+      m_pending(0)
+    {
+      if(m_filename.empty())
+      {
+        return;
+      }
+
+      if(boost::filesystem::exists(m_filename))
+      {
+        precalc_params_read(m_filename, g_precalc_params);
+      }
+      else
+      {
+        precalc_params_write(m_filename, g_precalc_params);
+        std::cout << "wrote default precalc parameters to '" << m_filename << "'" << std::endl;
+      }
+      m_write_time = getWriteTime();
+    }
+
+  private:
+    /// Get modification time of the file.
+    ///
+    /// \return Modification time or 0 if the file can not be accessed.
+    std::time_t getWriteTime() const
+    {
+      boost::system::error_code err;
+      std::time_t ret = boost::filesystem::last_write_time(m_filename, err);
+      return err ? 0 : ret;
+    }
+
+  public:
+    /// Accessor.
+    ///
+    /// \return Mask of assets waiting to be regenerated.
+    unsigned getPending() const
+    {
+      return m_pending;
+    }
+
+    /// Clear pending assets after regeneration has been started.
+    void clearPending()
+    {
+      m_pending = 0;
+    }
+
+    /// Check the file for changes.
+    ///
+    /// Changes are read into global precalc parameters. Invalid files are reported and ignored.
+    ///
+    /// \param ticks Current ticks.
+    void poll(int ticks)
+    {
+      if(m_filename.empty() || (ticks < m_next_poll))
+      {
+        return;
+      }
+      m_next_poll = ticks + POLL_INTERVAL;
+
+      std::time_t write_time = getWriteTime();
+      if((0 == write_time) || (write_time == m_write_time))
+      {
+        return;
+      }
+      m_write_time = write_time;
+
+      PrecalcParams params = g_precalc_params;
+      try
+      {
+        precalc_params_read(m_filename, params);
+      }
+      catch(const std::runtime_error& err)
+      {
+        std::cerr << err.what() << std::endl;
+        return;
+      }
+
+      unsigned assets = precalc_params_diff(g_precalc_params, params);
+      std::cout << "precalc parameters changed, regenerating:";
+      for(unsigned ii = 0; (ii < PRECALC_ASSET_COUNT); ++ii)
+      {
+        if(assets & (1u << ii))
+        {
+          std::cout << " " << precalc_asset_name(static_cast<PrecalcAsset>(ii));
+        }
+      }
+      std::cout << (assets ? "" : " nothing") << std::endl;
+
+      g_precalc_params = params;
+      m_pending |= assets;
+    }
+};
+
+#else
+
+/// Precalc parameters, constant in release builds.
+static const PrecalcParams g_precalc_params;
+
+#endif
+
+#endif
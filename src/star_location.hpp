@@ -49,6 +49,34 @@ public:
     return strength * m_luminosity * strength * strength;
   }
 
+  /// Calculate luminosity in regard to this star for a vector of directions.
+  ///
+  /// \param dx Direction X components.
+  /// \param dy Direction Y components.
+  /// \param dz Direction Z components.
+  /// \return Luminosities, same as calculateLuminosity().
+  template<typename V> V calculateLuminosity(const V& dx, const V& dy, const V& dz) const
+  {
+    V angle = dx * V(m_dir[0]) + dy * V(m_dir[1]) + dz * V(m_dir[2]);
+    V lower_bound(1.0f - m_radius);
+    V strength = (angle - lower_bound) / V(m_radius);
+    return vselect(angle < lower_bound, V(0.0f), strength * V(m_luminosity) * strength * strength);
+  }
+
+  /// Accessor.
+  /// \return Normalized direction.
+  const vec3& getDirection() const
+  {
+    return m_dir;
+  }
+
+  /// Accessor.
+  /// \return Luminosity.
+  float getLuminosity() const
+  {
+    return m_luminosity;
+  }
+
   /// Accessor.
   /// \return Mapped direction.
   const vec3& getMappedDirection() const
@@ -56,6 +84,13 @@ public:
     return m_mapped;
   }
 
+  /// Accessor.
+  /// \return Radius (angle).
+  float getRadius() const
+  {
+    return m_radius;
+  }
+
 private:
   /// Convert to mapped direction.
   /// \param dir Direction to map.
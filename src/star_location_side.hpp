@@ -57,11 +57,26 @@ class StarLocationSide
       m_stars[serializeLocation(star)].emplace_back(star);
     }
 
+    /// Accessor.
+    /// \param idx Cell index, row by row.
+    /// \return Stars in the cell.
+    const seq<StarLocation>& getCell(unsigned idx) const
+    {
+      return m_stars[idx];
+    }
+
+    /// Accessor.
+    /// \return Number of cells.
+    unsigned getCellCount() const
+    {
+      return m_stars.size();
+    }
+
     /// Get luminosity for given direction.
     /// \param dir Normalized direction.
     /// \param mapped Cube-mapped direction.
     /// \return Luminosiry extracted from this side.
-    float calculateLuminosity(const vec3& dir, const vec3& mapped)
+    float calculateLuminosity(const vec3& dir, const vec3& mapped) const
     {
       int ix = mapSubdivisionX(mapped);
       int iy = mapSubdivisionY(mapped);
@@ -85,11 +100,69 @@ class StarLocationSide
       return luminosity;
     }
 
+    /// Get luminosity for a vector of directions.
+    ///
+    /// Stars in the cells around any lane are visited once for the whole vector. Cells outside the
+    /// neighbourhood of a lane add nothing to it, so each lane sums the same stars in the same order as
+    /// calculateLuminosity().
+    ///
+    /// \param dx Normalized direction X components.
+    /// \param dy Normalized direction Y components.
+    /// \param dz Normalized direction Z components.
+    /// \param mx Cube-mapped direction X components.
+    /// \param my Cube-mapped direction Y components.
+    /// \param mz Cube-mapped direction Z components.
+    /// \return Luminosities extracted from this side.
+    template<typename V> V calculateLuminosity(const V& dx, const V& dy, const V& dz, const V& mx, const V& my,
+        const V& mz) const
+    {
+      V cx = mapSubdivisionX(mx, my, mz);
+      V cy = mapSubdivisionY(mx, my, mz);
+      float cells_x[V::LANES];
+      float cells_y[V::LANES];
+      cx.store(cells_x);
+      cy.store(cells_y);
+
+      float min_x = cells_x[0];
+      float max_x = cells_x[0];
+      float min_y = cells_y[0];
+      float max_y = cells_y[0];
+      for (unsigned ii = 1; (ii < V::LANES); ++ii)
+      {
+        min_x = std::min(min_x, cells_x[ii]);
+        max_x = std::max(max_x, cells_x[ii]);
+        min_y = std::min(min_y, cells_y[ii]);
+        max_y = std::max(max_y, cells_y[ii]);
+      }
+      int ix1 = std::max(static_cast<int>(min_x) - 1, 0);
+      int ix2 = std::min(static_cast<int>(max_x) + 1, SUBDIVISIONS - 1);
+      int iy1 = std::max(static_cast<int>(min_y) - 1, 0);
+      int iy2 = std::min(static_cast<int>(max_y) + 1, SUBDIVISIONS - 1);
+
+      V luminosity(0.0f);
+      for (int jj = iy1; (jj <= iy2); ++jj)
+      {
+        int row = jj * SUBDIVISIONS;
+        V dist_y = vabs(cy - V(static_cast<float>(jj)));
+        for (int ii = ix1; (ii <= ix2); ++ii)
+        {
+          int idx = row + ii;
+          V dist = vmax(vabs(cx - V(static_cast<float>(ii))), dist_y);
+          for (const StarLocation& vv : m_stars[idx])
+          {
+            luminosity = luminosity + vselect(dist > V(1.0f), V(0.0f), vv.calculateLuminosity(dx, dy, dz));
+          }
+        }
+      }
+
+      return luminosity;
+    }
+
   private:
     /// Map subdivision.
     /// \param coord Coordinate to map.
     /// \return Mapped subdivision coordinate.
-    int mapSubdivision(float coord)
+    int mapSubdivision(float coord) const
     {
 #if defined(USE_LD)
       if ((coord < -1.0f) || (coord > 1.0f))
@@ -103,10 +176,45 @@ class StarLocationSide
       return std::min(static_cast<int>((coord + 1.0f) * 0.5f * static_cast<float>(IDIV)), IDIV - 1);
     }
 
+    /// Map subdivision for a vector of coordinates.
+    /// \param coord Coordinates to map.
+    /// \return Mapped subdivision coordinates, same as mapSubdivision().
+    template<typename V> static V mapSubdivision(const V& coord)
+    {
+      const float FDIV = static_cast<float>(SUBDIVISIONS);
+      return vmin(vtrunc((coord + V(1.0f)) * V(0.5f) * V(FDIV)), V(FDIV - 1.0f));
+    }
+
+    /// Map X location for a vector of directions.
+    /// \param mx Direction X components.
+    /// \param mz Direction Z components.
+    /// \return X subdivision slots.
+    template<typename V> V mapSubdivisionX(const V& mx, const V& /*my*/, const V& mz) const
+    {
+      if ((m_bin == NEG_X) || (m_bin == POS_X))
+      {
+        return mapSubdivision(mz);
+      }
+      return mapSubdivision(mx);
+    }
+
+    /// Map Y location for a vector of directions.
+    /// \param my Direction Y components.
+    /// \param mz Direction Z components.
+    /// \return Y subdivision slots.
+    template<typename V> V mapSubdivisionY(const V& /*mx*/, const V& my, const V& mz) const
+    {
+      if ((m_bin == NEG_Y) || (m_bin == POS_Y))
+      {
+        return mapSubdivision(mz);
+      }
+      return mapSubdivision(my);
+    }
+
     /// Map X location.
     /// \param dir Direction to map.
     /// \return X subdivision slot.
-    int mapSubdivisionX(const vec3& dir)
+    int mapSubdivisionX(const vec3& dir) const
     {
       if ((m_bin == NEG_X) || (m_bin == POS_X))
       {
@@ -125,7 +233,7 @@ class StarLocationSide
     /// Map Y location.
     /// \param dir Direction to map.
     /// \return Y subdivision slot.
-    int mapSubdivisionY(const vec3& dir)
+    int mapSubdivisionY(const vec3& dir) const
     {
       if ((m_bin == NEG_X) || (m_bin == POS_X))
       {
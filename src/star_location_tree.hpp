@@ -2,10 +2,54 @@
 #define STAR_LOCATION_TREE_HPP
 
 #include "star_location_side.hpp"
+#include "verbatim_fast_math.hpp"
+#include "verbatim_image_cube.hpp"
 
 /// Star location tree.
 class StarLocationTree
 {
+private:
+  /// Kernel for calculating luminosity over a row of directions.
+  struct LuminosityRowKernel
+  {
+    /// Star location tree.
+    const StarLocationTree& m_tree;
+
+    /// Row directions.
+    const CubeMapRow& m_row;
+
+    /// Luminosities.
+    float* m_dst;
+
+    /// Constructor.
+    /// \param tree Star location tree.
+    /// \param row Row directions.
+    /// \param dst [out] Luminosities.
+    explicit LuminosityRowKernel(const StarLocationTree& tree, const CubeMapRow& row, float* dst) :
+      m_tree(tree),
+      m_row(row),
+      m_dst(dst)
+    {
+    }
+
+    /// Run the kernel.
+    template<typename V> void run()
+    {
+      unsigned ii = 0;
+
+      for(; (ii + V::LANES <= m_row.getWidth()); ii += V::LANES)
+      {
+        m_tree.calculateLuminosity(V::load(m_row.getNormDirX() + ii), V::load(m_row.getNormDirY() + ii),
+            V::load(m_row.getNormDirZ() + ii), V::load(m_row.getDirX() + ii), V::load(m_row.getDirY() + ii),
+            V::load(m_row.getDirZ() + ii)).store(m_dst + ii);
+      }
+      for(; (ii < m_row.getWidth()); ++ii)
+      {
+        m_dst[ii] = m_tree.calculateLuminosity(m_row.getNormDir(ii), m_row.getDir(ii));
+      }
+    }
+  };
+
 private:
   /// Side for containing stars.
   StarLocationSide m_neg_x;
@@ -97,11 +141,40 @@ public:
     }
   }
 
+  /// Accessor.
+  /// \param op Bin.
+  /// \return Side for the bin.
+  const StarLocationSide& getSide(StarLocationSide::Bin op) const
+  {
+    switch(op)
+    {
+      case StarLocationSide::NEG_X:
+        return m_neg_x;
+
+      case StarLocationSide::POS_X:
+        return m_pos_x;
+
+      case StarLocationSide::NEG_Y:
+        return m_neg_y;
+
+      case StarLocationSide::POS_Y:
+        return m_pos_y;
+
+      case StarLocationSide::NEG_Z:
+        return m_neg_z;
+
+      case StarLocationSide::POS_Z:
+      default:
+        break;
+    }
+    return m_pos_z;
+  }
+
   /// Get luminosity for given direction.
   /// \param dir Normalized direction.
   /// \param mapped Cube-mapped direction.
   /// \return Luminosity extracted from all sides.
-  float calculateLuminosity(const vec3& dir, const vec3& mapped)
+  float calculateLuminosity(const vec3& dir, const vec3& mapped) const
   {
     float luminosity = 0.0f;
 
@@ -114,6 +187,44 @@ public:
 
     return luminosity;
   }
+
+  /// Get luminosity for a vector of directions.
+  /// \param dx Normalized direction X components.
+  /// \param dy Normalized direction Y components.
+  /// \param dz Normalized direction Z components.
+  /// \param mx Cube-mapped direction X components.
+  /// \param my Cube-mapped direction Y components.
+  /// \param mz Cube-mapped direction Z components.
+  /// \return Luminosities, same as calculateLuminosity() for every lane.
+  template<typename V> V calculateLuminosity(const V& dx, const V& dy, const V& dz, const V& mx, const V& my,
+      const V& mz) const
+  {
+    V luminosity(0.0f);
+
+    luminosity = luminosity + m_neg_x.calculateLuminosity(dx, dy, dz, mx, my, mz);
+    luminosity = luminosity + m_pos_x.calculateLuminosity(dx, dy, dz, mx, my, mz);
+    luminosity = luminosity + m_neg_y.calculateLuminosity(dx, dy, dz, mx, my, mz);
+    luminosity = luminosity + m_pos_y.calculateLuminosity(dx, dy, dz, mx, my, mz);
+    luminosity = luminosity + m_neg_z.calculateLuminosity(dx, dy, dz, mx, my, mz);
+    luminosity = luminosity + m_pos_z.calculateLuminosity(dx, dy, dz, mx, my, mz);
+
+    return luminosity;
+  }
+
+  /// Get luminosity for a row of directions.
+  ///
+  /// Evaluates a vector of texels at a time from the direction planes of the row. Runs at the lane width of the
+  /// build target instead of the selected CPU level. Star falloff divides by radiuses of a few millionths, so
+  /// rounding differences from FMA contraction would show on star edges. Results are the same as from
+  /// calculateLuminosity() for each texel.
+  ///
+  /// \param row Row directions.
+  /// \param dst [out] Luminosities, one per texel.
+  void calculateLuminosity(const CubeMapRow& row, float* dst) const
+  {
+    LuminosityRowKernel kernel(*this, row, dst);
+    kernel.run<ffloat_native>();
+  }
 };
 
 #endif
@@ -0,0 +1,218 @@
+#ifndef VERBATIM_BENCHMARK_HPP
+#define VERBATIM_BENCHMARK_HPP
+
+#if defined(USE_LD)
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Sink for benchmark results so the compiler can not discard the benchmarked work.
+static volatile float g_benchmark_sink = 0.0f;
+
+/// Consume a benchmark result.
+///
+/// \param op Value.
+inline void benchmark_use(float op)
+{
+  g_benchmark_sink = g_benchmark_sink + op;
+}
+
+/// Result of one benchmark.
+struct BenchmarkResult
+{
+  /// Benchmark name.
+  std::string name;
+
+  /// Iterations in the measured run.
+  uint64_t iterations;
+
+  /// Wall clock nanoseconds per iteration.
+  double real_time;
+
+  /// Process CPU nanoseconds per iteration.
+  double cpu_time;
+
+  /// Items processed per second, 0 if not applicable.
+  double items_per_second;
+};
+
+/// Microbenchmark runner.
+///
+/// Each benchmark is a functor taking an iteration count. Iterations are increased until a run lasts for the
+/// minimum time, only the last run is reported. Results are written as JSON in the format used by Google
+/// Benchmark so its tools can also read them.
+class BenchmarkRunner
+{
+  private:
+    /// Results so far.
+    std::vector<BenchmarkResult> m_results;
+
+    /// Context key-value pairs.
+    std::vector<std::pair<std::string, std::string> > m_context;
+
+    /// Substring benchmark names must contain to run, empty to run all.
+    std::string m_filter;
+
+    /// Minimum duration of a measured run in seconds.
+    double m_min_time;
+
+  private:
+    /// Deleted copy constructor.
+    BenchmarkRunner(const BenchmarkRunner&) = delete;
+    /// Deleted assignment.
+    BenchmarkRunner& operator=(const BenchmarkRunner&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param filter Substring benchmark names must contain to run, empty to run all.
+    /// \param min_time Minimum duration of a measured run in seconds (default: 0.5).
+    explicit BenchmarkRunner(const std::string& filter, double min_time = 0.5) :
+      m_filter(filter),
+      m_min_time(min_time)
+    {
+    }
+
+  private:
+    /// Escape a string for JSON.
+    ///
+    /// \param op String.
+    /// \return Escaped string.
+    static std::string json_escape(const std::string& op)
+    {
+      std::string ret;
+
+      for(char cc : op)
+      {
+        if(('"' == cc) || ('\\' == cc))
+        {
+          ret += '\\';
+        }
+        ret += cc;
+      }
+
+      return ret;
+    }
+
+  public:
+    /// Add context information to output.
+    ///
+    /// \param key Key.
+    /// \param value Value.
+    void addContext(const std::string& key, const std::string& value)
+    {
+      m_context.emplace_back(key, value);
+    }
+
+    /// Run a benchmark.
+    ///
+    /// \param name Benchmark name.
+    /// \param func Functor taking an iteration count.
+    /// \param items Items processed per iteration, 0 if not applicable (default: 0).
+    template<typename F> void run(const std::string& name, F func, unsigned items = 0)
+    {
+      if(!m_filter.empty() && (name.find(m_filter) == std::string::npos))
+      {
+        return;
+      }
+
+      // Warm up caches and lazily initialized state.
+      func(1u);
+
+      uint64_t iterations = 1;
+      for(;;)
+      {
+        std::clock_t cpu_start = std::clock();
+        std::chrono::steady_clock::time_point real_start = std::chrono::steady_clock::now();
+        func(iterations);
+        double real_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - real_start).count();
+        double cpu_elapsed = static_cast<double>(std::clock() - cpu_start) / static_cast<double>(CLOCKS_PER_SEC);
+
+        if((real_elapsed >= m_min_time) || (iterations >= 1000000000u))
+        {
+          BenchmarkResult result;
+          result.name = name;
+          result.iterations = iterations;
+          result.real_time = real_elapsed * 1.0e9 / static_cast<double>(iterations);
+          result.cpu_time = cpu_elapsed * 1.0e9 / static_cast<double>(iterations);
+          result.items_per_second = items ?
+            (static_cast<double>(items) * static_cast<double>(iterations) / real_elapsed) : 0.0;
+          m_results.push_back(result);
+
+          std::cout << std::left << std::setw(48) << name << std::right << std::setw(14) << std::fixed <<
+            std::setprecision(0) << result.real_time << " ns" << std::setw(14) << result.cpu_time << " ns" <<
+            std::setw(12) << iterations;
+          if(items)
+          {
+            std::cout << std::setw(12) << std::setprecision(2) << (result.items_per_second * 1.0e-6) << " M/s";
+          }
+          std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+          return;
+        }
+
+        // Aim past the minimum time, but do not grow too fast from noisy short runs.
+        double multiplier = (real_elapsed > 0.0) ? (m_min_time * 1.4 / real_elapsed) : 10.0;
+        multiplier = std::min(std::max(multiplier, 2.0), 10.0);
+        iterations = static_cast<uint64_t>(static_cast<double>(iterations) * multiplier);
+      }
+    }
+
+    /// Write results as JSON.
+    ///
+    /// \param ostr Output stream.
+    void writeJson(std::ostream& ostr) const
+    {
+      ostr << "{\n  \"context\": {\n";
+      for(const std::pair<std::string, std::string>& vv : m_context)
+      {
+        ostr << "    \"" << json_escape(vv.first) << "\": \"" << json_escape(vv.second) << "\",\n";
+      }
+      ostr << "    \"time_unit\": \"ns\"\n  },\n  \"benchmarks\": [";
+
+      for(unsigned ii = 0; (ii < m_results.size()); ++ii)
+      {
+        const BenchmarkResult& result = m_results[ii];
+        ostr << (ii ? ",\n" : "\n") << "    {\n" <<
+          "      \"name\": \"" << json_escape(result.name) << "\",\n" <<
+          "      \"run_name\": \"" << json_escape(result.name) << "\",\n" <<
+          "      \"run_type\": \"iteration\",\n" <<
+          "      \"iterations\": " << result.iterations << ",\n" <<
+          std::setprecision(9) <<
+          "      \"real_time\": " << result.real_time << ",\n" <<
+          "      \"cpu_time\": " << result.cpu_time << ",\n";
+        if(result.items_per_second > 0.0)
+        {
+          ostr << "      \"items_per_second\": " << result.items_per_second << ",\n";
+        }
+        ostr << "      \"time_unit\": \"ns\"\n    }";
+      }
+
+      ostr << "\n  ]\n}\n";
+    }
+
+    /// Write results as JSON into a file.
+    ///
+    /// \param filename Output filename.
+    void writeJson(const std::string& filename) const
+    {
+      std::ofstream fd(filename);
+      if(!fd.is_open())
+      {
+        std::ostringstream sstr;
+        sstr << "could not open benchmark output '" << filename << "'";
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+      writeJson(fd);
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef VERBATIM_CANCEL_HPP
+#define VERBATIM_CANCEL_HPP
+
+/// Cooperative cancellation is only available in developer builds.
+///
+/// Release builds exit the process directly, cancellation points compile to nothing.
+#if defined(USE_LD)
+
+#include <atomic>
+#include <stdexcept>
+
+/// Exception thrown from cancellation points once cancellation has been requested.
+class CancelledError : public std::runtime_error
+{
+  public:
+    /// Constructor.
+    CancelledError() :
+      std::runtime_error("cancelled")
+    {
+    }
+};
+
+/// Cancellation token.
+///
+/// Requesting cancellation is thread-safe, long-running loops poll the token at cancellation points.
+class CancelToken
+{
+  private:
+    /// Has cancellation been requested?
+    std::atomic<bool> m_requested;
+
+  private:
+    /// Deleted copy constructor.
+    CancelToken(const CancelToken&) = delete;
+    /// Deleted assignment.
+    CancelToken& operator=(const CancelToken&) = delete;
+
+  public:
+    /// Constructor.
+    CancelToken() :
+      m_requested(false)
+    {
+    }
+
+  public:
+    /// Request cancellation.
+    void request()
+    {
+      m_requested.store(true, std::memory_order_relaxed);
+    }
+
+    /// Tell if cancellation has been requested.
+    ///
+    /// \return True if yes, false if no.
+    bool isRequested() const
+    {
+      return m_requested.load(std::memory_order_relaxed);
+    }
+
+    /// Throw if cancellation has been requested.
+    void check() const
+    {
+      if(isRequested())
+      {
+        BOOST_THROW_EXCEPTION(CancelledError());
+      }
+    }
+};
+
+/// Global cancellation token, polled by precalc.
+static CancelToken g_cancel_token;
+
+/// Tell if cancellation has been requested.
+///
+/// Used by loops in worker threads that can not throw, they return early instead.
+///
+/// \return True if yes, false if no.
+inline bool cancel_requested()
+{
+  return g_cancel_token.isRequested();
+}
+
+/// Cancellation point.
+///
+/// Throws CancelledError if cancellation has been requested. Only call where unwinding does not leak, i.e.
+/// outside of code owning raw allocations.
+inline void cancel_point()
+{
+  g_cancel_token.check();
+}
+
+#else
+
+/// Tell if cancellation has been requested, never in release builds.
+///
+/// \return False.
+inline bool cancel_requested()
+{
+  return false;
+}
+
+/// Cancellation point, does nothing in release builds.
+inline void cancel_point()
+{
+}
+
+#endif
+
+#endif
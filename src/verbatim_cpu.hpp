@@ -0,0 +1,191 @@
+#ifndef VERBATIM_CPU_HPP
+#define VERBATIM_CPU_HPP
+
+/// Runtime CPU dispatch is available on x86 with GCC-compatible compilers.
+///
+/// Kernels are compiled for every level using target attributes and selected at startup with cpuid. Define
+/// DISABLE_CPU_DISPATCH to only use the instruction set the build targets.
+#if !defined(DISABLE_CPU_DISPATCH) && defined(__GNUC__) && defined(__SSE2__) && \
+  (defined(__x86_64__) || defined(__i386__))
+#define CPU_DISPATCH
+#include <cpuid.h>
+#endif
+
+#if defined(USE_LD)
+#include <iostream>
+#include <sstream>
+#include <string>
+#endif
+
+#if defined(CPU_DISPATCH)
+/// Target attribute for AVX2 code.
+#define CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+/// Target attribute for AVX-512 code.
+#define CPU_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+/// Attribute for dispatch entry points, everything called from them is compiled for their target.
+#define CPU_FLATTEN __attribute__((flatten))
+#else
+#define CPU_TARGET_AVX2
+#define CPU_TARGET_AVX512
+#define CPU_FLATTEN
+#endif
+
+#if defined(CPU_DISPATCH) && !defined(__clang__)
+/// Start of code instanced for dispatched lane types.
+///
+/// Kernels passing vectors by value are only called from entry points of the same target, so the ABI change
+/// warned about does not matter.
+#define CPU_KERNELS_BEGIN _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wpsabi\"")
+/// End of code instanced for dispatched lane types.
+#define CPU_KERNELS_END _Pragma("GCC diagnostic pop")
+#else
+#define CPU_KERNELS_BEGIN
+#define CPU_KERNELS_END
+#endif
+
+/// CPU feature level.
+///
+/// Each level includes all the features of the levels below it.
+enum CpuLevel
+{
+  /// Instruction set the build targets.
+  CPU_LEVEL_BASELINE = 0,
+
+  /// AVX2 and FMA.
+  CPU_LEVEL_AVX2,
+
+  /// AVX-512F.
+  CPU_LEVEL_AVX512,
+
+  /// Number of levels, also used to denote no level.
+  CPU_LEVEL_COUNT
+};
+
+/// CPU level used by dispatched kernels.
+static CpuLevel g_cpu_level = CPU_LEVEL_BASELINE;
+
+/// Detect the highest CPU level supported by both the processor and the operating system.
+///
+/// \return Detected CPU level.
+inline CpuLevel cpu_detect()
+{
+#if defined(CPU_DISPATCH)
+  unsigned eax;
+  unsigned ebx;
+  unsigned ecx;
+  unsigned edx;
+
+  if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+  {
+    return CPU_LEVEL_BASELINE;
+  }
+  // FMA, OSXSAVE and AVX.
+  const unsigned ECX_FEATURES = (1u << 12) | (1u << 27) | (1u << 28);
+  if((ecx & ECX_FEATURES) != ECX_FEATURES)
+  {
+    return CPU_LEVEL_BASELINE;
+  }
+
+  // Operating system must save XMM and YMM state.
+  unsigned xcr0;
+  unsigned xcr0_hi;
+  asm volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+  (void)xcr0_hi;
+  if((xcr0 & 0x6) != 0x6)
+  {
+    return CPU_LEVEL_BASELINE;
+  }
+
+  if(__get_cpuid_max(0, NULL) < 7)
+  {
+    return CPU_LEVEL_BASELINE;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  if(!(ebx & (1u << 5)))
+  {
+    return CPU_LEVEL_BASELINE;
+  }
+
+  // AVX-512F additionally requires opmask and ZMM state.
+  if((ebx & (1u << 16)) && ((xcr0 & 0xE6) == 0xE6))
+  {
+    return CPU_LEVEL_AVX512;
+  }
+  return CPU_LEVEL_AVX2;
+#else
+  return CPU_LEVEL_BASELINE;
+#endif
+}
+
+#if defined(USE_LD)
+
+/// Get the name of a CPU level.
+///
+/// \param op CPU level.
+/// \return Human-readable name.
+inline const char* cpu_level_name(CpuLevel op)
+{
+  switch(op)
+  {
+    case CPU_LEVEL_AVX2:
+      return "avx2";
+
+    case CPU_LEVEL_AVX512:
+      return "avx512";
+
+    case CPU_LEVEL_BASELINE:
+    default:
+      return "baseline";
+  }
+}
+
+/// Parse a CPU level from a name.
+///
+/// \param op Name as returned by cpu_level_name().
+/// \return CPU level.
+inline CpuLevel cpu_level_parse(const std::string& op)
+{
+  for(int ii = 0; (ii < CPU_LEVEL_COUNT); ++ii)
+  {
+    CpuLevel level = static_cast<CpuLevel>(ii);
+    if(op == cpu_level_name(level))
+    {
+      return level;
+    }
+  }
+
+  std::ostringstream sstr;
+  sstr << "invalid CPU level: '" << op << "'";
+  BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+}
+
+#endif
+
+/// Select the CPU level for dispatched kernels.
+///
+/// Forcing a level above the detected one is an error, as the kernels would not run.
+///
+/// \param forced Level to force, CPU_LEVEL_COUNT to use the detected level (default: CPU_LEVEL_COUNT).
+inline void cpu_initialize(CpuLevel forced = CPU_LEVEL_COUNT)
+{
+  CpuLevel detected = cpu_detect();
+
+#if defined(USE_LD)
+  if((forced != CPU_LEVEL_COUNT) && (forced > detected))
+  {
+    std::ostringstream sstr;
+    sstr << "cannot force CPU level '" << cpu_level_name(forced) << "', detected level is '" <<
+      cpu_level_name(detected) << "'";
+    BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+  }
+#endif
+
+  g_cpu_level = (forced != CPU_LEVEL_COUNT) ? forced : detected;
+
+#if defined(USE_LD)
+  std::cout << "CPU level: " << cpu_level_name(g_cpu_level) << " (detected: " << cpu_level_name(detected) <<
+    ((forced != CPU_LEVEL_COUNT) ? ", forced" : "") << ")" << std::endl;
+#endif
+}
+
+#endif
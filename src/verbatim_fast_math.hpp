@@ -0,0 +1,1335 @@
+#ifndef VERBATIM_FAST_MATH_HPP
+#define VERBATIM_FAST_MATH_HPP
+
+#include "verbatim_cpu.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(USE_LD)
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#endif
+
+/// \file
+/// Fast transcendental functions for precalc.
+///
+/// All functions are built from one set of polynomial kernels (Cephes-derived), instanced for scalar floats and
+/// for SSE2, AVX2 and AVX-512 registers as available at compile time. Errors are measured against double
+/// precision libm and are given in single precision ULPs within the stated domain:
+///
+/// function | domain                          | max ULP
+/// ---------|---------------------------------|--------
+/// sin, cos | [-8192, 8192]                   | 2, or absolute error 6e-8 near zeros
+/// exp      | [-87, 88]                       | 1
+/// log      | normal floats > 0               | 1
+/// pow      | x > 0, y * log(x) in [-87, 88]  | 2 + 2 * abs(y * log(x))
+/// tanh     | all                             | 1
+/// asin     | [-1, 1]                         | 2
+/// sqrt     | >= 0                            | 0
+///
+/// Outside the domain the results are unspecified. Denormals, infinities and NaNs are not handled. All lane
+/// widths produce bit-identical results, except that lanes selected at runtime above the build baseline may
+/// contract multiplies and adds into FMA. Developer builds can verify the table with fast_math_verify().
+///
+/// Precalc code calls the functions through the precalc_* aliases, which map to the fast versions if
+/// PRECALC_FAST_MATH is defined and to libm (dnload) otherwise.
+
+/// Scalar lane.
+class ffloat1
+{
+  public:
+    /// Mask type.
+    typedef bool mask_type;
+
+    /// Number of lanes.
+    static const unsigned LANES = 1;
+
+  private:
+    /// Value.
+    float m_data;
+
+  public:
+    /// Empty constructor.
+    ffloat1()
+    {
+    }
+
+    /// Broadcast constructor.
+    ///
+    /// \param op Value.
+    ffloat1(float op) :
+      m_data(op)
+    {
+    }
+
+  public:
+    /// Accessor.
+    ///
+    /// \return Value.
+    float get() const
+    {
+      return m_data;
+    }
+
+    /// Store to memory.
+    ///
+    /// \param op Destination.
+    void store(float* op) const
+    {
+      *op = m_data;
+    }
+
+    /// Store truncated towards zero to integers (magnitude must be under 2^31).
+    ///
+    /// \param op Destination.
+    void storeInt(int32_t* op) const
+    {
+      *op = static_cast<int32_t>(m_data);
+    }
+
+    /// Load from memory.
+    ///
+    /// \param op Source.
+    /// \return Loaded value.
+    static ffloat1 load(const float* op)
+    {
+      return ffloat1(*op);
+    }
+
+  public:
+    /// Addition operator.
+    friend ffloat1 operator+(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return ffloat1(lhs.m_data + rhs.m_data);
+    }
+    /// Subtraction operator.
+    friend ffloat1 operator-(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return ffloat1(lhs.m_data - rhs.m_data);
+    }
+    /// Multiplication operator.
+    friend ffloat1 operator*(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return ffloat1(lhs.m_data * rhs.m_data);
+    }
+    /// Division operator.
+    friend ffloat1 operator/(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return ffloat1(lhs.m_data / rhs.m_data);
+    }
+    /// Unary minus operator.
+    friend ffloat1 operator-(const ffloat1& op)
+    {
+      return ffloat1(-op.m_data);
+    }
+
+    /// Less than operator.
+    friend bool operator<(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return lhs.m_data < rhs.m_data;
+    }
+    /// Greater than operator.
+    friend bool operator>(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return lhs.m_data > rhs.m_data;
+    }
+    /// Greater than or equal operator.
+    friend bool operator>=(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return lhs.m_data >= rhs.m_data;
+    }
+
+    /// Absolute value.
+    friend ffloat1 vabs(const ffloat1& op)
+    {
+      return ffloat1((op.m_data < 0.0f) ? -op.m_data : op.m_data);
+    }
+    /// Minimum.
+    friend ffloat1 vmin(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return ffloat1((lhs.m_data < rhs.m_data) ? lhs.m_data : rhs.m_data);
+    }
+    /// Maximum.
+    friend ffloat1 vmax(const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return ffloat1((lhs.m_data > rhs.m_data) ? lhs.m_data : rhs.m_data);
+    }
+    /// Square root.
+    friend ffloat1 vsqrt(const ffloat1& op)
+    {
+#if defined(__SSE2__)
+      return ffloat1(_mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(op.m_data))));
+#else
+      return ffloat1(dnload_sqrtf(op.m_data));
+#endif
+    }
+    /// Truncate towards zero (magnitude must be under 2^31).
+    friend ffloat1 vtrunc(const ffloat1& op)
+    {
+      return ffloat1(static_cast<float>(static_cast<int32_t>(op.m_data)));
+    }
+    /// Construct 2^n for integral n in [-126, 127].
+    friend ffloat1 vexp2i(const ffloat1& op)
+    {
+      union
+      {
+        uint32_t u;
+        float f;
+      } ret;
+      ret.u = static_cast<uint32_t>(static_cast<int32_t>(op.m_data) + 127) << 23;
+      return ffloat1(ret.f);
+    }
+    /// Split into mantissa [0.5, 1[ and exponent.
+    friend ffloat1 vfrexp(const ffloat1& op, ffloat1& exponent)
+    {
+      union
+      {
+        uint32_t u;
+        float f;
+      } ret;
+      ret.f = op.m_data;
+      exponent = ffloat1(static_cast<float>(static_cast<int32_t>((ret.u >> 23) & 0xFF) - 126));
+      ret.u = (ret.u & 0x807FFFFFu) | 0x3F000000u;
+      return ffloat1(ret.f);
+    }
+    /// Select by mask.
+    friend ffloat1 vselect(bool mask, const ffloat1& lhs, const ffloat1& rhs)
+    {
+      return mask ? lhs : rhs;
+    }
+    /// Gather from memory, index lanes hold integral values.
+    friend ffloat1 vgather(const float* base, const ffloat1& index)
+    {
+      return ffloat1(base[static_cast<int32_t>(index.m_data)]);
+    }
+};
+
+#if defined(__SSE2__)
+
+/// SSE2 lane.
+class ffloat4
+{
+  public:
+    /// Mask type.
+    typedef __m128 mask_type;
+
+    /// Number of lanes.
+    static const unsigned LANES = 4;
+
+  private:
+    /// Value.
+    __m128 m_data;
+
+  public:
+    /// Empty constructor.
+    ffloat4()
+    {
+    }
+
+    /// Constructor.
+    ///
+    /// \param op Register.
+    explicit ffloat4(__m128 op) :
+      m_data(op)
+    {
+    }
+
+    /// Broadcast constructor.
+    ///
+    /// \param op Value.
+    ffloat4(float op) :
+      m_data(_mm_set1_ps(op))
+    {
+    }
+
+  public:
+    /// Store to memory.
+    ///
+    /// \param op Destination.
+    void store(float* op) const
+    {
+      _mm_storeu_ps(op, m_data);
+    }
+
+    /// Store truncated towards zero to integers (magnitude must be under 2^31).
+    ///
+    /// \param op Destination.
+    void storeInt(int32_t* op) const
+    {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(op), _mm_cvttps_epi32(m_data));
+    }
+
+    /// Load from memory.
+    ///
+    /// \param op Source.
+    /// \return Loaded value.
+    static ffloat4 load(const float* op)
+    {
+      return ffloat4(_mm_loadu_ps(op));
+    }
+
+  public:
+    /// Addition operator.
+    friend ffloat4 operator+(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return ffloat4(_mm_add_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Subtraction operator.
+    friend ffloat4 operator-(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return ffloat4(_mm_sub_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Multiplication operator.
+    friend ffloat4 operator*(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return ffloat4(_mm_mul_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Division operator.
+    friend ffloat4 operator/(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return ffloat4(_mm_div_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Unary minus operator.
+    friend ffloat4 operator-(const ffloat4& op)
+    {
+      return ffloat4(_mm_xor_ps(op.m_data, _mm_set1_ps(-0.0f)));
+    }
+
+    /// Less than operator.
+    friend __m128 operator<(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return _mm_cmplt_ps(lhs.m_data, rhs.m_data);
+    }
+    /// Greater than operator.
+    friend __m128 operator>(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return _mm_cmpgt_ps(lhs.m_data, rhs.m_data);
+    }
+    /// Greater than or equal operator.
+    friend __m128 operator>=(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return _mm_cmpge_ps(lhs.m_data, rhs.m_data);
+    }
+
+    /// Absolute value.
+    friend ffloat4 vabs(const ffloat4& op)
+    {
+      return ffloat4(_mm_andnot_ps(_mm_set1_ps(-0.0f), op.m_data));
+    }
+    /// Minimum.
+    friend ffloat4 vmin(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return ffloat4(_mm_min_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Maximum.
+    friend ffloat4 vmax(const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return ffloat4(_mm_max_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Square root.
+    friend ffloat4 vsqrt(const ffloat4& op)
+    {
+      return ffloat4(_mm_sqrt_ps(op.m_data));
+    }
+    /// Truncate towards zero (magnitude must be under 2^31).
+    friend ffloat4 vtrunc(const ffloat4& op)
+    {
+      return ffloat4(_mm_cvtepi32_ps(_mm_cvttps_epi32(op.m_data)));
+    }
+    /// Construct 2^n for integral n in [-126, 127].
+    friend ffloat4 vexp2i(const ffloat4& op)
+    {
+      __m128i ee = _mm_add_epi32(_mm_cvttps_epi32(op.m_data), _mm_set1_epi32(127));
+      return ffloat4(_mm_castsi128_ps(_mm_slli_epi32(ee, 23)));
+    }
+    /// Split into mantissa [0.5, 1[ and exponent.
+    friend ffloat4 vfrexp(const ffloat4& op, ffloat4& exponent)
+    {
+      __m128i bits = _mm_castps_si128(op.m_data);
+      __m128i ee = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xFF)), _mm_set1_epi32(126));
+      exponent = ffloat4(_mm_cvtepi32_ps(ee));
+      bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(static_cast<int>(0x807FFFFFu))),
+          _mm_set1_epi32(0x3F000000));
+      return ffloat4(_mm_castsi128_ps(bits));
+    }
+    /// Select by mask.
+    friend ffloat4 vselect(__m128 mask, const ffloat4& lhs, const ffloat4& rhs)
+    {
+      return ffloat4(_mm_or_ps(_mm_and_ps(mask, lhs.m_data), _mm_andnot_ps(mask, rhs.m_data)));
+    }
+    /// Gather from memory, index lanes hold integral values.
+    friend ffloat4 vgather(const float* base, const ffloat4& index)
+    {
+      __m128i idx = _mm_cvttps_epi32(index.m_data);
+      return ffloat4(_mm_setr_ps(base[_mm_cvtsi128_si32(idx)],
+            base[_mm_cvtsi128_si32(_mm_shuffle_epi32(idx, 1))],
+            base[_mm_cvtsi128_si32(_mm_shuffle_epi32(idx, 2))],
+            base[_mm_cvtsi128_si32(_mm_shuffle_epi32(idx, 3))]));
+    }
+};
+
+#endif
+
+CPU_KERNELS_BEGIN
+
+#if defined(__AVX2__) || defined(CPU_DISPATCH)
+
+/// AVX2 lane.
+class ffloat8
+{
+  public:
+    /// Mask type.
+    typedef __m256 mask_type;
+
+    /// Number of lanes.
+    static const unsigned LANES = 8;
+
+  private:
+    /// Value.
+    __m256 m_data;
+
+  public:
+    /// Empty constructor.
+    CPU_TARGET_AVX2 ffloat8()
+    {
+    }
+
+    /// Constructor.
+    ///
+    /// \param op Register.
+    CPU_TARGET_AVX2 explicit ffloat8(__m256 op) :
+      m_data(op)
+    {
+    }
+
+    /// Broadcast constructor.
+    ///
+    /// \param op Value.
+    CPU_TARGET_AVX2 ffloat8(float op) :
+      m_data(_mm256_set1_ps(op))
+    {
+    }
+
+  public:
+    /// Store to memory.
+    ///
+    /// \param op Destination.
+    CPU_TARGET_AVX2 void store(float* op) const
+    {
+      _mm256_storeu_ps(op, m_data);
+    }
+
+    /// Store truncated towards zero to integers (magnitude must be under 2^31).
+    ///
+    /// \param op Destination.
+    CPU_TARGET_AVX2 void storeInt(int32_t* op) const
+    {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(op), _mm256_cvttps_epi32(m_data));
+    }
+
+    /// Load from memory.
+    ///
+    /// \param op Source.
+    /// \return Loaded value.
+    CPU_TARGET_AVX2 static ffloat8 load(const float* op)
+    {
+      return ffloat8(_mm256_loadu_ps(op));
+    }
+
+  public:
+    /// Addition operator.
+    CPU_TARGET_AVX2 friend ffloat8 operator+(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return ffloat8(_mm256_add_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Subtraction operator.
+    CPU_TARGET_AVX2 friend ffloat8 operator-(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return ffloat8(_mm256_sub_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Multiplication operator.
+    CPU_TARGET_AVX2 friend ffloat8 operator*(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return ffloat8(_mm256_mul_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Division operator.
+    CPU_TARGET_AVX2 friend ffloat8 operator/(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return ffloat8(_mm256_div_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Unary minus operator.
+    CPU_TARGET_AVX2 friend ffloat8 operator-(const ffloat8& op)
+    {
+      return ffloat8(_mm256_xor_ps(op.m_data, _mm256_set1_ps(-0.0f)));
+    }
+
+    /// Less than operator.
+    CPU_TARGET_AVX2 friend __m256 operator<(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return _mm256_cmp_ps(lhs.m_data, rhs.m_data, _CMP_LT_OQ);
+    }
+    /// Greater than operator.
+    CPU_TARGET_AVX2 friend __m256 operator>(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return _mm256_cmp_ps(lhs.m_data, rhs.m_data, _CMP_GT_OQ);
+    }
+    /// Greater than or equal operator.
+    CPU_TARGET_AVX2 friend __m256 operator>=(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return _mm256_cmp_ps(lhs.m_data, rhs.m_data, _CMP_GE_OQ);
+    }
+
+    /// Absolute value.
+    CPU_TARGET_AVX2 friend ffloat8 vabs(const ffloat8& op)
+    {
+      return ffloat8(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), op.m_data));
+    }
+    /// Minimum.
+    CPU_TARGET_AVX2 friend ffloat8 vmin(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return ffloat8(_mm256_min_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Maximum.
+    CPU_TARGET_AVX2 friend ffloat8 vmax(const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return ffloat8(_mm256_max_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Square root.
+    CPU_TARGET_AVX2 friend ffloat8 vsqrt(const ffloat8& op)
+    {
+      return ffloat8(_mm256_sqrt_ps(op.m_data));
+    }
+    /// Truncate towards zero (magnitude must be under 2^31).
+    CPU_TARGET_AVX2 friend ffloat8 vtrunc(const ffloat8& op)
+    {
+      return ffloat8(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(op.m_data)));
+    }
+    /// Construct 2^n for integral n in [-126, 127].
+    CPU_TARGET_AVX2 friend ffloat8 vexp2i(const ffloat8& op)
+    {
+      __m256i ee = _mm256_add_epi32(_mm256_cvttps_epi32(op.m_data), _mm256_set1_epi32(127));
+      return ffloat8(_mm256_castsi256_ps(_mm256_slli_epi32(ee, 23)));
+    }
+    /// Split into mantissa [0.5, 1[ and exponent.
+    CPU_TARGET_AVX2 friend ffloat8 vfrexp(const ffloat8& op, ffloat8& exponent)
+    {
+      __m256i bits = _mm256_castps_si256(op.m_data);
+      __m256i ee = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xFF)),
+          _mm256_set1_epi32(126));
+      exponent = ffloat8(_mm256_cvtepi32_ps(ee));
+      bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(static_cast<int>(0x807FFFFFu))),
+          _mm256_set1_epi32(0x3F000000));
+      return ffloat8(_mm256_castsi256_ps(bits));
+    }
+    /// Select by mask.
+    CPU_TARGET_AVX2 friend ffloat8 vselect(__m256 mask, const ffloat8& lhs, const ffloat8& rhs)
+    {
+      return ffloat8(_mm256_blendv_ps(rhs.m_data, lhs.m_data, mask));
+    }
+    /// Gather from memory, index lanes hold integral values.
+    CPU_TARGET_AVX2 friend ffloat8 vgather(const float* base, const ffloat8& index)
+    {
+      return ffloat8(_mm256_i32gather_ps(base, _mm256_cvttps_epi32(index.m_data), 4));
+    }
+};
+
+#endif
+
+#if defined(__AVX512F__) || defined(CPU_DISPATCH)
+
+/// AVX-512 lane.
+class ffloat16
+{
+  public:
+    /// Mask type.
+    typedef __mmask16 mask_type;
+
+    /// Number of lanes.
+    static const unsigned LANES = 16;
+
+  private:
+    /// Value.
+    __m512 m_data;
+
+  public:
+    /// Empty constructor.
+    CPU_TARGET_AVX512 ffloat16()
+    {
+    }
+
+    /// Constructor.
+    ///
+    /// \param op Register.
+    CPU_TARGET_AVX512 explicit ffloat16(__m512 op) :
+      m_data(op)
+    {
+    }
+
+    /// Broadcast constructor.
+    ///
+    /// \param op Value.
+    CPU_TARGET_AVX512 ffloat16(float op) :
+      m_data(_mm512_set1_ps(op))
+    {
+    }
+
+  public:
+    /// Store to memory.
+    ///
+    /// \param op Destination.
+    CPU_TARGET_AVX512 void store(float* op) const
+    {
+      _mm512_storeu_ps(op, m_data);
+    }
+
+    /// Store truncated towards zero to integers (magnitude must be under 2^31).
+    ///
+    /// \param op Destination.
+    CPU_TARGET_AVX512 void storeInt(int32_t* op) const
+    {
+      _mm512_storeu_si512(op, _mm512_cvttps_epi32(m_data));
+    }
+
+    /// Load from memory.
+    ///
+    /// \param op Source.
+    /// \return Loaded value.
+    CPU_TARGET_AVX512 static ffloat16 load(const float* op)
+    {
+      return ffloat16(_mm512_loadu_ps(op));
+    }
+
+  public:
+    /// Addition operator.
+    CPU_TARGET_AVX512 friend ffloat16 operator+(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return ffloat16(_mm512_add_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Subtraction operator.
+    CPU_TARGET_AVX512 friend ffloat16 operator-(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return ffloat16(_mm512_sub_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Multiplication operator.
+    CPU_TARGET_AVX512 friend ffloat16 operator*(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return ffloat16(_mm512_mul_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Division operator.
+    CPU_TARGET_AVX512 friend ffloat16 operator/(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return ffloat16(_mm512_div_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Unary minus operator.
+    CPU_TARGET_AVX512 friend ffloat16 operator-(const ffloat16& op)
+    {
+      return ffloat16(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(op.m_data),
+              _mm512_set1_epi32(static_cast<int>(0x80000000u)))));
+    }
+
+    /// Less than operator.
+    CPU_TARGET_AVX512 friend __mmask16 operator<(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return _mm512_cmp_ps_mask(lhs.m_data, rhs.m_data, _CMP_LT_OQ);
+    }
+    /// Greater than operator.
+    CPU_TARGET_AVX512 friend __mmask16 operator>(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return _mm512_cmp_ps_mask(lhs.m_data, rhs.m_data, _CMP_GT_OQ);
+    }
+    /// Greater than or equal operator.
+    CPU_TARGET_AVX512 friend __mmask16 operator>=(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return _mm512_cmp_ps_mask(lhs.m_data, rhs.m_data, _CMP_GE_OQ);
+    }
+
+    /// Absolute value.
+    CPU_TARGET_AVX512 friend ffloat16 vabs(const ffloat16& op)
+    {
+      return ffloat16(_mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(op.m_data),
+              _mm512_set1_epi32(0x7FFFFFFF))));
+    }
+    /// Minimum.
+    CPU_TARGET_AVX512 friend ffloat16 vmin(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return ffloat16(_mm512_min_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Maximum.
+    CPU_TARGET_AVX512 friend ffloat16 vmax(const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return ffloat16(_mm512_max_ps(lhs.m_data, rhs.m_data));
+    }
+    /// Square root.
+    CPU_TARGET_AVX512 friend ffloat16 vsqrt(const ffloat16& op)
+    {
+      return ffloat16(_mm512_sqrt_ps(op.m_data));
+    }
+    /// Truncate towards zero (magnitude must be under 2^31).
+    CPU_TARGET_AVX512 friend ffloat16 vtrunc(const ffloat16& op)
+    {
+      return ffloat16(_mm512_cvtepi32_ps(_mm512_cvttps_epi32(op.m_data)));
+    }
+    /// Construct 2^n for integral n in [-126, 127].
+    CPU_TARGET_AVX512 friend ffloat16 vexp2i(const ffloat16& op)
+    {
+      __m512i ee = _mm512_add_epi32(_mm512_cvttps_epi32(op.m_data), _mm512_set1_epi32(127));
+      return ffloat16(_mm512_castsi512_ps(_mm512_slli_epi32(ee, 23)));
+    }
+    /// Split into mantissa [0.5, 1[ and exponent.
+    CPU_TARGET_AVX512 friend ffloat16 vfrexp(const ffloat16& op, ffloat16& exponent)
+    {
+      __m512i bits = _mm512_castps_si512(op.m_data);
+      __m512i ee = _mm512_sub_epi32(_mm512_and_si512(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(0xFF)),
+          _mm512_set1_epi32(126));
+      exponent = ffloat16(_mm512_cvtepi32_ps(ee));
+      bits = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(static_cast<int>(0x807FFFFFu))),
+          _mm512_set1_epi32(0x3F000000));
+      return ffloat16(_mm512_castsi512_ps(bits));
+    }
+    /// Select by mask.
+    CPU_TARGET_AVX512 friend ffloat16 vselect(__mmask16 mask, const ffloat16& lhs, const ffloat16& rhs)
+    {
+      return ffloat16(_mm512_mask_blend_ps(mask, rhs.m_data, lhs.m_data));
+    }
+    /// Gather from memory, index lanes hold integral values.
+    CPU_TARGET_AVX512 friend ffloat16 vgather(const float* base, const ffloat16& index)
+    {
+      return ffloat16(_mm512_i32gather_ps(_mm512_cvttps_epi32(index.m_data), base, 4));
+    }
+};
+
+#endif
+
+CPU_KERNELS_END
+
+/// Widest lane type available at compile time.
+#if defined(__AVX512F__)
+typedef ffloat16 ffloat_native;
+#elif defined(__AVX2__)
+typedef ffloat8 ffloat_native;
+#elif defined(__SSE2__)
+typedef ffloat4 ffloat_native;
+#else
+typedef ffloat1 ffloat_native;
+#endif
+
+#if defined(CPU_DISPATCH)
+CPU_KERNELS_BEGIN
+/// Run a lane kernel with AVX2 lanes.
+///
+/// \param func Kernel functor.
+template<typename F> CPU_TARGET_AVX2 CPU_FLATTEN void ffloat_dispatch_avx2(F& func)
+{
+  func.template run<ffloat8>();
+}
+
+/// Run a lane kernel with AVX-512 lanes.
+///
+/// \param func Kernel functor.
+template<typename F> CPU_TARGET_AVX512 CPU_FLATTEN void ffloat_dispatch_avx512(F& func)
+{
+  func.template run<ffloat16>();
+}
+CPU_KERNELS_END
+#endif
+
+/// Run a lane kernel with the widest lanes of the selected CPU level.
+///
+/// The functor must have a member function template run<V>(), instanced for every lane type.
+///
+/// \param func Kernel functor.
+template<typename F> void ffloat_dispatch(F& func)
+{
+#if defined(CPU_DISPATCH)
+  if(g_cpu_level >= CPU_LEVEL_AVX512)
+  {
+    ffloat_dispatch_avx512(func);
+    return;
+  }
+  if(g_cpu_level >= CPU_LEVEL_AVX2)
+  {
+    ffloat_dispatch_avx2(func);
+    return;
+  }
+#endif
+  func.template run<ffloat_native>();
+}
+
+/// Sine/cosine polynomials on a reduced argument.
+///
+/// \param op Argument.
+/// \param quadrant [out] Octant index (0, 2, 4 or 6) of the argument.
+/// \param sin_poly [out] Sine polynomial.
+/// \param cos_poly [out] Cosine polynomial.
+template<typename V> static void fast_sincos_poly(const V& op, V& octant, V& sin_poly, V& cos_poly)
+{
+  const float FOUR_OVER_PI = 1.27323954473516f;
+  const float DP1 = 0.78515625f;
+  const float DP2 = 2.4187564849853515625e-4f;
+  const float DP3 = 3.77489497744594108e-8f;
+
+  // Round octant up to even so the reduced argument is in [-pi/4, pi/4].
+  V jj = vtrunc(op * FOUR_OVER_PI);
+  jj = vtrunc((jj + 1.0f) * 0.5f) * 2.0f;
+  V rr = ((op - jj * DP1) - jj * DP2) - jj * DP3;
+  V zz = rr * rr;
+
+  octant = jj - vtrunc(jj * 0.125f) * 8.0f;
+  sin_poly = ((-1.9515295891e-4f * zz + 8.3321608736e-3f) * zz - 1.6666654611e-1f) * zz * rr + rr;
+  cos_poly = ((2.443315711809948e-5f * zz - 1.388731625493765e-3f) * zz + 4.166664568298827e-2f) * zz * zz -
+    0.5f * zz + 1.0f;
+}
+
+/// Sine kernel.
+///
+/// \param op Argument.
+/// \return Sine.
+template<typename V> static V fast_sin_kernel(const V& op)
+{
+  V octant;
+  V sin_poly;
+  V cos_poly;
+  fast_sincos_poly(vabs(op), octant, sin_poly, cos_poly);
+
+  // Octants 2 and 6 use cosine, octants 4 and 6 are negative.
+  V half = octant - vselect(octant >= 4.0f, V(4.0f), V(0.0f));
+  V ret = vselect(half > 1.0f, cos_poly, sin_poly);
+  ret = vselect(octant >= 4.0f, -ret, ret);
+  return vselect(op < 0.0f, -ret, ret);
+}
+
+/// Cosine kernel.
+///
+/// \param op Argument.
+/// \return Cosine.
+template<typename V> static V fast_cos_kernel(const V& op)
+{
+  V octant;
+  V sin_poly;
+  V cos_poly;
+  fast_sincos_poly(vabs(op), octant, sin_poly, cos_poly);
+
+  // Octants 2 and 6 use sine, octants 2 and 4 are negative.
+  V half = octant - vselect(octant >= 4.0f, V(4.0f), V(0.0f));
+  V ret = vselect(half > 1.0f, sin_poly, cos_poly);
+  V dist = octant - 3.0f;
+  return vselect((dist * dist) < 5.0f, -ret, ret);
+}
+
+/// Exponent kernel.
+///
+/// \param op Argument.
+/// \return e^op.
+template<typename V> static V fast_exp_kernel(const V& op)
+{
+  const float LOG2E = 1.44269504088896341f;
+  const float C1 = 0.693359375f;
+  const float C2 = -2.12194440e-4f;
+
+  V xx = vmax(vmin(op, 88.0f), -87.0f);
+
+  // Round to nearest integer power of two.
+  V fx = xx * LOG2E + 0.5f;
+  V nn = vtrunc(fx);
+  nn = nn - vselect(nn > fx, V(1.0f), V(0.0f));
+
+  xx = xx - nn * C1 - nn * C2;
+  V zz = xx * xx;
+  V ret = (((((1.9875691500e-4f * xx + 1.3981999507e-3f) * xx + 8.3334519073e-3f) * xx + 4.1665795894e-2f) * xx +
+        1.6666665459e-1f) * xx + 5.0000001201e-1f) * zz + xx + 1.0f;
+  return ret * vexp2i(nn);
+}
+
+/// Natural logarithm kernel.
+///
+/// \param op Argument (positive, normal).
+/// \return log(op).
+template<typename V> static V fast_log_kernel(const V& op)
+{
+  const float SQRTHF = 0.707106781186547524f;
+  const float C1 = 0.693359375f;
+  const float C2 = -2.12194440e-4f;
+
+  V ee;
+  V xx = vfrexp(op, ee);
+
+  // Shift mantissa to [sqrt(0.5), sqrt(2)[.
+  typename V::mask_type small = xx < SQRTHF;
+  ee = ee - vselect(small, V(1.0f), V(0.0f));
+  xx = xx + vselect(small, xx, V(0.0f)) - 1.0f;
+
+  V zz = xx * xx;
+  V yy = ((((((((7.0376836292e-2f * xx - 1.1514610310e-1f) * xx + 1.1676998740e-1f) * xx - 1.2420140846e-1f) * xx +
+              1.4249322787e-1f) * xx - 1.6668057665e-1f) * xx + 2.0000714765e-1f) * xx - 2.4999993993e-1f) * xx +
+      3.3333331174e-1f) * xx * zz;
+  yy = yy + ee * C2;
+  yy = yy - zz * 0.5f;
+  return xx + yy + ee * C1;
+}
+
+/// Power kernel.
+///
+/// \param op Base (positive or zero).
+/// \param exponent Exponent.
+/// \return op^exponent.
+template<typename V> static V fast_pow_kernel(const V& op, const V& exponent)
+{
+  V ret = fast_exp_kernel(exponent * fast_log_kernel(vmax(op, 1.17549435e-38f)));
+  return vselect(op > 0.0f, ret, V(0.0f));
+}
+
+/// Hyperbolic tangent kernel.
+///
+/// \param op Argument.
+/// \return tanh(op).
+template<typename V> static V fast_tanh_kernel(const V& op)
+{
+  V ax = vabs(op);
+
+  // tanh(9) rounds to 1.
+  V large = 1.0f - 2.0f / (fast_exp_kernel(vmin(ax, 9.0f) * 2.0f) + 1.0f);
+  large = vselect(op < 0.0f, -large, large);
+
+  V zz = op * op;
+  V small = ((((-5.70498872745e-3f * zz + 2.06390887954e-2f) * zz - 5.37397155531e-2f) * zz +
+        1.33314422036e-1f) * zz - 3.33332819422e-1f) * zz * op + op;
+  return vselect(ax >= 0.625f, large, small);
+}
+
+/// Arc sine kernel.
+///
+/// \param op Argument.
+/// \return asin(op).
+template<typename V> static V fast_asin_kernel(const V& op)
+{
+  const float PIO2 = 1.5707963267948966192f;
+
+  V ax = vabs(op);
+  typename V::mask_type large = ax > 0.5f;
+  V zz = vselect(large, (1.0f - ax) * 0.5f, ax * ax);
+  V xx = vselect(large, vsqrt(zz), ax);
+
+  V ret = ((((4.2163199048e-2f * zz + 2.4181311049e-2f) * zz + 4.5470025998e-2f) * zz + 7.4953002686e-2f) * zz +
+      1.6666752422e-1f) * zz * xx + xx;
+  ret = vselect(large, PIO2 - (ret + ret), ret);
+  return vselect(op < 0.0f, -ret, ret);
+}
+
+/// Functor for sine kernel.
+struct FastSinKernel
+{
+  template<typename V> V operator()(const V& op) const
+  {
+    return fast_sin_kernel(op);
+  }
+};
+
+/// Functor for cosine kernel.
+struct FastCosKernel
+{
+  template<typename V> V operator()(const V& op) const
+  {
+    return fast_cos_kernel(op);
+  }
+};
+
+/// Functor for exponent kernel.
+struct FastExpKernel
+{
+  template<typename V> V operator()(const V& op) const
+  {
+    return fast_exp_kernel(op);
+  }
+};
+
+/// Functor for logarithm kernel.
+struct FastLogKernel
+{
+  template<typename V> V operator()(const V& op) const
+  {
+    return fast_log_kernel(op);
+  }
+};
+
+/// Functor for hyperbolic tangent kernel.
+struct FastTanhKernel
+{
+  template<typename V> V operator()(const V& op) const
+  {
+    return fast_tanh_kernel(op);
+  }
+};
+
+/// Functor for arc sine kernel.
+struct FastAsinKernel
+{
+  template<typename V> V operator()(const V& op) const
+  {
+    return fast_asin_kernel(op);
+  }
+};
+
+/// Functor for square root.
+struct FastSqrtKernel
+{
+  template<typename V> V operator()(const V& op) const
+  {
+    return vsqrt(op);
+  }
+};
+
+/// Apply a kernel over an array.
+///
+/// \param dst Destination array.
+/// \param src Source array (may be the same as destination).
+/// \param count Number of elements.
+/// \param kernel Kernel functor.
+template<typename V, typename K> static void fast_math_apply(float* dst, const float* src, unsigned count,
+    const K& kernel)
+{
+  unsigned ii = 0;
+
+  for(; (ii + V::LANES <= count); ii += V::LANES)
+  {
+    kernel(V::load(src + ii)).store(dst + ii);
+  }
+  for(; (ii < count); ++ii)
+  {
+    dst[ii] = kernel(ffloat1(src[ii])).get();
+  }
+}
+
+/// Apply a power kernel over arrays.
+///
+/// \param dst Destination array.
+/// \param base Base array.
+/// \param exponent Exponent array.
+/// \param count Number of elements.
+template<typename V> static void fast_math_apply_pow(float* dst, const float* base, const float* exponent,
+    unsigned count)
+{
+  unsigned ii = 0;
+
+  for(; (ii + V::LANES <= count); ii += V::LANES)
+  {
+    fast_pow_kernel(V::load(base + ii), V::load(exponent + ii)).store(dst + ii);
+  }
+  for(; (ii < count); ++ii)
+  {
+    dst[ii] = fast_pow_kernel(ffloat1(base[ii]), ffloat1(exponent[ii])).get();
+  }
+}
+
+/// Fast sine.
+///
+/// \param op Argument.
+/// \return Result.
+inline float fast_sinf(float op)
+{
+  return fast_sin_kernel(ffloat1(op)).get();
+}
+
+/// Fast cosine.
+///
+/// \param op Argument.
+/// \return Result.
+inline float fast_cosf(float op)
+{
+  return fast_cos_kernel(ffloat1(op)).get();
+}
+
+/// Fast exponent.
+///
+/// \param op Argument.
+/// \return Result.
+inline float fast_expf(float op)
+{
+  return fast_exp_kernel(ffloat1(op)).get();
+}
+
+/// Fast natural logarithm.
+///
+/// \param op Argument.
+/// \return Result.
+inline float fast_logf(float op)
+{
+  return fast_log_kernel(ffloat1(op)).get();
+}
+
+/// Fast power.
+///
+/// \param op Base.
+/// \param exponent Exponent.
+/// \return Result.
+inline float fast_powf(float op, float exponent)
+{
+  return fast_pow_kernel(ffloat1(op), ffloat1(exponent)).get();
+}
+
+/// Fast hyperbolic tangent.
+///
+/// \param op Argument.
+/// \return Result.
+inline float fast_tanhf(float op)
+{
+  return fast_tanh_kernel(ffloat1(op)).get();
+}
+
+/// Fast arc sine.
+///
+/// \param op Argument.
+/// \return Result.
+inline float fast_asinf(float op)
+{
+  return fast_asin_kernel(ffloat1(op)).get();
+}
+
+/// Fast square root.
+///
+/// \param op Argument.
+/// \return Result.
+inline float fast_sqrtf(float op)
+{
+  return vsqrt(ffloat1(op)).get();
+}
+
+/// Fast sine over an array.
+///
+/// \param dst Destination array.
+/// \param src Source array.
+/// \param count Number of elements.
+inline void fast_sinf_array(float* dst, const float* src, unsigned count)
+{
+  fast_math_apply<ffloat_native>(dst, src, count, FastSinKernel());
+}
+
+/// Fast cosine over an array.
+///
+/// \param dst Destination array.
+/// \param src Source array.
+/// \param count Number of elements.
+inline void fast_cosf_array(float* dst, const float* src, unsigned count)
+{
+  fast_math_apply<ffloat_native>(dst, src, count, FastCosKernel());
+}
+
+/// Fast exponent over an array.
+///
+/// \param dst Destination array.
+/// \param src Source array.
+/// \param count Number of elements.
+inline void fast_expf_array(float* dst, const float* src, unsigned count)
+{
+  fast_math_apply<ffloat_native>(dst, src, count, FastExpKernel());
+}
+
+/// Fast natural logarithm over an array.
+///
+/// \param dst Destination array.
+/// \param src Source array.
+/// \param count Number of elements.
+inline void fast_logf_array(float* dst, const float* src, unsigned count)
+{
+  fast_math_apply<ffloat_native>(dst, src, count, FastLogKernel());
+}
+
+/// Fast power over arrays.
+///
+/// \param dst Destination array.
+/// \param base Base array.
+/// \param exponent Exponent array.
+/// \param count Number of elements.
+inline void fast_powf_array(float* dst, const float* base, const float* exponent, unsigned count)
+{
+  fast_math_apply_pow<ffloat_native>(dst, base, exponent, count);
+}
+
+/// Fast hyperbolic tangent over an array.
+///
+/// \param dst Destination array.
+/// \param src Source array.
+/// \param count Number of elements.
+inline void fast_tanhf_array(float* dst, const float* src, unsigned count)
+{
+  fast_math_apply<ffloat_native>(dst, src, count, FastTanhKernel());
+}
+
+/// Fast arc sine over an array.
+///
+/// \param dst Destination array.
+/// \param src Source array.
+/// \param count Number of elements.
+inline void fast_asinf_array(float* dst, const float* src, unsigned count)
+{
+  fast_math_apply<ffloat_native>(dst, src, count, FastAsinKernel());
+}
+
+/// Fast square root over an array.
+///
+/// \param dst Destination array.
+/// \param src Source array.
+/// \param count Number of elements.
+inline void fast_sqrtf_array(float* dst, const float* src, unsigned count)
+{
+  fast_math_apply<ffloat_native>(dst, src, count, FastSqrtKernel());
+}
+
+#if defined(USE_LD)
+
+/// Distance between two floats in ULPs.
+///
+/// \param lhs Left-hand-side operand.
+/// \param rhs Right-hand-side operand.
+/// \return Distance in ULPs.
+inline int64_t fast_math_ulp_distance(float lhs, float rhs)
+{
+  union
+  {
+    float f;
+    int32_t i;
+  } ll, rr;
+  ll.f = lhs;
+  rr.f = rhs;
+  int64_t li = (ll.i < 0) ? (static_cast<int64_t>(INT32_MIN) - ll.i) : ll.i;
+  int64_t ri = (rr.i < 0) ? (static_cast<int64_t>(INT32_MIN) - rr.i) : rr.i;
+  return (li > ri) ? (li - ri) : (ri - li);
+}
+
+/// Verify one fast math function against libm.
+///
+/// Both scalar and widest SIMD path are checked over an evenly spaced sweep of the domain. A result is
+/// accepted if it is within the ULP bound or within the absolute error bound.
+///
+/// \param name Function name.
+/// \param domain_min Domain minimum.
+/// \param domain_max Domain maximum.
+/// \param max_ulp ULP error bound.
+/// \param max_abs Absolute error bound.
+/// \param kernel Kernel functor.
+/// \param reference Double precision libm reference.
+/// \return True if within bounds.
+template<typename K> bool fast_math_verify_function(const char* name, float domain_min, float domain_max,
+    int64_t max_ulp, float max_abs, const K& kernel, double (*reference)(double))
+{
+  const unsigned SAMPLES = 1 << 22;
+  const unsigned BLOCK = 1024;
+  float src[BLOCK];
+  float dst[BLOCK];
+  int64_t worst_scalar = 0;
+  int64_t worst_simd = 0;
+  bool ret = true;
+
+  for(unsigned ii = 0; (ii < SAMPLES); ii += BLOCK)
+  {
+    for(unsigned jj = 0; (jj < BLOCK); ++jj)
+    {
+      float ratio = static_cast<float>(ii + jj) / static_cast<float>(SAMPLES - 1);
+      src[jj] = domain_min + (domain_max - domain_min) * std::min(ratio, 1.0f);
+    }
+    fast_math_apply<ffloat_native>(dst, src, BLOCK, kernel);
+
+    for(unsigned jj = 0; (jj < BLOCK); ++jj)
+    {
+      float expected = static_cast<float>(reference(static_cast<double>(src[jj])));
+      float scalar = kernel(ffloat1(src[jj])).get();
+      int64_t ulp_scalar = fast_math_ulp_distance(scalar, expected);
+      int64_t ulp_simd = fast_math_ulp_distance(dst[jj], expected);
+
+      if(((ulp_scalar > max_ulp) && (std::abs(scalar - expected) > max_abs)) ||
+          ((ulp_simd > max_ulp) && (std::abs(dst[jj] - expected) > max_abs)))
+      {
+        ret = false;
+      }
+      worst_scalar = std::max(worst_scalar, ulp_scalar);
+      worst_simd = std::max(worst_simd, ulp_simd);
+    }
+  }
+
+  std::cout << std::setw(6) << name << " [" << domain_min << ", " << domain_max << "]: max ULP " <<
+    worst_scalar << " (scalar), " << worst_simd << " (" << ffloat_native::LANES << " lanes), bound " << max_ulp;
+  if(max_abs > 0.0f)
+  {
+    std::cout << " or " << max_abs << " absolute";
+  }
+  std::cout << (ret ? ": ok" : ": FAIL") << std::endl;
+  return ret;
+}
+
+/// Verify fast math power function against libm.
+///
+/// \param exponent Exponent to test.
+/// \return True if within bounds.
+inline bool fast_math_verify_pow(float exponent)
+{
+  const unsigned SAMPLES = 1 << 20;
+  const float DOMAIN_MIN = 0.001f;
+  const float DOMAIN_MAX = 100.0f;
+  int64_t worst = 0;
+  bool ret = true;
+
+  for(unsigned ii = 0; (ii < SAMPLES); ++ii)
+  {
+    float ratio = static_cast<float>(ii) / static_cast<float>(SAMPLES - 1);
+    float base = DOMAIN_MIN + (DOMAIN_MAX - DOMAIN_MIN) * ratio;
+    float expected = static_cast<float>(std::pow(static_cast<double>(base), static_cast<double>(exponent)));
+    int64_t ulp = fast_math_ulp_distance(fast_powf(base, exponent), expected);
+    float bound = 2.0f + 2.0f * std::abs(exponent * std::log(base));
+
+    if(static_cast<float>(ulp) > bound)
+    {
+      ret = false;
+    }
+    worst = std::max(worst, ulp);
+  }
+
+  std::cout << "   pow [" << DOMAIN_MIN << ", " << DOMAIN_MAX << "]^" << exponent << ": max ULP " << worst <<
+    (ret ? ": ok" : ": FAIL") << std::endl;
+  return ret;
+}
+
+/// Verify all fast math functions against libm.
+///
+/// \return True if all functions are within their documented error bounds.
+inline bool fast_math_verify()
+{
+  bool ret = true;
+
+  ret = fast_math_verify_function("sin", -100.0f, 100.0f, 2, 6e-8f, FastSinKernel(), std::sin) && ret;
+  ret = fast_math_verify_function("sin", -8192.0f, 8192.0f, 2, 6e-8f, FastSinKernel(), std::sin) && ret;
+  ret = fast_math_verify_function("cos", -100.0f, 100.0f, 2, 6e-8f, FastCosKernel(), std::cos) && ret;
+  ret = fast_math_verify_function("cos", -8192.0f, 8192.0f, 2, 6e-8f, FastCosKernel(), std::cos) && ret;
+  ret = fast_math_verify_function("exp", -87.0f, 88.0f, 1, 0.0f, FastExpKernel(), std::exp) && ret;
+  ret = fast_math_verify_function("log", 1e-30f, 1e30f, 1, 0.0f, FastLogKernel(), std::log) && ret;
+  ret = fast_math_verify_function("log", 0.01f, 10.0f, 1, 0.0f, FastLogKernel(), std::log) && ret;
+  ret = fast_math_verify_function("tanh", -20.0f, 20.0f, 1, 0.0f, FastTanhKernel(), std::tanh) && ret;
+  ret = fast_math_verify_function("asin", -1.0f, 1.0f, 2, 0.0f, FastAsinKernel(), std::asin) && ret;
+  ret = fast_math_verify_function("sqrt", 0.0f, 1e6f, 0, 0.0f, FastSqrtKernel(), std::sqrt) && ret;
+  ret = fast_math_verify_pow(2.0f) && ret;
+  ret = fast_math_verify_pow(0.5f) && ret;
+  ret = fast_math_verify_pow(3.7f) && ret;
+
+  return ret;
+}
+
+#endif
+
+#if defined(PRECALC_FAST_MATH)
+#define precalc_asinf fast_asinf
+#define precalc_cosf fast_cosf
+#define precalc_powf fast_powf
+#define precalc_sinf fast_sinf
+#define precalc_sqrtf fast_sqrtf
+#define precalc_tanhf fast_tanhf
+#else
+#define precalc_asinf dnload_asinf
+#define precalc_cosf dnload_cosf
+#define precalc_powf dnload_powf
+#define precalc_sinf dnload_sinf
+#define precalc_sqrtf dnload_sqrtf
+#define precalc_tanhf dnload_tanhf
+#endif
+
+#endif
@@ -10,6 +10,11 @@ class FrameBuffer
     /// Current render target.
     static FrameBuffer const *g_current_frame_buffer;
 
+#if defined(USE_LD)
+    /// Framebuffer standing in for the window, 0 to render into the window.
+    static GLuint g_default_frame_buffer_id;
+#endif
+
   private:
     /// Framebuffer id.
     GLuint m_id;
@@ -42,9 +47,10 @@ class FrameBuffer
     /// \param bpc Bytes per pixel (default: 2).
     /// \param filtering Filtering mode (default: BILINEAR).
     /// \param wrap Wrap mode (default: CLAMP).
+    /// \param channels Color texture channel count (default: 4).
     explicit FrameBuffer(unsigned width, unsigned height, bool color_texture = true,
         bool depth_texture = false, unsigned bpc = 2, FilteringMode filtering = BILINEAR,
-        WrapMode wrap = CLAMP) :
+        WrapMode wrap = CLAMP, unsigned channels = 4) :
       m_id(0),
       m_depth_buffer(0),
       m_width(width),
@@ -61,7 +67,7 @@ class FrameBuffer
 
       if(color_texture)
       {
-        m_color_texture.update(width, height, 4, bpc, filtering, wrap);
+        m_color_texture.update(width, height, channels, bpc, filtering, wrap);
       }
       if(depth_texture)
       {
@@ -153,6 +159,14 @@ class FrameBuffer
       return m_color_texture;
     }
 
+    /// Accessor.
+    ///
+    /// \return Get attached texture.
+    Texture& getTextureColor()
+    {
+      return m_color_texture;
+    }
+
     /// Accessor.
     ///
     /// \return Get attached texture.
@@ -183,7 +197,19 @@ class FrameBuffer
     /// \return ID of currently bound render target or 0.
     static unsigned get_current_frame_buffer_id()
     {
-      return g_current_frame_buffer ? g_current_frame_buffer->getId() : 0;
+      return g_current_frame_buffer ? g_current_frame_buffer->getId() : get_default_frame_buffer_id();
+    }
+
+    /// Get default render target id.
+    ///
+    /// \return ID of the render target standing in for the window or 0.
+    static unsigned get_default_frame_buffer_id()
+    {
+#if defined(USE_LD)
+      return g_default_frame_buffer_id;
+#else
+      return 0;
+#endif
     }
 
   public:
@@ -195,13 +221,36 @@ class FrameBuffer
     {
       if(g_current_frame_buffer)
       {
-        dnload_glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        dnload_glBindFramebuffer(GL_FRAMEBUFFER, get_default_frame_buffer_id());
         dnload_glViewport(0, 0, static_cast<GLsizei>(screen_width), static_cast<GLsizei>(screen_height));
         g_current_frame_buffer = NULL;
       }
     }
+
+#if defined(USE_LD)
+    /// Render into given framebuffer instead of the window.
+    ///
+    /// Binding the default framebuffer binds the given framebuffer from now on.
+    ///
+    /// \param op Framebuffer to use in place of the window, NULL to render into the window again.
+    static void replace_default_frame_buffer(const FrameBuffer* op)
+    {
+      g_default_frame_buffer_id = op ? op->getId() : 0;
+      if(!g_current_frame_buffer)
+      {
+        glBindFramebuffer(GL_FRAMEBUFFER, g_default_frame_buffer_id);
+        if(op)
+        {
+          glViewport(0, 0, static_cast<GLsizei>(op->getWidth()), static_cast<GLsizei>(op->getHeight()));
+        }
+      }
+    }
+#endif
 };
 
 const FrameBuffer *FrameBuffer::g_current_frame_buffer = NULL;
+#if defined(USE_LD)
+GLuint FrameBuffer::g_default_frame_buffer_id = 0;
+#endif
 
 #endif
@@ -1,6 +1,8 @@
 #ifndef VERBATIM_IMAGE_HPP
 #define VERBATIM_IMAGE_HPP
 
+#include "verbatim_cancel.hpp"
+#include "verbatim_fast_math.hpp"
 #include "verbatim_gl.hpp"
 #include "verbatim_uarr.hpp"
 
@@ -17,6 +19,179 @@ class Image
     /// Number of channels.
     unsigned m_channel_count;
 
+    /// Are channels stored in separate planes (as opposed to interleaved)?
+    bool m_planar;
+
+  private:
+    /// Kernel for minimum and maximum of contiguous data.
+    struct MinMaxKernel
+    {
+      /// Data.
+      const float* m_data;
+
+      /// Element count.
+      unsigned m_count;
+
+      /// Minimum value.
+      float m_min;
+
+      /// Maximum value.
+      float m_max;
+
+      /// Constructor.
+      ///
+      /// \param data Data.
+      /// \param count Element count.
+      /// \param min_value Initial minimum value.
+      /// \param max_value Initial maximum value.
+      explicit MinMaxKernel(const float* data, unsigned count, float min_value, float max_value) :
+        m_data(data),
+        m_count(count),
+        m_min(min_value),
+        m_max(max_value)
+      {
+      }
+
+      /// Run the kernel.
+      template<typename V> void run()
+      {
+        unsigned ii = 0;
+
+        if(m_count >= V::LANES)
+        {
+          V lmin(m_min);
+          V lmax(m_max);
+
+          for(; (ii + V::LANES <= m_count); ii += V::LANES)
+          {
+            V val = V::load(m_data + ii);
+
+            lmin = vmin(val, lmin);
+            lmax = vmax(val, lmax);
+          }
+
+          float lane_min[V::LANES];
+          float lane_max[V::LANES];
+          lmin.store(lane_min);
+          lmax.store(lane_max);
+          for(unsigned jj = 0; (jj < V::LANES); ++jj)
+          {
+            m_min = std::min(lane_min[jj], m_min);
+            m_max = std::max(lane_max[jj], m_max);
+          }
+        }
+
+        for(; (ii < m_count); ++ii)
+        {
+          float val = m_data[ii];
+
+          m_min = std::min(val, m_min);
+          m_max = std::max(val, m_max);
+        }
+      }
+    };
+
+    /// Kernel for scaling contiguous data.
+    struct ScaleKernel
+    {
+      /// Data.
+      float* m_data;
+
+      /// Element count.
+      unsigned m_count;
+
+      /// Multiplier.
+      float m_mul;
+
+      /// Addition after multiplication.
+      float m_add;
+
+      /// Constructor.
+      ///
+      /// \param data Data.
+      /// \param count Element count.
+      /// \param mul Multiplier.
+      /// \param add Addition after multiplication.
+      explicit ScaleKernel(float* data, unsigned count, float mul, float add) :
+        m_data(data),
+        m_count(count),
+        m_mul(mul),
+        m_add(add)
+      {
+      }
+
+      /// Run the kernel.
+      template<typename V> void run()
+      {
+        V mul(m_mul);
+        V add(m_add);
+        unsigned ii = 0;
+
+        for(; (ii + V::LANES <= m_count); ii += V::LANES)
+        {
+          ((V::load(m_data + ii) * mul) + add).store(m_data + ii);
+        }
+        for(; (ii < m_count); ++ii)
+        {
+          m_data[ii] = (m_data[ii] * m_mul) + m_add;
+        }
+      }
+    };
+
+    /// Kernel for converting contiguous data to UNORM.
+    template<typename T> struct ExportKernel
+    {
+      /// Destination data.
+      T* m_dst;
+
+      /// Source data.
+      const float* m_src;
+
+      /// Element count.
+      unsigned m_count;
+
+      /// Maximum UNORM value.
+      float m_mul;
+
+      /// Constructor.
+      ///
+      /// \param dst Destination data.
+      /// \param src Source data.
+      /// \param count Element count.
+      /// \param mul Maximum UNORM value.
+      explicit ExportKernel(T* dst, const float* src, unsigned count, float mul) :
+        m_dst(dst),
+        m_src(src),
+        m_count(count),
+        m_mul(mul)
+      {
+      }
+
+      /// Run the kernel.
+      template<typename V> void run()
+      {
+        V zero(0.0f);
+        V one(1.0f);
+        V half(0.5f);
+        V mul(m_mul);
+        int32_t converted[V::LANES];
+        unsigned ii = 0;
+
+        for(; (ii + V::LANES <= m_count); ii += V::LANES)
+        {
+          (half + vmin(vmax(V::load(m_src + ii), zero), one) * mul).storeInt(converted);
+          for(unsigned jj = 0; (jj < V::LANES); ++jj)
+          {
+            m_dst[ii + jj] = static_cast<T>(converted[jj]);
+          }
+        }
+        for(; (ii < m_count); ++ii)
+        {
+          m_dst[ii] = static_cast<T>(0.5f + clamp(m_src[ii], 0.0f, 1.0f) * m_mul);
+        }
+      }
+    };
+
   private:
     /// Deleted copy constructor.
     Image(const Image&) = delete;
@@ -28,14 +203,56 @@ class Image
     ///
     /// \param texel_count Number of texels.
     /// \param channel_count Number of channels.
-    explicit Image(unsigned texel_count, unsigned channel_count) :
+    /// \param planar True to store channels in separate planes (default: false).
+    explicit Image(unsigned texel_count, unsigned channel_count, bool planar = false) :
       m_data(texel_count * channel_count),
       m_texel_count(texel_count),
-      m_channel_count(channel_count)
+      m_channel_count(channel_count),
+      m_planar(planar)
+    {
+    }
+
+  private:
+    /// Get the first index and index stride of a channel.
+    ///
+    /// \param channel Channel.
+    /// \param stride [out] Distance between consecutive texels of the channel.
+    /// \return Index of the first texel of the channel.
+    unsigned getChannelStart(unsigned channel, unsigned& stride) const
     {
+#if defined(USE_LD)
+      if(channel >= m_channel_count)
+      {
+        std::ostringstream sstr;
+        sstr << "trying to access channel " << channel << " in " << m_channel_count << "-channel image";
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+#endif
+      if(m_planar)
+      {
+        stride = 1;
+        return channel * m_texel_count;
+      }
+      stride = m_channel_count;
+      return channel;
     }
 
   protected:
+    /// Get data index of an element.
+    ///
+    /// \param texel Texel index.
+    /// \param channel Channel index.
+    /// \return Index into image data.
+    unsigned getElementIndex(unsigned texel, unsigned channel) const
+    {
+      if(m_planar)
+      {
+        return (channel * m_texel_count) + texel;
+      }
+      return (texel * m_channel_count) + channel;
+    }
+
+
     /// Accessor.
     ///
     /// \param idx Index.
@@ -75,26 +292,117 @@ class Image
     /// \param value Value to clear to (default: 0.0f).
     void clear(unsigned channel, float value = 0.0f)
     {
+      unsigned stride;
+      float* data = m_data.get() + getChannelStart(channel, stride);
+
+      for(unsigned ii = 0, ee = m_texel_count * stride; (ii < ee); ii += stride)
+      {
+        data[ii] = value;
+      }
+    }
+
+    /// Scales a channel.
+    ///
+    /// Each value is replaced with value * mul + add.
+    ///
+    /// \param channel Channel to scale.
+    /// \param mul Multiplier.
+    /// \param add Addition after multiplication (default: 0.0f).
+    void scale(unsigned channel, float mul, float add = 0.0f)
+    {
+      unsigned stride;
+      float* data = m_data.get() + getChannelStart(channel, stride);
+
+      if(stride == 1)
+      {
+        ScaleKernel kernel(data, m_texel_count, mul, add);
+        ffloat_dispatch(kernel);
+        return;
+      }
+
+      for(unsigned ii = 0, ee = m_texel_count * stride; (ii < ee); ii += stride)
+      {
+        data[ii] = (data[ii] * mul) + add;
+      }
+    }
+
+    /// Blends a channel towards a channel of another image.
+    ///
+    /// Images must have the same texel count.
+    ///
+    /// \param channel Channel to blend into.
+    /// \param src Source image.
+    /// \param src_channel Channel in source image.
+    /// \param ratio Blending ratio, 0 keeps this image, 1 replaces with source.
+    void blend(unsigned channel, const Image& src, unsigned src_channel, float ratio)
+    {
 #if defined(USE_LD)
-      if(channel > m_channel_count)
+      if(src.m_texel_count != m_texel_count)
       {
         std::ostringstream sstr;
-        sstr << "trying to clear channel " << channel << " in " << (m_channel_count + 1) << "-channel image";
+        sstr << "cannot blend " << src.m_texel_count << " texels into " << m_texel_count << " texels";
         BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
       }
 #endif
-      for(unsigned ii = channel, ee = getElementCount(); (ii < ee); ii += m_channel_count)
+      unsigned stride;
+      unsigned src_stride;
+      float* data = m_data.get() + getChannelStart(channel, stride);
+      const float* src_data = src.m_data.get() + src.getChannelStart(src_channel, src_stride);
+
+      for(unsigned ii = 0; (ii < m_texel_count); ++ii)
+      {
+        float& dst = data[ii * stride];
+        dst = mix(dst, src_data[ii * src_stride], ratio);
+      }
+    }
+
+    /// Gets the minimum and maximum value of a channel.
+    ///
+    /// \param channel Channel to inspect.
+    /// \param min_value [out] Minimum value, not modified if smaller than current.
+    /// \param max_value [out] Maximum value, not modified if larger than current.
+    void getMinMax(unsigned channel, float& min_value, float& max_value) const
+    {
+      unsigned stride;
+      const float* data = m_data.get() + getChannelStart(channel, stride);
+
+      if(stride == 1)
+      {
+        MinMaxKernel kernel(data, m_texel_count, min_value, max_value);
+        ffloat_dispatch(kernel);
+        min_value = kernel.m_min;
+        max_value = kernel.m_max;
+        return;
+      }
+
+      float lmin = min_value;
+      float lmax = max_value;
+
+      for(unsigned ii = 0, ee = m_texel_count * stride; (ii < ee); ii += stride)
       {
-        m_data[ii] = value;
+        float val = data[ii];
+
+        lmin = std::min(val, lmin);
+        lmax = std::max(val, lmax);
       }
+
+      min_value = lmin;
+      max_value = lmax;
     }
 
     /// Recreates the export data array as UNORM data.
     ///
+    /// Export data is always interleaved.
+    ///
     /// \param bpc Bytes per component to convert to (default: 1).
     /// \return Pointer to raw image data.
     uarr<uint8_t> getExportData(unsigned bpc = 1)
     {
+      if(m_planar)
+      {
+        return getExportDataPlanar(bpc);
+      }
+
       unsigned element_count = getElementCount();
 
       // Floats do not need to be converted.
@@ -114,13 +422,9 @@ class Image
       if(bpc == 2)
       {
         uarr<uint8_t> ret(element_count * 2);
-        uint16_t* export_data = reinterpret_cast<uint16_t*>(ret.get());
-
-        for(unsigned ii = 0; (ii < element_count); ++ii)
-        {
-          export_data[ii] = static_cast<uint16_t>(0.5f + clamp(m_data[ii], 0.0f, 1.0f) * 65535.0f);
-        }
-
+        ExportKernel<uint16_t> kernel(reinterpret_cast<uint16_t*>(ret.get()), m_data.get(), element_count,
+            65535.0f);
+        ffloat_dispatch(kernel);
         return ret;
       }
 
@@ -134,15 +438,19 @@ class Image
 #endif
 
       uarr<uint8_t> ret(element_count);
-
-      for(unsigned ii = 0; (ii < element_count); ++ii)
-      {
-        ret[ii] = static_cast<uint8_t>(0.5f + clamp(m_data[ii], 0.0f, 1.0f) * 255.0f);
-      }
-
+      ExportKernel<uint8_t> kernel(ret.get(), m_data.get(), element_count, 255.0f);
+      ffloat_dispatch(kernel);
       return ret;
     }
 
+    /// Accessor.
+    ///
+    /// \return True if channels are stored in separate planes.
+    bool isPlanar() const
+    {
+      return m_planar;
+    }
+
     /// Accessor.
     ///
     /// \return Texel count.
@@ -175,9 +483,17 @@ class Image
     /// \param nceil Noise ceiling.
     void noise(float nfloor = 0.0f, float nceil = 1.0f)
     {
-      for(unsigned ii = 0, ee = getElementCount(); (ii < ee); ++ii)
+      // Random values are generated in interleaved order regardless of layout.
+      for(unsigned ii = 0; (ii < m_texel_count); ++ii)
       {
-        m_data[ii] = frand(nfloor, nceil);
+        if(!(ii % 65536))
+        {
+          cancel_point();
+        }
+        for(unsigned jj = 0; (jj < m_channel_count); ++jj)
+        {
+          m_data[getElementIndex(ii, jj)] = frand(nfloor, nceil);
+        }
       }
     }
 
@@ -187,17 +503,11 @@ class Image
     /// \param ambient Ambient level (default: 0.0f).
     void normalize(unsigned channel, float ambient = 0.0f)
     {
-      unsigned element_count = m_texel_count * m_channel_count;
       float min_value = FLT_MAX;
       float max_value = -FLT_MAX;
 
-      for(unsigned ii = channel; (element_count > ii); ii += m_channel_count)
-      {
-        float val = m_data[ii];
-
-        min_value = std::min(val, min_value);
-        max_value = std::max(val, max_value);
-      }
+      cancel_point();
+      getMinMax(channel, min_value, max_value);
 
       // If all values are identical, skip normalization.
       if(max_value != min_value)
@@ -206,13 +516,58 @@ class Image
 
         //std::cout << "max: " << max_value << " ; min: " << min_value << " ; mul: " << mul << std::endl;
 
-        for(unsigned ii = channel; (element_count > ii); ii += m_channel_count)
-        {
-          float val = m_data[ii];
+        scale(channel, mul, ambient - (mul * min_value));
+      }
+    }
 
-          m_data[ii] = (mul * (val - min_value)) + ambient;
+  private:
+    /// Creates interleaved UNORM export data from planar data.
+    ///
+    /// \param bpc Bytes per component to convert to.
+    /// \return Pointer to raw image data.
+    uarr<uint8_t> getExportDataPlanar(unsigned bpc)
+    {
+#if defined(USE_LD)
+      if((bpc != 1) && (bpc != 2) && (bpc != 4))
+      {
+        std::ostringstream sstr;
+        sstr << "invalid bpc value for UNORM conversion: " << bpc;
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+#endif
+      uarr<uint8_t> ret(getElementCount() * bpc);
+
+      for(unsigned ii = 0; (ii < m_channel_count); ++ii)
+      {
+        const float* src = m_data.get() + (ii * m_texel_count);
+
+        if(bpc == 4)
+        {
+          float* export_data = reinterpret_cast<float*>(ret.get()) + ii;
+          for(unsigned jj = 0; (jj < m_texel_count); ++jj)
+          {
+            export_data[jj * m_channel_count] = src[jj];
+          }
+        }
+        else if(bpc == 2)
+        {
+          uint16_t* export_data = reinterpret_cast<uint16_t*>(ret.get()) + ii;
+          for(unsigned jj = 0; (jj < m_texel_count); ++jj)
+          {
+            export_data[jj * m_channel_count] = static_cast<uint16_t>(0.5f + clamp(src[jj], 0.0f, 1.0f) * 65535.0f);
+          }
+        }
+        else
+        {
+          uint8_t* export_data = ret.get() + ii;
+          for(unsigned jj = 0; (jj < m_texel_count); ++jj)
+          {
+            export_data[jj * m_channel_count] = static_cast<uint8_t>(0.5f + clamp(src[jj], 0.0f, 1.0f) * 255.0f);
+          }
         }
       }
+
+      return ret;
     }
 };
 
@@ -21,11 +21,148 @@ class Image2D : public Image
     /// \param width Image width.
     /// \param height Image height.
     /// \param channels Number of channels.
-    explicit Image2D(unsigned width, unsigned height, unsigned channels) :
-      Image(width * height, channels),
+    /// \param planar True to store channels in separate planes (default: false).
+    explicit Image2D(unsigned width, unsigned height, unsigned channels, bool planar = false) :
+      Image(width * height, channels, planar),
       m_width(width),
       m_height(height) { }
 
+  private:
+    /// Kernel for box filtering one plane of elements with wrapping.
+    ///
+    /// A plane is a row-major array where each row has width * step elements and the horizontal neighbour of
+    /// an element is step elements away. Interleaved images are one plane with step equal to the channel
+    /// count, planar images are one plane per channel with step 1.
+    struct LowpassKernel
+    {
+      /// Destination plane.
+      float* m_dst;
+
+      /// Source plane.
+      const float* m_src;
+
+      /// Width in texels.
+      int m_width;
+
+      /// Height in texels.
+      int m_height;
+
+      /// Distance between horizontally adjacent texels.
+      int m_step;
+
+      /// Filter radius.
+      int m_radius;
+
+      /// Constructor.
+      ///
+      /// \param dst Destination plane.
+      /// \param src Source plane.
+      /// \param width Width in texels.
+      /// \param height Height in texels.
+      /// \param step Distance between horizontally adjacent texels.
+      /// \param radius Filter radius.
+      explicit LowpassKernel(float* dst, const float* src, int width, int height, int step, int radius) :
+        m_dst(dst),
+        m_src(src),
+        m_width(width),
+        m_height(height),
+        m_step(step),
+        m_radius(radius)
+      {
+      }
+
+      /// Run the kernel.
+      ///
+      /// Elements whose horizontal neighbourhood does not wrap are filtered a vector at a time. Summation
+      /// order is the same for all elements.
+      template<typename V> void run()
+      {
+        int row_elements = m_width * m_step;
+        int inner_begin = m_radius * m_step;
+        int inner_end = (m_width - m_radius) * m_step;
+        float divisor = static_cast<float>(((m_radius * 2) + 1) * ((m_radius * 2) + 1));
+        V vdivisor(divisor);
+
+        for(int jj = 0; (jj < m_height); ++jj)
+        {
+          float* dst = m_dst + (jj * row_elements);
+          int ii = 0;
+
+          if(inner_end > inner_begin)
+          {
+            for(; (ii < inner_begin); ++ii)
+            {
+              dst[ii] = filterElement(ii, jj, divisor);
+            }
+            for(; (ii + static_cast<int>(V::LANES) <= inner_end); ii += static_cast<int>(V::LANES))
+            {
+              V sum(0.0f);
+
+              for(int kk = -m_radius; (kk <= m_radius); ++kk)
+              {
+                const float* src = m_src + ii + (kk * m_step);
+
+                for(int ll = -m_radius; (ll <= m_radius); ++ll)
+                {
+                  sum = sum + V::load(src + (wrap(jj + ll, m_height) * row_elements));
+                }
+              }
+
+              (sum / vdivisor).store(dst + ii);
+            }
+          }
+          for(; (ii < row_elements); ++ii)
+          {
+            dst[ii] = filterElement(ii, jj, divisor);
+          }
+        }
+      }
+
+      /// Filter one element.
+      ///
+      /// \param element Element index within row.
+      /// \param row Row index.
+      /// \param divisor Number of texels in the filter.
+      /// \return Filtered value.
+      float filterElement(int element, int row, float divisor) const
+      {
+        int px = element / m_step;
+        int offset = element - (px * m_step);
+        int row_elements = m_width * m_step;
+        float ret = 0.0f;
+
+        for(int kk = -m_radius; (kk <= m_radius); ++kk)
+        {
+          const float* src = m_src + (wrap(px + kk, m_width) * m_step) + offset;
+
+          for(int ll = -m_radius; (ll <= m_radius); ++ll)
+          {
+            ret += src[wrap(row + ll, m_height) * row_elements];
+          }
+        }
+
+        return ret / divisor;
+      }
+
+      /// Wrap a coordinate.
+      ///
+      /// \param op Coordinate.
+      /// \param size Dimension.
+      /// \return Coordinate in [0, size[.
+      static int wrap(int op, int size)
+      {
+        while(op < 0)
+        {
+          op += size;
+        }
+        while(op >= size)
+        {
+          op -= size;
+        }
+        return op;
+      }
+    };
+
   private:
 #if defined(USE_LD) && defined(DEBUG)
     /// Check that accessed index is valid.
@@ -45,14 +182,14 @@ class Image2D : public Image
     }
 #endif
     
-    /// Get index for coordinates.
+    /// Get texel index for coordinates.
     ///
     /// \param px X coordinate.
     /// \param py Y coordinate.
-    /// \return Index.
+    /// \return Texel index.
     unsigned getIndex(unsigned px, unsigned py) const
     {
-      return ((py * m_width) + px) * getChannelCount();
+      return (py * m_width) + px;
     }
 
   protected:
@@ -125,72 +262,26 @@ class Image2D : public Image
     /// \param op Kernel size.
     void filterLowpass(int op)
     {
-#if defined(USE_LD)
-      if(4 < getChannelCount())
-      {
-        std::ostringstream sstr;
-        sstr << "cannot filter texture with " << getChannelCount() << " channels";
-        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
-      }
-#endif
-      unsigned element_count = getWidth() * getHeight() * getChannelCount();
+      unsigned element_count = getElementCount();
       float *replacement_data = array_new(static_cast<float*>(NULL), element_count);
       int iwidth = static_cast<int>(getWidth());
       int iheight = static_cast<int>(getHeight());
-      int ichannels = static_cast<int>(getChannelCount());
 
-      for(int ii = 0; (ii < iwidth); ++ii)
+      if(isPlanar())
       {
-        for(int jj = 0; (jj < iheight); ++jj)
+        for(unsigned ii = 0; (getChannelCount() > ii); ++ii)
         {
-          float values[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-          int idx = (jj * iwidth + ii) * ichannels;
-          int divisor = 0;
-
-          for(int kk = -op; (kk <= op); ++kk)
-          {
-            int rx = ii + kk;
-
-            while(rx < 0)
-            {
-              rx += iwidth;
-            }
-            while(rx >= iwidth)
-            {
-              rx -= iwidth;
-            }
-
-            for(int ll = -op; (ll <= op); ++ll)
-            {
-              int ry = jj + ll;
-
-              while(ry < 0)
-              {
-                ry += iheight;
-              }
-              while(ry >= iheight)
-              {
-                ry -= iheight;
-              }
-
-              unsigned ux = static_cast<unsigned>(rx);
-              unsigned uy = static_cast<unsigned>(ry);
-
-              for(unsigned mm = 0; (getChannelCount() > mm); ++mm)
-              {
-                values[mm] += getValue(ux, uy, mm);
-              }
-
-              ++divisor;
-            }
-          }
-
-          for(int mm = 0; (ichannels > mm); ++mm)
-          {
-            replacement_data[idx + mm] = values[mm] / static_cast<float>(divisor);
-          }
+          unsigned plane = getElementIndex(0, ii);
+          LowpassKernel kernel(replacement_data + plane, Image::getValueAddress(plane), iwidth, iheight, 1, op);
+          ffloat_dispatch(kernel);
         }
       }
+      else
+      {
+        LowpassKernel kernel(replacement_data, Image::getValueAddress(0), iwidth, iheight,
+            static_cast<int>(getChannelCount()), op);
+        ffloat_dispatch(kernel);
+      }
 
       replaceData(replacement_data);
     }
@@ -247,8 +338,8 @@ class Image2D : public Image
 #if defined(USE_LD) && defined(DEBUG)
       checkAccess(px, py, ch);
 #endif
-      unsigned idx = getIndex(px, py);
-      return Image::getValue(idx + ch);
+      unsigned idx = getElementIndex(getIndex(px, py), ch);
+      return Image::getValue(idx);
     }
     /// Get value address.
     ///
@@ -261,8 +352,8 @@ class Image2D : public Image
 #if defined(USE_LD) && defined(DEBUG)
       checkAccess(px, py, ch);
 #endif
-      unsigned idx = getIndex(px, py);
-      return Image::getValueAddress(idx + ch);
+      unsigned idx = getElementIndex(getIndex(px, py), ch);
+      return Image::getValueAddress(idx);
     }
     /// Set value.
     ///
@@ -275,8 +366,8 @@ class Image2D : public Image
 #if defined(USE_LD) && defined(DEBUG)
       checkAccess(px, py, ch);
 #endif
-      unsigned idx = getIndex(px, py);
-      Image::setValue(idx + ch, val);
+      unsigned idx = getElementIndex(getIndex(px, py), ch);
+      Image::setValue(idx, val);
     }
 
     /// Sample (in a bilinear fashion) from the image.
@@ -12,8 +12,9 @@ class Image2DGray : public Image2D
     ///
     /// \param width Image width.
     /// \param height Image height.
-    explicit Image2DGray(unsigned width, unsigned height) :
-      Image2D(width, height, 1) { }
+    /// \param planar True to store channels in separate planes (default: false).
+    explicit Image2DGray(unsigned width, unsigned height, bool planar = false) :
+      Image2D(width, height, 1, planar) { }
 
   public:
     /// Sample (in a bilinear fashion) from the image.
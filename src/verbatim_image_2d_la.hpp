@@ -12,8 +12,9 @@ class Image2DLA : public Image2D
     ///
     /// \param width Image width.
     /// \param height Image height.
-    explicit Image2DLA(unsigned width, unsigned height) :
-      Image2D(width, height, 2) { }
+    /// \param planar True to store channels in separate planes (default: false).
+    explicit Image2DLA(unsigned width, unsigned height, bool planar = false) :
+      Image2D(width, height, 2, planar) { }
 
   public:
     /// Set pixel value wrapper.
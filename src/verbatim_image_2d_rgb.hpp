@@ -13,8 +13,9 @@ class Image2DRGB : public Image2D
     ///
     /// \param width Image width.
     /// \param height Image height.
-    explicit Image2DRGB(unsigned width, unsigned height) :
-      Image2D(width, height, 3)
+    /// \param planar True to store channels in separate planes (default: false).
+    explicit Image2DRGB(unsigned width, unsigned height, bool planar = false) :
+      Image2D(width, height, 3, planar)
     {
     }
 
@@ -12,8 +12,9 @@ class Image2DRGBA : public Image2D
     ///
     /// \param width Image width.
     /// \param height Image height.
-    explicit Image2DRGBA(unsigned width, unsigned height) :
-      Image2D(width, height, 4) { }
+    /// \param planar True to store channels in separate planes (default: false).
+    explicit Image2DRGBA(unsigned width, unsigned height, bool planar = false) :
+      Image2D(width, height, 4, planar) { }
 
   public:
     /// Set pixel value wrapper.
@@ -3,8 +3,20 @@
 
 #include "verbatim_gl.hpp"
 #include "verbatim_image.hpp"
+#include "verbatim_mat3.hpp"
 #include "verbatim_vec3.hpp"
 
+/// Brick size (in texels) for bricked 3D images.
+///
+/// Each brick is stored with an one-texel apron on the positive side of every axis.
+static const unsigned IMAGE_3D_BRICK_SIZE = 8;
+
+/// Brick stride (in texels) along one axis, including the apron.
+static const unsigned IMAGE_3D_BRICK_STRIDE = IMAGE_3D_BRICK_SIZE + 1;
+
+/// Maximum number of samples in one weighted sum.
+static const unsigned IMAGE_3D_SAMPLE_SUM_MAX = 16;
+
 /// Base 3-dimensional image class.
 class Image3D : public Image
 {
@@ -18,6 +30,12 @@ class Image3D : public Image
     /// Depth.
     unsigned m_depth;
 
+    /// Bricked copy of the image data, empty if not built.
+    ///
+    /// Bricks are cubes of IMAGE_3D_BRICK_SIZE texels with a wrapping apron, so every trilinear fetch
+    /// reads from one contiguous brick without wrapping individual corners.
+    uarr<float> m_bricks;
+
   public:
     /// Constructor.
     ///
@@ -29,10 +47,296 @@ class Image3D : public Image
       Image(width * height * depth, channels),
       m_width(width),
       m_height(height),
-      m_depth(depth)
+      m_depth(depth),
+      m_bricks()
     {
     }
 
+  private:
+    CPU_KERNELS_BEGIN
+    /// Kernel for weighted sums of bricked samples.
+    ///
+    /// Processes a vector of samples at a time, producing the same values as sampleBricked().
+    struct BrickedSumKernel
+    {
+      /// Image to sample.
+      const Image3D& m_image;
+
+      /// Sample positions.
+      const vec3* m_pos;
+
+      /// Sample weights.
+      const float* m_weights;
+
+      /// Number of samples.
+      unsigned m_count;
+
+      /// Channel.
+      unsigned m_channel;
+
+      /// Weighted sum.
+      float m_result;
+
+      /// Constructor.
+      ///
+      /// \param image Image to sample.
+      /// \param pos Sample positions.
+      /// \param weights Sample weights.
+      /// \param count Number of samples.
+      /// \param channel Channel.
+      explicit BrickedSumKernel(const Image3D& image, const vec3* pos, const float* weights, unsigned count,
+          unsigned channel) :
+        m_image(image),
+        m_pos(pos),
+        m_weights(weights),
+        m_count(count),
+        m_channel(channel),
+        m_result(0.0f)
+      {
+      }
+
+      /// Run the kernel.
+      template<typename V> void run()
+      {
+        float px[IMAGE_3D_SAMPLE_SUM_MAX];
+        float py[IMAGE_3D_SAMPLE_SUM_MAX];
+        float pz[IMAGE_3D_SAMPLE_SUM_MAX];
+        float weights[IMAGE_3D_SAMPLE_SUM_MAX];
+        float products[IMAGE_3D_SAMPLE_SUM_MAX];
+        unsigned padded_count = ((m_count + V::LANES - 1) / V::LANES) * V::LANES;
+
+        // Padding samples have zero weight.
+        for(unsigned ii = 0; (ii < padded_count); ++ii)
+        {
+          bool valid = (ii < m_count);
+          px[ii] = valid ? m_pos[ii].x() : 0.0f;
+          py[ii] = valid ? m_pos[ii].y() : 0.0f;
+          pz[ii] = valid ? m_pos[ii].z() : 0.0f;
+          weights[ii] = valid ? m_weights[ii] : 0.0f;
+        }
+
+        for(unsigned ii = 0; (ii < padded_count); ii += V::LANES)
+        {
+          (sample_lanes(m_image, V::load(px + ii), V::load(py + ii), V::load(pz + ii), m_channel) *
+           V::load(weights + ii)).store(products + ii);
+        }
+
+        // Sum in sample order to match sampling one at a time.
+        m_result = products[0];
+        for(unsigned ii = 1; (ii < m_count); ++ii)
+        {
+          m_result += products[ii];
+        }
+      }
+
+      /// Sample a vector of positions from the bricked copy of an image.
+      ///
+      /// \param image Image to sample, bricks must have been built.
+      /// \param px X coordinates (wrap).
+      /// \param py Y coordinates (wrap).
+      /// \param pz Z coordinates (wrap).
+      /// \param channel Channel.
+      /// \return Samples, same as sampleBricked().
+      template<typename V> static V sample_lanes(const Image3D& image, const V& px, const V& py, const V& pz,
+          unsigned channel)
+      {
+        // Index arithmetic is done in floats, all intermediate values are integers below 2^24 and exact.
+        float fwidth = static_cast<float>(image.m_width);
+        float fheight = static_cast<float>(image.m_height);
+        float fdepth = static_cast<float>(image.m_depth);
+        unsigned stride_x = image.getChannelCount();
+        unsigned stride_y = IMAGE_3D_BRICK_STRIDE * stride_x;
+        unsigned stride_z = IMAGE_3D_BRICK_STRIDE * stride_y;
+        unsigned brick_size = IMAGE_3D_BRICK_STRIDE * stride_z;
+        const float* cc = image.m_bricks.get() + channel;
+
+        V cx = px * V(fwidth);
+        V cy = py * V(fheight);
+        V cz = pz * V(fdepth);
+        V ix = floor_lanes(cx);
+        V iy = floor_lanes(cy);
+        V iz = floor_lanes(cz);
+        V wx = smooth_weight(cx - ix);
+        V wy = smooth_weight(cy - iy);
+        V wz = smooth_weight(cz - iz);
+
+        ix = wrap_lanes(ix, fwidth);
+        iy = wrap_lanes(iy, fheight);
+        iz = wrap_lanes(iz, fdepth);
+        V bx = vtrunc(ix * V(1.0f / static_cast<float>(IMAGE_3D_BRICK_SIZE)));
+        V by = vtrunc(iy * V(1.0f / static_cast<float>(IMAGE_3D_BRICK_SIZE)));
+        V bz = vtrunc(iz * V(1.0f / static_cast<float>(IMAGE_3D_BRICK_SIZE)));
+        V fbrick(static_cast<float>(IMAGE_3D_BRICK_SIZE));
+        V brick_idx = (((bz * V(fheight / static_cast<float>(IMAGE_3D_BRICK_SIZE))) + by) *
+            V(fwidth / static_cast<float>(IMAGE_3D_BRICK_SIZE))) + bx;
+        V index = (brick_idx * V(static_cast<float>(brick_size))) +
+          ((iz - (bz * fbrick)) * V(static_cast<float>(stride_z))) +
+          ((iy - (by * fbrick)) * V(static_cast<float>(stride_y))) +
+          ((ix - (bx * fbrick)) * V(static_cast<float>(stride_x)));
+
+        V zz1 =
+          mix_lanes(
+              mix_lanes(vgather(cc, index), vgather(cc + stride_x, index), wx),
+              mix_lanes(vgather(cc + stride_y, index), vgather(cc + stride_y + stride_x, index), wx),
+              wy);
+        V zz2 =
+          mix_lanes(
+              mix_lanes(vgather(cc + stride_z, index), vgather(cc + stride_z + stride_x, index), wx),
+              mix_lanes(vgather(cc + stride_z + stride_y, index),
+                vgather(cc + stride_z + stride_y + stride_x, index), wx),
+              wy);
+        return mix_lanes(zz1, zz2, wz);
+      }
+
+      /// Floor function.
+      ///
+      /// \param op Value (magnitude must be under 2^31).
+      /// \return Value rounded towards negative infinity.
+      template<typename V> static V floor_lanes(const V& op)
+      {
+        V ret = vtrunc(op);
+        return vselect(op < ret, ret - V(1.0f), ret);
+      }
+
+      /// Wrap integral values to a power of two dimension.
+      ///
+      /// \param op Integral value.
+      /// \param size Dimension.
+      /// \return Value in [0, size[.
+      template<typename V> static V wrap_lanes(const V& op, float size)
+      {
+        return op - (floor_lanes(op * V(1.0f / size)) * V(size));
+      }
+
+      /// Smooth step weight, same as smooth_step(0.0f, 1.0f, op).
+      ///
+      /// \param op Ratio.
+      /// \return Weight.
+      template<typename V> static V smooth_weight(const V& op)
+      {
+        V ret = vmin(vmax(op, V(0.0f)), V(1.0f));
+        return ret * ret * (V(3.0f) - V(2.0f) * ret);
+      }
+
+      /// Linear interpolation, same as mix().
+      ///
+      /// \param lhs Left-hand-side operand.
+      /// \param rhs Right-hand-side operand.
+      /// \param ratio Ratio.
+      /// \return Interpolated value.
+      template<typename V> static V mix_lanes(const V& lhs, const V& rhs, const V& ratio)
+      {
+        return lhs + (rhs - lhs) * ratio;
+      }
+    };
+
+    /// Kernel for weighted sums of bricked samples over a row of positions.
+    ///
+    /// Processes a vector of positions at a time, producing the same values as sampleLinearSum() for each.
+    struct BrickedRowKernel
+    {
+      /// Image to sample.
+      const Image3D& m_image;
+
+      /// X coordinates of first samples.
+      const float* m_px;
+
+      /// Y coordinates of first samples.
+      const float* m_py;
+
+      /// Z coordinates of first samples.
+      const float* m_pz;
+
+      /// Number of positions.
+      unsigned m_width;
+
+      /// Rotation between consecutive samples.
+      const mat3& m_rot;
+
+      /// Sample weights.
+      const float* m_weights;
+
+      /// Number of samples.
+      unsigned m_count;
+
+      /// Channel.
+      unsigned m_channel;
+
+      /// Weighted sums.
+      float* m_dst;
+
+      /// Constructor.
+      ///
+      /// \param image Image to sample.
+      /// \param px X coordinates of first samples.
+      /// \param py Y coordinates of first samples.
+      /// \param pz Z coordinates of first samples.
+      /// \param width Number of positions.
+      /// \param rot Rotation between consecutive samples.
+      /// \param weights Sample weights.
+      /// \param count Number of samples.
+      /// \param channel Channel.
+      /// \param dst [out] Weighted sums.
+      explicit BrickedRowKernel(const Image3D& image, const float* px, const float* py, const float* pz,
+          unsigned width, const mat3& rot, const float* weights, unsigned count, unsigned channel, float* dst) :
+        m_image(image),
+        m_px(px),
+        m_py(py),
+        m_pz(pz),
+        m_width(width),
+        m_rot(rot),
+        m_weights(weights),
+        m_count(count),
+        m_channel(channel),
+        m_dst(dst)
+      {
+      }
+
+      /// Run the kernel.
+      template<typename V> void run()
+      {
+        unsigned ii = 0;
+
+        for(; (ii + V::LANES <= m_width); ii += V::LANES)
+        {
+          sum_lanes(V::load(m_px + ii), V::load(m_py + ii), V::load(m_pz + ii)).store(m_dst + ii);
+        }
+        for(; (ii < m_width); ++ii)
+        {
+          m_dst[ii] = sum_lanes(ffloat1(m_px[ii]), ffloat1(m_py[ii]), ffloat1(m_pz[ii])).get();
+        }
+      }
+
+      /// Weighted sum for a vector of positions.
+      ///
+      /// Positions are advanced with the same operations as vec3 math, in sample order.
+      ///
+      /// \param x X coordinates.
+      /// \param y Y coordinates.
+      /// \param z Z coordinates.
+      /// \return Weighted sums.
+      template<typename V> V sum_lanes(const V& x, const V& y, const V& z) const
+      {
+        V px = x;
+        V py = y;
+        V pz = z;
+        V ret = BrickedSumKernel::sample_lanes(m_image, px, py, pz, m_channel) * V(m_weights[0]);
+
+        for(unsigned ii = 1; (ii < m_count); ++ii)
+        {
+          V hx = px * V(0.5f);
+          V hy = py * V(0.5f);
+          V hz = pz * V(0.5f);
+          px = V(m_rot[0]) * hx + V(m_rot[3]) * hy + V(m_rot[6]) * hz;
+          py = V(m_rot[1]) * hx + V(m_rot[4]) * hy + V(m_rot[7]) * hz;
+          pz = V(m_rot[2]) * hx + V(m_rot[5]) * hy + V(m_rot[8]) * hz;
+          ret = ret + BrickedSumKernel::sample_lanes(m_image, px, py, pz, m_channel) * V(m_weights[ii]);
+        }
+        return ret;
+      }
+    };
+    CPU_KERNELS_END
+
   private:
 #if defined(USE_LD) && defined(DEBUG)
     /// Check that accessed index is valid.
@@ -53,15 +357,15 @@ class Image3D : public Image
     }
 #endif
 
-    /// Get index for coordinates.
+    /// Get texel index for coordinates.
     ///
     /// \param px X coordinate.
     /// \param py Y coordinate.
     /// \param pz Z coordinate.
-    /// \return Index.
+    /// \return Texel index.
     unsigned getIndex(unsigned px, unsigned py, unsigned pz) const
     {
-      return ((pz * m_width * m_height) + (py * m_width) + px) * getChannelCount();
+      return (pz * m_width * m_height) + (py * m_width) + px;
     }
 
   protected:
@@ -161,7 +465,141 @@ class Image3D : public Image
       return smooth_mix(zz1, zz2, fract_z);
     }
 
+    /// Find the bricked corner texels for a sample.
+    ///
+    /// Only valid if bricks have been built. Image dimensions are powers of two, so wrapping is a mask.
+    ///
+    /// \param px X coordinate (wraps).
+    /// \param py Y coordinate (wraps).
+    /// \param pz Z coordinate (wraps).
+    /// \param pc Channel.
+    /// \param fract_x [out] Fractional X coordinate.
+    /// \param fract_y [out] Fractional Y coordinate.
+    /// \param fract_z [out] Fractional Z coordinate.
+    /// \return Pointer to the first corner, other corners are at getChannelCount() strides.
+    const float* getBrickedCorner(float px, float py, float pz, unsigned pc, float& fract_x, float& fract_y,
+        float& fract_z) const
+    {
+      float cx = px * static_cast<float>(m_width);
+      float cy = py * static_cast<float>(m_height);
+      float cz = pz * static_cast<float>(m_depth);
+
+      // Floor without libm, conversion truncates towards zero.
+      int ix = static_cast<int>(cx);
+      int iy = static_cast<int>(cy);
+      int iz = static_cast<int>(cz);
+      ix -= (cx < static_cast<float>(ix)) ? 1 : 0;
+      iy -= (cy < static_cast<float>(iy)) ? 1 : 0;
+      iz -= (cz < static_cast<float>(iz)) ? 1 : 0;
+      fract_x = cx - static_cast<float>(ix);
+      fract_y = cy - static_cast<float>(iy);
+      fract_z = cz - static_cast<float>(iz);
+
+      unsigned ux = static_cast<unsigned>(ix) & (m_width - 1);
+      unsigned uy = static_cast<unsigned>(iy) & (m_height - 1);
+      unsigned uz = static_cast<unsigned>(iz) & (m_depth - 1);
+
+      unsigned stride_x = getChannelCount();
+      unsigned stride_y = IMAGE_3D_BRICK_STRIDE * stride_x;
+      unsigned stride_z = IMAGE_3D_BRICK_STRIDE * stride_y;
+      unsigned brick_size = IMAGE_3D_BRICK_STRIDE * stride_z;
+      unsigned bricks_x = m_width / IMAGE_3D_BRICK_SIZE;
+      unsigned bricks_y = m_height / IMAGE_3D_BRICK_SIZE;
+      unsigned brick_idx = (((uz / IMAGE_3D_BRICK_SIZE) * bricks_y) + (uy / IMAGE_3D_BRICK_SIZE)) * bricks_x +
+        (ux / IMAGE_3D_BRICK_SIZE);
+      return m_bricks.get() + (brick_idx * brick_size) +
+        ((uz % IMAGE_3D_BRICK_SIZE) * stride_z) +
+        ((uy % IMAGE_3D_BRICK_SIZE) * stride_y) +
+        ((ux % IMAGE_3D_BRICK_SIZE) * stride_x) + pc;
+    }
+
+    /// Sample (in a bilinear fashion) from the bricked copy of the image.
+    ///
+    /// Only valid if bricks have been built.
+    ///
+    /// \param px X coordinate (wraps).
+    /// \param py Y coordinate (wraps).
+    /// \param pz Z coordinate (wraps).
+    /// \param pc Channel.
+    /// \return Sampled color.
+    float sampleBricked(float px, float py, float pz, unsigned pc) const
+    {
+      float fract_x;
+      float fract_y;
+      float fract_z;
+      const float* cc = getBrickedCorner(px, py, pz, pc, fract_x, fract_y, fract_z);
+      unsigned stride_x = getChannelCount();
+      unsigned stride_y = IMAGE_3D_BRICK_STRIDE * stride_x;
+      unsigned stride_z = IMAGE_3D_BRICK_STRIDE * stride_y;
+
+      float zz1 =
+        smooth_mix(
+            smooth_mix(cc[0], cc[stride_x], fract_x),
+            smooth_mix(cc[stride_y], cc[stride_y + stride_x], fract_x),
+            fract_y);
+      cc += stride_z;
+      float zz2 =
+        smooth_mix(
+            smooth_mix(cc[0], cc[stride_x], fract_x),
+            smooth_mix(cc[stride_y], cc[stride_y + stride_x], fract_x),
+            fract_y);
+      return smooth_mix(zz1, zz2, fract_z);
+    }
+
   public:
+    /// Build the bricked copy of the image.
+    ///
+    /// Must be called again after modifying image contents. Does nothing unless all dimensions are powers of
+    /// two and at least IMAGE_3D_BRICK_SIZE, in which case sampling falls back to the wrapping sampler.
+    void buildBricks()
+    {
+      if(!is_brickable(m_width) || !is_brickable(m_height) || !is_brickable(m_depth))
+      {
+        m_bricks.reset();
+        return;
+      }
+
+      unsigned channels = getChannelCount();
+      unsigned bricks_x = m_width / IMAGE_3D_BRICK_SIZE;
+      unsigned bricks_y = m_height / IMAGE_3D_BRICK_SIZE;
+      unsigned bricks_z = m_depth / IMAGE_3D_BRICK_SIZE;
+      unsigned brick_size = IMAGE_3D_BRICK_STRIDE * IMAGE_3D_BRICK_STRIDE * IMAGE_3D_BRICK_STRIDE * channels;
+
+      m_bricks.resize(bricks_x * bricks_y * bricks_z * brick_size);
+
+      float* dst = m_bricks.get();
+      for(unsigned bz = 0; (bricks_z > bz); ++bz)
+      {
+        for(unsigned by = 0; (bricks_y > by); ++by)
+        {
+          for(unsigned bx = 0; (bricks_x > bx); ++bx)
+          {
+            for(unsigned kk = 0; (IMAGE_3D_BRICK_STRIDE > kk); ++kk)
+            {
+              unsigned pz = ((bz * IMAGE_3D_BRICK_SIZE) + kk) & (m_depth - 1);
+
+              for(unsigned jj = 0; (IMAGE_3D_BRICK_STRIDE > jj); ++jj)
+              {
+                unsigned py = ((by * IMAGE_3D_BRICK_SIZE) + jj) & (m_height - 1);
+
+                for(unsigned ii = 0; (IMAGE_3D_BRICK_STRIDE > ii); ++ii)
+                {
+                  unsigned px = ((bx * IMAGE_3D_BRICK_SIZE) + ii) & (m_width - 1);
+                  unsigned idx = getIndex(px, py, pz);
+
+                  for(unsigned ch = 0; (channels > ch); ++ch)
+                  {
+                    *dst = Image::getValue(getElementIndex(idx, ch));
+                    ++dst;
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+
     /// Accessor.
     ///
     /// \return Width.
@@ -196,8 +634,8 @@ class Image3D : public Image
 #if defined(USE_LD) && defined(DEBUG)
       checkAccess(px, py, pz, ch);
 #endif
-      unsigned idx = getIndex(px, py, pz);
-      return Image::getValue(idx + ch);
+      unsigned idx = getElementIndex(getIndex(px, py, pz), ch);
+      return Image::getValue(idx);
     }
     /// Set value.
     ///
@@ -210,8 +648,8 @@ class Image3D : public Image
 #if defined(USE_LD) && defined(DEBUG)
       checkAccess(px, py, pz, ch);
 #endif
-      unsigned idx = getIndex(px, py, pz);
-      Image::setValue(idx + ch, val);
+      unsigned idx = getElementIndex(getIndex(px, py, pz), ch);
+      Image::setValue(idx, val);
     }
 
     /// Sample (in a bilinear fashion) from the image.
@@ -222,6 +660,10 @@ class Image3D : public Image
     /// \param pc Channel.
     float sampleLinear(float px, float py, float pz, unsigned pc) const
     {
+      if(m_bricks)
+      {
+        return sampleBricked(px, py, pz, pc);
+      }
       return sample(px, py, pz, pc, false);
     }
     /// Sample linear wrapper.
@@ -232,6 +674,85 @@ class Image3D : public Image
     {
       return sampleLinear(pos.x(), pos.y(), pos.z(), pc);
     }
+    /// Weighted sum of linear samples.
+    ///
+    /// Equivalent to summing sampleLinear() * weight in order, but interpolates several samples at a time
+    /// if bricks have been built.
+    ///
+    /// \param pos Sampling coordinates.
+    /// \param weights Weights for samples.
+    /// \param count Number of samples [1, IMAGE_3D_SAMPLE_SUM_MAX].
+    /// \param pc Channel.
+    /// \return Weighted sum.
+    float sampleLinearSum(const vec3* pos, const float* weights, unsigned count, unsigned pc) const
+    {
+#if defined(USE_LD)
+      if((count < 1) || (count > IMAGE_3D_SAMPLE_SUM_MAX))
+      {
+        std::ostringstream sstr;
+        sstr << "invalid sample count for weighted sum: " << count;
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+#endif
+      if(m_bricks)
+      {
+        BrickedSumKernel kernel(*this, pos, weights, count, pc);
+        ffloat_dispatch(kernel);
+        return kernel.m_result;
+      }
+
+      float ret = sampleLinear(pos[0], pc) * weights[0];
+      for(unsigned ii = 1; (ii < count); ++ii)
+      {
+        ret += sampleLinear(pos[ii], pc) * weights[ii];
+      }
+      return ret;
+    }
+    /// Weighted sums of linear samples over a row of positions.
+    ///
+    /// Equivalent to calling sampleLinearSum() for every position, with each further sample taken at
+    /// rot * (previous * 0.5f). Positions are read from coordinate planes a vector at a time if bricks have been
+    /// built.
+    ///
+    /// \param px X coordinates of first samples.
+    /// \param py Y coordinates of first samples.
+    /// \param pz Z coordinates of first samples.
+    /// \param width Number of positions.
+    /// \param rot Rotation between consecutive samples.
+    /// \param weights Weights for samples.
+    /// \param count Number of samples [1, IMAGE_3D_SAMPLE_SUM_MAX].
+    /// \param pc Channel.
+    /// \param dst [out] Weighted sums, one per position.
+    void sampleLinearSumRow(const float* px, const float* py, const float* pz, unsigned width, const mat3& rot,
+        const float* weights, unsigned count, unsigned pc, float* dst) const
+    {
+#if defined(USE_LD)
+      if((count < 1) || (count > IMAGE_3D_SAMPLE_SUM_MAX))
+      {
+        std::ostringstream sstr;
+        sstr << "invalid sample count for weighted sum: " << count;
+        BOOST_THROW_EXCEPTION(std::runtime_error(sstr.str()));
+      }
+#endif
+      if(m_bricks)
+      {
+        BrickedRowKernel kernel(*this, px, py, pz, width, rot, weights, count, pc, dst);
+        ffloat_dispatch(kernel);
+        return;
+      }
+
+      for(unsigned ii = 0; (ii < width); ++ii)
+      {
+        vec3 positions[IMAGE_3D_SAMPLE_SUM_MAX];
+        positions[0] = vec3(px[ii], py[ii], pz[ii]);
+        for(unsigned jj = 1; (jj < count); ++jj)
+        {
+          positions[jj] = rot * (positions[jj - 1] * 0.5f);
+        }
+        dst[ii] = sampleLinearSum(positions, weights, count, pc);
+      }
+    }
+
     /// Sample (in a nearest fashion) from the image.
     ///
     /// \param px X coordinate [0, 1[.
@@ -249,6 +770,16 @@ class Image3D : public Image
     {
       return sampleNearest(pos.x(), pos.y(), pos.z(), pc);
     }
+
+  private:
+    /// Tell if a dimension can be bricked.
+    ///
+    /// \param op Dimension.
+    /// \return True if dimension is a power of two and at least one brick.
+    static bool is_brickable(unsigned op)
+    {
+      return (op >= IMAGE_3D_BRICK_SIZE) && !(op & (op - 1));
+    }
 };
 
 #endif
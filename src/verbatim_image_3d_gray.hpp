@@ -38,6 +38,31 @@ class Image3DGray : public Image3D
     {
       return sampleLinear(pos.x(), pos.y(), pos.z());
     }
+    /// Weighted sum of linear samples.
+    ///
+    /// \param pos Positions in image.
+    /// \param weights Weights for samples.
+    /// \param count Number of samples.
+    /// \return Weighted sum.
+    float sampleLinearSum(const vec3* pos, const float* weights, unsigned count) const
+    {
+      return Image3D::sampleLinearSum(pos, weights, count, 0);
+    }
+    /// Weighted sums of linear samples over a row of positions.
+    ///
+    /// \param px X coordinates of first samples.
+    /// \param py Y coordinates of first samples.
+    /// \param pz Z coordinates of first samples.
+    /// \param width Number of positions.
+    /// \param rot Rotation between consecutive samples.
+    /// \param weights Weights for samples.
+    /// \param count Number of samples.
+    /// \param dst [out] Weighted sums.
+    void sampleLinearSumRow(const float* px, const float* py, const float* pz, unsigned width, const mat3& rot,
+        const float* weights, unsigned count, float* dst) const
+    {
+      Image3D::sampleLinearSumRow(px, py, pz, width, rot, weights, count, 0, dst);
+    }
     /// Sample (in a nearest fashion) from the image.
     ///
     /// \param px X coordinate [0, 1[.
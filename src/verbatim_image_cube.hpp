@@ -1,9 +1,161 @@
 #ifndef VERBATIM_IMAGE_CUBE_HPP
 #define VERBATIM_IMAGE_CUBE_HPP
 
+#include "verbatim_perf.hpp"
 #include "verbatim_thread.hpp"
+#include "verbatim_uarr.hpp"
 #include "verbatim_vec3.hpp"
 
+/// One row of texels on a cube map side.
+///
+/// Passed to packet side functors. Directions are stored as structure-of-arrays so the functor (and the
+/// compiler) can process the whole row at once.
+class CubeMapRow
+{
+  private:
+    /// Direction data, 6 planes of width floats: dir x, y, z, normalized dir x, y, z.
+    uarr<float> m_data;
+
+    /// Row width in texels.
+    unsigned m_width;
+
+    /// Row index in image.
+    unsigned m_row;
+
+  private:
+    /// Deleted copy constructor.
+    CubeMapRow(const CubeMapRow&) = delete;
+    /// Deleted assignment.
+    CubeMapRow& operator=(const CubeMapRow&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param width Row width.
+    explicit CubeMapRow(unsigned width) :
+      m_data(width * 6),
+      m_width(width),
+      m_row(0)
+    {
+    }
+
+  public:
+    /// Normalize directions into the normalized direction planes.
+    void normalize()
+    {
+      const float* dx = getDirX();
+      const float* dy = getDirY();
+      const float* dz = getDirZ();
+      float* nx = m_data.get() + (m_width * 3);
+      float* ny = m_data.get() + (m_width * 4);
+      float* nz = m_data.get() + (m_width * 5);
+
+      for(unsigned ii = 0; (ii < m_width); ++ii)
+      {
+        float len = dnload_sqrtf(dx[ii] * dx[ii] + dy[ii] * dy[ii] + dz[ii] * dz[ii]);
+        nx[ii] = dx[ii] / len;
+        ny[ii] = dy[ii] / len;
+        nz[ii] = dz[ii] / len;
+      }
+    }
+
+    /// Set direction of a texel.
+    ///
+    /// \param idx Texel index in row.
+    /// \param op Direction mapped to cube map boundary.
+    void setDir(unsigned idx, const vec3& op)
+    {
+      m_data[idx] = op.x();
+      m_data[m_width + idx] = op.y();
+      m_data[(m_width * 2) + idx] = op.z();
+    }
+
+    /// Accessor.
+    ///
+    /// \param op New row index.
+    void setRow(unsigned op)
+    {
+      m_row = op;
+    }
+
+  public:
+    /// Accessor.
+    ///
+    /// \return Direction X plane.
+    const float* getDirX() const
+    {
+      return m_data.get();
+    }
+    /// Accessor.
+    ///
+    /// \return Direction Y plane.
+    const float* getDirY() const
+    {
+      return m_data.get() + m_width;
+    }
+    /// Accessor.
+    ///
+    /// \return Direction Z plane.
+    const float* getDirZ() const
+    {
+      return m_data.get() + (m_width * 2);
+    }
+    /// Accessor.
+    ///
+    /// \return Normalized direction X plane.
+    const float* getNormDirX() const
+    {
+      return m_data.get() + (m_width * 3);
+    }
+    /// Accessor.
+    ///
+    /// \return Normalized direction Y plane.
+    const float* getNormDirY() const
+    {
+      return m_data.get() + (m_width * 4);
+    }
+    /// Accessor.
+    ///
+    /// \return Normalized direction Z plane.
+    const float* getNormDirZ() const
+    {
+      return m_data.get() + (m_width * 5);
+    }
+
+    /// Gather direction of a texel.
+    ///
+    /// \param idx Texel index in row.
+    /// \return Direction mapped to cube map boundary.
+    vec3 getDir(unsigned idx) const
+    {
+      return vec3(getDirX()[idx], getDirY()[idx], getDirZ()[idx]);
+    }
+    /// Gather normalized direction of a texel.
+    ///
+    /// \param idx Texel index in row.
+    /// \return Normalized direction.
+    vec3 getNormDir(unsigned idx) const
+    {
+      return vec3(getNormDirX()[idx], getNormDirY()[idx], getNormDirZ()[idx]);
+    }
+
+    /// Accessor.
+    ///
+    /// \return Row index in image.
+    unsigned getRow() const
+    {
+      return m_row;
+    }
+
+    /// Accessor.
+    ///
+    /// \return Row width.
+    unsigned getWidth() const
+    {
+      return m_width;
+    }
+};
+
 /// Cube map image.
 template<typename T> class ImageCube
 {
@@ -123,6 +275,61 @@ template<typename T> class ImageCube
         }
     };
 
+    /// Sub-class for distributed packet side calculation.
+    ///
+    /// Packet side functors implement:
+    /// void operator()(const CubeMapRow& row, T& img) const;
+    template<typename F> class PacketCalculationContainer
+    {
+      private:
+        /// Direction function.
+        CubeMapDirFunc m_dir_func;
+
+        /// Side functor.
+        const F& m_side_func;
+
+        /// Target image.
+        T& m_img;
+
+#if defined(PERF_COUNTERS)
+        /// Stage name for performance counters.
+        std::string m_perf_name;
+#endif
+
+      public:
+        /// Constructor.
+        ///
+        /// \param dir_func Direction function.
+        /// \param side_func Side functor.
+        /// \param img Target image.
+        /// \param face Face name for performance counters.
+        PacketCalculationContainer(CubeMapDirFunc dir_func, const F& side_func, T& img, const char* face) :
+          m_dir_func(dir_func),
+          m_side_func(side_func),
+          m_img(img)
+#if defined(PERF_COUNTERS)
+          , m_perf_name(PerfStage::get_current_name() + " " + face)
+#endif
+        {
+#if !defined(PERF_COUNTERS)
+          (void)face;
+#endif
+        }
+
+      public:
+        /// Calculate the side of cube map.
+        ///
+        /// \param data Pointer to packet calculation container.
+        /// \return Always 0.
+        static int calculate_side(void* data)
+        {
+          PacketCalculationContainer<F>* container = static_cast<PacketCalculationContainer<F>*>(data);
+          PERF_STAGE(container->m_perf_name);
+          calculate_side_packet(container->m_dir_func, container->m_side_func, container->m_img);
+          return 0;
+        }
+    };
+
   private:
     /// Side image.
     T m_neg_x;
@@ -141,13 +348,14 @@ template<typename T> class ImageCube
     /// Constructor.
     ///
     /// \param side Length of one side of a 2D cube map image.
-    ImageCube(unsigned int side) :
-      m_neg_x(side, side),
-      m_pos_x(side, side),
-      m_neg_y(side, side),
-      m_pos_y(side, side),
-      m_neg_z(side, side),
-      m_pos_z(side, side)
+    /// \param planar True to store channels in separate planes (default: false).
+    ImageCube(unsigned int side, bool planar = false) :
+      m_neg_x(side, side, planar),
+      m_pos_x(side, side, planar),
+      m_neg_y(side, side, planar),
+      m_pos_y(side, side, planar),
+      m_neg_z(side, side, planar),
+      m_pos_z(side, side, planar)
     {
     }
 
@@ -222,6 +430,26 @@ template<typename T> class ImageCube
       Thread thr_pos_z(ImageCube<T>::SideCalculationContainer::calculate_side_pos_z, &container);
     }
 
+    /// Distributed mode, calculate all sides one row at a time.
+    ///
+    /// \param side_func Packet side functor.
+    template<typename F> void calculateDistributedPacket(const F& side_func)
+    {
+      PacketCalculationContainer<F> container_neg_x(dir_neg_x, side_func, m_neg_x, "-x");
+      PacketCalculationContainer<F> container_pos_x(dir_pos_x, side_func, m_pos_x, "+x");
+      PacketCalculationContainer<F> container_neg_y(dir_neg_y, side_func, m_neg_y, "-y");
+      PacketCalculationContainer<F> container_pos_y(dir_pos_y, side_func, m_pos_y, "+y");
+      PacketCalculationContainer<F> container_neg_z(dir_neg_z, side_func, m_neg_z, "-z");
+      PacketCalculationContainer<F> container_pos_z(dir_pos_z, side_func, m_pos_z, "+z");
+
+      Thread thr_neg_x(PacketCalculationContainer<F>::calculate_side, &container_neg_x);
+      Thread thr_pos_x(PacketCalculationContainer<F>::calculate_side, &container_pos_x);
+      Thread thr_neg_y(PacketCalculationContainer<F>::calculate_side, &container_neg_y);
+      Thread thr_pos_y(PacketCalculationContainer<F>::calculate_side, &container_pos_y);
+      Thread thr_neg_z(PacketCalculationContainer<F>::calculate_side, &container_neg_z);
+      Thread thr_pos_z(PacketCalculationContainer<F>::calculate_side, &container_pos_z);
+    }
+
     /// Clears a channel to a value.
     ///
     /// Clears all sides.
@@ -238,6 +466,31 @@ template<typename T> class ImageCube
       m_pos_z.clear(channel, value);
     }
 
+#if defined(USE_LD)
+    /// Copy a channel of all sides into contiguous memory.
+    ///
+    /// Sides are copied in order -X, +X, -Y, +Y, -Z, +Z, each row by row.
+    ///
+    /// \param channel Channel to copy.
+    /// \param dst Destination, must have room for 6 sides.
+    void getChannelData(unsigned channel, float* dst) const
+    {
+      const T* sides[] = { &m_neg_x, &m_pos_x, &m_neg_y, &m_pos_y, &m_neg_z, &m_pos_z };
+
+      for(const T* vv : sides)
+      {
+        for(unsigned jj = 0; (jj < vv->getHeight()); ++jj)
+        {
+          for(unsigned ii = 0; (ii < vv->getWidth()); ++ii)
+          {
+            *dst = vv->getValue(ii, jj, channel);
+            ++dst;
+          }
+        }
+      }
+    }
+#endif
+
     /// Gets the address for a pixel.
     ///
     /// \param dir Direction.
@@ -399,57 +652,33 @@ template<typename T> class ImageCube
     /// \param ambient Ambient level (default: 0.0f).
     void normalizeSides(unsigned channel, float ambient = 0.0f)
     {
-      unsigned width = m_neg_x.getWidth();
-      unsigned height = m_neg_x.getHeight();
       float min_value = FLT_MAX;
       float max_value = -FLT_MAX;
 
-      for(unsigned ii = 0; (ii < width); ++ii)
-      {
-        for(unsigned jj = 0; (jj < height); ++jj)
-        {
-          float val1 = m_neg_x.getValue(ii, jj, channel);
-          float val2 = m_pos_x.getValue(ii, jj, channel);
-          float val3 = m_neg_y.getValue(ii, jj, channel);
-          float val4 = m_pos_y.getValue(ii, jj, channel);
-          float val5 = m_neg_z.getValue(ii, jj, channel);
-          float val6 = m_pos_z.getValue(ii, jj, channel);
-
-          float lmin = std::min(std::min(std::min(std::min(std::min(val1, val2), val3), val4), val5), val6);
-          float lmax = std::max(std::max(std::max(std::max(std::max(val1, val2), val3), val4), val5), val6);
-          min_value = std::min(min_value, lmin);
-          max_value = std::max(max_value, lmax);
-        }
-      }
+      cancel_point();
+      m_neg_x.getMinMax(channel, min_value, max_value);
+      m_pos_x.getMinMax(channel, min_value, max_value);
+      m_neg_y.getMinMax(channel, min_value, max_value);
+      m_pos_y.getMinMax(channel, min_value, max_value);
+      m_neg_z.getMinMax(channel, min_value, max_value);
+      m_pos_z.getMinMax(channel, min_value, max_value);
 
       // If all values are identical, skip normalization.
       if(max_value != min_value)
       {
         float mul = (1.0f - ambient) / (max_value - min_value);
+        float add = ambient - (mul * min_value);
 
         //std::cout << "max: " << max_value << " ; min: " << min_value << " ; mul: " << mul << std::endl;
 
-        for(unsigned ii = 0; (ii < width); ++ii)
-        {
-          for(unsigned jj = 0; (jj < height); ++jj)
-          {
-            float val1 = m_neg_x.getValue(ii, jj, channel);
-            float val2 = m_pos_x.getValue(ii, jj, channel);
-            float val3 = m_neg_y.getValue(ii, jj, channel);
-            float val4 = m_pos_y.getValue(ii, jj, channel);
-            float val5 = m_neg_z.getValue(ii, jj, channel);
-            float val6 = m_pos_z.getValue(ii, jj, channel);
-
-            m_neg_x.setValue(ii, jj, channel, (mul * (val1 - min_value)) + ambient);
-            m_pos_x.setValue(ii, jj, channel, (mul * (val2 - min_value)) + ambient);
-            m_neg_y.setValue(ii, jj, channel, (mul * (val3 - min_value)) + ambient);
-            m_pos_y.setValue(ii, jj, channel, (mul * (val4 - min_value)) + ambient);
-            m_neg_z.setValue(ii, jj, channel, (mul * (val5 - min_value)) + ambient);
-            m_pos_z.setValue(ii, jj, channel, (mul * (val6 - min_value)) + ambient);
-          }
-        }
+        m_neg_x.scale(channel, mul, add);
+        m_pos_x.scale(channel, mul, add);
+        m_neg_y.scale(channel, mul, add);
+        m_pos_y.scale(channel, mul, add);
+        m_neg_z.scale(channel, mul, add);
+        m_pos_z.scale(channel, mul, add);
       }
-   }
+    }
 
   private:
     /// Calculate generic side of cube map.
@@ -466,6 +695,12 @@ template<typename T> class ImageCube
       {
         float fi = static_cast<float>(ii) * CUBE_MAP_SIDE_MUL;
 
+        // Side threads can not throw, leave the side unfinished instead.
+        if(cancel_requested())
+        {
+          return;
+        }
+
         for(unsigned jj = 0; (jj < img.getHeight()); ++jj)
         {
           float fj = static_cast<float>(jj) * CUBE_MAP_SIDE_MUL;
@@ -476,6 +711,38 @@ template<typename T> class ImageCube
       }
     }
 
+    /// Calculate generic side of cube map in row packets.
+    ///
+    /// \param dir_func Direction function.
+    /// \param side_func Packet side functor.
+    /// \param img Destination image.
+    template<typename F> static void calculate_side_packet(CubeMapDirFunc dir_func, const F& side_func, T& img)
+    {
+      const float CUBE_MAP_SIDE_MUL = 1.0f / (static_cast<float>(img.getWidth()) * 0.5f);
+      CubeMapRow row(img.getWidth());
+
+      for(unsigned jj = 0; (jj < img.getHeight()); ++jj)
+      {
+        float fj = static_cast<float>(jj) * CUBE_MAP_SIDE_MUL;
+
+        // Side threads can not throw, leave the side unfinished instead.
+        if(cancel_requested())
+        {
+          return;
+        }
+
+        for(unsigned ii = 0; (ii < img.getWidth()); ++ii)
+        {
+          float fi = static_cast<float>(ii) * CUBE_MAP_SIDE_MUL;
+          row.setDir(ii, dir_func(fi, fj));
+        }
+        row.normalize();
+        row.setRow(jj);
+
+        side_func(row, img);
+      }
+    }
+
     /// Direction function for negative X.
     ///
     /// \param fi Relative image coordinate X.
@@ -534,9 +801,10 @@ template<typename T> class ImageCube
     /// Creates a new cube map image.
     ///
     /// \param side Length of one cube map side.
-    static uptr<ImageCube<T> > create(unsigned side)
+    /// \param planar True to store channels in separate planes (default: false).
+    static uptr<ImageCube<T> > create(unsigned side, bool planar = false)
     {
-      return uptr<ImageCube<T> >(new ImageCube<T>(side));
+      return uptr<ImageCube<T> >(new ImageCube<T>(side, planar));
     }
 };
 
@@ -0,0 +1,520 @@
+#ifndef VERBATIM_PERF_HPP
+#define VERBATIM_PERF_HPP
+
+/// Hardware performance counters are only available in Linux developer builds.
+#if defined(USE_LD) && defined(__linux__)
+#define PERF_COUNTERS
+#endif
+
+#if defined(PERF_COUNTERS)
+
+#include "verbatim_scoped_lock.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/// Bytes transferred per memory controller CAS command.
+static const double PERF_BYTES_PER_CAS = 64.0;
+
+/// Bytes transferred per last level cache miss, used to estimate bandwidth without memory controller counters.
+static const double PERF_BYTES_PER_LLC_MISS = 64.0;
+
+/// Maximum number of memory controller PMUs probed.
+static const unsigned PERF_MAX_IMC = 32;
+
+/// Performance counter collection enabled flag.
+static bool g_perf_enabled = false;
+
+/// One performance counter event, possibly opened on several CPUs.
+class PerfCounter
+{
+  private:
+    /// File descriptors.
+    std::vector<int> m_fds;
+
+  private:
+    /// Deleted copy constructor.
+    PerfCounter(const PerfCounter&) = delete;
+    /// Deleted assignment.
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+  public:
+    /// Empty constructor.
+    PerfCounter()
+    {
+    }
+
+    /// Destructor.
+    ~PerfCounter()
+    {
+      for(unsigned ii = 0; (ii < m_fds.size()); ++ii)
+      {
+        close(m_fds[ii]);
+      }
+    }
+
+  public:
+    /// Open the event.
+    ///
+    /// Thread events count the calling thread and threads it creates afterwards, CPU events count everything
+    /// on the given CPU.
+    ///
+    /// \param type Event type.
+    /// \param config Event config.
+    /// \param cpu CPU to count on, -1 to count the calling thread.
+    /// \return 0 on success, errno on failure.
+    int open(uint32_t type, uint64_t config, int cpu = -1)
+    {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = type;
+      attr.config = config;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      if(cpu < 0)
+      {
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+      }
+
+      long fd = syscall(__NR_perf_event_open, &attr, (cpu < 0) ? 0 : -1, cpu, -1, 0);
+      if(fd < 0)
+      {
+        return errno;
+      }
+      m_fds.push_back(static_cast<int>(fd));
+      return 0;
+    }
+
+    /// Tell if the counter has been opened.
+    ///
+    /// \return True if at least one event is being counted.
+    bool isValid() const
+    {
+      return !m_fds.empty();
+    }
+
+    /// Read the counter value.
+    ///
+    /// Values are scaled up if the kernel had to multiplex the counter.
+    ///
+    /// \return Sum of counts over all opened events.
+    double read() const
+    {
+      double ret = 0.0;
+
+      for(unsigned ii = 0; (ii < m_fds.size()); ++ii)
+      {
+        uint64_t values[3];
+        if(::read(m_fds[ii], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)))
+        {
+          continue;
+        }
+        if(values[2] > 0)
+        {
+          ret += static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+        }
+      }
+
+      return ret;
+    }
+};
+
+/// Measurements of one finished precalc stage.
+struct PerfRow
+{
+  /// Stage name.
+  std::string m_name;
+
+  /// Wall clock time (milliseconds).
+  double m_wall_ms;
+
+  /// CPU time of the stage and threads it created (milliseconds), negative if not available.
+  double m_cpu_ms;
+
+  /// Cycles, negative if not available.
+  double m_cycles;
+
+  /// Instructions, negative if not available.
+  double m_instructions;
+
+  /// Last level cache misses, negative if not available.
+  double m_llc_misses;
+
+  /// Branch misses, negative if not available.
+  double m_branch_misses;
+
+  /// DRAM traffic in bytes over the whole system, negative if not available.
+  double m_dram_bytes;
+};
+
+/// Read the first line of a file.
+///
+/// \param filename File to read.
+/// \return First line or empty string.
+inline std::string perf_read_line(const std::string& filename)
+{
+  std::ifstream fd(filename.c_str());
+  std::string ret;
+  std::getline(fd, ret);
+  return ret;
+}
+
+/// Parse an event description from sysfs.
+///
+/// Only descriptions consisting of event and umask terms are supported.
+///
+/// \param op Description, for example "event=0x04,umask=0x03".
+/// \param config [out] Event config.
+/// \return True on success.
+inline bool perf_parse_event(const std::string& op, uint64_t& config)
+{
+  std::istringstream sstr(op);
+  std::string term;
+
+  config = 0;
+  while(std::getline(sstr, term, ','))
+  {
+    size_t separator = term.find('=');
+    if(std::string::npos == separator)
+    {
+      return false;
+    }
+    uint64_t value = strtoull(term.c_str() + separator + 1, NULL, 0);
+    std::string key = term.substr(0, separator);
+    if(key == "event")
+    {
+      config |= value;
+    }
+    else if(key == "umask")
+    {
+      config |= (value << 8);
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return !op.empty();
+}
+
+/// Open memory controller CAS counters for all memory controllers.
+///
+/// Requires permission for system-wide uncore events.
+///
+/// \param dst Counter to open into.
+inline void perf_open_imc(PerfCounter& dst)
+{
+  for(unsigned ii = 0; (ii < PERF_MAX_IMC); ++ii)
+  {
+    std::ostringstream sstr;
+    sstr << "/sys/bus/event_source/devices/uncore_imc_" << ii << "/";
+    std::string dir = sstr.str();
+    std::string type = perf_read_line(dir + "type");
+    if(type.empty())
+    {
+      continue;
+    }
+    // Uncore PMUs count on the first CPU of each package listed in cpumask.
+    std::istringstream cpumask(perf_read_line(dir + "cpumask"));
+    std::string cpu;
+    while(std::getline(cpumask, cpu, ','))
+    {
+      const char* events[] = { "cas_count_read", "cas_count_write" };
+      for(unsigned jj = 0; (jj < 2); ++jj)
+      {
+        uint64_t config;
+        if(perf_parse_event(perf_read_line(dir + "events/" + events[jj]), config))
+        {
+          dst.open(static_cast<uint32_t>(atoi(type.c_str())), config, atoi(cpu.c_str()));
+        }
+      }
+    }
+  }
+}
+
+/// Collected precalc stage measurements.
+class PerfReport
+{
+  private:
+    /// Finished stages.
+    std::vector<PerfRow> m_rows;
+
+    /// Reason for counters not being available, empty if they were.
+    std::string m_unavailable;
+
+    /// Guard for rows.
+    Mutex m_mutex;
+
+  private:
+    /// Constructor.
+    PerfReport()
+    {
+    }
+
+  public:
+    /// Add a finished stage.
+    ///
+    /// \param op Row to add.
+    void add(const PerfRow& op)
+    {
+      ScopedLock lock(m_mutex);
+      m_rows.push_back(op);
+    }
+
+    /// Note that hardware counters could not be opened.
+    ///
+    /// \param op Reason.
+    void setUnavailable(const std::string& op)
+    {
+      ScopedLock lock(m_mutex);
+      if(m_unavailable.empty())
+      {
+        m_unavailable = op;
+      }
+    }
+
+    /// Print the table of stages and clear it.
+    void print()
+    {
+      ScopedLock lock(m_mutex);
+
+      if(!m_unavailable.empty())
+      {
+        std::cout << "hardware counters not available: " << m_unavailable << std::endl;
+      }
+      std::cout << std::left << std::setw(18) << "stage" << std::right << std::setw(10) << "wall ms" <<
+        std::setw(10) << "cpu ms" << std::setw(10) << "Mcycles" << std::setw(10) << "Minstr" << std::setw(6) <<
+        "IPC" << std::setw(10) << "LLC MPKI" << std::setw(10) << "br MPKI" << std::setw(10) << "DRAM MB/s" <<
+        std::endl;
+
+      for(unsigned ii = 0; (ii < m_rows.size()); ++ii)
+      {
+        const PerfRow& row = m_rows[ii];
+        double kilo_instructions = row.m_instructions / 1000.0;
+
+        std::cout << std::left << std::setw(18) << row.m_name << std::right << std::fixed << std::setprecision(1) <<
+          std::setw(10) << row.m_wall_ms;
+        print_value(row.m_cpu_ms, 1.0, 10, 1);
+        print_value(row.m_cycles, 1e-6, 10, 1);
+        print_value(row.m_instructions, 1e-6, 10, 1);
+        print_value((row.m_cycles > 0.0) ? (row.m_instructions / row.m_cycles) : -1.0, 1.0, 6, 2);
+        print_value((kilo_instructions > 0.0) ? (row.m_llc_misses / kilo_instructions) : -1.0, 1.0, 10, 2);
+        print_value((kilo_instructions > 0.0) ? (row.m_branch_misses / kilo_instructions) : -1.0, 1.0, 10, 2);
+
+        // Without memory controller counters, estimate from LLC misses of the stage itself.
+        double seconds = row.m_wall_ms / 1000.0;
+        if((row.m_dram_bytes >= 0.0) && (seconds > 0.0))
+        {
+          print_value(row.m_dram_bytes / seconds, 1e-6, 10, 0);
+        }
+        else if((row.m_llc_misses >= 0.0) && (seconds > 0.0))
+        {
+          std::ostringstream sstr;
+          sstr << "~" << std::fixed << std::setprecision(0) <<
+            (row.m_llc_misses * PERF_BYTES_PER_LLC_MISS / seconds * 1e-6);
+          std::cout << std::setw(10) << sstr.str();
+        }
+        else
+        {
+          print_value(-1.0, 1.0, 10, 0);
+        }
+        std::cout << std::endl;
+      }
+      std::cout.unsetf(std::ios_base::floatfield);
+
+      m_rows.clear();
+    }
+
+  private:
+    /// Print one table cell.
+    ///
+    /// \param value Value, negative if not available.
+    /// \param mul Multiplier for value.
+    /// \param width Cell width.
+    /// \param precision Decimals.
+    static void print_value(double value, double mul, int width, int precision)
+    {
+      if(value < 0.0)
+      {
+        std::cout << std::setw(width) << "-";
+        return;
+      }
+      std::cout << std::setw(width) << std::setprecision(precision) << (value * mul);
+    }
+
+  public:
+    /// Accessor.
+    ///
+    /// \return Global report.
+    static PerfReport& get()
+    {
+      static PerfReport report;
+      return report;
+    }
+};
+
+/// Scoped measurement of one precalc stage.
+///
+/// Counts the constructing thread and all threads it creates until destruction.
+class PerfStage
+{
+  private:
+    /// Stage name.
+    std::string m_name;
+
+    /// Start time.
+    std::chrono::steady_clock::time_point m_start;
+
+    /// CPU time counter.
+    PerfCounter m_task_clock;
+
+    /// Cycle counter.
+    PerfCounter m_cycles;
+
+    /// Instruction counter.
+    PerfCounter m_instructions;
+
+    /// Last level cache miss counter.
+    PerfCounter m_llc_misses;
+
+    /// Branch miss counter.
+    PerfCounter m_branch_misses;
+
+    /// Memory controller CAS counter.
+    PerfCounter m_dram_cas;
+
+    /// Enclosing stage on this thread.
+    PerfStage* m_parent;
+
+  private:
+    /// Deleted copy constructor.
+    PerfStage(const PerfStage&) = delete;
+    /// Deleted assignment.
+    PerfStage& operator=(const PerfStage&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// Does nothing unless collection has been enabled.
+    ///
+    /// \param name Stage name.
+    explicit PerfStage(const std::string& name) :
+      m_name(name),
+      m_parent(get_current())
+    {
+      get_current() = this;
+      if(!g_perf_enabled)
+      {
+        return;
+      }
+
+      m_task_clock.open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+      int err = m_cycles.open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+      if(err)
+      {
+        std::string reason(strerror(err));
+        if((EACCES == err) || (EPERM == err))
+        {
+          reason += ", see /proc/sys/kernel/perf_event_paranoid";
+        }
+        PerfReport::get().setUnavailable(reason);
+      }
+      else
+      {
+        m_instructions.open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        m_llc_misses.open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        m_branch_misses.open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        perf_open_imc(m_dram_cas);
+      }
+
+      m_start = std::chrono::steady_clock::now();
+    }
+
+    /// Destructor.
+    ///
+    /// Adds the measurements to the report.
+    ~PerfStage()
+    {
+      get_current() = m_parent;
+      if(!g_perf_enabled)
+      {
+        return;
+      }
+
+      PerfRow row;
+      row.m_name = m_name;
+      row.m_wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+      row.m_cpu_ms = m_task_clock.isValid() ? (m_task_clock.read() * 1e-6) : -1.0;
+      row.m_cycles = m_cycles.isValid() ? m_cycles.read() : -1.0;
+      row.m_instructions = m_instructions.isValid() ? m_instructions.read() : -1.0;
+      row.m_llc_misses = m_llc_misses.isValid() ? m_llc_misses.read() : -1.0;
+      row.m_branch_misses = m_branch_misses.isValid() ? m_branch_misses.read() : -1.0;
+      row.m_dram_bytes = m_dram_cas.isValid() ? (m_dram_cas.read() * PERF_BYTES_PER_CAS) : -1.0;
+      PerfReport::get().add(row);
+    }
+
+  private:
+    /// Accessor.
+    ///
+    /// \return Reference to innermost stage on the calling thread.
+    static PerfStage*& get_current()
+    {
+      static thread_local PerfStage* current = NULL;
+      return current;
+    }
+
+  public:
+    /// Get the name of the innermost stage on the calling thread.
+    ///
+    /// Used to name stages of worker threads after the stage that spawned them.
+    ///
+    /// \return Stage name or empty string.
+    static std::string get_current_name()
+    {
+      PerfStage* stage = get_current();
+      return stage ? stage->m_name : std::string();
+    }
+};
+
+/// Print the report of finished precalc stages.
+///
+/// Does nothing unless collection has been enabled.
+inline void perf_report_print()
+{
+  if(g_perf_enabled)
+  {
+    PerfReport::get().print();
+  }
+}
+
+/// Measure the enclosing scope as a precalc stage.
+#define PERF_STAGE(name) PerfStage perf_stage_scope(name)
+
+#else
+
+#if defined(USE_LD)
+/// Print the report of finished precalc stages, not available on this platform.
+inline void perf_report_print()
+{
+}
+#endif
+
+#define PERF_STAGE(name)
+
+#endif
+
+#endif
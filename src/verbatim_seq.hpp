@@ -295,6 +295,24 @@ template<typename T> class seq
       return m_size;
     }
 
+    /// Swap contents with another array.
+    ///
+    /// \param op Array to swap with.
+    void swap(seq<T>& op)
+    {
+      T* data = m_data;
+      unsigned size = m_size;
+      unsigned capacity = m_capacity;
+
+      m_data = op.m_data;
+      m_size = op.m_size;
+      m_capacity = op.m_capacity;
+
+      op.m_data = data;
+      op.m_size = size;
+      op.m_capacity = capacity;
+    }
+
 #if defined(__LP64__)
     /// Access operator.
     ///
@@ -0,0 +1,90 @@
+#ifndef VERBATIM_SPSC_QUEUE_HPP
+#define VERBATIM_SPSC_QUEUE_HPP
+
+#include <atomic>
+
+/// Bounded lock-free single-producer, single-consumer queue.
+///
+/// Exactly one thread may push and exactly one thread may pop. Pushing publishes everything the producer wrote
+/// before the push to the consumer that pops the element.
+///
+/// \param T Element type, must be copyable.
+/// \param N Capacity, must be a power of two.
+template<typename T, unsigned N> class SpscQueue
+{
+  private:
+    static_assert((N > 0) && ((N & (N - 1)) == 0), "SpscQueue capacity must be a power of two");
+
+  private:
+    /// Elements.
+    T m_data[N];
+
+    /// Number of elements pushed, only written by the producer.
+    std::atomic<unsigned> m_head;
+
+    /// Number of elements popped, only written by the consumer.
+    std::atomic<unsigned> m_tail;
+
+  private:
+    /// Deleted copy constructor.
+    SpscQueue(const SpscQueue&) = delete;
+    /// Deleted assignment.
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+  public:
+    /// Constructor.
+    SpscQueue() :
+      m_head(0),
+      m_tail(0)
+    {
+    }
+
+  public:
+    /// Tell if the queue is empty.
+    ///
+    /// Exact only when called from the consumer.
+    ///
+    /// \return True if yes, false if no.
+    bool empty() const
+    {
+      return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+    }
+
+    /// Pop an element.
+    ///
+    /// Only call from the consumer thread.
+    ///
+    /// \param op [out] Popped element.
+    /// \return True if an element was popped, false if the queue was empty.
+    bool pop(T& op)
+    {
+      unsigned tail = m_tail.load(std::memory_order_relaxed);
+      if(m_head.load(std::memory_order_acquire) == tail)
+      {
+        return false;
+      }
+      op = m_data[tail & (N - 1)];
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /// Push an element.
+    ///
+    /// Only call from the producer thread.
+    ///
+    /// \param op Element to push.
+    /// \return True if the element was pushed, false if the queue was full.
+    bool push(const T& op)
+    {
+      unsigned head = m_head.load(std::memory_order_relaxed);
+      if((head - m_tail.load(std::memory_order_acquire)) >= N)
+      {
+        return false;
+      }
+      m_data[head & (N - 1)] = op;
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+};
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef VERBATIM_TEXTURE_HPP
 #define VERBATIM_TEXTURE_HPP
 
+#include "verbatim_texture_format.hpp"
+#include "verbatim_uarr.hpp"
+
 /// Filtering mode.
 enum FilteringMode
 {
@@ -50,6 +53,35 @@ class Texture
     /// OpenGL texture name.
     GLuint m_id;
 
+#if defined(USE_LD)
+    /// Number of channels in contents, 0 for depth texture.
+    unsigned m_channels;
+
+    /// Bytes per component in contents.
+    unsigned m_bpc;
+
+    /// True if contents were uploaded from an image, false for render targets.
+    bool m_has_data;
+
+    /// GPU memory used by contents in bytes.
+    unsigned m_data_size;
+
+    /// Full resolution width.
+    unsigned m_full_width;
+
+    /// Full resolution height.
+    unsigned m_full_height;
+
+    /// Full resolution depth.
+    unsigned m_full_depth;
+
+    /// Full resolution contents of level 0, read back on first reduction.
+    uarr<uint8_t> m_backup;
+
+    /// Resolution reduction as a power of two, 0 for full resolution.
+    unsigned m_reduction;
+#endif
+
   private:
     /// Deleted copy constructor.
     Texture(const Texture&) = delete;
@@ -60,6 +92,16 @@ class Texture
     /// Constructor.
     explicit Texture(GLenum type) :
       m_type(type)
+#if defined(USE_LD)
+      , m_channels(0),
+      m_bpc(0),
+      m_has_data(false),
+      m_data_size(0),
+      m_full_width(0),
+      m_full_height(0),
+      m_full_depth(0),
+      m_reduction(0)
+#endif
     {
       dnload_glGenTextures(1, &m_id);
     }
@@ -172,6 +214,34 @@ class Texture
     }
 
 #if defined(USE_LD)
+    /// Record new contents.
+    ///
+    /// Resets any reduction, since the old full resolution contents are no longer valid.
+    ///
+    /// \param channels Number of channels, 0 for depth texture.
+    /// \param bpc Bytes per component.
+    /// \param has_data True if contents were uploaded from an image.
+    /// \param data_size GPU memory used in bytes.
+    void setContents(unsigned channels, unsigned bpc, bool has_data, unsigned data_size)
+    {
+      m_channels = channels;
+      m_bpc = bpc;
+      m_has_data = has_data;
+      m_backup.reset();
+      m_reduction = 0;
+      setDataSize(data_size);
+    }
+
+    /// Set GPU memory used by contents.
+    ///
+    /// \param op Size in bytes.
+    void setDataSize(unsigned op)
+    {
+      // Unsigned arithmetic wraps, so this also works when the size decreases.
+      vgl::increment_data_size_texture(op - m_data_size);
+      m_data_size = op;
+    }
+
     /// Unbind texture from whichever texture unit it's bound to.
     void unbind() const
     {
@@ -214,6 +284,24 @@ class Texture
       }
     }
 
+    /// Turn on trilinear filtering for rendered contents.
+    ///
+    /// Framebuffer textures are created without mipmaps, call after rendering to sample them minified.
+    void generateMipmaps()
+    {
+      const Texture* prev_texture = updateBegin();
+
+      dnload_glTexParameteri(m_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      dnload_glGenerateMipmap(m_type);
+
+#if defined(USE_LD)
+      // Rendered contents must survive reduction like uploaded images.
+      setContents(m_channels, m_bpc, true, (m_data_size * 4) / 3);
+#endif
+
+      updateEnd(prev_texture);
+    }
+
     /// Accessor.
     ///
     /// \return Texture id.
@@ -230,6 +318,214 @@ class Texture
       return m_type;
     }
 
+#if defined(USE_LD)
+    /// Accessor.
+    ///
+    /// \return GPU memory used by contents in bytes.
+    unsigned getDataSize() const
+    {
+      return m_data_size;
+    }
+
+    /// Accessor.
+    ///
+    /// \return Resolution reduction as a power of two, 0 for full resolution.
+    unsigned getReduction() const
+    {
+      return m_reduction;
+    }
+
+  private:
+    /// Get number of faces.
+    ///
+    /// \return 6 for cube maps, 1 otherwise.
+    unsigned getFaceCount() const
+    {
+      return (GL_TEXTURE_CUBE_MAP == m_type) ? 6 : 1;
+    }
+
+    /// Get target for specifying one face.
+    ///
+    /// \param op Face index.
+    /// \return Target for glTexImage calls.
+    GLenum getFaceTarget(unsigned op) const
+    {
+      return (GL_TEXTURE_CUBE_MAP == m_type) ? (GL_TEXTURE_CUBE_MAP_POSITIVE_X + op) : m_type;
+    }
+
+    /// Tell if the current filtering uses mipmaps.
+    ///
+    /// Texture must be bound.
+    ///
+    /// \return True if mipmaps are in use.
+    bool hasMipmaps() const
+    {
+      GLint filter;
+      glGetTexParameteriv(m_type, GL_TEXTURE_MIN_FILTER, &filter);
+      return (GL_NEAREST != filter) && (GL_LINEAR != filter);
+    }
+
+    /// Replace level 0 of all faces and regenerate mipmaps if in use.
+    ///
+    /// Texture must be bound. Levels of the previous contents are freed.
+    ///
+    /// \param width New width.
+    /// \param height New height.
+    /// \param depth New depth.
+    /// \param data Tightly packed contents of all faces, NULL for undefined contents.
+    void respecify(unsigned width, unsigned height, unsigned depth, const uint8_t* data)
+    {
+      TextureFormat format(m_channels, m_bpc, m_has_data ? reinterpret_cast<void*>(1u) : NULL);
+      unsigned face_size = width * height * depth * format.getTypeSize();
+      bool mipmaps = hasMipmaps();
+
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      for(unsigned ii = 0; (ii < getFaceCount()); ++ii)
+      {
+        GLenum target = getFaceTarget(ii);
+        const uint8_t* face_data = data ? (data + ii * face_size) : NULL;
+
+        // Empty images free the storage of levels the new contents do not reach.
+        for(unsigned jj = 1; ((m_full_width >> jj) || (m_full_height >> jj)); ++jj)
+        {
+          if(GL_TEXTURE_3D == m_type)
+          {
+            glTexImage3D(target, static_cast<GLint>(jj), format.getInternalFormat(), 0, 0, 0, 0,
+                format.getFormat(), format.getType(), NULL);
+          }
+          else
+          {
+            glTexImage2D(target, static_cast<GLint>(jj), format.getInternalFormat(), 0, 0, 0,
+                format.getFormat(), format.getType(), NULL);
+          }
+        }
+
+        if(GL_TEXTURE_3D == m_type)
+        {
+          glTexImage3D(target, 0, format.getInternalFormat(), static_cast<GLsizei>(width),
+              static_cast<GLsizei>(height), static_cast<GLsizei>(depth), 0, format.getFormat(), format.getType(),
+              face_data);
+        }
+        else
+        {
+          glTexImage2D(target, 0, format.getInternalFormat(), static_cast<GLsizei>(width),
+              static_cast<GLsizei>(height), 0, format.getFormat(), format.getType(), face_data);
+        }
+      }
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+      unsigned data_size = face_size * getFaceCount();
+      if(mipmaps)
+      {
+        glGenerateMipmap(m_type);
+        data_size = (GL_TEXTURE_3D == m_type) ? ((data_size * 8) / 7) : ((data_size * 4) / 3);
+      }
+      setDataSize(data_size);
+    }
+
+  public:
+    /// Reduce resolution to free GPU memory.
+    ///
+    /// Contents are downsampled from a full resolution copy read back on the first reduction. Render targets and
+    /// discarded textures are not read back, their contents are undefined after reduction and restore.
+    ///
+    /// \param op Resolution reduction as a power of two, 0 to restore.
+    /// \param keep False to discard contents (default: true).
+    void reduce(unsigned op, bool keep = true)
+    {
+      if(op == m_reduction)
+      {
+        return;
+      }
+      if(!op)
+      {
+        restore();
+        return;
+      }
+
+      const Texture* prev_texture = updateBegin();
+      TextureFormat format(m_channels, m_bpc, m_has_data ? reinterpret_cast<void*>(1u) : NULL);
+      unsigned texel_size = format.getTypeSize();
+
+      if(!m_reduction)
+      {
+        GLint width;
+        GLint height;
+        GLint depth;
+        glGetTexLevelParameteriv(getFaceTarget(0), 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(getFaceTarget(0), 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(getFaceTarget(0), 0, GL_TEXTURE_DEPTH, &depth);
+        m_full_width = static_cast<unsigned>(width);
+        m_full_height = static_cast<unsigned>(height);
+        m_full_depth = static_cast<unsigned>(depth);
+
+        if(m_has_data && keep && !m_backup)
+        {
+          unsigned face_size = m_full_width * m_full_height * m_full_depth * texel_size;
+          m_backup.resize(face_size * getFaceCount());
+
+          glPixelStorei(GL_PACK_ALIGNMENT, 1);
+          for(unsigned ii = 0; (ii < getFaceCount()); ++ii)
+          {
+            glGetTexImage(getFaceTarget(ii), 0, format.getFormat(), format.getType(),
+                m_backup.get() + ii * face_size);
+          }
+          glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        }
+      }
+
+      unsigned width = std::max(m_full_width >> op, 1u);
+      unsigned height = std::max(m_full_height >> op, 1u);
+      unsigned depth = std::max(m_full_depth >> op, 1u);
+
+      // Point sample the full resolution copy.
+      uarr<uint8_t> reduced;
+      if(m_backup)
+      {
+        reduced.resize(width * height * depth * texel_size * getFaceCount());
+
+        uint8_t* dst = reduced.get();
+        for(unsigned ii = 0; (ii < getFaceCount()); ++ii)
+        {
+          for(unsigned kk = 0; (kk < depth); ++kk)
+          {
+            for(unsigned jj = 0; (jj < height); ++jj)
+            {
+              for(unsigned hh = 0; (hh < width); ++hh)
+              {
+                unsigned src_idx = ((ii * m_full_depth + (kk << op)) * m_full_height + (jj << op)) * m_full_width +
+                  (hh << op);
+                memcpy(dst, m_backup.get() + src_idx * texel_size, texel_size);
+                dst += texel_size;
+              }
+            }
+          }
+        }
+      }
+
+      respecify(width, height, depth, reduced.get());
+      m_reduction = op;
+
+      updateEnd(prev_texture);
+    }
+
+    /// Restore full resolution after reduce().
+    void restore()
+    {
+      if(!m_reduction)
+      {
+        return;
+      }
+
+      const Texture* prev_texture = updateBegin();
+
+      respecify(m_full_width, m_full_height, m_full_depth, m_backup.get());
+      m_reduction = 0;
+
+      updateEnd(prev_texture);
+    }
+#endif
+
   private:
     /// Activate a texture unit.
     ///
@@ -22,7 +22,7 @@ class Texture2D : public Texture
     {
     }
 
-  private:
+  public:
     /// Explicit update operation.
     ///
     /// \param width Width of the texture.
@@ -57,7 +57,7 @@ class Texture2D : public Texture
       setWrapMode(wrap);
 
 #if defined(USE_LD)
-      vgl::increment_data_size_texture(data_size);
+      setContents(channels, bpc, (NULL != data), data_size);
 #endif
 
       updateEnd(prev_texture);
@@ -60,7 +60,7 @@ class Texture3D : public Texture
       setWrapMode(wrap);
 
 #if defined(USE_LD)
-      vgl::increment_data_size_texture(data_size);
+      setContents(channels, bpc, (NULL != data), data_size);
 #endif
 
       updateEnd(prev_texture);
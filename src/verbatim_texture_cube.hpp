@@ -70,6 +70,10 @@ class TextureCube : public Texture
 
       const Texture* prev_texture = updateBegin();
 
+#if defined(USE_LD)
+      // Updates may replace contents with a different resolution, sides only need to match each other.
+      m_side = 0;
+#endif
       updateSide(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, img.getSideNegX(), bpc);
       updateSide(GL_TEXTURE_CUBE_MAP_POSITIVE_X, img.getSidePosX(), bpc);
       updateSide(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, img.getSideNegY(), bpc);
@@ -78,10 +82,66 @@ class TextureCube : public Texture
       updateSide(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, img.getSidePosZ(), bpc);
 
       // Seamless cube map enabled -> wrap mode does not need to be set.
+#if defined(USE_LD)
+      TextureFormat format(img.getSideNegX().getChannelCount(), bpc, reinterpret_cast<void*>(1u));
+      unsigned data_size = m_side * m_side * 6 * format.getTypeSize();
+      if(setFiltering(reinterpret_cast<void*>(1), filtering))
+      {
+        data_size = (data_size * 4) / 3;
+      }
+      setContents(img.getSideNegX().getChannelCount(), bpc, true, data_size);
+#else
       setFiltering(reinterpret_cast<void*>(1), filtering);
+#endif
 
       updateEnd(prev_texture);
     }
+
+#if defined(USE_LD)
+    /// Allocate texture storage without contents, e.g. for writing from compute shaders.
+    ///
+    /// The texture has no mipmaps and uses bilinear filtering until updateFiltering() is called.
+    ///
+    /// \param side Side length.
+    /// \param internal_format Internal format.
+    void allocate(unsigned side, GLenum internal_format)
+    {
+      glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+      const Texture* prev_texture = updateBegin();
+
+      for(unsigned ii = 0; (ii < 6); ++ii)
+      {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + ii, 0, static_cast<GLint>(internal_format),
+            static_cast<GLsizei>(side), static_cast<GLsizei>(side), 0, GL_RGBA, GL_FLOAT, NULL);
+      }
+      m_side = side;
+
+      // Image units need a complete texture, which it is not before mipmaps exist.
+      setFiltering(reinterpret_cast<void*>(1), BILINEAR);
+
+      // Recorded as if uploaded from an image of matching format, so reduction keeps the contents.
+      unsigned bpc = (GL_RGBA16 == internal_format) ? 2 : 1;
+      setContents(4, bpc, true, side * side * 6 * 4 * bpc);
+
+      updateEnd(prev_texture);
+    }
+
+    /// Set filtering after contents have been written on the GPU.
+    ///
+    /// \param filtering Filtering mode (default: trilinear).
+    void updateFiltering(FilteringMode filtering = TRILINEAR)
+    {
+      const Texture* prev_texture = updateBegin();
+
+      if(setFiltering(reinterpret_cast<void*>(1), filtering))
+      {
+        setDataSize((getDataSize() * 4) / 3);
+      }
+
+      updateEnd(prev_texture);
+    }
+#endif
 };
 
 #endif
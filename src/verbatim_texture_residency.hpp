@@ -0,0 +1,136 @@
+#ifndef VERBATIM_TEXTURE_RESIDENCY_HPP
+#define VERBATIM_TEXTURE_RESIDENCY_HPP
+
+#if defined(USE_LD)
+
+#include "verbatim_texture.hpp"
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+/// Keeps textures at full resolution only around the time they are used.
+///
+/// Each managed texture has a list of time spans it is sampled in. Textures not needed within the lookahead are
+/// reduced to free GPU memory and restored before their next span starts. At most one texture changes per update
+/// so the cost of readbacks and uploads is spread over frames.
+class TextureResidency
+{
+  private:
+    /// Managed texture.
+    struct Entry
+    {
+      /// Name for reporting.
+      const char* name;
+
+      /// Texture.
+      Texture* texture;
+
+      /// Time spans [start, end) the texture is used in.
+      std::vector<std::pair<int, int> > spans;
+    };
+
+  private:
+    /// Managed textures.
+    std::vector<Entry> m_entries;
+
+    /// Milliseconds before use a texture is restored.
+    int m_lookahead;
+
+    /// Resolution reduction as a power of two for textures not needed soon.
+    unsigned m_reduction;
+
+  private:
+    /// Deleted copy constructor.
+    TextureResidency(const TextureResidency&) = delete;
+    /// Deleted assignment.
+    TextureResidency& operator=(const TextureResidency&) = delete;
+
+  public:
+    /// Constructor.
+    ///
+    /// \param lookahead Milliseconds before use a texture is restored.
+    /// \param reduction Resolution reduction as a power of two (default: 3).
+    explicit TextureResidency(int lookahead, unsigned reduction = 3) :
+      m_lookahead(lookahead),
+      m_reduction(reduction)
+    {
+    }
+
+  private:
+    /// Tell if an entry is needed within the lookahead.
+    ///
+    /// \param entry Entry.
+    /// \param ticks Current time.
+    /// \return True if needed.
+    bool isNeeded(const Entry& entry, int ticks) const
+    {
+      for(const std::pair<int, int>& vv : entry.spans)
+      {
+        if((ticks >= vv.first - m_lookahead) && (ticks < vv.second))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+  public:
+    /// Add a texture.
+    ///
+    /// \param name Name for reporting.
+    /// \param texture Texture.
+    /// \param spans Time spans [start, end) the texture is used in, empty to discard contents.
+    void add(const char* name, Texture& texture, const std::vector<std::pair<int, int> >& spans)
+    {
+      Entry entry;
+      entry.name = name;
+      entry.texture = &texture;
+      entry.spans = spans;
+      m_entries.push_back(entry);
+    }
+
+    /// Restore all textures to full resolution.
+    void restoreAll()
+    {
+      for(Entry& vv : m_entries)
+      {
+        vv.texture->restore();
+      }
+    }
+
+    /// Update residency for current time.
+    ///
+    /// \param ticks Current time.
+    void update(int ticks)
+    {
+      // Restores take priority over reductions.
+      for(Entry& vv : m_entries)
+      {
+        if(vv.texture->getReduction() && isNeeded(vv, ticks))
+        {
+          int start_ticks = get_current_ticks();
+          vv.texture->restore();
+          std::cout << "residency: restored " << vv.name << " at " << ticks << " (" <<
+            (get_current_ticks() - start_ticks) << " ms)" << std::endl;
+          return;
+        }
+      }
+
+      for(Entry& vv : m_entries)
+      {
+        if(!vv.texture->getReduction() && !isNeeded(vv, ticks))
+        {
+          int start_ticks = get_current_ticks();
+          vv.texture->reduce(m_reduction, !vv.spans.empty());
+          std::cout << "residency: reduced " << vv.name << " at " << ticks << " (" <<
+            (get_current_ticks() - start_ticks) << " ms)" << std::endl;
+          return;
+        }
+      }
+    }
+};
+
+#endif
+
+#endif
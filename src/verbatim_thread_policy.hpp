@@ -0,0 +1,331 @@
+#ifndef VERBATIM_THREAD_POLICY_HPP
+#define VERBATIM_THREAD_POLICY_HPP
+
+/// Thread policy is only applied in developer builds.
+///
+/// Release builds only link the symbols in the dnload table and keep default scheduling.
+#if defined(USE_LD)
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// Role of a thread, determines its scheduling.
+enum ThreadRole
+{
+  /// Main thread, owns the GL context.
+  THREAD_ROLE_RENDER = 0,
+
+  /// Audio callback thread.
+  THREAD_ROLE_AUDIO,
+
+  /// Background computation, i.e. precalc and synth.
+  THREAD_ROLE_PRECALC
+};
+
+/// Number of cores to reserve for render and audio threads, negative to select automatically.
+static int g_thread_reserved_cores = -1;
+
+/// Nice value for background threads.
+static int g_thread_precalc_nice = 10;
+
+/// Realtime priority for the audio thread, 0 to not request realtime scheduling.
+static int g_thread_audio_priority = 10;
+
+/// CPU reserved for the render thread, negative if not reserved.
+static int g_thread_render_cpu = -1;
+
+/// CPU reserved for the audio thread, negative if not reserved.
+static int g_thread_audio_cpu = -1;
+
+/// CPUs background threads may run on, empty if not restricted.
+static std::vector<int> g_thread_precalc_cpus;
+
+/// Get a human-readable name for a thread role.
+///
+/// \param op Thread role.
+/// \return Role name.
+inline const char* thread_role_name(ThreadRole op)
+{
+  switch(op)
+  {
+    case THREAD_ROLE_RENDER:
+      return "render";
+
+    case THREAD_ROLE_AUDIO:
+      return "audio";
+
+    case THREAD_ROLE_PRECALC:
+    default:
+      return "precalc";
+  }
+}
+
+#if defined(__linux__)
+
+/// Read the topology of a CPU from sysfs.
+///
+/// \param cpu CPU index.
+/// \param name Topology file name, for example "core_id".
+/// \return Value or -1 if not available.
+inline int thread_policy_read_topology(int cpu, const char* name)
+{
+  std::ostringstream sstr;
+  sstr << "/sys/devices/system/cpu/cpu" << cpu << "/topology/" << name;
+  FILE* fd = fopen(sstr.str().c_str(), "r");
+  if(!fd)
+  {
+    return -1;
+  }
+  int ret = -1;
+  if(fscanf(fd, "%d", &ret) != 1)
+  {
+    ret = -1;
+  }
+  fclose(fd);
+  return ret;
+}
+
+/// Set the affinity of the calling thread.
+///
+/// \param cpus CPUs to run on.
+/// \return Empty string on success, error on failure.
+inline std::string thread_policy_set_affinity(const std::vector<int>& cpus)
+{
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for(unsigned ii = 0; (ii < cpus.size()); ++ii)
+  {
+    CPU_SET(cpus[ii], &mask);
+  }
+  // Zero pid is the calling thread, not the whole process.
+  if(sched_setaffinity(0, sizeof(mask), &mask))
+  {
+    return std::string(strerror(errno));
+  }
+  return std::string();
+}
+
+#endif
+
+/// Format a list of CPUs.
+///
+/// \param cpus CPUs.
+/// \return List as string.
+inline std::string thread_policy_format_cpus(const std::vector<int>& cpus)
+{
+  std::ostringstream sstr;
+  for(unsigned ii = 0; (ii < cpus.size()); ++ii)
+  {
+    sstr << (ii ? "," : "") << cpus[ii];
+  }
+  return sstr.str();
+}
+
+/// Decide which cores are reserved and print the resulting topology.
+///
+/// Must be called before any threads that the policy applies to are created. Reserved cores are picked from
+/// distinct physical cores where possible, at least one CPU is always left for background threads.
+inline void thread_policy_initialize()
+{
+#if defined(__linux__)
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if(sched_getaffinity(0, sizeof(mask), &mask))
+  {
+    std::cout << "thread policy: cannot get affinity: " << strerror(errno) << std::endl;
+    return;
+  }
+
+  std::vector<int> allowed;
+  for(int ii = 0; (ii < CPU_SETSIZE); ++ii)
+  {
+    if(CPU_ISSET(ii, &mask))
+    {
+      allowed.push_back(ii);
+    }
+  }
+  int cpu_count = static_cast<int>(allowed.size());
+
+  int reserved = g_thread_reserved_cores;
+  if(reserved < 0)
+  {
+    reserved = (cpu_count >= 8) ? 2 : ((cpu_count >= 4) ? 1 : 0);
+  }
+  reserved = std::min(std::min(reserved, 2), cpu_count - 1);
+
+  // Prefer CPUs on different physical cores so SMT siblings of reserved CPUs are used last.
+  std::vector<int> reserved_cpus;
+  for(int ii = 0; (ii < cpu_count) && (static_cast<int>(reserved_cpus.size()) < reserved); ++ii)
+  {
+    int cpu = allowed[ii];
+    bool sibling = false;
+    for(unsigned jj = 0; (jj < reserved_cpus.size()); ++jj)
+    {
+      int other = reserved_cpus[jj];
+      if((thread_policy_read_topology(cpu, "core_id") == thread_policy_read_topology(other, "core_id")) &&
+          (thread_policy_read_topology(cpu, "physical_package_id") ==
+           thread_policy_read_topology(other, "physical_package_id")))
+      {
+        sibling = true;
+      }
+    }
+    if(!sibling)
+    {
+      reserved_cpus.push_back(cpu);
+    }
+  }
+  for(int ii = 0; (ii < cpu_count) && (static_cast<int>(reserved_cpus.size()) < reserved); ++ii)
+  {
+    if(std::find(reserved_cpus.begin(), reserved_cpus.end(), allowed[ii]) == reserved_cpus.end())
+    {
+      reserved_cpus.push_back(allowed[ii]);
+    }
+  }
+
+  g_thread_render_cpu = reserved_cpus.empty() ? -1 : reserved_cpus[0];
+  g_thread_audio_cpu = reserved_cpus.empty() ? -1 : reserved_cpus.back();
+  g_thread_precalc_cpus.clear();
+  if(!reserved_cpus.empty())
+  {
+    for(int ii = 0; (ii < cpu_count); ++ii)
+    {
+      if(std::find(reserved_cpus.begin(), reserved_cpus.end(), allowed[ii]) == reserved_cpus.end())
+      {
+        g_thread_precalc_cpus.push_back(allowed[ii]);
+      }
+    }
+  }
+
+  std::cout << "thread policy: " << cpu_count << " CPUs (" << thread_policy_format_cpus(allowed) << ")";
+  for(int ii = 0; (ii < cpu_count); ++ii)
+  {
+    int core = thread_policy_read_topology(allowed[ii], "core_id");
+    int package = thread_policy_read_topology(allowed[ii], "physical_package_id");
+    if((core >= 0) && (package >= 0))
+    {
+      std::cout << (ii ? ", " : ", cores: ") << allowed[ii] << "=" << package << ":" << core;
+    }
+  }
+  std::cout << std::endl;
+  if(reserved_cpus.empty())
+  {
+    std::cout << "thread policy: no cores reserved" << std::endl;
+  }
+  else
+  {
+    std::cout << "thread policy: render on " << g_thread_render_cpu << ", audio on " << g_thread_audio_cpu <<
+      ", precalc on " << thread_policy_format_cpus(g_thread_precalc_cpus) << " with nice " <<
+      g_thread_precalc_nice << std::endl;
+  }
+#else
+  std::cout << "thread policy: core reservation not supported on this platform" << std::endl;
+#endif
+}
+
+/// Apply the policy of a role to the calling thread.
+///
+/// Threads created afterwards by the calling thread inherit its affinity and nice value, so precalc workers
+/// spawned from a precalc thread need no further calls. Failures due to missing permissions are reported but
+/// not fatal.
+///
+/// \param role Thread role.
+inline void thread_policy_apply(ThreadRole role)
+{
+  std::ostringstream sstr;
+  sstr << "thread policy: " << thread_role_name(role) << ":";
+
+#if defined(__linux__)
+  int cpu = (THREAD_ROLE_RENDER == role) ? g_thread_render_cpu :
+    ((THREAD_ROLE_AUDIO == role) ? g_thread_audio_cpu : -1);
+  std::vector<int> cpus;
+  if(cpu >= 0)
+  {
+    cpus.push_back(cpu);
+  }
+  else if(THREAD_ROLE_PRECALC == role)
+  {
+    cpus = g_thread_precalc_cpus;
+  }
+  if(!cpus.empty())
+  {
+    std::string err = thread_policy_set_affinity(cpus);
+    sstr << " cpu " << thread_policy_format_cpus(cpus);
+    if(!err.empty())
+    {
+      sstr << " (" << err << ")";
+    }
+  }
+#endif
+
+  switch(role)
+  {
+    case THREAD_ROLE_RENDER:
+      sstr << " priority high";
+      if(SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH))
+      {
+        sstr << " (" << SDL_GetError() << ")";
+      }
+      break;
+
+    case THREAD_ROLE_AUDIO:
+#if defined(__linux__)
+      if(g_thread_audio_priority > 0)
+      {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = g_thread_audio_priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(!err)
+        {
+          sstr << " SCHED_FIFO " << g_thread_audio_priority;
+          break;
+        }
+        sstr << " SCHED_FIFO (" << strerror(err) << "),";
+      }
+#endif
+      sstr << " priority high";
+      if(SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH))
+      {
+        sstr << " (" << SDL_GetError() << ")";
+      }
+      break;
+
+    case THREAD_ROLE_PRECALC:
+    default:
+#if defined(__linux__)
+      // Nice values are per-thread on Linux.
+      sstr << " nice " << g_thread_precalc_nice;
+      if(setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), g_thread_precalc_nice))
+      {
+        sstr << " (" << strerror(errno) << ")";
+      }
+#else
+      sstr << " priority low";
+      if(SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW))
+      {
+        sstr << " (" << SDL_GetError() << ")";
+      }
+#endif
+      break;
+  }
+
+  std::cout << sstr.str() << std::endl;
+}
+
+#endif
+
+#endif